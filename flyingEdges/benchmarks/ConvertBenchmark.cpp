@@ -0,0 +1,189 @@
+/*
+ * ConvertBenchmark.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+#include <iostream>
+#include <string.h>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "../util/ConvertBuffer.h"
+#include "../util/TypeInfo.h"
+
+#include "../util/Timer.h"
+#include "../mantevoCommon/YAML_Doc.hpp"
+
+// The big endian bytes of n values of type T, as in an image file.
+template <typename T>
+std::vector<char> makeValues(size_t n)
+{
+    std::vector<char> bytes(n * sizeof(T));
+    T* values = reinterpret_cast<T*>(bytes.data());
+    uint32_t state = 12345;
+    for(size_t i = 0; i != n; ++i)
+    {
+        state = state * 1103515245 + 12345;
+        values[i] = static_cast<T>(int32_t(state) >> 8);
+        util::flipEndianness(values[i]);
+    }
+    return bytes;
+}
+
+// The conversion as it was before the byte swap kernels, one value at a
+// time.
+template <typename SrcT, typename DstT>
+void referenceConvert(const char* in, size_t n, DstT* out)
+{
+    const SrcT* src = reinterpret_cast<const SrcT*>(in);
+    for(size_t i = 0; i != n; ++i)
+    {
+        SrcT val = src[i];
+        util::flipEndianness(val);
+        out[i] = static_cast<DstT>(val);
+    }
+}
+
+// Best wall time over the repetitions of converting bytes into result.
+template <typename DstT, typename ConvertFunction>
+double timeConvert(std::vector<char> const& bytes, size_t n, int repeat,
+                   ConvertFunction convert, std::vector<DstT>& result)
+{
+    result.assign(n, DstT());
+
+    double best = std::numeric_limits<double>::max();
+    for(int r = 0; r != repeat; ++r)
+    {
+        util::Timer timer;
+        convert(bytes.data(), n, result.data());
+        timer.stop();
+
+        best = std::min(best, timer.getWallTime());
+    }
+    return best;
+}
+
+// Times the reference, the kernel on one thread and the kernel on all of
+// the threads converting n values of type SrcT to DstT, and reports the
+// bytes of the file read per second.
+template <typename SrcT, typename DstT>
+void benchmark(YAML_Doc& doc, size_t n, int repeat)
+{
+    util::TypeInfo ti = util::createTemplateTypeInfo<SrcT>();
+    util::TypeInfo to = util::createTemplateTypeInfo<DstT>();
+    std::string name = std::string(ti.name()) + " to " + to.name();
+
+    std::vector<char> bytes = makeValues<SrcT>(n);
+
+    std::vector<DstT> reference;
+    std::vector<DstT> serial;
+    std::vector<DstT> parallel;
+
+    double referenceTime = timeConvert(bytes, n, repeat,
+        referenceConvert<SrcT, DstT>, reference);
+    double serialTime = timeConvert(bytes, n, repeat,
+        [&ti](const char* in, size_t n, DstT* out)
+        {
+            util::convertBufferWithTypeInfo(in, ti, n, out);
+        },
+        serial);
+    double parallelTime = timeConvert(bytes, n, repeat,
+        [&ti](const char* in, size_t n, DstT* out)
+        {
+            util::convertBufferWithTypeInfoParallel(in, ti, n, out);
+        },
+        parallel);
+
+    double gigabytes = bytes.size() / 1e9;
+    bool match = reference == serial && reference == parallel;
+
+    doc.add(name, "");
+    doc.get(name)->add("Conversions match", match ? "yes" : "no");
+    doc.get(name)->add("Reference (GB/s)", gigabytes / referenceTime);
+    doc.get(name)->add("Kernel (GB/s)", gigabytes / serialTime);
+    doc.get(name)->add("Parallel kernel (GB/s)", gigabytes / parallelTime);
+}
+
+template <typename DstT>
+void benchmarkAllTypes(YAML_Doc& doc, size_t n, int repeat)
+{
+    benchmark<char, DstT>(doc, n, repeat);
+    benchmark<unsigned char, DstT>(doc, n, repeat);
+    benchmark<short, DstT>(doc, n, repeat);
+    benchmark<unsigned short, DstT>(doc, n, repeat);
+    benchmark<int, DstT>(doc, n, repeat);
+    benchmark<float, DstT>(doc, n, repeat);
+    benchmark<double, DstT>(doc, n, repeat);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = size_t(1) << 25;
+    int repeat = 5;
+    std::string yamlDirectory = "";
+    std::string yamlFileName  = "";
+
+    // Read command line arguments
+    for(int i=0; i<argc; i++)
+    {
+        if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-num_values") == 0))
+        {
+            n = std::stoul(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-r") == 0) || (strcmp(argv[i], "-repeat") == 0))
+        {
+            repeat = std::max(1, atoi(argv[++i]));
+        }
+        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
+        {
+            std::string wholeFile(argv[++i]);
+
+            std::size_t pos = wholeFile.rfind("/");
+            if(pos == std::string::npos)
+            {
+                yamlDirectory = "./";
+                yamlFileName = wholeFile;
+            }
+            else
+            {
+                yamlDirectory = wholeFile.substr(0, pos + 1);
+                yamlFileName = wholeFile.substr(pos + 1);
+            }
+        }
+        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
+        {
+            std::cout <<
+                "Flying Edges Convert Benchmark Options:" << std::endl <<
+                "  -num_values (-n), default 2^25" << std::endl <<
+                "  -repeat (-r), default 5"       << std::endl <<
+                "  -yaml_output_file (-y)"        << std::endl <<
+                "  -help (-h)"                    << std::endl;
+            return 0;
+        }
+    }
+
+    YAML_Doc doc("Flying Edges Convert Benchmark", "0.1",
+                 yamlDirectory, yamlFileName);
+
+    doc.add("Number of values", n);
+    doc.add("Repetitions", repeat);
+    doc.add("Number of threads", omp_get_max_threads());
+    doc.add("Byte swap kernel", util::byteSwapKernelName());
+
+    benchmarkAllTypes<float>(doc, n, repeat);
+    benchmarkAllTypes<double>(doc, n, repeat);
+
+    std::cout << doc.generateYAML();
+}
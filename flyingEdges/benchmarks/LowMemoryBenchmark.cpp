@@ -0,0 +1,199 @@
+/*
+ * LowMemoryBenchmark.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+#include <iostream>
+#include <string.h>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include "../serial/FlyingEdgesAlgorithm.h"
+
+#include "../util/LoadImage.h"
+
+#include "../util/Timer.h"
+#include "../mantevoCommon/YAML_Doc.hpp"
+
+// Best wall time of each pass and of all 4 passes over the repetitions.
+struct ModeResult
+{
+    ModeResult()
+      : stateBytes(0)
+    {
+        passTimes.fill(std::numeric_limits<double>::max());
+        totalTime = std::numeric_limits<double>::max();
+    }
+
+    std::array<double, 4> passTimes;
+    double totalTime;
+    size_t stateBytes;
+    util::TriangleMesh mesh;
+};
+
+ModeResult
+runMode(util::Image3D const& image, scalar_t isoval, bool lowMemory,
+        int repeat)
+{
+    ModeResult result;
+    for(int r = 0; r != repeat; ++r)
+    {
+        FlyingEdgesAlgorithm algo(image, isoval, lowMemory);
+
+        std::array<util::Timer, 4> timers;
+
+        timers[0].start();
+        algo.pass1();
+        timers[0].stop();
+
+        timers[1].start();
+        algo.pass2();
+        timers[1].stop();
+
+        timers[2].start();
+        algo.pass3();
+        timers[2].stop();
+
+        timers[3].start();
+        algo.pass4();
+        timers[3].stop();
+
+        double total = 0.0;
+        for(int p = 0; p != 4; ++p)
+        {
+            double t = timers[p].getWallTime();
+            result.passTimes[p] = std::min(result.passTimes[p], t);
+            total += t;
+        }
+        result.totalTime = std::min(result.totalTime, total);
+
+        result.stateBytes = algo.intermediateStateBytes();
+        result.mesh = algo.moveOutput();
+    }
+    return result;
+}
+
+bool sameMesh(util::TriangleMesh const& a, util::TriangleMesh const& b)
+{
+    return a.numberOfVertices() == b.numberOfVertices() &&
+           a.numberOfTriangles() == b.numberOfTriangles() &&
+           a.getPoints() == b.getPoints() &&
+           a.getNormals() == b.getNormals() &&
+           std::equal(a.trianglesBegin(), a.trianglesEnd(),
+                      b.trianglesBegin());
+}
+
+void report(YAML_Doc& doc, std::string const& name, ModeResult const& result)
+{
+    doc.add(name, "");
+    YAML_Element* e = doc.get(name);
+    e->add("Intermediate state (bytes)", result.stateBytes);
+    e->add("Pass 1 Wall Time (seconds)", result.passTimes[0]);
+    e->add("Pass 2 Wall Time (seconds)", result.passTimes[1]);
+    e->add("Pass 3 Wall Time (seconds)", result.passTimes[2]);
+    e->add("Pass 4 Wall Time (seconds)", result.passTimes[3]);
+    e->add("Total Wall Time (seconds)", result.totalTime);
+}
+
+int main(int argc, char* argv[])
+{
+    scalar_t isoval;
+    bool isovalSet = false;
+    char* vtkFile = NULL;
+    int repeat = 5;
+    std::string yamlDirectory = "";
+    std::string yamlFileName  = "";
+
+    // Read command line arguments
+    for(int i=0; i<argc; i++)
+    {
+        if( (strcmp(argv[i], "-i") == 0) || (strcmp(argv[i], "-input_file") == 0))
+        {
+            vtkFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-v") == 0) || (strcmp(argv[i], "-isoval") == 0))
+        {
+            isovalSet = true;
+            isoval = atof(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-r") == 0) || (strcmp(argv[i], "-repeat") == 0))
+        {
+            repeat = std::max(1, atoi(argv[++i]));
+        }
+        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
+        {
+            std::string wholeFile(argv[++i]);
+
+            std::size_t pos = wholeFile.rfind("/");
+            if(pos == std::string::npos)
+            {
+                yamlDirectory = "./";
+                yamlFileName = wholeFile;
+            }
+            else
+            {
+                yamlDirectory = wholeFile.substr(0, pos + 1);
+                yamlFileName = wholeFile.substr(pos + 1);
+            }
+        }
+        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
+        {
+            std::cout <<
+                "Flying Edges Low Memory Benchmark Options:" << std::endl <<
+                "  -input_file (-i)"              << std::endl <<
+                "  -isoval (-v)"                  << std::endl <<
+                "  -repeat (-r), default 5"       << std::endl <<
+                "  -yaml_output_file (-y)"        << std::endl <<
+                "  -help (-h)"                    << std::endl;
+            return 0;
+        }
+    }
+
+    if(isovalSet == false || vtkFile == NULL)
+    {
+        std::cout << "Error: isoval and input_file must be set." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    YAML_Doc doc("Flying Edges Low Memory Benchmark", "0.1",
+                 yamlDirectory, yamlFileName);
+
+    doc.add("Flying Edges Algorithm", "serial");
+    doc.add("Volume image data file path", vtkFile);
+    doc.add("Isoval", isoval);
+    doc.add("Repetitions", repeat);
+
+    util::Image3D image = util::loadImage(vtkFile);
+
+    doc.add("File x-dimension", image.xdimension());
+    doc.add("File y-dimension", image.ydimension());
+    doc.add("File z-dimension", image.zdimension());
+
+    // Both modes run the serial algorithm on the same image. Times are the
+    // best of the repetitions.
+    ModeResult stored = runMode(image, isoval, false, repeat);
+    ModeResult lowMemory = runMode(image, isoval, true, repeat);
+
+    doc.add("Number of vertices in mesh", stored.mesh.numberOfVertices());
+    doc.add("Number of triangles in mesh", stored.mesh.numberOfTriangles());
+    doc.add("Meshes match", sameMesh(stored.mesh, lowMemory.mesh) ? "yes" : "no");
+
+    report(doc, "Stored cube cases", stored);
+    report(doc, "Low memory", lowMemory);
+
+    doc.add("Bytes saved by low memory mode",
+            stored.stateBytes - lowMemory.stateBytes);
+    doc.add("Pass 4 slowdown of low memory mode",
+            lowMemory.passTimes[3] / stored.passTimes[3]);
+
+    std::cout << doc.generateYAML();
+}
@@ -0,0 +1,149 @@
+/*
+ * ScanBenchmark.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+#include <iostream>
+#include <string.h>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <omp.h>
+
+#include "../util/ParallelScan.h"
+
+#include "../util/Timer.h"
+#include "../mantevoCommon/YAML_Doc.hpp"
+
+// The counts scanned in pass 3 are small, like these.
+std::vector<uint32_t> makeCounts(size_t n)
+{
+    std::vector<uint32_t> counts(n);
+    uint32_t state = 12345;
+    for(uint32_t& c: counts)
+    {
+        state = state * 1103515245 + 12345;
+        c = (state >> 16) % 16;
+    }
+    return counts;
+}
+
+size_t serialExclusiveScan(uint32_t* values, size_t n)
+{
+    size_t sum = 0;
+    for(size_t i = 0; i != n; ++i)
+    {
+        size_t value = values[i];
+        values[i] = sum;
+        sum += value;
+    }
+    return sum;
+}
+
+// Best wall time over the repetitions of scanning a fresh copy of counts.
+template <typename ScanFunction>
+double timeScan(std::vector<uint32_t> const& counts, int repeat,
+                ScanFunction scan, std::vector<uint32_t>& result,
+                size_t& total)
+{
+    double best = std::numeric_limits<double>::max();
+    for(int r = 0; r != repeat; ++r)
+    {
+        result = counts;
+
+        util::Timer timer;
+        total = scan(result.data(), result.size());
+        timer.stop();
+
+        best = std::min(best, timer.getWallTime());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = size_t(1) << 26;
+    int repeat = 5;
+    std::string yamlDirectory = "";
+    std::string yamlFileName  = "";
+
+    // Read command line arguments
+    for(int i=0; i<argc; i++)
+    {
+        if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-num_values") == 0))
+        {
+            n = std::stoul(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-r") == 0) || (strcmp(argv[i], "-repeat") == 0))
+        {
+            repeat = std::max(1, atoi(argv[++i]));
+        }
+        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
+        {
+            std::string wholeFile(argv[++i]);
+
+            std::size_t pos = wholeFile.rfind("/");
+            if(pos == std::string::npos)
+            {
+                yamlDirectory = "./";
+                yamlFileName = wholeFile;
+            }
+            else
+            {
+                yamlDirectory = wholeFile.substr(0, pos + 1);
+                yamlFileName = wholeFile.substr(pos + 1);
+            }
+        }
+        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
+        {
+            std::cout <<
+                "Flying Edges Scan Benchmark Options:" << std::endl <<
+                "  -num_values (-n), default 2^26" << std::endl <<
+                "  -repeat (-r), default 5"       << std::endl <<
+                "  -yaml_output_file (-y)"        << std::endl <<
+                "  -help (-h)"                    << std::endl;
+            return 0;
+        }
+    }
+
+    YAML_Doc doc("Flying Edges Scan Benchmark", "0.1",
+                 yamlDirectory, yamlFileName);
+
+    doc.add("Number of values", n);
+    doc.add("Repetitions", repeat);
+    doc.add("Number of threads", omp_get_max_threads());
+
+    std::vector<uint32_t> counts = makeCounts(n);
+
+    std::vector<uint32_t> serialResult;
+    std::vector<uint32_t> parallelResult;
+    size_t serialTotal;
+    size_t parallelTotal;
+
+    double serialTime = timeScan(counts, repeat, serialExclusiveScan,
+                                 serialResult, serialTotal);
+    double parallelTime = timeScan(counts, repeat,
+        [](uint32_t* values, size_t n)
+        {
+            return util::exclusiveScan<size_t>(values, n);
+        },
+        parallelResult, parallelTotal);
+
+    bool match = serialTotal == parallelTotal &&
+                 serialResult == parallelResult;
+    doc.add("Scans match", match ? "yes" : "no");
+    doc.add("Serial Wall Time (seconds)", serialTime);
+    doc.add("Parallel Wall Time (seconds)", parallelTime);
+    doc.add("Speedup", serialTime / parallelTime);
+
+    std::cout << doc.generateYAML();
+}
@@ -15,20 +15,47 @@
 #include "FlyingEdgesAlgorithm.h"
 
 #include "../util/MarchingCubesTables.h"
+#include "../util/EdgeCaseKernels.h"
+#include "../util/Errors.h"
+#include "../util/ParallelScan.h"
 #include <algorithm>
+#include <limits>
 #include <iostream>
 
 ///////////////////////////////////////////////////////////////////////////////
 // Pass 1 of the algorithm
 ///////////////////////////////////////////////////////////////////////////////
-void FlyingEdgesAlgorithm::pass1()
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass1()
 {
+    runPass1(this, 1);
+}
+
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass1(
+    std::vector<BasicFlyingEdgesAlgorithm>& algos)
+{
+    runPass1(algos.data(), algos.size());
+}
+
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::runPass1(
+    BasicFlyingEdgesAlgorithm* algos, size_t numAlgos)
+{
+    if(numAlgos == 0)
+        return;
+
+    size_t ny = algos[0].ny;
+    size_t nz = algos[0].nz;
+
     // For each (j, k):
     //  - for each edge i along fixed (j, k) gridEdge, fill edgeCases with
     //    cut information.
     //  - find the locations for computational trimming, xl and xr
     //  To properly find xl and xr, have to check along the x axis,
     //  the y-axis and the z-axis!
+    // Each row of the image is classified for every isoval while it is
+    // still in cache.
     size_t total = ny*nz;
     size_t oidx;
     #pragma omp parallel for
@@ -36,17 +63,8 @@ void FlyingEdgesAlgorithm::pass1()
     {
         size_t k = oidx / ny;
         size_t j = oidx % ny;
-        auto curEdgeCases = edgeCases.begin() + (nx-1) * (k*ny + j);
-        auto curPointValues = image.getRowIter(j, k);
-
-        std::array<bool, 2> isGE;
-        isGE[0] = (curPointValues[0] >= isoval);
-        for(int i = 1; i != nx; ++i)
-        {
-            isGE[i%2] = (curPointValues[i] >= isoval);
-
-            curEdgeCases[i-1] = calcCaseEdge(isGE[(i+1)%2], isGE[i%2]);
-        }
+        for(size_t a = 0; a != numAlgos; ++a)
+            algos[a].classifyRow(j, k);
     }
 
     #pragma omp parallel for
@@ -54,30 +72,51 @@ void FlyingEdgesAlgorithm::pass1()
     {
         size_t k = oidx / ny;
         size_t j = oidx % ny;
+        for(size_t a = 0; a != numAlgos; ++a)
+            algos[a].trimRow(j, k);
+    }
+}
 
-        gridEdge& curGridEdge = gridEdges[k*ny + j];
-        curGridEdge.xl = nx;
-        for(int i = 1; i != nx; ++i)
-        {
-            // If the edge is cut
-            if(isCutEdge(i-1, j, k))
-            {
-                if(curGridEdge.xl == nx)
-                {
-                    curGridEdge.xl = i-1;
-                }
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::classifyRow(size_t j, size_t k)
+{
+    auto curEdgeCases = edgeCases.begin() + ecStride * (k*ny + j);
+    auto curPointValues = image.getRowIter(j, k);
 
-                curGridEdge.xr = i;
-            }
-        }
-    }
+    // Compares the whole row against isoval with the widest vector
+    // instructions available.
+    util::classifyEdges(
+        &curPointValues[0], nx, isoval, &curEdgeCases[0]);
+}
+
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::trimRow(size_t j, size_t k)
+{
+    gridEdge& curGridEdge = gridEdges[k*ny + j];
+
+    // The edge cases of this row and of the neighbouring rows in y and
+    // z are compared 8 edges at a time. The search stops at the first
+    // and last cut edge.
+    auto curEdgeCases = edgeCases.begin() + ecStride * (k*ny + j);
+    const util::edgeCaseWord_t* nextEdgeCasesY =
+        (j != ny-1) ? &curEdgeCases[ecStride] : nullptr;
+    const util::edgeCaseWord_t* nextEdgeCasesZ =
+        (k != nz-1) ? &curEdgeCases[ecStride*ny] : nullptr;
+
+    size_t xl, xr;
+    util::findTrim(
+        &curEdgeCases[0], nextEdgeCasesY, nextEdgeCasesZ, nx, xl, xr);
+
+    curGridEdge.xl = xl;
+    curGridEdge.xr = xr;
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
 // Pass 2 of the algorithm
 ///////////////////////////////////////////////////////////////////////////////
-void FlyingEdgesAlgorithm::pass2()
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass2()
 {
     // For each (j, k):
     //  - for each cube (i, j, k) calculate caseId and number of gridEdge cuts
@@ -89,477 +128,598 @@ void FlyingEdgesAlgorithm::pass2()
     {
         size_t k = oidx / (ny-1);
         size_t j = oidx % (ny-1);
+        countRow(j, k);
+    }
+}
 
-        // find adjusted trim values
-        size_t xl, xr;
-        calcTrimValues(xl, xr, j, k); // xl, xr set in this function
-
-        // ge0 is owned by this (i, j, k). ge1, ge2 and ge3 are only used for
-        // boundary cells.
-        gridEdge& ge0 = gridEdges[k*ny + j];
-        gridEdge& ge1 = gridEdges[k*ny + j + 1];
-        gridEdge& ge2 = gridEdges[(k+1)*ny + j];
-        gridEdge& ge3 = gridEdges[(k+1)*ny + j + 1];
-
-        // ec0, ec1, ec2 and ec3 were set in pass 1. They are used
-        // to calculate the cell caseId.
-        auto const& ec0 = edgeCases.begin() + (nx-1)*(k*ny + j);
-        auto const& ec1 = edgeCases.begin() + (nx-1)*(k*ny + j + 1);
-        auto const& ec2 = edgeCases.begin() + (nx-1)*((k+1)*ny + j);
-        auto const& ec3 = edgeCases.begin() + (nx-1)*((k+1)*ny + j + 1);
-
-        // Count the number of triangles along this row of cubes.
-        size_t& curTriCounter = *(triCounter.begin() + k*(ny-1) + j);
-
-        auto curCubeCaseIds = cubeCases.begin() + (nx-1)*(k*(ny-1) + j);
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::countRow(size_t j, size_t k)
+{
+    // find adjusted trim values
+    size_t xl, xr;
+    calcTrimValues(xl, xr, j, k); // xl, xr set in this function
+
+    // ge0 is owned by this (i, j, k). ge1, ge2 and ge3 are only used for
+    // boundary cells.
+    gridEdge& ge0 = gridEdges[k*ny + j];
+    gridEdge& ge1 = gridEdges[k*ny + j + 1];
+    gridEdge& ge2 = gridEdges[(k+1)*ny + j];
+    gridEdge& ge3 = gridEdges[(k+1)*ny + j + 1];
+
+    // ec0, ec1, ec2 and ec3 were set in pass 1. They are used
+    // to calculate the cell caseId.
+    const util::edgeCaseWord_t* ec0 = &edgeCases[ecStride*(k*ny + j)];
+    const util::edgeCaseWord_t* ec1 = &edgeCases[ecStride*(k*ny + j + 1)];
+    const util::edgeCaseWord_t* ec2 = &edgeCases[ecStride*((k+1)*ny + j)];
+    const util::edgeCaseWord_t* ec3 =
+        &edgeCases[ecStride*((k+1)*ny + j + 1)];
+
+    // Count the number of triangles along this row of cubes.
+    offset_t& curTriCounter = *(triCounter.begin() + k*(ny-1) + j);
+
+    uchar* curCubeCaseIds =
+        lowMemory ? nullptr : &cubeCases[(nx-1)*(k*(ny-1) + j)];
+
+    bool isYEnd = (j == ny-2);
+    bool isZEnd = (k == nz-2);
+
+    for(size_t i = xl; i != xr; ++i)
+    {
+        bool isXEnd = (i == nx-2);
 
-        bool isYEnd = (j == ny-2);
-        bool isZEnd = (k == nz-2);
+        // using edgeCases from pass 2, compute cubeCases for this cube
+        uchar caseId = calcCubeCase(
+            util::getEdgeCase(ec0, i), util::getEdgeCase(ec1, i),
+            util::getEdgeCase(ec2, i), util::getEdgeCase(ec3, i));
 
-        for(size_t i = xl; i != xr; ++i)
+        if(!lowMemory)
         {
-            bool isXEnd = (i == nx-2);
-
-            // using edgeCases from pass 2, compute cubeCases for this cube
-            uchar caseId = calcCubeCase(ec0[i], ec1[i], ec2[i], ec3[i]);
-
             curCubeCaseIds[i] = caseId;
+        }
 
-            // If the cube has no triangles through it
-            if(caseId == 0 || caseId == 255)
-            {
-                continue;
-            }
+        // If the cube has no triangles through it
+        if(caseId == 0 || caseId == 255)
+        {
+            continue;
+        }
 
-            curTriCounter += util::numTris[caseId];
-
-            const bool* isCut = util::isCut[caseId]; // size 12
-
-            ge0.xstart += isCut[0];
-            ge0.ystart += isCut[3];
-            ge0.zstart += isCut[8];
-
-            // Note: Each 'gridCell' contains four gridEdges running along it,
-            //       ge0, ge1, ge2 and ge3. Each gridCell can access it's own
-            //       ge0 but ge1, ge2 and ge3 are owned by other gridCells.
-            //       Accessing ge1, ge2 and ge3 leads to a race condition
-            //       unless gridCell is along the boundry of the image.
-            //
-            //       To really make sense of the indices, it helps to draw
-            //       out the following picture of a cube with the appropriate
-            //       labels:
-            //         v0 is at (i,   j,   k)
-            //         v1       (i+1, j,   k)
-            //         v2       (i+1, j+1, k)
-            //         v3       (i,   j+1, k)
-            //         v4       (i,   j,   k+1)
-            //         v5       (i+1, j,   k+1)
-            //         v6       (i+1, j+1, k+1)
-            //         v7       (i,   j+1, k+1)
-            //         e0  connects v0 to v1 and is parallel to the x-axis
-            //         e1           v1    v2                        y
-            //         e2           v2    v3                        x
-            //         e3           v0    v3                        y
-            //         e4           v4    v5                        x
-            //         e5           v5    v6                        y
-            //         e6           v6    v7                        x
-            //         e7           v4    v7                        y
-            //         e8           v0    v4                        z
-            //         e9           v1    v5                        z
-            //         e10          v3    v7                        z
-            //         e11          v2    v6                        z
-
-            // Handle cubes along the edge of the image
-            if(isXEnd)
-            {
-                ge0.ystart += isCut[1];
-                ge0.zstart += isCut[9];
-            }
-            if(isYEnd)
-            {
-                ge1.xstart += isCut[2];
-                ge1.zstart += isCut[10];
-            }
-            if(isZEnd)
-            {
-                ge2.xstart += isCut[4];
-                ge2.ystart += isCut[7];
-            }
+        curTriCounter += util::numTris[caseId];
+
+        const bool* isCut = util::isCut[caseId]; // size 12
+
+        ge0.xstart += isCut[0];
+        ge0.ystart += isCut[3];
+        ge0.zstart += isCut[8];
+
+        // Note: Each 'gridCell' contains four gridEdges running along it,
+        //       ge0, ge1, ge2 and ge3. Each gridCell can access it's own
+        //       ge0 but ge1, ge2 and ge3 are owned by other gridCells.
+        //       Accessing ge1, ge2 and ge3 leads to a race condition
+        //       unless gridCell is along the boundry of the image.
+        //
+        //       To really make sense of the indices, it helps to draw
+        //       out the following picture of a cube with the appropriate
+        //       labels:
+        //         v0 is at (i,   j,   k)
+        //         v1       (i+1, j,   k)
+        //         v2       (i+1, j+1, k)
+        //         v3       (i,   j+1, k)
+        //         v4       (i,   j,   k+1)
+        //         v5       (i+1, j,   k+1)
+        //         v6       (i+1, j+1, k+1)
+        //         v7       (i,   j+1, k+1)
+        //         e0  connects v0 to v1 and is parallel to the x-axis
+        //         e1           v1    v2                        y
+        //         e2           v2    v3                        x
+        //         e3           v0    v3                        y
+        //         e4           v4    v5                        x
+        //         e5           v5    v6                        y
+        //         e6           v6    v7                        x
+        //         e7           v4    v7                        y
+        //         e8           v0    v4                        z
+        //         e9           v1    v5                        z
+        //         e10          v3    v7                        z
+        //         e11          v2    v6                        z
+
+        // Handle cubes along the edge of the image
+        if(isXEnd)
+        {
+            ge0.ystart += isCut[1];
+            ge0.zstart += isCut[9];
+        }
+        if(isYEnd)
+        {
+            ge1.xstart += isCut[2];
+            ge1.zstart += isCut[10];
+        }
+        if(isZEnd)
+        {
+            ge2.xstart += isCut[4];
+            ge2.ystart += isCut[7];
+        }
 
-            if(isXEnd and isYEnd)
-            {
-                ge1.zstart += isCut[11];
-            }
-            if(isXEnd and isZEnd)
-            {
-                ge2.ystart += isCut[5];
-            }
-            if(isYEnd and isZEnd)
-            {
-                ge3.xstart += isCut[6];
-            }
+        if(isXEnd and isYEnd)
+        {
+            ge1.zstart += isCut[11];
+        }
+        if(isXEnd and isZEnd)
+        {
+            ge2.ystart += isCut[5];
+        }
+        if(isYEnd and isZEnd)
+        {
+            ge3.xstart += isCut[6];
         }
     }
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
-// Pass 3 of the algorithm
+// Passes 1 and 2 of the algorithm, fused
 ///////////////////////////////////////////////////////////////////////////////
-void FlyingEdgesAlgorithm::pass3()
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass12()
 {
-    size_t numTriangles;
-    size_t numPoints;
+    runPass12(this, 1);
+}
 
-    {
-        std::vector<size_t> parts(omp_get_max_threads());
-        int num_threads_global;
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass12(
+    std::vector<BasicFlyingEdgesAlgorithm>& algos)
+{
+    runPass12(algos.data(), algos.size());
+}
 
-        #pragma omp parallel default (shared)
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::runPass12(
+    BasicFlyingEdgesAlgorithm* algos, size_t numAlgos)
+{
+    if(numAlgos == 0)
+        return;
+
+    size_t ny = algos[0].ny;
+    size_t nz = algos[0].nz;
+
+    // The cubes between slices k and k+1 need the edge cases and the trim
+    // values of both slices, and the trim values of slice k+1 need the edge
+    // cases of slice k+2. So the rows of slice k+2 are classified while the
+    // cubes of slice k-1 are counted, and then slice k+1 is trimmed. Only
+    // about four slices of edgeCases are touched at a time, and the threads
+    // wait for each other twice per slice.
+    #pragma omp parallel
+    {
+        size_t firstRows = std::min(nz, size_t(2))*ny;
+        #pragma omp for
+        for(size_t oidx = 0; oidx < firstRows; oidx++)
         {
-            int num_threads = omp_get_num_threads();
-            int tID = omp_get_thread_num();
-
-            if(tID == 0)
-                num_threads_global = num_threads;
-
-            size_t total_size = (nz-1)*(ny-1);
-            size_t part_size = (total_size + num_threads - 1) / num_threads;
+            size_t k = oidx / ny;
+            size_t j = oidx % ny;
+            for(size_t a = 0; a != numAlgos; ++a)
+                algos[a].classifyRow(j, k);
+        }
 
-            int beg = part_size*tID;
-            int end = std::min(beg + part_size, total_size);
+        #pragma omp for
+        for(size_t j = 0; j < ny; j++)
+        {
+            for(size_t a = 0; a != numAlgos; ++a)
+                algos[a].trimRow(j, 0);
+        }
 
-            size_t tmp;
-            size_t part_total = 0;
-            for(int idx = beg; idx != end; ++idx)
+        for(size_t k = 0; k + 1 < nz; ++k)
+        {
+            size_t classifyRows = (k + 2 < nz) ? ny : 0;
+            #pragma omp for nowait
+            for(size_t j = 0; j < classifyRows; j++)
             {
-                tmp = triCounter[idx];
-                triCounter[idx] = part_total;
-                part_total += tmp;
+                for(size_t a = 0; a != numAlgos; ++a)
+                    algos[a].classifyRow(j, k+2);
             }
 
-            parts[tID] = part_total;
-
-            #pragma omp barrier
-            #pragma omp single
+            size_t countRows = (k != 0) ? ny-1 : 0;
+            #pragma omp for
+            for(size_t j = 0; j < countRows; j++)
             {
-                for(int idx = 1; idx != num_threads; ++idx)
-                {
-                    parts[idx] += parts[idx-1];
-                }
+                for(size_t a = 0; a != numAlgos; ++a)
+                    algos[a].countRow(j, k-1);
             }
 
-            #pragma omp barier
-            if(tID > 0)
+            #pragma omp for
+            for(size_t j = 0; j < ny; j++)
             {
-                for(int idx = beg; idx != end; ++idx)
-                {
-                    triCounter[idx] += parts[tID-1];
-                }
+                for(size_t a = 0; a != numAlgos; ++a)
+                    algos[a].trimRow(j, k+1);
             }
         }
 
-        numTriangles = parts[num_threads_global-1];
+        size_t lastRows = (nz > 1) ? ny-1 : 0;
+        #pragma omp for
+        for(size_t j = 0; j < lastRows; j++)
+        {
+            for(size_t a = 0; a != numAlgos; ++a)
+                algos[a].countRow(j, nz-2);
+        }
     }
+}
+///////////////////////////////////////////////////////////////////////////////
 
-    {
-        std::vector<size_t> parts(omp_get_max_threads());
-        int num_threads_global;
-
-        #pragma omp parallel default (shared)
+///////////////////////////////////////////////////////////////////////////////
+// Pass 3 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass3()
+{
+    // Each triCounter becomes the index of the first triangle of its row of
+    // cubes.
+    size_t numTriangles =
+        util::exclusiveScan<size_t>(triCounter.data(), triCounter.size());
+
+    // The x, y and z starts of each gridEdge become the indices of the
+    // first point on its x, y and z edges. They are numbered in that order.
+    size_t numPoints = util::parallelScan<size_t>(gridEdges.size(),
+        [this](size_t beg, size_t end)
         {
-            int num_threads = omp_get_num_threads();
-            int tID = omp_get_thread_num();
-
-            if(tID == 0)
-                num_threads_global = num_threads;
-
-            size_t total_size = nz*ny;
-            size_t part_size = (total_size + num_threads - 1) / num_threads;
-
-            int beg = part_size*tID;
-            int end = std::min(beg + part_size, total_size);
-
-            size_t tmp;
-            size_t part_total = 0;
-            for(int idx = beg; idx != end; ++idx)
+            size_t sum = 0;
+            for(size_t idx = beg; idx != end; ++idx)
+            {
+                gridEdge const& curGridEdge = gridEdges[idx];
+                sum += size_t(curGridEdge.xstart) + curGridEdge.ystart +
+                       curGridEdge.zstart;
+            }
+            return sum;
+        },
+        [this](size_t beg, size_t end, size_t offset)
+        {
+            for(size_t idx = beg; idx != end; ++idx)
             {
                 gridEdge& curGridEdge = gridEdges[idx];
 
-                tmp = curGridEdge.xstart;
-                curGridEdge.xstart = part_total;
-                part_total += tmp;
+                size_t tmp = curGridEdge.xstart;
+                curGridEdge.xstart = offset;
+                offset += tmp;
 
                 tmp = curGridEdge.ystart;
-                curGridEdge.ystart = part_total;
-                part_total += tmp;
+                curGridEdge.ystart = offset;
+                offset += tmp;
 
                 tmp = curGridEdge.zstart;
-                curGridEdge.zstart = part_total;
-                part_total += tmp;
+                curGridEdge.zstart = offset;
+                offset += tmp;
             }
+            return offset;
+        });
 
-            parts[tID] = part_total;
-
-            #pragma omp barrier
-            #pragma omp single
-            {
-                for(int idx = 1; idx != num_threads; ++idx)
-                {
-                    parts[idx] += parts[idx-1];
-                }
-            }
-            #pragma omp barier
-            if(tID > 0)
-            {
-                for(int idx = beg; idx != end; ++idx)
-                {
-                    gridEdge& curGridEdge = gridEdges[idx];
-
-                    curGridEdge.xstart += parts[tID-1];
-                    curGridEdge.ystart += parts[tID-1];
-                    curGridEdge.zstart += parts[tID-1];
-                }
-            }
-        }
+    if(numPoints > std::numeric_limits<offset_t>::max() ||
+       numTriangles > std::numeric_limits<offset_t>::max())
+    {
+        throw util::offset_overflow("Too many points or triangles for offset_t");
+    }
 
-        numPoints = parts[num_threads_global-1];
+    if(numPoints > std::numeric_limits<index_t>::max())
+    {
+        throw util::index_overflow("Too many points for index_t");
     }
 
-    points = std::vector<std::array<scalar_t, 3> >(numPoints);
-    normals = std::vector<std::array<scalar_t, 3> >(numPoints);
-    tris = std::vector<std::array<size_t, 3> >(numTriangles);
+    // Vectors handed back by run keep their memory. New elements are left
+    // uninitialized, so pass 4 first touches each page of the output from
+    // the thread that fills it, unless the placement is serial.
+    points.resize(numPoints);
+    normals.resize(normalMode == util::NormalMode::gradient ? numPoints : 0);
+    tris.resize(numTriangles);
+
+    if(placement == util::Placement::serial)
+    {
+        points.zero();
+        normals.zero();
+        std::fill(tris.begin(), tris.end(), std::array<index_t, 3>());
+    }
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
 // Pass 4 of the algorithm
 ///////////////////////////////////////////////////////////////////////////////
-void FlyingEdgesAlgorithm::pass4()
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass4()
 {
-    // For each (j, k):
-    //  - For each cube at i, fill out points, normals and triangles owned by
-    //    the cube. Each cube is in charge of filling out e0, e3 and e8. Only
-    //    in edge cases does it also fill out other edges.
-    size_t total = (ny-1)*(nz-1);
-    size_t oidx;
-    #pragma omp parallel for
-    for(oidx = 0; oidx < total; oidx++)
+    runPass4(this, 1);
+}
+
+template <typename T>
+std::vector<double>
+BasicFlyingEdgesAlgorithm<T>::pass4(
+    std::vector<BasicFlyingEdgesAlgorithm>& algos)
+{
+    return runPass4(algos.data(), algos.size());
+}
+
+// Every row counts as this many points or triangles on top of its own, so
+// long runs of rows with nothing in them are split up too.
+const size_t pass4RowWork = 1;
+
+// Rows [0, n) are split into numChunks chunks of about the same work.
+// workBefore(r) is the work of the rows before row r and never decreases.
+// Returns the first row of chunk c, found by binary search.
+template <typename WorkBefore>
+size_t balancedChunkBegin(
+    size_t n, size_t c, size_t numChunks, WorkBefore workBefore)
+{
+    size_t target = workBefore(n) * c / numChunks;
+
+    size_t lo = 0;
+    size_t hi = n;
+    while(lo != hi)
     {
-        size_t k = oidx / (ny-1);
-        size_t j = oidx % (ny-1);
+        size_t mid = lo + (hi - lo) / 2;
+        if(workBefore(mid) < target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
 
-        // find adjusted trim values
-        size_t xl, xr;
-        calcTrimValues(xl, xr, j, k); // xl, xr set in this function
+template <typename T>
+std::vector<double> BasicFlyingEdgesAlgorithm<T>::runPass4(
+    BasicFlyingEdgesAlgorithm* algos, size_t numAlgos)
+{
+    std::vector<double> busyTimes(omp_get_max_threads(), 0.0);
 
-        if(xl == xr)
-            continue;
+    if(numAlgos == 0)
+        return busyTimes;
+
+    size_t nx = algos[0].nx;
+    size_t ny = algos[0].ny;
+    size_t nz = algos[0].nz;
 
-        size_t triIdx = triCounter[k*(ny-1) + j];
-        auto curCubeCaseIds = cubeCases.begin() + (nx-1)*(k*(ny-1) + j);
+    // Pass 4 is done in two parts that don't depend on each other.
+    //
+    // For each (j, k):
+    //  - Find the cut x, y and z edges starting on the gridEdge and fill out
+    //    their points and normals. Each direction is swept on its own: the
+    //    cut edges are gathered first and then interpolated in tight loops.
+    //    The gradients around the gridEdge are shared by every isoval.
+    // Without gradient normals, the provider computes nothing up front and
+    // is never read.
+    util::BasicGradientProvider<T> gradients(algos[0].image,
+        algos[0].normalMode == util::NormalMode::gradient ?
+            algos[0].gradientMode : util::GradientMode::onTheFly);
+
+    // Each thread needs its own reader and scratch space since a reader
+    // holds the rolling cache of gradients.
+    std::vector<GradientReader> gradReaders;
+    std::vector<EdgeSweep> sweeps;
+    gradReaders.reserve(omp_get_max_threads());
+    sweeps.reserve(omp_get_max_threads());
+    for(int t = 0; t != omp_get_max_threads(); ++t)
+    {
+        gradReaders.emplace_back(gradients);
+        sweeps.emplace_back(nx);
+    }
 
-        gridEdge const& ge0 = gridEdges[k*ny + j];
-        gridEdge const& ge1 = gridEdges[k*ny + j + 1];
-        gridEdge const& ge2 = gridEdges[(k+1)*ny + j];
-        gridEdge const& ge3 = gridEdges[(k+1)*ny + j + 1];
+    // Most rows are trimmed to nothing and a few hold most of the surface,
+    // so each thread gets a chunk of rows with about the same work instead
+    // of the same number of rows. Pass 3 left the offsets of the first
+    // point of each gridEdge and the first triangle of each row of cubes,
+    // which are the work before them. Each thread times its own chunk.
+    size_t total = ny*nz;
+    auto pointsBefore = [algos, numAlgos, total](size_t r)
+    {
+        size_t work = r * pass4RowWork;
+        for(size_t a = 0; a != numAlgos; ++a)
+        {
+            work += (r != total) ? size_t(algos[a].gridEdges[r].xstart)
+                                 : algos[a].points.size();
+        }
+        return work;
+    };
 
-        size_t x0counter = 0;
-        size_t y0counter = 0;
-        size_t z0counter = 0;
+    #pragma omp parallel
+    {
+        size_t numThreads = omp_get_num_threads();
+        size_t tID = omp_get_thread_num();
+        size_t beg = balancedChunkBegin(total, tID, numThreads, pointsBefore);
+        size_t end = balancedChunkBegin(total, tID + 1, numThreads,
+                                        pointsBefore);
 
-        size_t x1counter = 0;
-        size_t z1counter = 0;
+        GradientReader& gradReader = gradReaders[tID];
+        EdgeSweep& sweep = sweeps[tID];
 
-        size_t x2counter = 0;
-        size_t y2counter = 0;
+        double start = omp_get_wtime();
+        for(size_t oidx = beg; oidx != end; ++oidx)
+        {
+            size_t k = oidx / ny;
+            size_t j = oidx % ny;
 
-        size_t x3counter = 0;
+            for(size_t a = 0; a != numAlgos; ++a)
+                algos[a].interpolateRow(j, k, gradReader, sweep);
+        }
+        busyTimes[tID] += omp_get_wtime() - start;
+    }
 
-        bool isYEnd = (j == ny-2);
-        bool isZEnd = (k == nz-2);
+    // For each (j, k):
+    //  - For each cube at i, fill out the triangles of the cube. The
+    //    points of the cube's edges are numbered the same way pass 2
+    //    counted them. Each cube counts e0, e3 and e8. Only in edge cases
+    //    does it also count other edges.
+    size_t totalCubeRows = (ny-1)*(nz-1);
+    auto trianglesBefore = [algos, numAlgos, totalCubeRows](size_t r)
+    {
+        size_t work = r * pass4RowWork;
+        for(size_t a = 0; a != numAlgos; ++a)
+        {
+            work += (r != totalCubeRows) ? size_t(algos[a].triCounter[r])
+                                         : algos[a].tris.size();
+        }
+        return work;
+    };
 
-        for(size_t i = xl; i != xr; ++i)
+    #pragma omp parallel
+    {
+        size_t numThreads = omp_get_num_threads();
+        size_t tID = omp_get_thread_num();
+        size_t beg = balancedChunkBegin(totalCubeRows, tID, numThreads,
+                                        trianglesBefore);
+        size_t end = balancedChunkBegin(totalCubeRows, tID + 1, numThreads,
+                                        trianglesBefore);
+
+        double start = omp_get_wtime();
+        for(size_t oidx = beg; oidx != end; ++oidx)
         {
-            bool isXEnd = (i == nx-2);
+            size_t k = oidx / (ny-1);
+            size_t j = oidx % (ny-1);
+            for(size_t a = 0; a != numAlgos; ++a)
+                algos[a].triangulateRow(j, k);
+        }
+        busyTimes[tID] += omp_get_wtime() - start;
+    }
 
-            uchar caseId = curCubeCaseIds[i];
+    for(size_t a = 0; a != numAlgos; ++a)
+    {
+        if(algos[a].normalMode == util::NormalMode::face)
+        {
+            util::computeFaceNormals(
+                algos[a].points, algos[a].tris, algos[a].normals);
+        }
+    }
 
-            if(caseId == 0 || caseId == 255)
-            {
-                continue;
-            }
+    return busyTimes;
+}
 
-            const bool* isCut = util::isCut[caseId]; // has 12 elements
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::interpolateRow(
+    size_t j, size_t k,
+    GradientReader& gradReader,
+    EdgeSweep& sweep)
+{
+    gridEdge const& ge = gridEdges[k*ny + j];
 
-            // Most of the information contained in pointCube, isovalCube
-            // and gradCube will be used--but not necessarily all. It has
-            // not been tested whether or not obtaining only the information
-            // needed will provide a significant speedup--but
-            // most likely not.
-            cube_t        pointCube = image.getPosCube(i, j, k);
-            scalarCube_t  isovalCube = image.getValsCube(i, j, k);
-            cube_t        gradCube = image.getGradCube(i, j, k);
+    const util::edgeCaseWord_t* ec = &edgeCases[ecStride*(k*ny + j)];
 
-            // Add Points and normals.
-            // Calculate global indices for triangles
-            std::array<size_t, 12> globalIdxs;
+    size_t n = findCutXEdges(ec, ge.xl, ge.xr, sweep);
+    interpolateEdges(n, j, k, 0, points, normals, ge.xstart,
+                     gradReader, sweep);
 
-            if(isCut[0])
-            {
-                size_t idx = ge0.xstart + x0counter;
-                points[idx] = interpolateOnCube(pointCube, isovalCube, 0);
-                normals[idx] = interpolateOnCube(gradCube, isovalCube, 0);
-                globalIdxs[0] = idx;
-                ++x0counter;
-            }
+    if(j != ny-1)
+    {
+        n = findCutEdges(ec, ec + ecStride, ge.xl, ge.xr, sweep);
+        interpolateEdges(n, j, k, 1, points, normals, ge.ystart,
+                         gradReader, sweep);
+    }
 
-            if(isCut[3])
-            {
-                size_t idx = ge0.ystart + y0counter;
-                points[idx] = interpolateOnCube(pointCube, isovalCube, 3);
-                normals[idx] = interpolateOnCube(gradCube, isovalCube, 3);
-                globalIdxs[3] = idx;
-                ++y0counter;
-            }
+    if(k != nz-1)
+    {
+        n = findCutEdges(ec, ec + ecStride*ny, ge.xl, ge.xr, sweep);
+        interpolateEdges(n, j, k, 2, points, normals, ge.zstart,
+                         gradReader, sweep);
+    }
+}
 
-            if(isCut[8])
-            {
-                size_t idx = ge0.zstart + z0counter;
-                points[idx] = interpolateOnCube(pointCube, isovalCube, 8);
-                normals[idx] = interpolateOnCube(gradCube, isovalCube, 8);
-                globalIdxs[8] = idx;
-                ++z0counter;
-            }
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::triangulateRow(size_t j, size_t k)
+{
+    // find adjusted trim values
+    size_t xl, xr;
+    calcTrimValues(xl, xr, j, k); // xl, xr set in this function
 
-            // Note:
-            //   e1, e5, e9 and e11 will be visited in the next iteration
-            //   when they are e3, e7, e8 and 10 respectively. So don't
-            //   increment their counters. When the cube is an edge cube,
-            //   their counters don't need to be incremented because they
-            //   won't be used agin.
+    if(xl == xr)
+        return;
 
-            // Manage boundary cases if needed. Otherwise just update
-            // globalIdx.
-            if(isCut[1])
-            {
-                size_t idx = ge0.ystart + y0counter;
-                if(isXEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 1);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 1);
-                    // y0counter counter doesn't need to be incremented
-                    // because it won't be used again.
-                }
-                globalIdxs[1] = idx;
-            }
+    size_t triIdx = triCounter[k*(ny-1) + j];
+    // In low memory mode, the cube cases are recomputed from the edge
+    // cases as in pass 2.
+    const uchar* curCubeCaseIds =
+        lowMemory ? nullptr : &cubeCases[(nx-1)*(k*(ny-1) + j)];
 
-            if(isCut[9])
-            {
-                size_t idx = ge0.zstart + z0counter;
-                if(isXEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 9);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 9);
-                    // z0counter doesn't need to in incremented.
-                }
-                globalIdxs[9] = idx;
-            }
+    const util::edgeCaseWord_t* ec0 = &edgeCases[ecStride*(k*ny + j)];
+    const util::edgeCaseWord_t* ec1 = &edgeCases[ecStride*(k*ny + j + 1)];
+    const util::edgeCaseWord_t* ec2 = &edgeCases[ecStride*((k+1)*ny + j)];
+    const util::edgeCaseWord_t* ec3 =
+        &edgeCases[ecStride*((k+1)*ny + j + 1)];
 
-            if(isCut[2])
-            {
-                size_t idx = ge1.xstart + x1counter;
-                if(isYEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 2);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 2);
-                }
-                globalIdxs[2] = idx;
-                ++x1counter;
-            }
+    gridEdge const& ge0 = gridEdges[k*ny + j];
+    gridEdge const& ge1 = gridEdges[k*ny + j + 1];
+    gridEdge const& ge2 = gridEdges[(k+1)*ny + j];
+    gridEdge const& ge3 = gridEdges[(k+1)*ny + j + 1];
 
-            if(isCut[10])
-            {
-                size_t idx = ge1.zstart + z1counter;
-
-                if(isYEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 10);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 10);
-                }
-                globalIdxs[10] = idx;
-                ++z1counter;
-            }
+    size_t x0counter = 0;
+    size_t y0counter = 0;
+    size_t z0counter = 0;
 
-            if(isCut[4])
-            {
-                size_t idx = ge2.xstart + x2counter;
-                if(isZEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 4);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 4);
-                }
-                globalIdxs[4] = idx;
-                ++x2counter;
-            }
+    size_t x1counter = 0;
+    size_t z1counter = 0;
 
-            if(isCut[7])
-            {
-                size_t idx = ge2.ystart + y2counter;
-                if(isZEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 7);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 7);
-                }
-                globalIdxs[7] = idx;
-                ++y2counter;
-            }
+    size_t x2counter = 0;
+    size_t y2counter = 0;
 
-            if(isCut[11])
-            {
-                size_t idx = ge1.zstart + z1counter;
-                if(isXEnd and isYEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 11);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 11);
-                    // z1counter does not need to be incremented.
-                }
-                globalIdxs[11] = idx;
-            }
+    size_t x3counter = 0;
 
-            if(isCut[5])
-            {
-                size_t idx = ge2.ystart + y2counter;
-                if(isXEnd and isZEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 5);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 5);
-                    // y2 counter does not need to be incremented.
-                }
-                globalIdxs[5] = idx;
-            }
+    for(size_t i = xl; i != xr; ++i)
+    {
+        uchar caseId;
+        if(lowMemory)
+        {
+            caseId = calcCubeCase(
+                util::getEdgeCase(ec0, i), util::getEdgeCase(ec1, i),
+                util::getEdgeCase(ec2, i), util::getEdgeCase(ec3, i));
+        }
+        else
+        {
+            caseId = curCubeCaseIds[i];
+        }
 
-            if(isCut[6])
-            {
-                size_t idx = ge3.xstart + x3counter;
-                if(isYEnd and isZEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 6);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 6);
-                }
-                globalIdxs[6] = idx;
-                ++x3counter;
-            }
+        if(caseId == 0 || caseId == 255)
+        {
+            continue;
+        }
 
-            // Add triangles
-            const char* caseTri = util::caseTriangles[caseId]; // size 16
-            for(int idx = 0; caseTri[idx] != -1; idx += 3)
-            {
-                tris[triIdx][0] = globalIdxs[caseTri[idx]];
-                tris[triIdx][1] = globalIdxs[caseTri[idx+1]];
-                tris[triIdx][2] = globalIdxs[caseTri[idx+2]];
-                ++triIdx;
-            }
+        const bool* isCut = util::isCut[caseId]; // has 12 elements
+
+        // Calculate global indices for triangles
+        std::array<size_t, 12> globalIdxs;
+
+        // Note:
+        //   e1, e5, e9 and e11 are visited in the next iteration
+        //   when they are e3, e7, e8 and 10 respectively. So don't
+        //   increment their counters. When the cube is an edge cube,
+        //   their counters won't be used again.
+        if(isCut[0])
+            globalIdxs[0] = ge0.xstart + x0counter++;
+        if(isCut[3])
+            globalIdxs[3] = ge0.ystart + y0counter++;
+        if(isCut[8])
+            globalIdxs[8] = ge0.zstart + z0counter++;
+
+        if(isCut[1])
+            globalIdxs[1] = ge0.ystart + y0counter;
+        if(isCut[9])
+            globalIdxs[9] = ge0.zstart + z0counter;
+
+        if(isCut[2])
+            globalIdxs[2] = ge1.xstart + x1counter++;
+        if(isCut[10])
+            globalIdxs[10] = ge1.zstart + z1counter++;
+
+        if(isCut[4])
+            globalIdxs[4] = ge2.xstart + x2counter++;
+        if(isCut[7])
+            globalIdxs[7] = ge2.ystart + y2counter++;
+
+        if(isCut[11])
+            globalIdxs[11] = ge1.zstart + z1counter;
+        if(isCut[5])
+            globalIdxs[5] = ge2.ystart + y2counter;
+
+        if(isCut[6])
+            globalIdxs[6] = ge3.xstart + x3counter++;
+
+        // Add triangles
+        const char* caseTri = util::caseTriangles[caseId]; // size 16
+        for(int idx = 0; caseTri[idx] != -1; idx += 3)
+        {
+            tris[triIdx][0] = globalIdxs[caseTri[idx]];
+            tris[triIdx][1] = globalIdxs[caseTri[idx+1]];
+            tris[triIdx][2] = globalIdxs[caseTri[idx+2]];
+            ++triIdx;
         }
     }
 }
@@ -568,7 +728,8 @@ void FlyingEdgesAlgorithm::pass4()
 ///////////////////////////////////////////////////////////////////////////////
 // Don't copy points, normals and tris but move the output into a TrianlgeMesh.
 ///////////////////////////////////////////////////////////////////////////////
-util::TriangleMesh FlyingEdgesAlgorithm::moveOutput()
+template <typename T>
+util::TriangleMesh BasicFlyingEdgesAlgorithm<T>::moveOutput()
 {
     return util::TriangleMesh(std::move(points),
                               std::move(normals),
@@ -577,72 +738,65 @@ util::TriangleMesh FlyingEdgesAlgorithm::moveOutput()
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
-// Private helper functions
+// Running the algorithm again
 ///////////////////////////////////////////////////////////////////////////////
-
-bool FlyingEdgesAlgorithm::isCutEdge(
-    size_t const& i, size_t const& j, size_t const& k) const
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::reset(scalar_t isoval)
 {
-    // Assuming edgeCases are all set
-    size_t edgeCaseIdx = k*(nx-1)*ny + j*(nx-1) + i;
-    if(edgeCases[edgeCaseIdx] == 1 || edgeCases[edgeCaseIdx] == 2)
-    {
-        return true;
-    }
+    this->isoval = isoval;
 
-    if(j != ny - 1)
-    {
-        size_t edgeCaseIdxY = k*(nx-1)*ny + (j+1)*(nx-1) + i;
-
-        // If (edgeCaseX, edgeCaseY) is (0, 1), (1, 2), (2, 3), (0, 3)
-        //                              (1, 0), (2, 1), (3, 2), (3, 0)
-        // and not the other options of (0, 2), (1, 3),
-        //                              (2, 0), (3, 1)
-        // then the edge along the y axis is cut.
-        // So check to see if edgeCaseX + edgeCaseY is odd.
-        if((edgeCases[edgeCaseIdx] + edgeCases[edgeCaseIdxY]) % 2 == 1)
-        {
-            return true;
-        }
-    }
+    // Pass 1 writes all of edgeCases and xl and xr of every gridEdge, and
+    // pass 2 only reads cubeCases where it wrote them. The counts that
+    // pass 2 adds to have to start at zero.
+    std::fill(gridEdges.begin(), gridEdges.end(), gridEdge());
+    std::fill(triCounter.begin(), triCounter.end(), 0);
+}
 
-    if(k != nz - 1)
-    {
-        size_t edgeCaseIdxZ = (k+1)*(nx-1)*ny + j*(nx-1) + i;
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::run(util::TriangleMesh& output)
+{
+    output.releaseBuffers(points, normals, tris);
 
-        // Same as above. If it is odd, then there is a cut except this
-        // time along the z axis.
-        if((edgeCases[edgeCaseIdx] + edgeCases[edgeCaseIdxZ]) % 2 == 1)
-        {
-            return true;
-        }
-    }
+    pass1();
+    pass2();
+    pass3();
+    pass4();
 
-    return false;
+    output = moveOutput();
 }
+///////////////////////////////////////////////////////////////////////////////
 
-inline uchar
-FlyingEdgesAlgorithm::calcCaseEdge(
-    bool const& prevEdge,
-    bool const& currEdge) const
+///////////////////////////////////////////////////////////////////////////////
+// Memory used by the state kept between passes
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+size_t BasicFlyingEdgesAlgorithm<T>::intermediateStateBytes() const
 {
-    // o -- is greater than or equal to
-    // case 0: (i-1) o-----o (i) | (_,j,k)
-    // case 1: (i-1) x-----o (i) | (_,j+1,k)
-    // case 2: (i-1) o-----x (i) | (_,j,k+1)
-    // case 3: (i-1) x-----x (i) | (_,j+1,k+1)
-    if(prevEdge && currEdge)
-        return 0;
-    if(!prevEdge && currEdge)
-        return 1;
-    if(prevEdge && !currEdge)
-        return 2;
-    else // !prevEdge && !currEdge
-        return 3;
+    return gridEdges.size() * sizeof(gridEdge) +
+           triCounter.size() * sizeof(offset_t) +
+           edgeCases.size() * sizeof(util::edgeCaseWord_t) +
+           cubeCases.size() * sizeof(uchar);
 }
 
+template <typename T>
+size_t BasicFlyingEdgesAlgorithm<T>::fullIntermediateStateBytes() const
+{
+    // gridEdge has 5 size_t, each edge case is a byte and cubeCases is
+    // allocated
+    return gridEdges.size() * 5 * sizeof(size_t) +
+           triCounter.size() * sizeof(size_t) +
+           (nx-1)*ny*nz * sizeof(uchar) +
+           (nx-1)*(ny-1)*(nz-1) * sizeof(uchar);
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Private helper functions
+///////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
 inline uchar
-FlyingEdgesAlgorithm::calcCubeCase(
+BasicFlyingEdgesAlgorithm<T>::calcCubeCase(
     uchar const& ec0, uchar const& ec1,
     uchar const& ec2, uchar const& ec3) const
 {
@@ -671,8 +825,9 @@ FlyingEdgesAlgorithm::calcCubeCase(
     return caseId;
 }
 
+template <typename T>
 inline void
-FlyingEdgesAlgorithm::calcTrimValues(
+BasicFlyingEdgesAlgorithm<T>::calcTrimValues(
     size_t& xl, size_t& xr,
     size_t const& j, size_t const& k) const
 {
@@ -688,21 +843,134 @@ FlyingEdgesAlgorithm::calcTrimValues(
         xl = xr;
 }
 
-inline std::array<scalar_t, 3>
-FlyingEdgesAlgorithm::interpolateOnCube(
-    cube_t const& pts,
-    scalarCube_t const& isovals,
-    uchar const& edge) const
+template <typename T>
+inline size_t
+BasicFlyingEdgesAlgorithm<T>::findCutXEdges(
+    const util::edgeCaseWord_t* ec, size_t xl, size_t xr,
+    EdgeSweep& sweep) const
+{
+    // Every index is written but n only moves past the cut ones, so the
+    // loop has no branches.
+    size_t n = 0;
+    for(size_t i = xl; i < xr; ++i)
+    {
+        uchar edgeCase = util::getEdgeCase(ec, i);
+        sweep.cuts[n] = i;
+        n += (edgeCase == 1) | (edgeCase == 2);
+    }
+    return n;
+}
+
+template <typename T>
+inline size_t
+BasicFlyingEdgesAlgorithm<T>::findCutEdges(
+    const util::edgeCaseWord_t* ec, const util::edgeCaseWord_t* ecNext,
+    size_t xl, size_t xr, EdgeSweep& sweep) const
 {
-    uchar i0 = util::edgeVertices[edge][0];
-    uchar i1 = util::edgeVertices[edge][1];
+    // The edge from point i to the next row is cut if bit 0 of the edge
+    // cases differ. Pass 1 trimmed each row to the points with such edges
+    // except the last point, which is only bit 1 of the last edge case.
+    size_t n = 0;
+    for(size_t i = xl; i < xr; ++i)
+    {
+        uchar diff = util::getEdgeCase(ec, i) ^ util::getEdgeCase(ecNext, i);
+        sweep.cuts[n] = i;
+        n += diff & 1;
+    }
+
+    uchar diff =
+        util::getEdgeCase(ec, nx-2) ^ util::getEdgeCase(ecNext, nx-2);
+    if(diff & 2)
+    {
+        sweep.cuts[n++] = nx-1;
+    }
+    return n;
+}
 
-    scalar_t weight = (isoval - isovals[i0]) / (isovals[i1] - isovals[i0]);
-    return interpolate(pts[i0], pts[i1], weight);
+template <typename T>
+inline void
+BasicFlyingEdgesAlgorithm<T>::interpolateEdges(
+    size_t n, size_t j, size_t k, int axis,
+    util::VectorArray& edgePoints, util::VectorArray& edgeNormals, size_t start,
+    GradientReader& gradReader, EdgeSweep& sweep) const
+{
+    // Each edge starts at (sweep.cuts[m], j, k) and goes one point along
+    // axis.
+    size_t const di = (axis == 0);
+    size_t const dj = (axis == 1);
+    size_t const dk = (axis == 2);
+
+    const T* row = image.pointer() + nx*(k*ny + j);
+    size_t const step = di + dj*nx + dk*nx*ny;
+
+    for(size_t m = 0; m != n; ++m)
+    {
+        scalar_t v0 = row[sweep.cuts[m]];
+        scalar_t v1 = row[sweep.cuts[m] + step];
+        sweep.weights[m] = (isoval - v0) / (v1 - v0);
+    }
+
+    std::array<scalar_t, 3> const zeroPos = image.getZeroPos();
+    std::array<scalar_t, 3> const spacing = image.getSpacing();
+    size_t const zOffset = image.zoffset();
+
+    std::array<scalar_t, 3> a;
+    a[1] = position(j, ny, zeroPos[1], spacing[1]);
+    a[2] = position(k + zOffset, nz + zOffset, zeroPos[2], spacing[2]);
+    std::array<scalar_t, 3> b = a;
+    b[axis] += spacing[axis];
+
+    // The components are written straight into the output arrays. With
+    // MESH_SOA each of them is contiguous.
+    size_t const stride = util::VectorArray::stride;
+    scalar_t* pointX = edgePoints.data(0) + start*stride;
+    scalar_t* pointY = edgePoints.data(1) + start*stride;
+    scalar_t* pointZ = edgePoints.data(2) + start*stride;
+    for(size_t m = 0; m != n; ++m)
+    {
+        size_t i = sweep.cuts[m];
+        scalar_t w = sweep.weights[m];
+        a[0] = position(i, nx, zeroPos[0], spacing[0]);
+        b[0] = di ? a[0] + spacing[0] : a[0];
+        pointX[m*stride] = a[0] + (w * (b[0] - a[0]));
+        pointY[m*stride] = a[1] + (w * (b[1] - a[1]));
+        pointZ[m*stride] = a[2] + (w * (b[2] - a[2]));
+    }
+
+    if(normalMode != util::NormalMode::gradient)
+        return;
+
+    scalar_t* normX = edgeNormals.data(0) + start*stride;
+    scalar_t* normY = edgeNormals.data(1) + start*stride;
+    scalar_t* normZ = edgeNormals.data(2) + start*stride;
+    for(size_t m = 0; m != n; ++m)
+    {
+        size_t i = sweep.cuts[m];
+        std::array<scalar_t, 3> normal = interpolate(
+            gradReader.getGradient(i, j, k),
+            gradReader.getGradient(i + di, j + dj, k + dk),
+            sweep.weights[m]);
+        normX[m*stride] = normal[0];
+        normY[m*stride] = normal[1];
+        normZ[m*stride] = normal[2];
+    }
+}
+
+template <typename T>
+inline scalar_t
+BasicFlyingEdgesAlgorithm<T>::position(
+    size_t idx, size_t dim, scalar_t zeroPos, scalar_t spacing) const
+{
+    // Same as Image3D::getPosCube, where the last point along an axis is
+    // one spacing past the point before it.
+    if(idx + 1 != dim)
+        return zeroPos + idx * spacing;
+    return (zeroPos + (idx - 1) * spacing) + spacing;
 }
 
+template <typename T>
 inline std::array<scalar_t, 3>
-FlyingEdgesAlgorithm::interpolate(
+BasicFlyingEdgesAlgorithm<T>::interpolate(
     std::array<scalar_t, 3> const& a,
     std::array<scalar_t, 3> const& b,
     scalar_t const& weight) const
@@ -716,3 +984,11 @@ FlyingEdgesAlgorithm::interpolate(
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// The scalar types an image file can hold, see TypeInfo.h
+template struct BasicFlyingEdgesAlgorithm<char>;
+template struct BasicFlyingEdgesAlgorithm<unsigned char>;
+template struct BasicFlyingEdgesAlgorithm<short>;
+template struct BasicFlyingEdgesAlgorithm<unsigned short>;
+template struct BasicFlyingEdgesAlgorithm<int>;
+template struct BasicFlyingEdgesAlgorithm<float>;
+template struct BasicFlyingEdgesAlgorithm<double>;
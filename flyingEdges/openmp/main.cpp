@@ -12,92 +12,90 @@
  * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
  * certain rights in this software.
  */
+#include <algorithm>
 #include <iostream>
 #include <string.h>
 #include <cstdlib>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <omp.h>
 
 #include "FlyingEdgesAlgorithm.h"
 
+#include "../util/EdgeCaseKernels.h"
+#include "../util/FirstTouch.h"
+#include "../util/GradientProvider.h"
 #include "../util/LoadImage.h"
+#include "../util/MeshNormals.h"
 #include "../util/SaveTriangleMesh.h"
 
 #include "../util/Timer.h"
 #include "../mantevoCommon/YAML_Doc.hpp"
 
-int main(int argc, char* argv[])
+// Parse a comma separated list of isovals. Return false if it has no
+// isovals or something that isn't a number.
+bool parseIsovals(char const* arg, std::vector<scalar_t>& isovals)
 {
-    scalar_t isoval;
-    bool isovalSet = false;
-    char* vtkFile = NULL;
-    char* outFile = NULL;
-    std::string yamlDirectory = "";
-    std::string yamlFileName  = "";
-
-    // Read command line arguments
-    for(int i=0; i<argc; i++)
+    std::stringstream ss(arg);
+    std::string item;
+    while(std::getline(ss, item, ','))
     {
-        if( (strcmp(argv[i], "-i") == 0) || (strcmp(argv[i], "-input_file") == 0))
-        {
-            vtkFile = argv[++i];
-        }
-        else if( (strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "-output_file") == 0))
-        {
-            outFile = argv[++i];
-        }
-        else if( (strcmp(argv[i], "-v") == 0) || (strcmp(argv[i], "-isoval") == 0))
-        {
-            isovalSet = true;
-            isoval = atof(argv[++i]);
-        }
-        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
-        {
-            std::string wholeFile(argv[++i]);
+        char* end;
+        scalar_t isoval = strtod(item.c_str(), &end);
+        if(end == item.c_str() || *end != '\0')
+            return false;
+        isovals.push_back(isoval);
+    }
+    return !isovals.empty();
+}
 
-            std::size_t pos = wholeFile.rfind("/");
-            if(pos == std::string::npos)
-            {
-                yamlDirectory = "./";
-                yamlFileName = wholeFile;
-            }
-            else
-            {
-                yamlDirectory = wholeFile.substr(0, pos + 1);
-                yamlFileName = wholeFile.substr(pos + 1);
-            }
-        }
-        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
-        {
-            std::cout <<
-                "Serial Flying Edges Options:"    << std::endl <<
-                "  -input_file (-i)"              << std::endl <<
-                "  -output_file (-o)"             << std::endl <<
-                "  -isoval (-v)"                  << std::endl <<
-                "  -yaml_output_file (-y)"        << std::endl <<
-                "  -help (-h)"                    << std::endl;
-            return 0;
-        }
+// Parse start:stop:count into count evenly spaced isovals from start to
+// stop. Return false if it isn't of that form.
+bool parseIsovalRange(char const* arg, std::vector<scalar_t>& isovals)
+{
+    double start, stop;
+    int count;
+    char extra;
+    if(sscanf(arg, "%lf:%lf:%d%c", &start, &stop, &count, &extra) != 3 ||
+       count < 1)
+    {
+        return false;
     }
 
-    if(isovalSet == false || vtkFile == NULL || outFile == NULL)
+    for(int n = 0; n != count; ++n)
     {
-        std::cout << "Error: isoval, input_file and output_file must be set." << std::endl <<
-                     "Try -help" << std::endl;
-        return 0;
+        isovals.push_back(
+            count == 1 ? start : start + (stop - start) * n / (count - 1));
     }
+    return true;
+}
 
-    // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
-    // YAML_Doc will create a file at in the current directory with a
-    // timestamp on it.
-    YAML_Doc doc("Flying Edges", "0.1", yamlDirectory, yamlFileName);
+// The settings of a run. The algorithm is run on the image as it is in the
+// file, so it is instantiated for each scalar type a file can hold.
+struct Run
+{
+    std::vector<scalar_t> const& isovals;
+    std::vector<std::string> const& outFiles;
+    bool lowMemory;
+    bool fused;
+    bool autoGradient;
+    util::GradientMode gradientMode;
+    size_t gradientMemory; // MiB
+    util::NormalMode normalMode;
+    util::Placement placement;
+    YAML_Doc& doc;
 
-    // Add information related to this run to doc.
-    doc.add("Flying Edges Algorithm", "openmp");
-    doc.add("Volume image data file path", vtkFile);
-    doc.add("Polygonal mesh output file", outFile);
-    doc.add("Isoval", isoval);
+    template <typename T>
+    void operator()(util::BasicImage3D<T> const& image);
+};
 
-    // Load the image file
-    util::Image3D image = util::loadImage(vtkFile);
+template <typename T>
+void Run::operator()(util::BasicImage3D<T> const& image)
+{
+    doc.add("Image scalar type", util::createTemplateTypeInfo<T>().name());
+    doc.add("Edge classification kernel", util::edgeCaseKernelName<T>());
 
     // Just for comparison purposes to gpu versions--this makes problem size smaller
     //image.cutDown(100);
@@ -106,14 +104,40 @@ int main(int argc, char* argv[])
     doc.add("File y-dimension", image.ydimension());
     doc.add("File z-dimension", image.zdimension());
 
+    // Without a gradient mode given, use the fastest one that fits in the
+    // gradient memory budget.
+    size_t gradientBudget = gradientMemory << 20;
+    if(autoGradient)
+    {
+        gradientMode = util::chooseGradientMode(
+            image.xdimension(), image.ydimension(), image.zdimension(),
+            omp_get_max_threads(), gradientBudget);
+    }
+    doc.add("Gradient mode", util::gradientModeName(gradientMode));
+    doc.add("Gradient memory budget (bytes)", gradientBudget);
+
     // Time the output. util::Timer's constructor starts timing.
     util::Timer runTime;
 
     // The inputs of the algorithm are the 3D image file and the isoval to
     // estimate the isosurface at.
-    FlyingEdgesAlgorithm algo(image, isoval);
+    // In low memory mode, the case of each cube isn't kept between pass 2
+    // and pass 4.
+    // The gradient mode is how pass 4 gets the gradients for the normals.
+    // The normal mode is whether the normals are interpolated from the
+    // gradients, averaged from the triangles or not made at all.
+    // The placement is which threads first write the buffers of the algo.
+    // There is one algo for each isoval. They all share the image.
+    std::vector<BasicFlyingEdgesAlgorithm<T> > algos;
+    algos.reserve(isovals.size());
+    for(scalar_t isoval : isovals)
+    {
+        algos.emplace_back(image, isoval, lowMemory, gradientMode, normalMode,
+                           placement);
+    }
     // The flying edges algorithm makes 4 passes through the image file.
-    // Each pass is timed.
+    // Each pass is timed. Passes 1 and 4 read the image, so they do all of
+    // the isovals in one sweep through it.
 
     // Pass 1 of the algorithm labels each edge parallel to the x-axis as cut
     // or not. In the process, each gridEdge is assigned an xl and xr.
@@ -122,55 +146,112 @@ int main(int argc, char* argv[])
     // A gridEdge E_jk can be thought of as the row of edges parallel to the
     // x-axis for some fixed j and k.
     util::Timer runTimePass1;
-    algo.pass1();
-    runTimePass1.stop();
-
-    // Pass 2 of the algorithm determines the marching cubes case ID of each
-    // cube. This is determined fully from information obtained in pass1, so
-    // there is no need to access the input image. Each cube starts at (i,j,k)
-    // and extends to (i+1, j+1, k+1).
-    // In addition to determining case ID of each cell, pass 2 counts the
-    // number of cuts on incident to each gridEdge.
     util::Timer runTimePass2;
-    algo.pass2();
-    runTimePass2.stop();
+    if(fused)
+    {
+        // Passes 1 and 2 can also be done together a z-slice at a time, so
+        // the edge cases of each slice are still in cache when pass 2 reads
+        // them. They are timed together.
+        BasicFlyingEdgesAlgorithm<T>::pass12(algos);
+        runTimePass1.stop();
+    }
+    else
+    {
+        BasicFlyingEdgesAlgorithm<T>::pass1(algos);
+        runTimePass1.stop();
+
+        // Pass 2 of the algorithm determines the marching cubes case ID of
+        // each cube. This is determined fully from information obtained in
+        // pass1, so there is no need to access the input image. Each cube
+        // starts at (i,j,k) and extends to (i+1, j+1, k+1).
+        // In addition to determining case ID of each cell, pass 2 counts the
+        // number of cuts on incident to each gridEdge.
+        runTimePass2.start();
+        for(BasicFlyingEdgesAlgorithm<T>& algo : algos)
+            algo.pass2();
+        runTimePass2.stop();
+    }
 
     // Pass 3 of the algorithm uses information from pass 2 to determine how
     // many triangles and points there are. It also sets up starting indices
     // on each gridEdge. Once these sizes are determined, memory is allocated
     // for storing triangles, points and normals.
     util::Timer runTimePass3;
-    algo.pass3();
+    for(BasicFlyingEdgesAlgorithm<T>& algo : algos)
+        algo.pass3();
     runTimePass3.stop();
 
     // Pass 4 of the algorithm calculates calculates and fills out points,
-    // normals and the triangles.
+    // normals and the triangles. The rows are split among the threads by
+    // the number of points and triangles in them, and each thread reports
+    // how long it was busy.
     util::Timer runTimePass4;
-    algo.pass4();
+    std::vector<double> pass4BusyTimes =
+        BasicFlyingEdgesAlgorithm<T>::pass4(algos);
     runTimePass4.stop();
 
+    // Report the memory kept between passes
+    size_t stateBytes = 0;
+    size_t fullStateBytes = 0;
+    for(BasicFlyingEdgesAlgorithm<T> const& algo : algos)
+    {
+        stateBytes += algo.intermediateStateBytes();
+        fullStateBytes += algo.fullIntermediateStateBytes();
+    }
+
     // This function receives the output. The data is not copied or deep copied
     // but instead is moved or shallow copied. Once moveOutput is called, the
     // algo structure no longer maintains responsibility of any data.
-    util::TriangleMesh mesh = algo.moveOutput();
+    std::vector<util::TriangleMesh> meshes;
+    for(BasicFlyingEdgesAlgorithm<T>& algo : algos)
+        meshes.push_back(algo.moveOutput());
+    algos.clear();
 
     // End overall timing
     runTime.stop();
 
     // Report mesh information
-    doc.add("Number of vertices in mesh", mesh.numberOfVertices());
-    doc.add("Number of triangles in mesh", mesh.numberOfTriangles());
+    if(meshes.size() == 1)
+    {
+        doc.add("Number of vertices in mesh", meshes[0].numberOfVertices());
+        doc.add("Number of triangles in mesh", meshes[0].numberOfTriangles());
+    }
+    else
+    {
+        for(size_t n = 0; n != meshes.size(); ++n)
+        {
+            std::string name = "Mesh " + std::to_string(n);
+            doc.add(name, "");
+            doc.get(name)->add("Isoval", isovals[n]);
+            doc.get(name)->add("Output file", outFiles[n]);
+            doc.get(name)->add("Number of vertices", meshes[n].numberOfVertices());
+            doc.get(name)->add("Number of triangles", meshes[n].numberOfTriangles());
+        }
+    }
+
+    doc.add("Intermediate state (bytes)", stateBytes);
+    doc.add("Intermediate state saved (bytes)", fullStateBytes - stateBytes);
 
     // Report timing information
-    doc.add("Pass 1", "");
-    doc.get("Pass 1")->add("CPU Time (clicks)", runTimePass1.getTotalTicks());
-    doc.get("Pass 1")->add("CPU Time (seconds)", runTimePass1.getCPUtime());
-    doc.get("Pass 1")->add("Wall Time (seconds)", runTimePass1.getWallTime());
+    if(fused)
+    {
+        doc.add("Passes 1 and 2", "");
+        doc.get("Passes 1 and 2")->add("CPU Time (clicks)", runTimePass1.getTotalTicks());
+        doc.get("Passes 1 and 2")->add("CPU Time (seconds)", runTimePass1.getCPUtime());
+        doc.get("Passes 1 and 2")->add("Wall Time (seconds)", runTimePass1.getWallTime());
+    }
+    else
+    {
+        doc.add("Pass 1", "");
+        doc.get("Pass 1")->add("CPU Time (clicks)", runTimePass1.getTotalTicks());
+        doc.get("Pass 1")->add("CPU Time (seconds)", runTimePass1.getCPUtime());
+        doc.get("Pass 1")->add("Wall Time (seconds)", runTimePass1.getWallTime());
 
-    doc.add("Pass 2", "");
-    doc.get("Pass 2")->add("CPU Time (clicks)", runTimePass2.getTotalTicks());
-    doc.get("Pass 2")->add("CPU Time (seconds)", runTimePass2.getCPUtime());
-    doc.get("Pass 2")->add("Wall Time (seconds)", runTimePass2.getWallTime());
+        doc.add("Pass 2", "");
+        doc.get("Pass 2")->add("CPU Time (clicks)", runTimePass2.getTotalTicks());
+        doc.get("Pass 2")->add("CPU Time (seconds)", runTimePass2.getCPUtime());
+        doc.get("Pass 2")->add("Wall Time (seconds)", runTimePass2.getWallTime());
+    }
 
     doc.add("Pass 3", "");
     doc.get("Pass 3")->add("CPU Time (clicks)", runTimePass3.getTotalTicks());
@@ -182,6 +263,24 @@ int main(int argc, char* argv[])
     doc.get("Pass 4")->add("CPU Time (seconds)", runTimePass4.getCPUtime());
     doc.get("Pass 4")->add("Wall Time (seconds)", runTimePass4.getWallTime());
 
+    // The slowest thread against the average shows how evenly the work of
+    // pass 4 was split.
+    double maxBusyTime = 0;
+    double sumBusyTime = 0;
+    doc.get("Pass 4")->add("Thread Busy Times (seconds)", "");
+    for(size_t t = 0; t != pass4BusyTimes.size(); ++t)
+    {
+        doc.get("Pass 4")->get("Thread Busy Times (seconds)")->add(
+            "Thread " + std::to_string(t), pass4BusyTimes[t]);
+        maxBusyTime = std::max(maxBusyTime, pass4BusyTimes[t]);
+        sumBusyTime += pass4BusyTimes[t];
+    }
+    if(sumBusyTime > 0)
+    {
+        doc.get("Pass 4")->add("Busy Time Imbalance (max/mean)",
+            maxBusyTime * pass4BusyTimes.size() / sumBusyTime);
+    }
+
     doc.add("Total Program CPU Time (clicks)", runTime.getTotalTicks());
     doc.add("Total Program CPU Time (seconds)", runTime.getCPUtime());
     doc.add("Total Program WALL Time (seconds)", runTime.getWallTime());
@@ -189,6 +288,198 @@ int main(int argc, char* argv[])
     // Generate the YAML file. The file will be both saved and printed to console.
     std::cout << doc.generateYAML();
 
-    // Save the polygonal mesh to the output file.
-    util::saveTriangleMesh(mesh, outFile);
+    // Save the polygonal meshes to the output files.
+    for(size_t n = 0; n != meshes.size(); ++n)
+        util::saveTriangleMesh(meshes[n], outFiles[n].c_str());
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<scalar_t> isovals;
+    bool isovalSet = false;
+    bool isovalsValid = true;
+    char* vtkFile = NULL;
+    char* outFile = NULL;
+    bool lowMemory = false;
+    bool fused = false;
+    char* gradientName = NULL;
+    size_t gradientMemory = 1024; // MiB
+    char* normalName = NULL;
+    char* placementName = NULL;
+    std::string yamlDirectory = "";
+    std::string yamlFileName  = "";
+
+    // Read command line arguments
+    for(int i=0; i<argc; i++)
+    {
+        if( (strcmp(argv[i], "-i") == 0) || (strcmp(argv[i], "-input_file") == 0))
+        {
+            vtkFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "-output_file") == 0))
+        {
+            outFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-v") == 0) || (strcmp(argv[i], "-isoval") == 0))
+        {
+            isovalSet = true;
+            isovals.clear();
+            isovalsValid = parseIsovals(argv[++i], isovals);
+        }
+        else if( (strcmp(argv[i], "-vr") == 0) || (strcmp(argv[i], "-isoval_range") == 0))
+        {
+            isovalSet = true;
+            isovals.clear();
+            isovalsValid = parseIsovalRange(argv[++i], isovals);
+        }
+        else if( (strcmp(argv[i], "-l") == 0) || (strcmp(argv[i], "-low_memory") == 0))
+        {
+            lowMemory = atoi(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-f") == 0) || (strcmp(argv[i], "-fused") == 0))
+        {
+            fused = atoi(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-g") == 0) || (strcmp(argv[i], "-gradient") == 0))
+        {
+            gradientName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-gm") == 0) || (strcmp(argv[i], "-gradient_memory") == 0))
+        {
+            gradientMemory = atol(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-normals") == 0))
+        {
+            normalName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-p") == 0) || (strcmp(argv[i], "-placement") == 0))
+        {
+            placementName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
+        {
+            std::string wholeFile(argv[++i]);
+
+            std::size_t pos = wholeFile.rfind("/");
+            if(pos == std::string::npos)
+            {
+                yamlDirectory = "./";
+                yamlFileName = wholeFile;
+            }
+            else
+            {
+                yamlDirectory = wholeFile.substr(0, pos + 1);
+                yamlFileName = wholeFile.substr(pos + 1);
+            }
+        }
+        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
+        {
+            std::cout <<
+                "Serial Flying Edges Options:"    << std::endl <<
+                "  -input_file (-i)"              << std::endl <<
+                "  -output_file (-o)"             << std::endl <<
+                "  -isoval (-v), one or a comma"  << std::endl <<
+                "    separated list"              << std::endl <<
+                "  -isoval_range (-vr),"          << std::endl <<
+                "    start:stop:count"            << std::endl <<
+                "  -low_memory (-l), default 0"   << std::endl <<
+                "  -fused (-f), default 0"        << std::endl <<
+                "  -gradient (-g), default auto"  << std::endl <<
+                "    auto, onthefly, rolling or"  << std::endl <<
+                "    precomputed"                 << std::endl <<
+                "  -gradient_memory (-gm), MiB,"  << std::endl <<
+                "    default 1024"                << std::endl <<
+                "  -normals (-n), default"        << std::endl <<
+                "    gradient, none or face"      << std::endl <<
+                "  -placement (-p), default"      << std::endl <<
+                "    firsttouch or serial"        << std::endl <<
+                "  -yaml_output_file (-y)"        << std::endl <<
+                "  -help (-h)"                    << std::endl;
+            return 0;
+        }
+    }
+
+    if(isovalSet == false || vtkFile == NULL || outFile == NULL)
+    {
+        std::cout << "Error: isoval, input_file and output_file must be set." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    if(!isovalsValid)
+    {
+        std::cout << "Error: isoval must be a number or a comma separated list of numbers" << std::endl <<
+                     "and isoval_range must be start:stop:count." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    // With more than one isoval, the mesh of the nth isoval is saved to
+    // outFile.n.
+    std::vector<std::string> outFiles;
+    for(size_t n = 0; n != isovals.size(); ++n)
+    {
+        outFiles.push_back(isovals.size() == 1 ?
+            std::string(outFile) : std::string(outFile) + "." + std::to_string(n));
+    }
+
+    bool autoGradient =
+        gradientName == NULL || strcmp(gradientName, "auto") == 0;
+    util::GradientMode gradientMode = util::GradientMode::onTheFly;
+    if(!autoGradient && !util::parseGradientMode(gradientName, gradientMode))
+    {
+        std::cout << "Error: unknown gradient mode " << gradientName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::NormalMode normalMode = util::NormalMode::gradient;
+    if(normalName != NULL && !util::parseNormalMode(normalName, normalMode))
+    {
+        std::cout << "Error: unknown normal mode " << normalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::Placement placement = util::Placement::firstTouch;
+    if(placementName != NULL && !util::parsePlacement(placementName, placement))
+    {
+        std::cout << "Error: unknown placement " << placementName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
+    // YAML_Doc will create a file at in the current directory with a
+    // timestamp on it.
+    YAML_Doc doc("Flying Edges", "0.1", yamlDirectory, yamlFileName);
+
+    // Add information related to this run to doc.
+    doc.add("Flying Edges Algorithm", "openmp");
+    doc.add("Volume image data file path", vtkFile);
+    doc.add("Polygonal mesh output file", outFile);
+    if(isovals.size() == 1)
+    {
+        doc.add("Isoval", isovals[0]);
+    }
+    else
+    {
+        doc.add("Number of isovals", isovals.size());
+    }
+#ifdef FE_COMPACT
+    doc.add("Compact intermediate state", "on");
+#else
+    doc.add("Compact intermediate state", "off");
+#endif
+    doc.add("Low memory mode", lowMemory ? "on" : "off");
+    doc.add("Fused passes 1 and 2", fused ? "on" : "off");
+    doc.add("Normal mode", util::normalModeName(normalMode));
+    doc.add("Memory placement", util::placementName(placement));
+
+    // Load the image file keeping its scalar type, and run the algorithm
+    // on it. With first touch placement, its rows are converted by the
+    // threads that read them in the passes.
+    Run run = { isovals, outFiles, lowMemory, fused, autoGradient,
+                gradientMode, gradientMemory, normalMode, placement, doc };
+    util::visitImage(vtkFile, run, placement);
 }
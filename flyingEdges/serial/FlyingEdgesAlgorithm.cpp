@@ -15,12 +15,16 @@
 #include "FlyingEdgesAlgorithm.h"
 
 #include "../util/MarchingCubesTables.h"
+#include "../util/EdgeCaseKernels.h"
+#include "../util/Errors.h"
 #include <algorithm>
+#include <limits>
 
 ///////////////////////////////////////////////////////////////////////////////
 // Pass 1 of the algorithm
 ///////////////////////////////////////////////////////////////////////////////
-void FlyingEdgesAlgorithm::pass1()
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass1()
 {
     // For each (j, k):
     //  - for each edge i along fixed (j, k) gridEdge, fill edgeCases with
@@ -31,45 +35,56 @@ void FlyingEdgesAlgorithm::pass1()
     for(size_t k = 0; k != nz; ++k) {
     for(size_t j = 0; j != ny; ++j)
     {
-        auto curEdgeCases = edgeCases.begin() + (nx-1) * (k*ny + j);
-        auto curPointValues = image.getRowIter(j, k);
-
-        std::array<bool, 2> isGE;
-        isGE[0] = (curPointValues[0] >= isoval);
-        for(int i = 1; i != nx; ++i)
-        {
-            isGE[i%2] = (curPointValues[i] >= isoval);
-
-            curEdgeCases[i-1] = calcCaseEdge(isGE[(i+1)%2], isGE[i%2]);
-        }
+        classifyRow(j, k);
     }}
 
     for(size_t k = 0; k != nz; ++k) {
     for(size_t j = 0; j != ny; ++j)
     {
-        gridEdge& curGridEdge = gridEdges[k*ny + j];
-        curGridEdge.xl = nx;
-        for(int i = 1; i != nx; ++i)
-        {
-            // If the edge is cut
-            if(isCutEdge(i-1, j, k))
-            {
-                if(curGridEdge.xl == nx)
-                {
-                    curGridEdge.xl = i-1;
-                }
-
-                curGridEdge.xr = i;
-            }
-        }
+        trimRow(j, k);
     }}
 }
+
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::classifyRow(size_t j, size_t k)
+{
+    auto curEdgeCases = edgeCases.begin() + ecStride * (k*ny + j);
+    auto curPointValues = image.getRowIter(j, k);
+
+    // Compares the whole row against isoval with the widest vector
+    // instructions available.
+    util::classifyEdges(
+        &curPointValues[0], nx, isoval, &curEdgeCases[0]);
+}
+
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::trimRow(size_t j, size_t k)
+{
+    gridEdge& curGridEdge = gridEdges[k*ny + j];
+
+    // The edge cases of this row and of the neighbouring rows in y and
+    // z are compared 8 edges at a time. The search stops at the first
+    // and last cut edge.
+    auto curEdgeCases = edgeCases.begin() + ecStride * (k*ny + j);
+    const util::edgeCaseWord_t* nextEdgeCasesY =
+        (j != ny-1) ? &curEdgeCases[ecStride] : nullptr;
+    const util::edgeCaseWord_t* nextEdgeCasesZ =
+        (k != nz-1) ? &curEdgeCases[ecStride*ny] : nullptr;
+
+    size_t xl, xr;
+    util::findTrim(
+        &curEdgeCases[0], nextEdgeCasesY, nextEdgeCasesZ, nx, xl, xr);
+
+    curGridEdge.xl = xl;
+    curGridEdge.xr = xr;
+}
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
 // Pass 2 of the algorithm
 ///////////////////////////////////////////////////////////////////////////////
-void FlyingEdgesAlgorithm::pass2()
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass2()
 {
     // For each (j, k):
     //  - for each cube (i, j, k) calculate caseId and number of gridEdge cuts
@@ -77,123 +92,184 @@ void FlyingEdgesAlgorithm::pass2()
     for(size_t k = 0; k != nz-1; ++k) {
     for(size_t j = 0; j != ny-1; ++j)
     {
-        // find adjusted trim values
-        size_t xl, xr;
-        calcTrimValues(xl, xr, j, k); // xl, xr set in this function
+        countRow(j, k);
+    }}
+}
 
-        // ge0 is owned by this (i, j, k). ge1, ge2 and ge3 are only used for
-        // boundary cells.
-        gridEdge& ge0 = gridEdges[k*ny + j];
-        gridEdge& ge1 = gridEdges[k*ny + j + 1];
-        gridEdge& ge2 = gridEdges[(k+1)*ny + j];
-        gridEdge& ge3 = gridEdges[(k+1)*ny + j + 1];
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::countRow(size_t j, size_t k)
+{
+    // find adjusted trim values
+    size_t xl, xr;
+    calcTrimValues(xl, xr, j, k); // xl, xr set in this function
+
+    // ge0 is owned by this (i, j, k). ge1, ge2 and ge3 are only used for
+    // boundary cells.
+    gridEdge& ge0 = gridEdges[k*ny + j];
+    gridEdge& ge1 = gridEdges[k*ny + j + 1];
+    gridEdge& ge2 = gridEdges[(k+1)*ny + j];
+    gridEdge& ge3 = gridEdges[(k+1)*ny + j + 1];
+
+    // ec0, ec1, ec2 and ec3 were set in pass 1. They are used
+    // to calculate the cell caseId.
+    const util::edgeCaseWord_t* ec0 = &edgeCases[ecStride*(k*ny + j)];
+    const util::edgeCaseWord_t* ec1 = &edgeCases[ecStride*(k*ny + j + 1)];
+    const util::edgeCaseWord_t* ec2 = &edgeCases[ecStride*((k+1)*ny + j)];
+    const util::edgeCaseWord_t* ec3 =
+        &edgeCases[ecStride*((k+1)*ny + j + 1)];
+
+    // Count the number of triangles along this row of cubes.
+    offset_t& curTriCounter = *(triCounter.begin() + k*(ny-1) + j);
+
+    uchar* curCubeCaseIds =
+        lowMemory ? nullptr : &cubeCases[(nx-1)*(k*(ny-1) + j)];
+
+    bool isYEnd = (j == ny-2);
+    bool isZEnd = (k == nz-2);
+
+    for(size_t i = xl; i != xr; ++i)
+    {
+        bool isXEnd = (i == nx-2);
 
-        // ec0, ec1, ec2 and ec3 were set in pass 1. They are used
-        // to calculate the cell caseId.
-        auto const& ec0 = edgeCases.begin() + (nx-1)*(k*ny + j);
-        auto const& ec1 = edgeCases.begin() + (nx-1)*(k*ny + j + 1);
-        auto const& ec2 = edgeCases.begin() + (nx-1)*((k+1)*ny + j);
-        auto const& ec3 = edgeCases.begin() + (nx-1)*((k+1)*ny + j + 1);
+        // using edgeCases from pass 2, compute cubeCases for this cube
+        uchar caseId = calcCubeCase(
+            util::getEdgeCase(ec0, i), util::getEdgeCase(ec1, i),
+            util::getEdgeCase(ec2, i), util::getEdgeCase(ec3, i));
 
-        // Count the number of triangles along this row of cubes.
-        size_t& curTriCounter = *(triCounter.begin() + k*(ny-1) + j);
+        if(!lowMemory)
+        {
+            curCubeCaseIds[i] = caseId;
+        }
 
-        auto curCubeCaseIds = cubeCases.begin() + (nx-1)*(k*(ny-1) + j);
+        // If the cube has no triangles through it
+        if(caseId == 0 || caseId == 255)
+        {
+            continue;
+        }
 
-        bool isYEnd = (j == ny-2);
-        bool isZEnd = (k == nz-2);
+        curTriCounter += util::numTris[caseId];
+
+        const bool* isCut = util::isCut[caseId]; // size 12
+
+        ge0.xstart += isCut[0];
+        ge0.ystart += isCut[3];
+        ge0.zstart += isCut[8];
+
+        // Note: Each 'gridCell' contains four gridEdges running along it,
+        //       ge0, ge1, ge2 and ge3. Each gridCell can access it's own
+        //       ge0 but ge1, ge2 and ge3 are owned by other gridCells.
+        //       Accessing ge1, ge2 and ge3 leads to a race condition
+        //       unless gridCell is along the boundry of the image.
+        //
+        //       To really make sense of the indices, it helps to draw
+        //       out the following picture of a cube with the appropriate
+        //       labels:
+        //         v0 is at (i,   j,   k)
+        //         v1       (i+1, j,   k)
+        //         v2       (i+1, j+1, k)
+        //         v3       (i,   j+1, k)
+        //         v4       (i,   j,   k+1)
+        //         v5       (i+1, j,   k+1)
+        //         v6       (i+1, j+1, k+1)
+        //         v7       (i,   j+1, k+1)
+        //         e0  connects v0 to v1 and is parallel to the x-axis
+        //         e1           v1    v2                        y
+        //         e2           v2    v3                        x
+        //         e3           v0    v3                        y
+        //         e4           v4    v5                        x
+        //         e5           v5    v6                        y
+        //         e6           v6    v7                        x
+        //         e7           v4    v7                        y
+        //         e8           v0    v4                        z
+        //         e9           v1    v5                        z
+        //         e10          v3    v7                        z
+        //         e11          v2    v6                        z
+
+        // Handle cubes along the edge of the image
+        if(isXEnd)
+        {
+            ge0.ystart += isCut[1];
+            ge0.zstart += isCut[9];
+        }
+        if(isYEnd)
+        {
+            ge1.xstart += isCut[2];
+            ge1.zstart += isCut[10];
+        }
+        if(isZEnd)
+        {
+            ge2.xstart += isCut[4];
+            ge2.ystart += isCut[7];
+        }
 
-        for(size_t i = xl; i != xr; ++i)
+        if(isXEnd and isYEnd)
         {
-            bool isXEnd = (i == nx-2);
+            ge1.zstart += isCut[11];
+        }
+        if(isXEnd and isZEnd)
+        {
+            ge2.ystart += isCut[5];
+        }
+        if(isYEnd and isZEnd)
+        {
+            ge3.xstart += isCut[6];
+        }
+    }
+}
+///////////////////////////////////////////////////////////////////////////////
 
-            // using edgeCases from pass 2, compute cubeCases for this cube
-            uchar caseId = calcCubeCase(ec0[i], ec1[i], ec2[i], ec3[i]);
+///////////////////////////////////////////////////////////////////////////////
+// Passes 1 and 2 of the algorithm, fused
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass12()
+{
+    // The cubes between slices k and k+1 need the edge cases and the trim
+    // values of both slices, and the trim values of slice k+1 need the edge
+    // cases of slice k+2. So once slice k+2 is classified and slice k+1 is
+    // trimmed, the cubes of slice k are counted. Only about three slices of
+    // edgeCases are touched at a time, so they are still in cache when
+    // pass 2 reads them. edgeCases is still kept whole since pass 4 reads
+    // it.
+    for(size_t k = 0; k != std::min(nz, size_t(2)); ++k) {
+    for(size_t j = 0; j != ny; ++j)
+    {
+        classifyRow(j, k);
+    }}
 
-            curCubeCaseIds[i] = caseId;
+    for(size_t j = 0; j != ny; ++j)
+    {
+        trimRow(j, 0);
+    }
 
-            // If the cube has no triangles through it
-            if(caseId == 0 || caseId == 255)
+    for(size_t k = 0; k + 1 < nz; ++k)
+    {
+        if(k + 2 != nz)
+        {
+            for(size_t j = 0; j != ny; ++j)
             {
-                continue;
+                classifyRow(j, k+2);
             }
+        }
 
-            curTriCounter += util::numTris[caseId];
-
-            const bool* isCut = util::isCut[caseId]; // size 12
-
-            ge0.xstart += isCut[0];
-            ge0.ystart += isCut[3];
-            ge0.zstart += isCut[8];
-
-            // Note: Each 'gridCell' contains four gridEdges running along it,
-            //       ge0, ge1, ge2 and ge3. Each gridCell can access it's own
-            //       ge0 but ge1, ge2 and ge3 are owned by other gridCells.
-            //       Accessing ge1, ge2 and ge3 leads to a race condition
-            //       unless gridCell is along the boundry of the image.
-            //
-            //       To really make sense of the indices, it helps to draw
-            //       out the following picture of a cube with the appropriate
-            //       labels:
-            //         v0 is at (i,   j,   k)
-            //         v1       (i+1, j,   k)
-            //         v2       (i+1, j+1, k)
-            //         v3       (i,   j+1, k)
-            //         v4       (i,   j,   k+1)
-            //         v5       (i+1, j,   k+1)
-            //         v6       (i+1, j+1, k+1)
-            //         v7       (i,   j+1, k+1)
-            //         e0  connects v0 to v1 and is parallel to the x-axis
-            //         e1           v1    v2                        y
-            //         e2           v2    v3                        x
-            //         e3           v0    v3                        y
-            //         e4           v4    v5                        x
-            //         e5           v5    v6                        y
-            //         e6           v6    v7                        x
-            //         e7           v4    v7                        y
-            //         e8           v0    v4                        z
-            //         e9           v1    v5                        z
-            //         e10          v3    v7                        z
-            //         e11          v2    v6                        z
-
-            // Handle cubes along the edge of the image
-            if(isXEnd)
-            {
-                ge0.ystart += isCut[1];
-                ge0.zstart += isCut[9];
-            }
-            if(isYEnd)
-            {
-                ge1.xstart += isCut[2];
-                ge1.zstart += isCut[10];
-            }
-            if(isZEnd)
-            {
-                ge2.xstart += isCut[4];
-                ge2.ystart += isCut[7];
-            }
+        for(size_t j = 0; j != ny; ++j)
+        {
+            trimRow(j, k+1);
+        }
 
-            if(isXEnd and isYEnd)
-            {
-                ge1.zstart += isCut[11];
-            }
-            if(isXEnd and isZEnd)
-            {
-                ge2.ystart += isCut[5];
-            }
-            if(isYEnd and isZEnd)
-            {
-                ge3.xstart += isCut[6];
-            }
+        for(size_t j = 0; j != ny-1; ++j)
+        {
+            countRow(j, k);
         }
-    }}
+    }
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
 // Pass 3 of the algorithm
 ///////////////////////////////////////////////////////////////////////////////
-void FlyingEdgesAlgorithm::pass3()
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass3()
 {
     // Accumulate triangles into triCounter
     size_t tmp;
@@ -201,7 +277,7 @@ void FlyingEdgesAlgorithm::pass3()
     for(size_t k = 0; k != nz-1; ++k) {
     for(size_t j = 0; j != ny-1; ++j)
     {
-        size_t& curTriCounter = triCounter[k*(ny-1)+j];
+        offset_t& curTriCounter = triCounter[k*(ny-1)+j];
 
         tmp = curTriCounter;
         curTriCounter = triAccum;
@@ -263,21 +339,76 @@ void FlyingEdgesAlgorithm::pass3()
     }}
 */
 
-    points = std::vector<std::array<scalar_t, 3> >(pointAccum);
-    normals = std::vector<std::array<scalar_t, 3> >(pointAccum);
-    tris = std::vector<std::array<size_t, 3> >(triAccum);
+    if(pointAccum > std::numeric_limits<offset_t>::max() ||
+       triAccum > std::numeric_limits<offset_t>::max())
+    {
+        throw util::offset_overflow("Too many points or triangles for offset_t");
+    }
+
+    if(pointAccum > std::numeric_limits<index_t>::max())
+    {
+        throw util::index_overflow("Too many points for index_t");
+    }
+
+    // Vectors handed back by run keep their memory.
+    points.resize(pointAccum);
+    normals.resize(normalMode == util::NormalMode::gradient ? pointAccum : 0);
+    tris.resize(triAccum);
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
 // Pass 4 of the algorithm
 ///////////////////////////////////////////////////////////////////////////////
-void FlyingEdgesAlgorithm::pass4()
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::pass4()
 {
+    // Pass 4 is done in two parts that don't depend on each other.
+    //
     // For each (j, k):
-    //  - For each cube at i, fill out points, normals and triangles owned by
-    //    the cube. Each cube is in charge of filling out e0, e3 and e8. Only
-    //    in edge cases does it also fill out other edges.
+    //  - Find the cut x, y and z edges starting on the gridEdge and fill out
+    //    their points and normals. Each direction is swept on its own: the
+    //    cut edges are gathered first and then interpolated in tight loops.
+    // Without gradient normals, the provider computes nothing up front and
+    // is never read.
+    util::BasicGradientProvider<T> gradients(image,
+        normalMode == util::NormalMode::gradient ?
+            gradientMode : util::GradientMode::onTheFly);
+    GradientReader gradReader(gradients);
+
+    EdgeSweep sweep(nx);
+
+    for(size_t k = 0; k != nz; ++k) {
+    for(size_t j = 0; j != ny; ++j)
+    {
+        gridEdge const& ge = gridEdges[k*ny + j];
+
+        const util::edgeCaseWord_t* ec = &edgeCases[ecStride*(k*ny + j)];
+
+        size_t n = findCutXEdges(ec, ge.xl, ge.xr, sweep);
+        interpolateEdges(n, j, k, 0, points, normals, ge.xstart,
+                         gradReader, sweep);
+
+        if(j != ny-1)
+        {
+            n = findCutEdges(ec, ec + ecStride, ge.xl, ge.xr, sweep);
+            interpolateEdges(n, j, k, 1, points, normals, ge.ystart,
+                             gradReader, sweep);
+        }
+
+        if(k != nz-1)
+        {
+            n = findCutEdges(ec, ec + ecStride*ny, ge.xl, ge.xr, sweep);
+            interpolateEdges(n, j, k, 2, points, normals, ge.zstart,
+                             gradReader, sweep);
+        }
+    }}
+
+    // For each (j, k):
+    //  - For each cube at i, fill out the triangles of the cube. The
+    //    points of the cube's edges are numbered the same way pass 2
+    //    counted them. Each cube counts e0, e3 and e8. Only in edge cases
+    //    does it also count other edges.
     for(size_t k = 0; k != nz-1; ++k) {
     for(size_t j = 0; j != ny-1; ++j)
     {
@@ -289,7 +420,16 @@ void FlyingEdgesAlgorithm::pass4()
             continue;
 
         size_t triIdx = triCounter[k*(ny-1) + j];
-        auto curCubeCaseIds = cubeCases.begin() + (nx-1)*(k*(ny-1) + j);
+        // In low memory mode, the cube cases are recomputed from the edge
+        // cases as in pass 2.
+        const uchar* curCubeCaseIds =
+            lowMemory ? nullptr : &cubeCases[(nx-1)*(k*(ny-1) + j)];
+
+        const util::edgeCaseWord_t* ec0 = &edgeCases[ecStride*(k*ny + j)];
+        const util::edgeCaseWord_t* ec1 = &edgeCases[ecStride*(k*ny + j + 1)];
+        const util::edgeCaseWord_t* ec2 = &edgeCases[ecStride*((k+1)*ny + j)];
+        const util::edgeCaseWord_t* ec3 =
+            &edgeCases[ecStride*((k+1)*ny + j + 1)];
 
         gridEdge const& ge0 = gridEdges[k*ny + j];
         gridEdge const& ge1 = gridEdges[k*ny + j + 1];
@@ -308,14 +448,19 @@ void FlyingEdgesAlgorithm::pass4()
 
         size_t x3counter = 0;
 
-        bool isYEnd = (j == ny-2);
-        bool isZEnd = (k == nz-2);
-
         for(size_t i = xl; i != xr; ++i)
         {
-            bool isXEnd = (i == nx-2);
-
-            uchar caseId = curCubeCaseIds[i];
+            uchar caseId;
+            if(lowMemory)
+            {
+                caseId = calcCubeCase(
+                    util::getEdgeCase(ec0, i), util::getEdgeCase(ec1, i),
+                    util::getEdgeCase(ec2, i), util::getEdgeCase(ec3, i));
+            }
+            else
+            {
+                caseId = curCubeCaseIds[i];
+            }
 
             if(caseId == 0 || caseId == 255)
             {
@@ -324,164 +469,43 @@ void FlyingEdgesAlgorithm::pass4()
 
             const bool* isCut = util::isCut[caseId]; // has 12 elements
 
-            // Most of the information contained in pointCube, isovalCube
-            // and gradCube will be used--but not necessarily all. It has
-            // not been tested whether or not obtaining only the information
-            // needed will provide a significant speedup--but
-            // most likely not.
-            cube_t        pointCube = image.getPosCube(i, j, k);
-            scalarCube_t  isovalCube = image.getValsCube(i, j, k);
-            cube_t        gradCube = image.getGradCube(i, j, k);
-
-            // Add Points and normals.
             // Calculate global indices for triangles
             std::array<size_t, 12> globalIdxs;
 
-            if(isCut[0])
-            {
-                size_t idx = ge0.xstart + x0counter;
-                points[idx] = interpolateOnCube(pointCube, isovalCube, 0);
-                normals[idx] = interpolateOnCube(gradCube, isovalCube, 0);
-                globalIdxs[0] = idx;
-                ++x0counter;
-            }
-
-            if(isCut[3])
-            {
-                size_t idx = ge0.ystart + y0counter;
-                points[idx] = interpolateOnCube(pointCube, isovalCube, 3);
-                normals[idx] = interpolateOnCube(gradCube, isovalCube, 3);
-                globalIdxs[3] = idx;
-                ++y0counter;
-            }
-
-            if(isCut[8])
-            {
-                size_t idx = ge0.zstart + z0counter;
-                points[idx] = interpolateOnCube(pointCube, isovalCube, 8);
-                normals[idx] = interpolateOnCube(gradCube, isovalCube, 8);
-                globalIdxs[8] = idx;
-                ++z0counter;
-            }
-
             // Note:
-            //   e1, e5, e9 and e11 will be visited in the next iteration
+            //   e1, e5, e9 and e11 are visited in the next iteration
             //   when they are e3, e7, e8 and 10 respectively. So don't
             //   increment their counters. When the cube is an edge cube,
-            //   their counters don't need to be incremented because they
-            //   won't be used agin.
+            //   their counters won't be used again.
+            if(isCut[0])
+                globalIdxs[0] = ge0.xstart + x0counter++;
+            if(isCut[3])
+                globalIdxs[3] = ge0.ystart + y0counter++;
+            if(isCut[8])
+                globalIdxs[8] = ge0.zstart + z0counter++;
 
-            // Manage boundary cases if needed. Otherwise just update
-            // globalIdx.
             if(isCut[1])
-            {
-                size_t idx = ge0.ystart + y0counter;
-                if(isXEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 1);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 1);
-                    // y0counter counter doesn't need to be incremented
-                    // because it won't be used again.
-                }
-                globalIdxs[1] = idx;
-            }
-
+                globalIdxs[1] = ge0.ystart + y0counter;
             if(isCut[9])
-            {
-                size_t idx = ge0.zstart + z0counter;
-                if(isXEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 9);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 9);
-                    // z0counter doesn't need to in incremented.
-                }
-                globalIdxs[9] = idx;
-            }
+                globalIdxs[9] = ge0.zstart + z0counter;
 
             if(isCut[2])
-            {
-                size_t idx = ge1.xstart + x1counter;
-                if(isYEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 2);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 2);
-                }
-                globalIdxs[2] = idx;
-                ++x1counter;
-            }
-
+                globalIdxs[2] = ge1.xstart + x1counter++;
             if(isCut[10])
-            {
-                size_t idx = ge1.zstart + z1counter;
-
-                if(isYEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 10);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 10);
-                }
-                globalIdxs[10] = idx;
-                ++z1counter;
-            }
+                globalIdxs[10] = ge1.zstart + z1counter++;
 
             if(isCut[4])
-            {
-                size_t idx = ge2.xstart + x2counter;
-                if(isZEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 4);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 4);
-                }
-                globalIdxs[4] = idx;
-                ++x2counter;
-            }
-
+                globalIdxs[4] = ge2.xstart + x2counter++;
             if(isCut[7])
-            {
-                size_t idx = ge2.ystart + y2counter;
-                if(isZEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 7);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 7);
-                }
-                globalIdxs[7] = idx;
-                ++y2counter;
-            }
+                globalIdxs[7] = ge2.ystart + y2counter++;
 
             if(isCut[11])
-            {
-                size_t idx = ge1.zstart + z1counter;
-                if(isXEnd and isYEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 11);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 11);
-                    // z1counter does not need to be incremented.
-                }
-                globalIdxs[11] = idx;
-            }
-
+                globalIdxs[11] = ge1.zstart + z1counter;
             if(isCut[5])
-            {
-                size_t idx = ge2.ystart + y2counter;
-                if(isXEnd and isZEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 5);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 5);
-                    // y2 counter does not need to be incremented.
-                }
-                globalIdxs[5] = idx;
-            }
+                globalIdxs[5] = ge2.ystart + y2counter;
 
             if(isCut[6])
-            {
-                size_t idx = ge3.xstart + x3counter;
-                if(isYEnd and isZEnd)
-                {
-                    points[idx] = interpolateOnCube(pointCube, isovalCube, 6);
-                    normals[idx] = interpolateOnCube(gradCube, isovalCube, 6);
-                }
-                globalIdxs[6] = idx;
-                ++x3counter;
-            }
+                globalIdxs[6] = ge3.xstart + x3counter++;
 
             // Add triangles
             const char* caseTri = util::caseTriangles[caseId]; // size 16
@@ -494,13 +518,19 @@ void FlyingEdgesAlgorithm::pass4()
             }
         }
     }}
+
+    if(normalMode == util::NormalMode::face)
+    {
+        util::computeFaceNormals(points, tris, normals);
+    }
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
 // Don't copy points, normals and tris but move the output into a TrianlgeMesh.
 ///////////////////////////////////////////////////////////////////////////////
-util::TriangleMesh FlyingEdgesAlgorithm::moveOutput()
+template <typename T>
+util::TriangleMesh BasicFlyingEdgesAlgorithm<T>::moveOutput()
 {
     return util::TriangleMesh(std::move(points),
                               std::move(normals),
@@ -509,72 +539,65 @@ util::TriangleMesh FlyingEdgesAlgorithm::moveOutput()
 ///////////////////////////////////////////////////////////////////////////////
 
 ///////////////////////////////////////////////////////////////////////////////
-// Private helper functions
+// Running the algorithm again
 ///////////////////////////////////////////////////////////////////////////////
-
-bool FlyingEdgesAlgorithm::isCutEdge(
-    size_t const& i, size_t const& j, size_t const& k) const
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::reset(scalar_t isoval)
 {
-    // Assuming edgeCases are all set
-    size_t edgeCaseIdx = k*(nx-1)*ny + j*(nx-1) + i;
-    if(edgeCases[edgeCaseIdx] == 1 || edgeCases[edgeCaseIdx] == 2)
-    {
-        return true;
-    }
+    this->isoval = isoval;
 
-    if(j != ny - 1)
-    {
-        size_t edgeCaseIdxY = k*(nx-1)*ny + (j+1)*(nx-1) + i;
-
-        // If (edgeCaseX, edgeCaseY) is (0, 1), (1, 2), (2, 3), (0, 3)
-        //                              (1, 0), (2, 1), (3, 2), (3, 0)
-        // and not the other options of (0, 2), (1, 3),
-        //                              (2, 0), (3, 1)
-        // then the edge along the y axis is cut.
-        // So check to see if edgeCaseX + edgeCaseY is odd.
-        if((edgeCases[edgeCaseIdx] + edgeCases[edgeCaseIdxY]) % 2 == 1)
-        {
-            return true;
-        }
-    }
+    // Pass 1 writes all of edgeCases and xl and xr of every gridEdge, and
+    // pass 2 only reads cubeCases where it wrote them. The counts that
+    // pass 2 adds to have to start at zero.
+    std::fill(gridEdges.begin(), gridEdges.end(), gridEdge());
+    std::fill(triCounter.begin(), triCounter.end(), 0);
+}
 
-    if(k != nz - 1)
-    {
-        size_t edgeCaseIdxZ = (k+1)*(nx-1)*ny + j*(nx-1) + i;
+template <typename T>
+void BasicFlyingEdgesAlgorithm<T>::run(util::TriangleMesh& output)
+{
+    output.releaseBuffers(points, normals, tris);
 
-        // Same as above. If it is odd, then there is a cut except this
-        // time along the z axis.
-        if((edgeCases[edgeCaseIdx] + edgeCases[edgeCaseIdxZ]) % 2 == 1)
-        {
-            return true;
-        }
-    }
+    pass1();
+    pass2();
+    pass3();
+    pass4();
 
-    return false;
+    output = moveOutput();
 }
+///////////////////////////////////////////////////////////////////////////////
 
-inline uchar
-FlyingEdgesAlgorithm::calcCaseEdge(
-    bool const& prevEdge,
-    bool const& currEdge) const
+///////////////////////////////////////////////////////////////////////////////
+// Memory used by the state kept between passes
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+size_t BasicFlyingEdgesAlgorithm<T>::intermediateStateBytes() const
+{
+    return gridEdges.size() * sizeof(gridEdge) +
+           triCounter.size() * sizeof(offset_t) +
+           edgeCases.size() * sizeof(util::edgeCaseWord_t) +
+           cubeCases.size() * sizeof(uchar);
+}
+
+template <typename T>
+size_t BasicFlyingEdgesAlgorithm<T>::fullIntermediateStateBytes() const
 {
-    // o -- is greater than or equal to
-    // case 0: (i-1) o-----o (i) | (_,j,k)
-    // case 1: (i-1) x-----o (i) | (_,j+1,k)
-    // case 2: (i-1) o-----x (i) | (_,j,k+1)
-    // case 3: (i-1) x-----x (i) | (_,j+1,k+1)
-    if(prevEdge && currEdge)
-        return 0;
-    if(!prevEdge && currEdge)
-        return 1;
-    if(prevEdge && !currEdge)
-        return 2;
-    else // !prevEdge && !currEdge
-        return 3;
+    // gridEdge has 5 size_t, each edge case is a byte and cubeCases is
+    // allocated
+    return gridEdges.size() * 5 * sizeof(size_t) +
+           triCounter.size() * sizeof(size_t) +
+           (nx-1)*ny*nz * sizeof(uchar) +
+           (nx-1)*(ny-1)*(nz-1) * sizeof(uchar);
 }
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Private helper functions
+///////////////////////////////////////////////////////////////////////////////
 
+template <typename T>
 inline uchar
-FlyingEdgesAlgorithm::calcCubeCase(
+BasicFlyingEdgesAlgorithm<T>::calcCubeCase(
     uchar const& ec0, uchar const& ec1,
     uchar const& ec2, uchar const& ec3) const
 {
@@ -603,8 +626,9 @@ FlyingEdgesAlgorithm::calcCubeCase(
     return caseId;
 }
 
+template <typename T>
 inline void
-FlyingEdgesAlgorithm::calcTrimValues(
+BasicFlyingEdgesAlgorithm<T>::calcTrimValues(
     size_t& xl, size_t& xr,
     size_t const& j, size_t const& k) const
 {
@@ -620,21 +644,134 @@ FlyingEdgesAlgorithm::calcTrimValues(
         xl = xr;
 }
 
-inline std::array<scalar_t, 3>
-FlyingEdgesAlgorithm::interpolateOnCube(
-    cube_t const& pts,
-    scalarCube_t const& isovals,
-    uchar const& edge) const
+template <typename T>
+inline size_t
+BasicFlyingEdgesAlgorithm<T>::findCutXEdges(
+    const util::edgeCaseWord_t* ec, size_t xl, size_t xr,
+    EdgeSweep& sweep) const
+{
+    // Every index is written but n only moves past the cut ones, so the
+    // loop has no branches.
+    size_t n = 0;
+    for(size_t i = xl; i < xr; ++i)
+    {
+        uchar edgeCase = util::getEdgeCase(ec, i);
+        sweep.cuts[n] = i;
+        n += (edgeCase == 1) | (edgeCase == 2);
+    }
+    return n;
+}
+
+template <typename T>
+inline size_t
+BasicFlyingEdgesAlgorithm<T>::findCutEdges(
+    const util::edgeCaseWord_t* ec, const util::edgeCaseWord_t* ecNext,
+    size_t xl, size_t xr, EdgeSweep& sweep) const
 {
-    uchar i0 = util::edgeVertices[edge][0];
-    uchar i1 = util::edgeVertices[edge][1];
+    // The edge from point i to the next row is cut if bit 0 of the edge
+    // cases differ. Pass 1 trimmed each row to the points with such edges
+    // except the last point, which is only bit 1 of the last edge case.
+    size_t n = 0;
+    for(size_t i = xl; i < xr; ++i)
+    {
+        uchar diff = util::getEdgeCase(ec, i) ^ util::getEdgeCase(ecNext, i);
+        sweep.cuts[n] = i;
+        n += diff & 1;
+    }
+
+    uchar diff =
+        util::getEdgeCase(ec, nx-2) ^ util::getEdgeCase(ecNext, nx-2);
+    if(diff & 2)
+    {
+        sweep.cuts[n++] = nx-1;
+    }
+    return n;
+}
+
+template <typename T>
+inline void
+BasicFlyingEdgesAlgorithm<T>::interpolateEdges(
+    size_t n, size_t j, size_t k, int axis,
+    util::VectorArray& edgePoints, util::VectorArray& edgeNormals, size_t start,
+    GradientReader& gradReader, EdgeSweep& sweep) const
+{
+    // Each edge starts at (sweep.cuts[m], j, k) and goes one point along
+    // axis.
+    size_t const di = (axis == 0);
+    size_t const dj = (axis == 1);
+    size_t const dk = (axis == 2);
+
+    const T* row = image.pointer() + nx*(k*ny + j);
+    size_t const step = di + dj*nx + dk*nx*ny;
 
-    scalar_t weight = (isoval - isovals[i0]) / (isovals[i1] - isovals[i0]);
-    return interpolate(pts[i0], pts[i1], weight);
+    for(size_t m = 0; m != n; ++m)
+    {
+        scalar_t v0 = row[sweep.cuts[m]];
+        scalar_t v1 = row[sweep.cuts[m] + step];
+        sweep.weights[m] = (isoval - v0) / (v1 - v0);
+    }
+
+    std::array<scalar_t, 3> const zeroPos = image.getZeroPos();
+    std::array<scalar_t, 3> const spacing = image.getSpacing();
+    size_t const zOffset = image.zoffset();
+
+    std::array<scalar_t, 3> a;
+    a[1] = position(j, ny, zeroPos[1], spacing[1]);
+    a[2] = position(k + zOffset, nz + zOffset, zeroPos[2], spacing[2]);
+    std::array<scalar_t, 3> b = a;
+    b[axis] += spacing[axis];
+
+    // The components are written straight into the output arrays. With
+    // MESH_SOA each of them is contiguous.
+    size_t const stride = util::VectorArray::stride;
+    scalar_t* pointX = edgePoints.data(0) + start*stride;
+    scalar_t* pointY = edgePoints.data(1) + start*stride;
+    scalar_t* pointZ = edgePoints.data(2) + start*stride;
+    for(size_t m = 0; m != n; ++m)
+    {
+        size_t i = sweep.cuts[m];
+        scalar_t w = sweep.weights[m];
+        a[0] = position(i, nx, zeroPos[0], spacing[0]);
+        b[0] = di ? a[0] + spacing[0] : a[0];
+        pointX[m*stride] = a[0] + (w * (b[0] - a[0]));
+        pointY[m*stride] = a[1] + (w * (b[1] - a[1]));
+        pointZ[m*stride] = a[2] + (w * (b[2] - a[2]));
+    }
+
+    if(normalMode != util::NormalMode::gradient)
+        return;
+
+    scalar_t* normX = edgeNormals.data(0) + start*stride;
+    scalar_t* normY = edgeNormals.data(1) + start*stride;
+    scalar_t* normZ = edgeNormals.data(2) + start*stride;
+    for(size_t m = 0; m != n; ++m)
+    {
+        size_t i = sweep.cuts[m];
+        std::array<scalar_t, 3> normal = interpolate(
+            gradReader.getGradient(i, j, k),
+            gradReader.getGradient(i + di, j + dj, k + dk),
+            sweep.weights[m]);
+        normX[m*stride] = normal[0];
+        normY[m*stride] = normal[1];
+        normZ[m*stride] = normal[2];
+    }
+}
+
+template <typename T>
+inline scalar_t
+BasicFlyingEdgesAlgorithm<T>::position(
+    size_t idx, size_t dim, scalar_t zeroPos, scalar_t spacing) const
+{
+    // Same as Image3D::getPosCube, where the last point along an axis is
+    // one spacing past the point before it.
+    if(idx + 1 != dim)
+        return zeroPos + idx * spacing;
+    return (zeroPos + (idx - 1) * spacing) + spacing;
 }
 
+template <typename T>
 inline std::array<scalar_t, 3>
-FlyingEdgesAlgorithm::interpolate(
+BasicFlyingEdgesAlgorithm<T>::interpolate(
     std::array<scalar_t, 3> const& a,
     std::array<scalar_t, 3> const& b,
     scalar_t const& weight) const
@@ -648,3 +785,11 @@ FlyingEdgesAlgorithm::interpolate(
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// The scalar types an image file can hold, see TypeInfo.h
+template struct BasicFlyingEdgesAlgorithm<char>;
+template struct BasicFlyingEdgesAlgorithm<unsigned char>;
+template struct BasicFlyingEdgesAlgorithm<short>;
+template struct BasicFlyingEdgesAlgorithm<unsigned short>;
+template struct BasicFlyingEdgesAlgorithm<int>;
+template struct BasicFlyingEdgesAlgorithm<float>;
+template struct BasicFlyingEdgesAlgorithm<double>;
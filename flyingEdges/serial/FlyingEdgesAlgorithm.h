@@ -20,34 +20,72 @@
 #include <array>
 
 #include "../util/FlyingEdges_Config.h"
+#include "../util/EdgeCaseKernels.h"
+#include "../util/GradientProvider.h"
+#include "../util/MeshNormals.h"
 
 #include "../util/Image3D.h"
 #include "../util/TriangleMesh.h"
 
-struct FlyingEdgesAlgorithm
+// T is the scalar type of the image. The isoval, points and normals are
+// scalar_t whatever T is.
+template <typename T>
+struct BasicFlyingEdgesAlgorithm
 {
-    FlyingEdgesAlgorithm(util::Image3D const& image, scalar_t const& isoval)
+    // With lowMemory set, cubeCases is not allocated and pass4 recomputes
+    // the case of each cube from edgeCases. gradientMode is how pass4 finds
+    // the gradients that the normals are interpolated from. normalMode is
+    // how the normals are made, if at all.
+    BasicFlyingEdgesAlgorithm(util::BasicImage3D<T> const& image,
+                              scalar_t const& isoval,
+                              bool lowMemory = false,
+                              util::GradientMode gradientMode =
+                                  util::GradientMode::onTheFly,
+                              util::NormalMode normalMode =
+                                  util::NormalMode::gradient)
       : image(image),
         isoval(isoval),
+        lowMemory(lowMemory),
+        gradientMode(gradientMode),
+        normalMode(normalMode),
         nx(image.xdimension()),
         ny(image.ydimension()),
         nz(image.zdimension()),
+        ecStride(util::edgeCaseRowSize(nx)),
         gridEdges(ny*nz),
         triCounter((ny-1)*(nz-1)),
-        edgeCases((nx-1)*ny*nz),
-        cubeCases((nx-1)*(ny-1)*(nz-1))
+        edgeCases(ecStride*ny*nz),
+        cubeCases(lowMemory ? 0 : (nx-1)*(ny-1)*(nz-1))
     {}
 
     void pass1();
 
     void pass2();
 
+    // Passes 1 and 2 done a z-slice at a time, so the edge cases pass 2
+    // reads were just written by pass 1. Does the same as pass1 and pass2.
+    void pass12();
+
     void pass3();
 
     void pass4();
 
+    // An algorithm can be run any number of times if reset is called
+    // between runs. reset sets the isoval of the next run and clears the
+    // state kept between passes without freeing it. run does the four
+    // passes and moves the mesh into output.
+    // The vectors output held before are reused for the new mesh, so
+    // passing the same output to every run avoids allocating it again.
+    void reset(scalar_t isoval);
+    void run(util::TriangleMesh& output);
+
     util::TriangleMesh moveOutput();
 
+    // Bytes used by gridEdges, triCounter, edgeCases and cubeCases, and the
+    // bytes they use without FE_COMPACT defined or lowMemory set.
+    size_t intermediateStateBytes() const;
+    size_t fullIntermediateStateBytes() const;
+
 private:
     struct gridEdge
     {
@@ -61,39 +99,59 @@ private:
 
         // trim values
         // set on pass 1
-        size_t xl;
-        size_t xr;
+        offset_t xl;
+        offset_t xr;
 
         // modified on pass 2
         // set on pass 3
-        size_t xstart;
-        size_t ystart;
-        size_t zstart;
+        offset_t xstart;
+        offset_t ystart;
+        offset_t zstart;
+    };
+
+    // Scratch space for the cut edges along a gridEdge in pass 4
+    struct EdgeSweep
+    {
+        EdgeSweep(size_t nx)
+          : cuts(nx),
+            weights(nx)
+        {}
+
+        std::vector<size_t> cuts;       // where each cut edge starts
+        std::vector<scalar_t> weights;  // where the isosurface cuts it
     };
 
+    using GradientReader = typename util::BasicGradientProvider<T>::Reader;
+
 private:
-    util::Image3D const& image;
-    scalar_t const isoval;
+    util::BasicImage3D<T> const& image;
+    scalar_t isoval;
+    bool const lowMemory;
+    util::GradientMode const gradientMode;
+    util::NormalMode const normalMode;
 
     size_t const nx; //
     size_t const ny; // for indexing
     size_t const nz; //
 
+    size_t const ecStride; // words in a row of edgeCases
+
     std::vector<gridEdge> gridEdges; // size of ny*nz
-    std::vector<size_t> triCounter;  // size of (ny-1)*(nz-1)
+    std::vector<offset_t> triCounter; // size of (ny-1)*(nz-1)
 
-    std::vector<uchar> edgeCases;    // size (nx-1)*ny*nz
-    std::vector<uchar> cubeCases;    // size (nx-1)*(ny-1)*(nz-1)
+    std::vector<util::edgeCaseWord_t> edgeCases; // size ecStride*ny*nz
+    std::vector<uchar> cubeCases;    // size (nx-1)*(ny-1)*(nz-1) or 0
 
-    std::vector<std::array<scalar_t, 3> > points;  //
-    std::vector<std::array<scalar_t, 3> > normals; // The output
-    std::vector<std::array<size_t, 3> > tris;     //
+    util::VectorArray points;                      //
+    util::VectorArray normals;                     // The output
+    util::TriangleArray tris;                      //
 
 private:
-    bool isCutEdge(size_t const& i, size_t const& j, size_t const& k) const;
-
-    inline uchar
-    calcCaseEdge(bool const& prevEdge, bool const& currEdge) const;
+    // The work of passes 1 and 2 on gridEdge (j, k). countRow works on the
+    // row of cubes starting at gridEdge (j, k).
+    inline void classifyRow(size_t j, size_t k);
+    inline void trimRow(size_t j, size_t k);
+    inline void countRow(size_t j, size_t k);
 
     inline uchar
     calcCubeCase(uchar const& ec0, uchar const& ec1,
@@ -102,11 +160,30 @@ private:
     inline void calcTrimValues(
         size_t& xl, size_t& xr, size_t const& j, size_t const& k) const;
 
-    inline std::array<scalar_t, 3>
-    interpolateOnCube(
-        cube_t const& pts,
-        scalarCube_t const& isovals,
-        uchar const& edge) const;
+    // Fill sweep.cuts with the cut x-edges of a gridEdge, or with the
+    // points of a gridEdge whose edge to the next row is cut. ecNext holds
+    // the edge cases of the next row in y or z. Return how many there are.
+    inline size_t findCutXEdges(
+        const util::edgeCaseWord_t* ec, size_t xl, size_t xr,
+        EdgeSweep& sweep) const;
+
+    inline size_t findCutEdges(
+        const util::edgeCaseWord_t* ec, const util::edgeCaseWord_t* ecNext,
+        size_t xl, size_t xr, EdgeSweep& sweep) const;
+
+    // Fill out the points and normals of the first n edges in sweep.cuts
+    // along gridEdge (j, k), from index start on. axis is the direction of
+    // the edges.
+    inline void interpolateEdges(
+        size_t n, size_t j, size_t k, int axis,
+        util::VectorArray& edgePoints,
+        util::VectorArray& edgeNormals,
+        size_t start,
+        GradientReader& gradReader,
+        EdgeSweep& sweep) const;
+
+    inline scalar_t position(
+        size_t idx, size_t dim, scalar_t zeroPos, scalar_t spacing) const;
 
     inline std::array<scalar_t, 3>
     interpolate(
@@ -115,5 +192,7 @@ private:
         scalar_t const& weight) const;
 };
 
+using FlyingEdgesAlgorithm = BasicFlyingEdgesAlgorithm<scalar_t>;
+
 
 #endif
@@ -18,86 +18,38 @@
 
 #include "FlyingEdgesAlgorithm.h"
 
+#include "../util/EdgeCaseKernels.h"
+#include "../util/GradientProvider.h"
 #include "../util/LoadImage.h"
+#include "../util/MeshNormals.h"
 #include "../util/SaveTriangleMesh.h"
 
 #include "../util/Timer.h"
 #include "../mantevoCommon/YAML_Doc.hpp"
 
-int main(int argc, char* argv[])
+// The settings of a run. The algorithm is run on the image as it is in the
+// file, so it is instantiated for each scalar type a file can hold.
+struct Run
 {
     scalar_t isoval;
-    bool isovalSet = false;
-    char* vtkFile = NULL;
-    char* outFile = NULL;
-    std::string yamlDirectory = "";
-    std::string yamlFileName  = "";
-
-    // Read command line arguments
-    for(int i=0; i<argc; i++)
-    {
-        if( (strcmp(argv[i], "-i") == 0) || (strcmp(argv[i], "-input_file") == 0))
-        {
-            vtkFile = argv[++i];
-        }
-        else if( (strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "-output_file") == 0))
-        {
-            outFile = argv[++i];
-        }
-        else if( (strcmp(argv[i], "-v") == 0) || (strcmp(argv[i], "-isoval") == 0))
-        {
-            isovalSet = true;
-            isoval = atof(argv[++i]);
-        }
-        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
-        {
-            std::string wholeFile(argv[++i]);
-
-            std::size_t pos = wholeFile.rfind("/");
-            if(pos == std::string::npos)
-            {
-                yamlDirectory = "./";
-                yamlFileName = wholeFile;
-            }
-            else
-            {
-                yamlDirectory = wholeFile.substr(0, pos + 1);
-                yamlFileName = wholeFile.substr(pos + 1);
-            }
-        }
-        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
-        {
-            std::cout <<
-                "Serial Flying Edges Options:"    << std::endl <<
-                "  -input_file (-i)"              << std::endl <<
-                "  -output_file (-o)"             << std::endl <<
-                "  -isoval (-v)"                  << std::endl <<
-                "  -yaml_output_file (-y)"        << std::endl <<
-                "  -help (-h)"                    << std::endl;
-            return 0;
-        }
-    }
-
-    if(isovalSet == false || vtkFile == NULL || outFile == NULL)
-    {
-        std::cout << "Error: isoval, input_file and output_file must be set." << std::endl <<
-                     "Try -help" << std::endl;
-        return 0;
-    }
+    bool lowMemory;
+    bool fused;
+    bool autoGradient;
+    util::GradientMode gradientMode;
+    size_t gradientMemory; // MiB
+    util::NormalMode normalMode;
+    const char* outFile;
+    YAML_Doc& doc;
 
-    // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
-    // YAML_Doc will create a file at in the current directory with a
-    // timestamp on it.
-    YAML_Doc doc("Flying Edges", "0.1", yamlDirectory, yamlFileName);
-
-    // Add information related to this run to doc.
-    doc.add("Flying Edges Algorithm", "serial");
-    doc.add("Volume image data file path", vtkFile);
-    doc.add("Polygonal mesh output file", outFile);
-    doc.add("Isoval", isoval);
+    template <typename T>
+    void operator()(util::BasicImage3D<T> const& image);
+};
 
-    // Load the image file
-    util::Image3D image = util::loadImage(vtkFile);
+template <typename T>
+void Run::operator()(util::BasicImage3D<T> const& image)
+{
+    doc.add("Image scalar type", util::createTemplateTypeInfo<T>().name());
+    doc.add("Edge classification kernel", util::edgeCaseKernelName<T>());
 
     // Just for comparison purposes to gpu versions--this makes problem size smaller
     //image.cutDown(100);
@@ -106,12 +58,30 @@ int main(int argc, char* argv[])
     doc.add("File y-dimension", image.ydimension());
     doc.add("File z-dimension", image.zdimension());
 
+    // Without a gradient mode given, use the fastest one that fits in the
+    // gradient memory budget.
+    size_t gradientBudget = gradientMemory << 20;
+    if(autoGradient)
+    {
+        gradientMode = util::chooseGradientMode(
+            image.xdimension(), image.ydimension(), image.zdimension(),
+            1, gradientBudget);
+    }
+    doc.add("Gradient mode", util::gradientModeName(gradientMode));
+    doc.add("Gradient memory budget (bytes)", gradientBudget);
+
     // Time the output. util::Timer's constructor starts timing.
     util::Timer runTime;
 
     // The inputs of the algorithm are the 3D image file and the isoval to
     // estimate the isosurface at.
-    FlyingEdgesAlgorithm algo(image, isoval);
+    // In low memory mode, the case of each cube isn't kept between pass 2
+    // and pass 4.
+    // The gradient mode is how pass 4 gets the gradients for the normals.
+    // The normal mode is whether the normals are interpolated from the
+    // gradients, averaged from the triangles or not made at all.
+    BasicFlyingEdgesAlgorithm<T> algo(image, isoval, lowMemory, gradientMode,
+                                      normalMode);
     // The flying edges algorithm makes 4 passes through the image file.
     // Each pass is timed.
 
@@ -122,18 +92,30 @@ int main(int argc, char* argv[])
     // A gridEdge E_jk can be thought of as the row of edges parallel to the
     // x-axis for some fixed j and k.
     util::Timer runTimePass1;
-    algo.pass1();
-    runTimePass1.stop();
-
-    // Pass 2 of the algorithm determines the marching cubes case ID of each
-    // cube. This is determined fully from information obtained in pass1, so
-    // there is no need to access the input image. Each cube starts at (i,j,k)
-    // and extends to (i+1, j+1, k+1).
-    // In addition to determining case ID of each cell, pass 2 counts the
-    // number of cuts on incident to each gridEdge.
     util::Timer runTimePass2;
-    algo.pass2();
-    runTimePass2.stop();
+    if(fused)
+    {
+        // Passes 1 and 2 can also be done together a z-slice at a time, so
+        // the edge cases of each slice are still in cache when pass 2 reads
+        // them. They are timed together.
+        algo.pass12();
+        runTimePass1.stop();
+    }
+    else
+    {
+        algo.pass1();
+        runTimePass1.stop();
+
+        // Pass 2 of the algorithm determines the marching cubes case ID of
+        // each cube. This is determined fully from information obtained in
+        // pass1, so there is no need to access the input image. Each cube
+        // starts at (i,j,k) and extends to (i+1, j+1, k+1).
+        // In addition to determining case ID of each cell, pass 2 counts the
+        // number of cuts on incident to each gridEdge.
+        runTimePass2.start();
+        algo.pass2();
+        runTimePass2.stop();
+    }
 
     // Pass 3 of the algorithm uses information from pass 2 to determine how
     // many triangles and points there are. It also sets up starting indices
@@ -161,16 +143,32 @@ int main(int argc, char* argv[])
     doc.add("Number of vertices in mesh", mesh.numberOfVertices());
     doc.add("Number of triangles in mesh", mesh.numberOfTriangles());
 
+    // Report the memory kept between passes
+    size_t stateBytes = algo.intermediateStateBytes();
+    size_t fullStateBytes = algo.fullIntermediateStateBytes();
+    doc.add("Intermediate state (bytes)", stateBytes);
+    doc.add("Intermediate state saved (bytes)", fullStateBytes - stateBytes);
+
     // Report timing information
-    doc.add("Pass 1", "");
-    doc.get("Pass 1")->add("CPU Time (clicks)", runTimePass1.getTotalTicks());
-    doc.get("Pass 1")->add("CPU Time (seconds)", runTimePass1.getCPUtime());
-    doc.get("Pass 1")->add("Wall Time (seconds)", runTimePass1.getWallTime());
+    if(fused)
+    {
+        doc.add("Passes 1 and 2", "");
+        doc.get("Passes 1 and 2")->add("CPU Time (clicks)", runTimePass1.getTotalTicks());
+        doc.get("Passes 1 and 2")->add("CPU Time (seconds)", runTimePass1.getCPUtime());
+        doc.get("Passes 1 and 2")->add("Wall Time (seconds)", runTimePass1.getWallTime());
+    }
+    else
+    {
+        doc.add("Pass 1", "");
+        doc.get("Pass 1")->add("CPU Time (clicks)", runTimePass1.getTotalTicks());
+        doc.get("Pass 1")->add("CPU Time (seconds)", runTimePass1.getCPUtime());
+        doc.get("Pass 1")->add("Wall Time (seconds)", runTimePass1.getWallTime());
 
-    doc.add("Pass 2", "");
-    doc.get("Pass 2")->add("CPU Time (clicks)", runTimePass2.getTotalTicks());
-    doc.get("Pass 2")->add("CPU Time (seconds)", runTimePass2.getCPUtime());
-    doc.get("Pass 2")->add("Wall Time (seconds)", runTimePass2.getWallTime());
+        doc.add("Pass 2", "");
+        doc.get("Pass 2")->add("CPU Time (clicks)", runTimePass2.getTotalTicks());
+        doc.get("Pass 2")->add("CPU Time (seconds)", runTimePass2.getCPUtime());
+        doc.get("Pass 2")->add("Wall Time (seconds)", runTimePass2.getWallTime());
+    }
 
     doc.add("Pass 3", "");
     doc.get("Pass 3")->add("CPU Time (clicks)", runTimePass3.getTotalTicks());
@@ -192,3 +190,142 @@ int main(int argc, char* argv[])
     // Save the polygonal mesh to the output file.
     util::saveTriangleMesh(mesh, outFile);
 }
+
+int main(int argc, char* argv[])
+{
+    scalar_t isoval;
+    bool isovalSet = false;
+    char* vtkFile = NULL;
+    char* outFile = NULL;
+    bool lowMemory = false;
+    bool fused = false;
+    char* gradientName = NULL;
+    size_t gradientMemory = 1024; // MiB
+    char* normalName = NULL;
+    std::string yamlDirectory = "";
+    std::string yamlFileName  = "";
+
+    // Read command line arguments
+    for(int i=0; i<argc; i++)
+    {
+        if( (strcmp(argv[i], "-i") == 0) || (strcmp(argv[i], "-input_file") == 0))
+        {
+            vtkFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "-output_file") == 0))
+        {
+            outFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-v") == 0) || (strcmp(argv[i], "-isoval") == 0))
+        {
+            isovalSet = true;
+            isoval = atof(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-l") == 0) || (strcmp(argv[i], "-low_memory") == 0))
+        {
+            lowMemory = atoi(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-f") == 0) || (strcmp(argv[i], "-fused") == 0))
+        {
+            fused = atoi(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-g") == 0) || (strcmp(argv[i], "-gradient") == 0))
+        {
+            gradientName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-gm") == 0) || (strcmp(argv[i], "-gradient_memory") == 0))
+        {
+            gradientMemory = atol(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-normals") == 0))
+        {
+            normalName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
+        {
+            std::string wholeFile(argv[++i]);
+
+            std::size_t pos = wholeFile.rfind("/");
+            if(pos == std::string::npos)
+            {
+                yamlDirectory = "./";
+                yamlFileName = wholeFile;
+            }
+            else
+            {
+                yamlDirectory = wholeFile.substr(0, pos + 1);
+                yamlFileName = wholeFile.substr(pos + 1);
+            }
+        }
+        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
+        {
+            std::cout <<
+                "Serial Flying Edges Options:"    << std::endl <<
+                "  -input_file (-i)"              << std::endl <<
+                "  -output_file (-o)"             << std::endl <<
+                "  -isoval (-v)"                  << std::endl <<
+                "  -low_memory (-l), default 0"   << std::endl <<
+                "  -fused (-f), default 0"        << std::endl <<
+                "  -gradient (-g), default auto"  << std::endl <<
+                "    auto, onthefly, rolling or"  << std::endl <<
+                "    precomputed"                 << std::endl <<
+                "  -gradient_memory (-gm), MiB,"  << std::endl <<
+                "    default 1024"                << std::endl <<
+                "  -normals (-n), default"        << std::endl <<
+                "    gradient, none or face"      << std::endl <<
+                "  -yaml_output_file (-y)"        << std::endl <<
+                "  -help (-h)"                    << std::endl;
+            return 0;
+        }
+    }
+
+    if(isovalSet == false || vtkFile == NULL || outFile == NULL)
+    {
+        std::cout << "Error: isoval, input_file and output_file must be set." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    bool autoGradient =
+        gradientName == NULL || strcmp(gradientName, "auto") == 0;
+    util::GradientMode gradientMode = util::GradientMode::onTheFly;
+    if(!autoGradient && !util::parseGradientMode(gradientName, gradientMode))
+    {
+        std::cout << "Error: unknown gradient mode " << gradientName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::NormalMode normalMode = util::NormalMode::gradient;
+    if(normalName != NULL && !util::parseNormalMode(normalName, normalMode))
+    {
+        std::cout << "Error: unknown normal mode " << normalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
+    // YAML_Doc will create a file at in the current directory with a
+    // timestamp on it.
+    YAML_Doc doc("Flying Edges", "0.1", yamlDirectory, yamlFileName);
+
+    // Add information related to this run to doc.
+    doc.add("Flying Edges Algorithm", "serial");
+    doc.add("Volume image data file path", vtkFile);
+    doc.add("Polygonal mesh output file", outFile);
+    doc.add("Isoval", isoval);
+#ifdef FE_COMPACT
+    doc.add("Compact intermediate state", "on");
+#else
+    doc.add("Compact intermediate state", "off");
+#endif
+    doc.add("Low memory mode", lowMemory ? "on" : "off");
+    doc.add("Fused passes 1 and 2", fused ? "on" : "off");
+    doc.add("Normal mode", util::normalModeName(normalMode));
+
+    // Load the image file keeping its scalar type, and run the algorithm
+    // on it. The image is freed when the run is done.
+    Run run = { isoval, lowMemory, fused, autoGradient, gradientMode,
+                gradientMemory, normalMode, outFile, doc };
+    util::visitImage(vtkFile, run);
+}
@@ -0,0 +1,657 @@
+/*
+ * flyingEdgesAlgorithm.cpp
+ *
+ *  Created on: Feb 17, 2017
+ *      Author: dbourge
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+#include "FlyingEdgesAlgorithm.h"
+
+#include "../util/MarchingCubesTables.h"
+#include "../util/EdgeCaseKernels.h"
+#include "../util/Errors.h"
+#include <algorithm>
+#include <limits>
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass 1 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+void FlyingEdgesAlgorithm::pass1()
+{
+    // For each (j, k):
+    //  - for each edge i along fixed (j, k) gridEdge, fill edgeCases with
+    //    cut information.
+    //  - find the locations for computational trimming, xl and xr
+    //  To properly find xl and xr, have to check along the x axis,
+    //  the y-axis and the z-axis!
+    //  The slice below kBegin is not needed.
+    for(size_t k = kBegin; k != nz; ++k) {
+    for(size_t j = 0; j != ny; ++j)
+    {
+        auto curEdgeCases = edgeCases.begin() + ecStride * (k*ny + j);
+        auto curPointValues = image.getRowIter(j, k);
+
+        // Compares the whole row against isoval with the widest vector
+        // instructions available.
+        util::classifyEdges(
+            &curPointValues[0], nx, isoval, &curEdgeCases[0]);
+    }}
+
+    for(size_t k = kBegin; k != nz; ++k) {
+    for(size_t j = 0; j != ny; ++j)
+    {
+        gridEdge& curGridEdge = gridEdges[k*ny + j];
+
+        // The edge cases of this row and of the neighbouring rows in y and
+        // z are compared 8 edges at a time. The search stops at the first
+        // and last cut edge.
+        auto curEdgeCases = edgeCases.begin() + ecStride * (k*ny + j);
+        const util::edgeCaseWord_t* nextEdgeCasesY =
+            (j != ny-1) ? &curEdgeCases[ecStride] : nullptr;
+        const util::edgeCaseWord_t* nextEdgeCasesZ =
+            (k != nz-1) ? &curEdgeCases[ecStride*ny] : nullptr;
+
+        size_t xl, xr;
+        util::findTrim(
+            &curEdgeCases[0], nextEdgeCasesY, nextEdgeCasesZ, nx, xl, xr);
+
+        curGridEdge.xl = xl;
+        curGridEdge.xr = xr;
+    }}
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass 2 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+void FlyingEdgesAlgorithm::pass2()
+{
+    // For each (j, k):
+    //  - for each cube (i, j, k) calculate caseId and number of gridEdge cuts
+    //    in the x, y and z direction.
+    //  Unless this is the last slab, the cells above kEnd are counted too.
+    //  They give the number of points on the gridEdges of slice kEnd, which
+    //  are needed to number the points the slab's triangles use.
+    for(size_t k = kBegin; k != nz-1; ++k) {
+    for(size_t j = 0; j != ny-1; ++j)
+    {
+        // find adjusted trim values
+        size_t xl, xr;
+        calcTrimValues(xl, xr, j, k); // xl, xr set in this function
+
+        // ge0 is owned by this (i, j, k). ge1, ge2 and ge3 are only used for
+        // boundary cells.
+        gridEdge& ge0 = gridEdges[k*ny + j];
+        gridEdge& ge1 = gridEdges[k*ny + j + 1];
+        gridEdge& ge2 = gridEdges[(k+1)*ny + j];
+        gridEdge& ge3 = gridEdges[(k+1)*ny + j + 1];
+
+        // ec0, ec1, ec2 and ec3 were set in pass 1. They are used
+        // to calculate the cell caseId.
+        const util::edgeCaseWord_t* ec0 = &edgeCases[ecStride*(k*ny + j)];
+        const util::edgeCaseWord_t* ec1 = &edgeCases[ecStride*(k*ny + j + 1)];
+        const util::edgeCaseWord_t* ec2 = &edgeCases[ecStride*((k+1)*ny + j)];
+        const util::edgeCaseWord_t* ec3 =
+            &edgeCases[ecStride*((k+1)*ny + j + 1)];
+
+        // Count the number of triangles along this row of cubes.
+        offset_t& curTriCounter = *(triCounter.begin() + k*(ny-1) + j);
+
+        uchar* curCubeCaseIds =
+            lowMemory ? nullptr : &cubeCases[(nx-1)*(k*(ny-1) + j)];
+
+        bool isYEnd = (j == ny-2);
+        bool isZEnd = lastSlab && (k == nz-2);
+
+        for(size_t i = xl; i != xr; ++i)
+        {
+            bool isXEnd = (i == nx-2);
+
+            // using edgeCases from pass 2, compute cubeCases for this cube
+            uchar caseId = calcCubeCase(
+                util::getEdgeCase(ec0, i), util::getEdgeCase(ec1, i),
+                util::getEdgeCase(ec2, i), util::getEdgeCase(ec3, i));
+
+            if(!lowMemory)
+            {
+                curCubeCaseIds[i] = caseId;
+            }
+
+            // If the cube has no triangles through it
+            if(caseId == 0 || caseId == 255)
+            {
+                continue;
+            }
+
+            curTriCounter += util::numTris[caseId];
+
+            const bool* isCut = util::isCut[caseId]; // size 12
+
+            ge0.xstart += isCut[0];
+            ge0.ystart += isCut[3];
+            ge0.zstart += isCut[8];
+
+            // Note: Each 'gridCell' contains four gridEdges running along it,
+            //       ge0, ge1, ge2 and ge3. Each gridCell can access it's own
+            //       ge0 but ge1, ge2 and ge3 are owned by other gridCells.
+            //       Accessing ge1, ge2 and ge3 leads to a race condition
+            //       unless gridCell is along the boundry of the image.
+            //
+            //       To really make sense of the indices, it helps to draw
+            //       out the following picture of a cube with the appropriate
+            //       labels:
+            //         v0 is at (i,   j,   k)
+            //         v1       (i+1, j,   k)
+            //         v2       (i+1, j+1, k)
+            //         v3       (i,   j+1, k)
+            //         v4       (i,   j,   k+1)
+            //         v5       (i+1, j,   k+1)
+            //         v6       (i+1, j+1, k+1)
+            //         v7       (i,   j+1, k+1)
+            //         e0  connects v0 to v1 and is parallel to the x-axis
+            //         e1           v1    v2                        y
+            //         e2           v2    v3                        x
+            //         e3           v0    v3                        y
+            //         e4           v4    v5                        x
+            //         e5           v5    v6                        y
+            //         e6           v6    v7                        x
+            //         e7           v4    v7                        y
+            //         e8           v0    v4                        z
+            //         e9           v1    v5                        z
+            //         e10          v3    v7                        z
+            //         e11          v2    v6                        z
+
+            // Handle cubes along the edge of the image
+            if(isXEnd)
+            {
+                ge0.ystart += isCut[1];
+                ge0.zstart += isCut[9];
+            }
+            if(isYEnd)
+            {
+                ge1.xstart += isCut[2];
+                ge1.zstart += isCut[10];
+            }
+            if(isZEnd)
+            {
+                ge2.xstart += isCut[4];
+                ge2.ystart += isCut[7];
+            }
+
+            if(isXEnd and isYEnd)
+            {
+                ge1.zstart += isCut[11];
+            }
+            if(isXEnd and isZEnd)
+            {
+                ge2.ystart += isCut[5];
+            }
+            if(isYEnd and isZEnd)
+            {
+                ge3.xstart += isCut[6];
+            }
+        }
+    }}
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass 3 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+void FlyingEdgesAlgorithm::pass3()
+{
+    // Accumulate triangles into triCounter, starting after the triangles
+    // of the slabs before.
+    size_t tmp;
+    size_t triAccum = triOffset;
+    for(size_t k = kBegin; k != kEnd; ++k) {
+    for(size_t j = 0; j != ny-1; ++j)
+    {
+        offset_t& curTriCounter = triCounter[k*(ny-1)+j];
+
+        tmp = curTriCounter;
+        curTriCounter = triAccum;
+        triAccum += tmp;
+    }}
+
+    // accumulate points, filling out starting locations of each gridEdge
+    // in the process. The gridEdges of slice kEnd get starting locations
+    // even if their points are owned by the next slab.
+    size_t pointAccum = pointOffset;
+    size_t ownedPointAccum = pointOffset;
+    for(size_t k = kBegin; k != kEnd+1; ++k)
+    {
+        for(size_t j = 0; j != ny; ++j)
+        {
+            gridEdge& curGridEdge = gridEdges[k*ny + j];
+
+            tmp = curGridEdge.xstart;
+            curGridEdge.xstart = pointAccum;
+            pointAccum += tmp;
+
+            tmp = curGridEdge.ystart;
+            curGridEdge.ystart = pointAccum;
+            pointAccum += tmp;
+
+            tmp = curGridEdge.zstart;
+            curGridEdge.zstart = pointAccum;
+            pointAccum += tmp;
+        }
+
+        if(k != kEnd || lastSlab)
+        {
+            ownedPointAccum = pointAccum;
+        }
+    }
+
+    if(pointAccum > std::numeric_limits<offset_t>::max() ||
+       triAccum > std::numeric_limits<offset_t>::max())
+    {
+        throw util::offset_overflow("Too many points or triangles for offset_t");
+    }
+
+    if(pointAccum > std::numeric_limits<index_t>::max())
+    {
+        throw util::index_overflow("Too many points for index_t");
+    }
+
+    size_t numPoints = ownedPointAccum - pointOffset;
+    size_t numTriangles = triAccum - triOffset;
+
+    points.resize(numPoints);
+    normals.resize(numPoints);
+    tris = util::TriangleArray(numTriangles);
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass 4 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+void FlyingEdgesAlgorithm::pass4()
+{
+    // Pass 4 is done in two parts that don't depend on each other.
+    //
+    // For each (j, k):
+    //  - Find the cut x, y and z edges starting on the gridEdge and fill out
+    //    their points and normals. Each direction is swept on its own: the
+    //    cut edges are gathered first and then interpolated in tight loops.
+    util::GradientProvider gradients(image, gradientMode);
+    util::GradientProvider::Reader gradReader(gradients);
+
+    EdgeSweep sweep(nx);
+
+    //  Only the gridEdges whose points the slab owns are visited.
+    size_t const kOwnedEnd = lastSlab ? kEnd+1 : kEnd;
+    for(size_t k = kBegin; k != kOwnedEnd; ++k) {
+    for(size_t j = 0; j != ny; ++j)
+    {
+        gridEdge const& ge = gridEdges[k*ny + j];
+
+        const util::edgeCaseWord_t* ec = &edgeCases[ecStride*(k*ny + j)];
+
+        // points[0] is point pointOffset of the mesh
+        size_t xstart = ge.xstart - pointOffset;
+        size_t ystart = ge.ystart - pointOffset;
+        size_t zstart = ge.zstart - pointOffset;
+
+        size_t n = findCutXEdges(ec, ge.xl, ge.xr, sweep);
+        interpolateEdges(n, j, k, 0, points, normals, xstart,
+                         gradReader, sweep);
+
+        if(j != ny-1)
+        {
+            n = findCutEdges(ec, ec + ecStride, ge.xl, ge.xr, sweep);
+            interpolateEdges(n, j, k, 1, points, normals, ystart,
+                             gradReader, sweep);
+        }
+
+        if(k != nz-1)
+        {
+            n = findCutEdges(ec, ec + ecStride*ny, ge.xl, ge.xr, sweep);
+            interpolateEdges(n, j, k, 2, points, normals, zstart,
+                             gradReader, sweep);
+        }
+    }}
+
+    // For each (j, k):
+    //  - For each cube at i, fill out the triangles of the cube. The
+    //    points of the cube's edges are numbered the same way pass 2
+    //    counted them. Each cube counts e0, e3 and e8. Only in edge cases
+    //    does it also count other edges.
+    //  Only the cells of the slab are visited.
+    for(size_t k = kBegin; k != kEnd; ++k) {
+    for(size_t j = 0; j != ny-1; ++j)
+    {
+        // find adjusted trim values
+        size_t xl, xr;
+        calcTrimValues(xl, xr, j, k); // xl, xr set in this function
+
+        if(xl == xr)
+            continue;
+
+        size_t triIdx = triCounter[k*(ny-1) + j] - triOffset;
+        // In low memory mode, the cube cases are recomputed from the edge
+        // cases as in pass 2.
+        const uchar* curCubeCaseIds =
+            lowMemory ? nullptr : &cubeCases[(nx-1)*(k*(ny-1) + j)];
+
+        const util::edgeCaseWord_t* ec0 = &edgeCases[ecStride*(k*ny + j)];
+        const util::edgeCaseWord_t* ec1 = &edgeCases[ecStride*(k*ny + j + 1)];
+        const util::edgeCaseWord_t* ec2 = &edgeCases[ecStride*((k+1)*ny + j)];
+        const util::edgeCaseWord_t* ec3 =
+            &edgeCases[ecStride*((k+1)*ny + j + 1)];
+
+        gridEdge const& ge0 = gridEdges[k*ny + j];
+        gridEdge const& ge1 = gridEdges[k*ny + j + 1];
+        gridEdge const& ge2 = gridEdges[(k+1)*ny + j];
+        gridEdge const& ge3 = gridEdges[(k+1)*ny + j + 1];
+
+        size_t x0counter = 0;
+        size_t y0counter = 0;
+        size_t z0counter = 0;
+
+        size_t x1counter = 0;
+        size_t z1counter = 0;
+
+        size_t x2counter = 0;
+        size_t y2counter = 0;
+
+        size_t x3counter = 0;
+
+        for(size_t i = xl; i != xr; ++i)
+        {
+            uchar caseId;
+            if(lowMemory)
+            {
+                caseId = calcCubeCase(
+                    util::getEdgeCase(ec0, i), util::getEdgeCase(ec1, i),
+                    util::getEdgeCase(ec2, i), util::getEdgeCase(ec3, i));
+            }
+            else
+            {
+                caseId = curCubeCaseIds[i];
+            }
+
+            if(caseId == 0 || caseId == 255)
+            {
+                continue;
+            }
+
+            const bool* isCut = util::isCut[caseId]; // has 12 elements
+
+            // Calculate global indices for triangles
+            std::array<size_t, 12> globalIdxs;
+
+            // Note:
+            //   e1, e5, e9 and e11 are visited in the next iteration
+            //   when they are e3, e7, e8 and 10 respectively. So don't
+            //   increment their counters. When the cube is an edge cube,
+            //   their counters won't be used again.
+            if(isCut[0])
+                globalIdxs[0] = ge0.xstart + x0counter++;
+            if(isCut[3])
+                globalIdxs[3] = ge0.ystart + y0counter++;
+            if(isCut[8])
+                globalIdxs[8] = ge0.zstart + z0counter++;
+
+            if(isCut[1])
+                globalIdxs[1] = ge0.ystart + y0counter;
+            if(isCut[9])
+                globalIdxs[9] = ge0.zstart + z0counter;
+
+            if(isCut[2])
+                globalIdxs[2] = ge1.xstart + x1counter++;
+            if(isCut[10])
+                globalIdxs[10] = ge1.zstart + z1counter++;
+
+            if(isCut[4])
+                globalIdxs[4] = ge2.xstart + x2counter++;
+            if(isCut[7])
+                globalIdxs[7] = ge2.ystart + y2counter++;
+
+            if(isCut[11])
+                globalIdxs[11] = ge1.zstart + z1counter;
+            if(isCut[5])
+                globalIdxs[5] = ge2.ystart + y2counter;
+
+            if(isCut[6])
+                globalIdxs[6] = ge3.xstart + x3counter++;
+
+            // Add triangles
+            const char* caseTri = util::caseTriangles[caseId]; // size 16
+            for(int idx = 0; caseTri[idx] != -1; idx += 3)
+            {
+                tris[triIdx][0] = globalIdxs[caseTri[idx]];
+                tris[triIdx][1] = globalIdxs[caseTri[idx+1]];
+                tris[triIdx][2] = globalIdxs[caseTri[idx+2]];
+                ++triIdx;
+            }
+        }
+    }}
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Don't copy points, normals and tris but move the output into a TrianlgeMesh.
+///////////////////////////////////////////////////////////////////////////////
+util::TriangleMesh FlyingEdgesAlgorithm::moveOutput()
+{
+    return util::TriangleMesh(std::move(points),
+                              std::move(normals),
+                              std::move(tris));
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory used by the state kept between passes
+///////////////////////////////////////////////////////////////////////////////
+size_t FlyingEdgesAlgorithm::intermediateStateBytes() const
+{
+    return gridEdges.size() * sizeof(gridEdge) +
+           triCounter.size() * sizeof(offset_t) +
+           edgeCases.size() * sizeof(util::edgeCaseWord_t) +
+           cubeCases.size() * sizeof(uchar);
+}
+
+size_t FlyingEdgesAlgorithm::fullIntermediateStateBytes() const
+{
+    // gridEdge has 5 size_t, each edge case is a byte and cubeCases is
+    // allocated
+    return gridEdges.size() * 5 * sizeof(size_t) +
+           triCounter.size() * sizeof(size_t) +
+           (nx-1)*ny*nz * sizeof(uchar) +
+           (nx-1)*(ny-1)*(nz-1) * sizeof(uchar);
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Private helper functions
+///////////////////////////////////////////////////////////////////////////////
+
+inline uchar
+FlyingEdgesAlgorithm::calcCubeCase(
+    uchar const& ec0, uchar const& ec1,
+    uchar const& ec2, uchar const& ec3) const
+{
+    // ec0 | (_,j,k)
+    // ec1 | (_,j+1,k)
+    // ec2 | (_,j,k+1)
+    // ec3 | (_,j+1,k+1)
+
+    uchar caseId = 0;
+    if((ec0 == 0) || (ec0 == 2)) // 0 | (i,j,k)
+        caseId |= 1;
+    if((ec0 == 0) || (ec0 == 1)) // 1 | (i+1,j,k)
+        caseId |= 2;
+    if((ec1 == 0) || (ec1 == 1)) // 2 | (i+1,j+1,k)
+        caseId |= 4;
+    if((ec1 == 0) || (ec1 == 2)) // 3 | (i,j+1,k)
+        caseId |= 8;
+    if((ec2 == 0) || (ec2 == 2)) // 4 | (i,j,k+1)
+        caseId |= 16;
+    if((ec2 == 0) || (ec2 == 1)) // 5 | (i+1,j,k+1)
+        caseId |= 32;
+    if((ec3 == 0) || (ec3 == 1)) // 6 | (i+1,j+1,k+1)
+        caseId |= 64;
+    if((ec3 == 0) || (ec3 == 2)) // 7 | (i,j+1,k+1)
+        caseId |= 128;
+    return caseId;
+}
+
+inline void
+FlyingEdgesAlgorithm::calcTrimValues(
+    size_t& xl, size_t& xr,
+    size_t const& j, size_t const& k) const
+{
+    gridEdge const& ge0 = gridEdges[k*ny + j];
+    gridEdge const& ge1 = gridEdges[k*ny + j + 1];
+    gridEdge const& ge2 = gridEdges[(k+1)*ny + j];
+    gridEdge const& ge3 = gridEdges[(k+1)*ny + j + 1];
+
+    xl = size_t(std::min({ge0.xl, ge1.xl, ge2.xl, ge3.xl}));
+    xr = size_t(std::max({ge0.xr, ge1.xr, ge2.xr, ge3.xr}));
+
+    if(xl > xr)
+        xl = xr;
+}
+
+inline size_t
+FlyingEdgesAlgorithm::findCutXEdges(
+    const util::edgeCaseWord_t* ec, size_t xl, size_t xr,
+    EdgeSweep& sweep) const
+{
+    // Every index is written but n only moves past the cut ones, so the
+    // loop has no branches.
+    size_t n = 0;
+    for(size_t i = xl; i < xr; ++i)
+    {
+        uchar edgeCase = util::getEdgeCase(ec, i);
+        sweep.cuts[n] = i;
+        n += (edgeCase == 1) | (edgeCase == 2);
+    }
+    return n;
+}
+
+inline size_t
+FlyingEdgesAlgorithm::findCutEdges(
+    const util::edgeCaseWord_t* ec, const util::edgeCaseWord_t* ecNext,
+    size_t xl, size_t xr, EdgeSweep& sweep) const
+{
+    // The edge from point i to the next row is cut if bit 0 of the edge
+    // cases differ. Pass 1 trimmed each row to the points with such edges
+    // except the last point, which is only bit 1 of the last edge case.
+    size_t n = 0;
+    for(size_t i = xl; i < xr; ++i)
+    {
+        uchar diff = util::getEdgeCase(ec, i) ^ util::getEdgeCase(ecNext, i);
+        sweep.cuts[n] = i;
+        n += diff & 1;
+    }
+
+    uchar diff =
+        util::getEdgeCase(ec, nx-2) ^ util::getEdgeCase(ecNext, nx-2);
+    if(diff & 2)
+    {
+        sweep.cuts[n++] = nx-1;
+    }
+    return n;
+}
+
+inline void
+FlyingEdgesAlgorithm::interpolateEdges(
+    size_t n, size_t j, size_t k, int axis,
+    util::VectorArray& edgePoints, util::VectorArray& edgeNormals, size_t start,
+    util::GradientProvider::Reader& gradReader, EdgeSweep& sweep) const
+{
+    // Each edge starts at (sweep.cuts[m], j, k) and goes one point along
+    // axis.
+    size_t const di = (axis == 0);
+    size_t const dj = (axis == 1);
+    size_t const dk = (axis == 2);
+
+    const scalar_t* row = image.pointer() + nx*(k*ny + j);
+    size_t const step = di + dj*nx + dk*nx*ny;
+
+    for(size_t m = 0; m != n; ++m)
+    {
+        scalar_t v0 = row[sweep.cuts[m]];
+        scalar_t v1 = row[sweep.cuts[m] + step];
+        sweep.weights[m] = (isoval - v0) / (v1 - v0);
+    }
+
+    std::array<scalar_t, 3> const zeroPos = image.getZeroPos();
+    std::array<scalar_t, 3> const spacing = image.getSpacing();
+    size_t const zOffset = image.zoffset();
+
+    std::array<scalar_t, 3> a;
+    a[1] = position(j, ny, zeroPos[1], spacing[1]);
+    a[2] = position(k + zOffset, nz + zOffset, zeroPos[2], spacing[2]);
+    std::array<scalar_t, 3> b = a;
+    b[axis] += spacing[axis];
+
+    // The components are written straight into the output arrays. With
+    // MESH_SOA each of them is contiguous.
+    size_t const stride = util::VectorArray::stride;
+    scalar_t* pointX = edgePoints.data(0) + start*stride;
+    scalar_t* pointY = edgePoints.data(1) + start*stride;
+    scalar_t* pointZ = edgePoints.data(2) + start*stride;
+    for(size_t m = 0; m != n; ++m)
+    {
+        size_t i = sweep.cuts[m];
+        scalar_t w = sweep.weights[m];
+        a[0] = position(i, nx, zeroPos[0], spacing[0]);
+        b[0] = di ? a[0] + spacing[0] : a[0];
+        pointX[m*stride] = a[0] + (w * (b[0] - a[0]));
+        pointY[m*stride] = a[1] + (w * (b[1] - a[1]));
+        pointZ[m*stride] = a[2] + (w * (b[2] - a[2]));
+    }
+
+    scalar_t* normX = edgeNormals.data(0) + start*stride;
+    scalar_t* normY = edgeNormals.data(1) + start*stride;
+    scalar_t* normZ = edgeNormals.data(2) + start*stride;
+    for(size_t m = 0; m != n; ++m)
+    {
+        size_t i = sweep.cuts[m];
+        std::array<scalar_t, 3> normal = interpolate(
+            gradReader.getGradient(i, j, k),
+            gradReader.getGradient(i + di, j + dj, k + dk),
+            sweep.weights[m]);
+        normX[m*stride] = normal[0];
+        normY[m*stride] = normal[1];
+        normZ[m*stride] = normal[2];
+    }
+}
+
+inline scalar_t
+FlyingEdgesAlgorithm::position(
+    size_t idx, size_t dim, scalar_t zeroPos, scalar_t spacing) const
+{
+    // Same as Image3D::getPosCube, where the last point along an axis is
+    // one spacing past the point before it.
+    if(idx + 1 != dim)
+        return zeroPos + idx * spacing;
+    return (zeroPos + (idx - 1) * spacing) + spacing;
+}
+
+inline std::array<scalar_t, 3>
+FlyingEdgesAlgorithm::interpolate(
+    std::array<scalar_t, 3> const& a,
+    std::array<scalar_t, 3> const& b,
+    scalar_t const& weight) const
+{
+    std::array<scalar_t, 3> ret;
+    ret[0] = a[0] + (weight * (b[0] - a[0]));
+    ret[1] = a[1] + (weight * (b[1] - a[1]));
+    ret[2] = a[2] + (weight * (b[2] - a[2]));
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
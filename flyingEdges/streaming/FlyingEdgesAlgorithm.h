@@ -0,0 +1,191 @@
+/*
+ * flyingEdgesAlgorithm.h
+ *
+ *  Created on: Feb 17, 2017
+ *      Author: dbourge
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef FLYINGEDGESALGORITHM_H_
+#define FLYINGEDGESALGORITHM_H_
+
+#include <vector>
+#include <array>
+
+#include "../util/FlyingEdges_Config.h"
+#include "../util/EdgeCaseKernels.h"
+#include "../util/GradientProvider.h"
+
+#include "../util/Image3D.h"
+#include "../util/TriangleMesh.h"
+
+struct FlyingEdgesAlgorithm
+{
+    // The algorithm runs on one z slab of a larger image at a time. The
+    // cells of the slab are the cells [kBegin, kEnd) of image in z. image
+    // also holds the slice below kBegin, if there is one, and the slice
+    // above kEnd, unless kEnd is the last slice of the larger image. With
+    // them, the gradients and the point numbering are the same as for the
+    // whole image.
+    //
+    // The slab owns the points on the slices [kBegin, kEnd), and the points
+    // on slice kEnd if it's the last slab. pointOffset and triOffset are the
+    // number of points and triangles of the slabs before this one.
+    //
+    // With lowMemory set, cubeCases is not allocated and pass4 recomputes
+    // the case of each cube from edgeCases. gradientMode is how pass4 finds
+    // the gradients that the normals are interpolated from.
+    FlyingEdgesAlgorithm(util::Image3D const& image, scalar_t const& isoval,
+                         size_t kBegin, size_t kEnd,
+                         size_t pointOffset, size_t triOffset,
+                         bool lowMemory = false,
+                         util::GradientMode gradientMode =
+                             util::GradientMode::onTheFly)
+      : image(image),
+        isoval(isoval),
+        kBegin(kBegin),
+        kEnd(kEnd),
+        lastSlab(kEnd == image.zdimension() - 1),
+        pointOffset(pointOffset),
+        triOffset(triOffset),
+        lowMemory(lowMemory),
+        gradientMode(gradientMode),
+        nx(image.xdimension()),
+        ny(image.ydimension()),
+        nz(image.zdimension()),
+        ecStride(util::edgeCaseRowSize(nx)),
+        gridEdges(ny*nz),
+        triCounter((ny-1)*(nz-1)),
+        edgeCases(ecStride*ny*nz),
+        cubeCases(lowMemory ? 0 : (nx-1)*(ny-1)*(nz-1))
+    {}
+
+    void pass1();
+
+    void pass2();
+
+    void pass3();
+
+    void pass4();
+
+    util::TriangleMesh moveOutput();
+
+    // Bytes used by gridEdges, triCounter, edgeCases and cubeCases, and the
+    // bytes they use without FE_COMPACT defined or lowMemory set.
+    size_t intermediateStateBytes() const;
+    size_t fullIntermediateStateBytes() const;
+
+private:
+    struct gridEdge
+    {
+        gridEdge()
+          : xl(0),
+            xr(0),
+            xstart(0),
+            ystart(0),
+            zstart(0)
+        {}
+
+        // trim values
+        // set on pass 1
+        offset_t xl;
+        offset_t xr;
+
+        // modified on pass 2
+        // set on pass 3
+        offset_t xstart;
+        offset_t ystart;
+        offset_t zstart;
+    };
+
+    // Scratch space for the cut edges along a gridEdge in pass 4
+    struct EdgeSweep
+    {
+        EdgeSweep(size_t nx)
+          : cuts(nx),
+            weights(nx)
+        {}
+
+        std::vector<size_t> cuts;       // where each cut edge starts
+        std::vector<scalar_t> weights;  // where the isosurface cuts it
+    };
+
+private:
+    util::Image3D const& image;
+    scalar_t const isoval;
+
+    size_t const kBegin;      // The cells of the slab
+    size_t const kEnd;        //
+    bool const lastSlab;      // kEnd is the last slice of the larger image
+
+    size_t const pointOffset; // Points and triangles of the slabs before
+    size_t const triOffset;   //
+
+    bool const lowMemory;
+    util::GradientMode const gradientMode;
+
+    size_t const nx; //
+    size_t const ny; // for indexing
+    size_t const nz; //
+
+    size_t const ecStride; // words in a row of edgeCases
+
+    std::vector<gridEdge> gridEdges; // size of ny*nz
+    std::vector<offset_t> triCounter; // size of (ny-1)*(nz-1)
+
+    std::vector<util::edgeCaseWord_t> edgeCases; // size ecStride*ny*nz
+    std::vector<uchar> cubeCases;    // size (nx-1)*(ny-1)*(nz-1) or 0
+
+    util::VectorArray points;                      // The output of the slab.
+    util::VectorArray normals;                     // points[0] is point
+    util::TriangleArray tris;                      // pointOffset of the mesh
+
+private:
+    inline uchar
+    calcCubeCase(uchar const& ec0, uchar const& ec1,
+                 uchar const& ec2, uchar const& ec3) const;
+
+    inline void calcTrimValues(
+        size_t& xl, size_t& xr, size_t const& j, size_t const& k) const;
+
+    // Fill sweep.cuts with the cut x-edges of a gridEdge, or with the
+    // points of a gridEdge whose edge to the next row is cut. ecNext holds
+    // the edge cases of the next row in y or z. Return how many there are.
+    inline size_t findCutXEdges(
+        const util::edgeCaseWord_t* ec, size_t xl, size_t xr,
+        EdgeSweep& sweep) const;
+
+    inline size_t findCutEdges(
+        const util::edgeCaseWord_t* ec, const util::edgeCaseWord_t* ecNext,
+        size_t xl, size_t xr, EdgeSweep& sweep) const;
+
+    // Fill out the points and normals of the first n edges in sweep.cuts
+    // along gridEdge (j, k), from index start on. axis is the direction of
+    // the edges.
+    inline void interpolateEdges(
+        size_t n, size_t j, size_t k, int axis,
+        util::VectorArray& edgePoints,
+        util::VectorArray& edgeNormals,
+        size_t start,
+        util::GradientProvider::Reader& gradReader,
+        EdgeSweep& sweep) const;
+
+    inline scalar_t position(
+        size_t idx, size_t dim, scalar_t zeroPos, scalar_t spacing) const;
+
+    inline std::array<scalar_t, 3>
+    interpolate(
+        std::array<scalar_t, 3> const& a,
+        std::array<scalar_t, 3> const& b,
+        scalar_t const& weight) const;
+};
+
+
+#endif
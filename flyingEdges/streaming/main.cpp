@@ -0,0 +1,281 @@
+/*
+ * main.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+#include <iostream>
+#include <string.h>
+#include <cstdlib>
+#include <algorithm>
+
+#include "FlyingEdgesAlgorithm.h"
+
+#include "../util/EdgeCaseKernels.h"
+#include "../util/GradientProvider.h"
+#include "../util/LoadImage.h"
+#include "../util/SaveTriangleMesh.h"
+
+#include "../util/Timer.h"
+#include "../mantevoCommon/YAML_Doc.hpp"
+
+void addTime(YAML_Doc& doc, std::string const& name, util::Timer const& timer)
+{
+    doc.add(name, "");
+    doc.get(name)->add("CPU Time (seconds)", timer.getCPUtime());
+    doc.get(name)->add("Wall Time (seconds)", timer.getWallTime());
+}
+
+int main(int argc, char* argv[])
+{
+    scalar_t isoval;
+    bool isovalSet = false;
+    char* vtkFile = NULL;
+    char* outFile = NULL;
+    size_t slabSize = 64;
+    bool lowMemory = false;
+    char* gradientName = NULL;
+    size_t gradientMemory = 1024; // MiB
+    std::string yamlDirectory = "";
+    std::string yamlFileName  = "";
+
+    // Read command line arguments
+    for(int i=0; i<argc; i++)
+    {
+        if( (strcmp(argv[i], "-i") == 0) || (strcmp(argv[i], "-input_file") == 0))
+        {
+            vtkFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "-output_file") == 0))
+        {
+            outFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-v") == 0) || (strcmp(argv[i], "-isoval") == 0))
+        {
+            isovalSet = true;
+            isoval = atof(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-s") == 0) || (strcmp(argv[i], "-slab_size") == 0))
+        {
+            slabSize = std::max(size_t(1), size_t(std::stoul(argv[++i])));
+        }
+        else if( (strcmp(argv[i], "-l") == 0) || (strcmp(argv[i], "-low_memory") == 0))
+        {
+            lowMemory = atoi(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-g") == 0) || (strcmp(argv[i], "-gradient") == 0))
+        {
+            gradientName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-gm") == 0) || (strcmp(argv[i], "-gradient_memory") == 0))
+        {
+            gradientMemory = atol(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
+        {
+            std::string wholeFile(argv[++i]);
+
+            std::size_t pos = wholeFile.rfind("/");
+            if(pos == std::string::npos)
+            {
+                yamlDirectory = "./";
+                yamlFileName = wholeFile;
+            }
+            else
+            {
+                yamlDirectory = wholeFile.substr(0, pos + 1);
+                yamlFileName = wholeFile.substr(pos + 1);
+            }
+        }
+        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
+        {
+            std::cout <<
+                "Streaming Flying Edges Options:" << std::endl <<
+                "  -input_file (-i)"              << std::endl <<
+                "  -output_file (-o)"             << std::endl <<
+                "  -isoval (-v)"                  << std::endl <<
+                "  -slab_size (-s), default 64"   << std::endl <<
+                "  -low_memory (-l), default 0"   << std::endl <<
+                "  -gradient (-g), default auto"  << std::endl <<
+                "    auto, onthefly, rolling or"  << std::endl <<
+                "    precomputed"                 << std::endl <<
+                "  -gradient_memory (-gm), MiB,"  << std::endl <<
+                "    default 1024"                << std::endl <<
+                "  -yaml_output_file (-y)"        << std::endl <<
+                "  -help (-h)"                    << std::endl;
+            return 0;
+        }
+    }
+
+    if(isovalSet == false || vtkFile == NULL || outFile == NULL)
+    {
+        std::cout << "Error: isoval, input_file and output_file must be set." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    bool autoGradient =
+        gradientName == NULL || strcmp(gradientName, "auto") == 0;
+    util::GradientMode gradientMode = util::GradientMode::onTheFly;
+    if(!autoGradient && !util::parseGradientMode(gradientName, gradientMode))
+    {
+        std::cout << "Error: unknown gradient mode " << gradientName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
+    // YAML_Doc will create a file at in the current directory with a
+    // timestamp on it.
+    YAML_Doc doc("Flying Edges", "0.1", yamlDirectory, yamlFileName);
+
+    // Add information related to this run to doc.
+    doc.add("Flying Edges Algorithm", "streaming");
+    doc.add("Volume image data file path", vtkFile);
+    doc.add("Polygonal mesh output file", outFile);
+    doc.add("Isoval", isoval);
+    doc.add("Edge classification kernel", util::edgeCaseKernelName<scalar_t>());
+#ifdef FE_COMPACT
+    doc.add("Compact intermediate state", "on");
+#else
+    doc.add("Compact intermediate state", "off");
+#endif
+    doc.add("Low memory mode", lowMemory ? "on" : "off");
+    doc.add("Slab size (cells)", slabSize);
+
+    // Only the header is read here. The image is read a slab at a time.
+    // Consecutive slabs share the three slices around the slice between
+    // them.
+    util::SlabLoader loader(vtkFile, 3);
+
+    size_t nz = loader.zdimension();
+
+    doc.add("File x-dimension", loader.xdimension());
+    doc.add("File y-dimension", loader.ydimension());
+    doc.add("File z-dimension", nz);
+
+    // Without a gradient mode given, use the fastest one that fits in the
+    // gradient memory budget. Each slab is at most slabSize+3 slices.
+    size_t gradientBudget = gradientMemory << 20;
+    if(autoGradient)
+    {
+        gradientMode = util::chooseGradientMode(
+            loader.xdimension(), loader.ydimension(),
+            std::min(slabSize + 3, nz), 1, gradientBudget);
+    }
+    doc.add("Gradient mode", util::gradientModeName(gradientMode));
+    doc.add("Gradient memory budget (bytes)", gradientBudget);
+
+    // The mesh of each slab is written to its own file once the next slab
+    // is made.
+    util::TriangleMeshStreamWriter writer(outFile);
+
+    // Time the output. util::Timer's constructor starts timing.
+    util::Timer runTime;
+
+    // The time of each step is summed over the slabs.
+    util::Timer runTimeLoad;
+    util::Timer runTimePass1;
+    util::Timer runTimePass2;
+    util::Timer runTimePass3;
+    util::Timer runTimePass4;
+    util::Timer runTimeSave;
+    for(util::Timer* timer : { &runTimeLoad, &runTimePass1, &runTimePass2,
+                               &runTimePass3, &runTimePass4, &runTimeSave })
+    {
+        timer->pause();
+    }
+
+    size_t numSlabs = 0;
+    size_t maxSlabImageBytes = 0;
+    size_t maxStateBytes = 0;
+
+    size_t pointOffset = 0;
+    size_t triOffset = 0;
+
+    // Each slab is the cells [k0, k1) in z. The image of the slab also has
+    // the slices k0-1 and k1+1 if they exist.
+    for(size_t k0 = 0; k0 < nz-1; k0 += slabSize)
+    {
+        size_t k1 = std::min(k0 + slabSize, nz-1);
+        size_t zBegin = (k0 == 0) ? 0 : k0-1;
+        size_t zEnd = std::min(k1 + 2, nz);
+
+        runTimeLoad.resume();
+        util::Image3D image = loader.load(zBegin, zEnd);
+        runTimeLoad.pause();
+
+        FlyingEdgesAlgorithm algo(image, isoval,
+                                  k0 - zBegin, k1 - zBegin,
+                                  pointOffset, triOffset,
+                                  lowMemory, gradientMode);
+
+        runTimePass1.resume();
+        algo.pass1();
+        runTimePass1.pause();
+
+        runTimePass2.resume();
+        algo.pass2();
+        runTimePass2.pause();
+
+        runTimePass3.resume();
+        algo.pass3();
+        runTimePass3.pause();
+
+        runTimePass4.resume();
+        algo.pass4();
+        runTimePass4.pause();
+
+        ++numSlabs;
+        maxSlabImageBytes = std::max(maxSlabImageBytes,
+            image.xdimension()*image.ydimension()*image.zdimension()*
+            sizeof(scalar_t));
+        maxStateBytes = std::max(maxStateBytes, algo.intermediateStateBytes());
+
+        util::TriangleMesh mesh = algo.moveOutput();
+
+        pointOffset += mesh.numberOfVertices();
+        triOffset += mesh.numberOfTriangles();
+
+        runTimeSave.resume();
+        writer.append(std::move(mesh));
+        runTimeSave.pause();
+    }
+
+    runTimeSave.resume();
+    writer.finish();
+    runTimeSave.pause();
+
+    // End overall timing
+    runTime.stop();
+
+    // Report mesh information
+    doc.add("Number of vertices in mesh", writer.numberOfVertices());
+    doc.add("Number of triangles in mesh", writer.numberOfTriangles());
+    doc.add("Number of output files", writer.numberOfFiles());
+
+    // Report the memory used by the largest slab
+    doc.add("Number of slabs", numSlabs);
+    doc.add("Largest slab image (bytes)", maxSlabImageBytes);
+    doc.add("Largest intermediate state (bytes)", maxStateBytes);
+
+    // Report timing information
+    addTime(doc, "Load", runTimeLoad);
+    addTime(doc, "Pass 1", runTimePass1);
+    addTime(doc, "Pass 2", runTimePass2);
+    addTime(doc, "Pass 3", runTimePass3);
+    addTime(doc, "Pass 4", runTimePass4);
+    addTime(doc, "Save", runTimeSave);
+
+    doc.add("Total Program CPU Time (clicks)", runTime.getTotalTicks());
+    doc.add("Total Program CPU Time (seconds)", runTime.getCPUtime());
+    doc.add("Total Program WALL Time (seconds)", runTime.getWallTime());
+
+    // Generate the YAML file. The file will be both saved and printed to console.
+    std::cout << doc.generateYAML();
+}
@@ -0,0 +1,125 @@
+/*
+ * tests/ResetRunCheck.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// The serial or the openmp algorithm, whichever directory is on the
+// include path
+#include "FlyingEdgesAlgorithm.h"
+
+using std::size_t;
+
+// Runs several isovals through one algorithm with reset and run and checks
+// that each mesh is the same as the one of a new algorithm made for that
+// isoval.
+
+// An image of T with a few blobs in it, so that every isoval below cuts
+// it differently.
+template <typename T>
+util::BasicImage3D<T> makeImage(std::array<size_t, 3> dim)
+{
+    util::FirstTouchVector<T> data(dim[0] * dim[1] * dim[2]);
+    for(size_t k = 0; k != dim[2]; ++k)
+    for(size_t j = 0; j != dim[1]; ++j)
+    for(size_t i = 0; i != dim[0]; ++i)
+    {
+        double v = std::sin(0.31 * i) * std::cos(0.23 * j) +
+                   std::sin(0.17 * (i + k)) + 0.05 * k;
+        data[i + dim[0] * (j + dim[1] * k)] = T(40.0 * (v + 2.0));
+    }
+
+    std::array<scalar_t, 3> spacing = {{ 1, 1, 1 }};
+    std::array<scalar_t, 3> zeroPos = {{ 0, 0, 0 }};
+    return util::BasicImage3D<T>(std::move(data), spacing, zeroPos, dim);
+}
+
+bool sameMesh(util::TriangleMesh const& a, util::TriangleMesh const& b)
+{
+    return a.getPoints() == b.getPoints() &&
+           a.getNormals() == b.getNormals() &&
+           a.numberOfTriangles() == b.numberOfTriangles() &&
+           std::equal(a.trianglesBegin(), a.trianglesEnd(),
+                      b.trianglesBegin());
+}
+
+template <typename T>
+int checkResetRun(char const* typeName)
+{
+    util::BasicImage3D<T> image = makeImage<T>({{ 45, 38, 33 }});
+
+    // 400 is above every value, so its mesh is empty, and the isoval after
+    // it has to start over from nothing.
+    std::vector<scalar_t> const isovals = { 100, 130, 70.5, 130, 400, 90 };
+
+    struct Settings
+    {
+        bool lowMemory;
+        util::GradientMode gradientMode;
+        util::NormalMode normalMode;
+    };
+    std::vector<Settings> const settings = {
+        { false, util::GradientMode::onTheFly, util::NormalMode::gradient },
+        { true, util::GradientMode::rolling, util::NormalMode::gradient },
+        { false, util::GradientMode::precomputed, util::NormalMode::face },
+        { true, util::GradientMode::onTheFly, util::NormalMode::none }
+    };
+
+    int failures = 0;
+    for(Settings const& s: settings)
+    {
+        BasicFlyingEdgesAlgorithm<T> reused(
+            image, isovals[0], s.lowMemory, s.gradientMode, s.normalMode);
+        util::TriangleMesh mesh;
+
+        for(scalar_t isoval: isovals)
+        {
+            reused.reset(isoval);
+            reused.run(mesh);
+
+            BasicFlyingEdgesAlgorithm<T> fresh(
+                image, isoval, s.lowMemory, s.gradientMode, s.normalMode);
+            fresh.pass1();
+            fresh.pass2();
+            fresh.pass3();
+            fresh.pass4();
+            util::TriangleMesh expected = fresh.moveOutput();
+
+            if(!sameMesh(mesh, expected))
+            {
+                std::cout << "ERROR: " << typeName << " isoval " << isoval
+                          << " low memory " << s.lowMemory
+                          << " gradient mode "
+                          << util::gradientModeName(s.gradientMode)
+                          << " differs after reset and run" << std::endl;
+                ++failures;
+            }
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    int failures = checkResetRun<float>("float") +
+                   checkResetRun<unsigned char>("unsigned char");
+    if(failures != 0)
+    {
+        return 1;
+    }
+
+    std::cout << "Reset and run made the same meshes." << std::endl;
+    return 0;
+}
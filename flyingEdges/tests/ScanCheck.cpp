@@ -0,0 +1,166 @@
+/*
+ * tests/ScanCheck.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "../util/ParallelScan.h"
+
+using std::size_t;
+
+// Checks the scans of util/ParallelScan.h against a serial scan. The grain
+// size of 1 makes even the smallest inputs use as many threads as they can,
+// so the sizes below cover no elements, one element, fewer elements than
+// threads and blocks of different sizes.
+
+std::vector<uint32_t> makeValues(size_t n)
+{
+    std::vector<uint32_t> values(n);
+    uint32_t state = 12345 + n;
+    for(uint32_t& v: values)
+    {
+        state = state * 1103515245 + 12345;
+        v = (state >> 16) % 16;
+    }
+    return values;
+}
+
+// The scan of values, exclusive or inclusive, and the sum of all of them
+std::vector<size_t> serialScan(std::vector<uint32_t> const& values,
+                               bool inclusive, size_t& total)
+{
+    std::vector<size_t> scanned(values.size());
+    total = 0;
+    for(size_t i = 0; i != values.size(); ++i)
+    {
+        if(inclusive)
+        {
+            total += values[i];
+            scanned[i] = total;
+        }
+        else
+        {
+            scanned[i] = total;
+            total += values[i];
+        }
+    }
+    return scanned;
+}
+
+bool checkScan(size_t n, size_t grainSize, bool inclusive)
+{
+    std::vector<uint32_t> const values = makeValues(n);
+    size_t expectedTotal;
+    std::vector<size_t> const expected =
+        serialScan(values, inclusive, expectedTotal);
+
+    std::vector<size_t> scanned(values.begin(), values.end());
+    size_t total = inclusive ?
+        util::inclusiveScan<size_t>(scanned.data(), n, grainSize) :
+        util::exclusiveScan<size_t>(scanned.data(), n, grainSize);
+
+    if(total != expectedTotal || scanned != expected)
+    {
+        std::cout << "ERROR: " << (inclusive ? "inclusive" : "exclusive")
+                  << " scan of " << n << " values with grain size "
+                  << grainSize << " differs from the serial scan"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Elements with two fields, like the point and triangle counts of pass 3,
+// are scanned as the sequence a[0], b[0], a[1], b[1], ...
+bool checkFieldScan(size_t n, size_t grainSize)
+{
+    std::vector<uint32_t> const values = makeValues(2 * n);
+    size_t expectedTotal;
+    std::vector<size_t> const expected =
+        serialScan(values, false, expectedTotal);
+
+    std::vector<size_t> a(n), b(n);
+    for(size_t i = 0; i != n; ++i)
+    {
+        a[i] = values[2 * i];
+        b[i] = values[2 * i + 1];
+    }
+
+    size_t total = util::parallelScan<size_t>(n,
+        [&](size_t beg, size_t end)
+        {
+            size_t sum = 0;
+            for(size_t i = beg; i != end; ++i)
+            {
+                sum += a[i] + b[i];
+            }
+            return sum;
+        },
+        [&](size_t beg, size_t end, size_t offset)
+        {
+            for(size_t i = beg; i != end; ++i)
+            {
+                size_t aValue = a[i];
+                a[i] = offset;
+                offset += aValue;
+                size_t bValue = b[i];
+                b[i] = offset;
+                offset += bValue;
+            }
+            return offset;
+        },
+        grainSize);
+
+    bool same = total == expectedTotal;
+    for(size_t i = 0; i != n && same; ++i)
+    {
+        same = a[i] == expected[2 * i] && b[i] == expected[2 * i + 1];
+    }
+    if(!same)
+    {
+        std::cout << "ERROR: scan of " << n << " elements with two fields"
+                  << " with grain size " << grainSize
+                  << " differs from the serial scan" << std::endl;
+    }
+    return same;
+}
+
+int main()
+{
+    std::vector<size_t> const sizes = {
+        0, 1, 2, 3, 5, 7, 8, 9, 13, 100, 1001, 4099 };
+
+    bool ok = true;
+    for(size_t n: sizes)
+    {
+        ok = checkScan(n, 1, false) && ok;
+        ok = checkScan(n, 1, true) && ok;
+        ok = checkFieldScan(n, 1) && ok;
+    }
+
+    // The default grain size, below and above it
+    for(size_t n: { util::scanGrainSize - 1, 3 * util::scanGrainSize + 17 })
+    {
+        ok = checkScan(n, util::scanGrainSize, false) && ok;
+        ok = checkScan(n, util::scanGrainSize, true) && ok;
+        ok = checkFieldScan(n, util::scanGrainSize) && ok;
+    }
+
+    if(!ok)
+    {
+        return 1;
+    }
+
+    std::cout << "The parallel scans match the serial scan." << std::endl;
+    return 0;
+}
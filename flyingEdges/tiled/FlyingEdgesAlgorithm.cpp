@@ -0,0 +1,735 @@
+/*
+ * FlyingEdgesAlgorithm.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+#include "FlyingEdgesAlgorithm.h"
+
+#include "../util/MarchingCubesTables.h"
+#include "../util/EdgeCaseKernels.h"
+#include "../util/Errors.h"
+#include "../util/ParallelScan.h"
+#include <algorithm>
+#include <limits>
+
+///////////////////////////////////////////////////////////////////////////////
+// Tasks
+///////////////////////////////////////////////////////////////////////////////
+template <typename Work>
+void FlyingEdgesAlgorithm::forEachTile(size_t numY, size_t numZ, Work work)
+{
+    size_t const tileY = FE_BLOCK_WIDTH_Y;
+    size_t const tileZ = FE_BLOCK_WIDTH_Z;
+
+    // One thread makes the tasks and every thread, including it, runs them
+    // as they come. A thread that runs out takes the next task waiting, so
+    // tiles with most of the surface don't hold the others up. The barrier
+    // at the end of the parallel region waits for all of them.
+    #pragma omp parallel
+    #pragma omp single
+    {
+        for(size_t k = 0; k < numZ; k += tileZ)
+        for(size_t j = 0; j < numY; j += tileY)
+        for(size_t s = 0; s != numSegments; ++s)
+        {
+            size_t jEnd = std::min(j + tileY, numY);
+            size_t kEnd = std::min(k + tileZ, numZ);
+
+            #pragma omp task firstprivate(s, j, jEnd, k, kEnd)
+            work(s, j, jEnd, k, kEnd);
+        }
+    }
+}
+
+std::array<size_t, 3> FlyingEdgesAlgorithm::tileCounts() const
+{
+    return {{ numSegments,
+              (ny + FE_BLOCK_WIDTH_Y - 1) / FE_BLOCK_WIDTH_Y,
+              (nz + FE_BLOCK_WIDTH_Z - 1) / FE_BLOCK_WIDTH_Z }};
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass 1 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+void FlyingEdgesAlgorithm::pass1()
+{
+    // For each segment of each (j, k):
+    //  - for each edge i along the segment, fill edgeCases with cut
+    //    information.
+    //  - find the locations for computational trimming, xl and xr
+    // The trim values look at the edge cases of the next rows in y and z,
+    // which can belong to other tiles, so all tiles are classified before
+    // any is trimmed.
+    forEachTile(ny, nz,
+        [this](size_t s, size_t jBegin, size_t jEnd,
+               size_t kBegin, size_t kEnd)
+        {
+            for(size_t k = kBegin; k != kEnd; ++k)
+                for(size_t j = jBegin; j != jEnd; ++j)
+                    classifyRow(s, j, k);
+        });
+
+    forEachTile(ny, nz,
+        [this](size_t s, size_t jBegin, size_t jEnd,
+               size_t kBegin, size_t kEnd)
+        {
+            for(size_t k = kBegin; k != kEnd; ++k)
+                for(size_t j = jBegin; j != jEnd; ++j)
+                    trimRow(s, j, k);
+        });
+}
+
+void FlyingEdgesAlgorithm::classifyRow(size_t s, size_t j, size_t k)
+{
+    size_t x0 = segmentBegin(s);
+    size_t x1 = segmentEnd(s);
+
+    auto curEdgeCases = edgeCases.begin() + ecStride * (k*ny + j);
+    auto curPointValues = image.getRowIter(j, k);
+
+    // The segment's edges run from point x0 to point x1, which is the first
+    // point of the next segment.
+    util::classifyEdges(&curPointValues[x0], x1 - x0 + 1, isoval,
+                        &curEdgeCases[segmentWord(s)]);
+}
+
+void FlyingEdgesAlgorithm::trimRow(size_t s, size_t j, size_t k)
+{
+    size_t x0 = segmentBegin(s);
+    size_t x1 = segmentEnd(s);
+
+    gridEdge& curGridEdge = gridEdges[(k*ny + j)*numSegments + s];
+
+    auto curEdgeCases =
+        edgeCases.begin() + ecStride * (k*ny + j) + segmentWord(s);
+    const util::edgeCaseWord_t* nextEdgeCasesY =
+        (j != ny-1) ? &curEdgeCases[ecStride] : nullptr;
+    const util::edgeCaseWord_t* nextEdgeCasesZ =
+        (k != nz-1) ? &curEdgeCases[ecStride*ny] : nullptr;
+
+    size_t xl, xr;
+    util::findTrim(&curEdgeCases[0], nextEdgeCasesY, nextEdgeCasesZ,
+                   x1 - x0 + 1, xl, xr);
+
+    // A segment with no cut edges is left trimmed to nothing, the same as
+    // a row with none.
+    if(xl > xr)
+    {
+        curGridEdge.xl = nx;
+        curGridEdge.xr = 0;
+    }
+    else
+    {
+        curGridEdge.xl = x0 + xl;
+        curGridEdge.xr = x0 + xr;
+    }
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass 2 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+void FlyingEdgesAlgorithm::pass2()
+{
+    // For each segment of each (j, k):
+    //  - for each cube (i, j, k) calculate caseId and number of gridEdge cuts
+    //    in the x, y and z direction.
+    forEachTile(ny-1, nz-1,
+        [this](size_t s, size_t jBegin, size_t jEnd,
+               size_t kBegin, size_t kEnd)
+        {
+            for(size_t k = kBegin; k != kEnd; ++k)
+                for(size_t j = jBegin; j != jEnd; ++j)
+                    countRow(s, j, k);
+        });
+}
+
+void FlyingEdgesAlgorithm::countRow(size_t s, size_t j, size_t k)
+{
+    // find adjusted trim values
+    size_t xl, xr;
+    calcTrimValues(xl, xr, s, j, k); // xl, xr set in this function
+
+    // ge0 is owned by this (i, j, k). ge1, ge2 and ge3 are only used for
+    // boundary cells. All of them are segment s of their gridEdge.
+    gridEdge& ge0 = gridEdges[(k*ny + j)*numSegments + s];
+    gridEdge& ge1 = gridEdges[(k*ny + j + 1)*numSegments + s];
+    gridEdge& ge2 = gridEdges[((k+1)*ny + j)*numSegments + s];
+    gridEdge& ge3 = gridEdges[((k+1)*ny + j + 1)*numSegments + s];
+
+    // ec0, ec1, ec2 and ec3 were set in pass 1. They are used
+    // to calculate the cell caseId.
+    const util::edgeCaseWord_t* ec0 = &edgeCases[ecStride*(k*ny + j)];
+    const util::edgeCaseWord_t* ec1 = &edgeCases[ecStride*(k*ny + j + 1)];
+    const util::edgeCaseWord_t* ec2 = &edgeCases[ecStride*((k+1)*ny + j)];
+    const util::edgeCaseWord_t* ec3 =
+        &edgeCases[ecStride*((k+1)*ny + j + 1)];
+
+    // Count the number of triangles along this segment of cubes.
+    offset_t& curTriCounter =
+        triCounter[(k*(ny-1) + j)*numSegments + s];
+
+    uchar* curCubeCaseIds =
+        lowMemory ? nullptr : &cubeCases[(nx-1)*(k*(ny-1) + j)];
+
+    bool isYEnd = (j == ny-2);
+    bool isZEnd = (k == nz-2);
+
+    for(size_t i = xl; i != xr; ++i)
+    {
+        // Only the last segment has the cube at nx-2.
+        bool isXEnd = (i == nx-2);
+
+        // using edgeCases from pass 1, compute cubeCases for this cube
+        uchar caseId = calcCubeCase(
+            util::getEdgeCase(ec0, i), util::getEdgeCase(ec1, i),
+            util::getEdgeCase(ec2, i), util::getEdgeCase(ec3, i));
+
+        if(!lowMemory)
+        {
+            curCubeCaseIds[i] = caseId;
+        }
+
+        // If the cube has no triangles through it
+        if(caseId == 0 || caseId == 255)
+        {
+            continue;
+        }
+
+        curTriCounter += util::numTris[caseId];
+
+        const bool* isCut = util::isCut[caseId]; // size 12
+
+        // Each cube counts the edges starting on its first point, e0, e3
+        // and e8. See the openmp algorithm for the labels of the cube.
+        ge0.xstart += isCut[0];
+        ge0.ystart += isCut[3];
+        ge0.zstart += isCut[8];
+
+        // Handle cubes along the edge of the image
+        if(isXEnd)
+        {
+            ge0.ystart += isCut[1];
+            ge0.zstart += isCut[9];
+        }
+        if(isYEnd)
+        {
+            ge1.xstart += isCut[2];
+            ge1.zstart += isCut[10];
+        }
+        if(isZEnd)
+        {
+            ge2.xstart += isCut[4];
+            ge2.ystart += isCut[7];
+        }
+
+        if(isXEnd and isYEnd)
+        {
+            ge1.zstart += isCut[11];
+        }
+        if(isXEnd and isZEnd)
+        {
+            ge2.ystart += isCut[5];
+        }
+        if(isYEnd and isZEnd)
+        {
+            ge3.xstart += isCut[6];
+        }
+    }
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass 3 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+void FlyingEdgesAlgorithm::pass3()
+{
+    // Each triCounter becomes the index of the first triangle of its
+    // segment of cubes. The segments of a row of cubes follow each other.
+    size_t numTriangles =
+        util::exclusiveScan<size_t>(triCounter.data(), triCounter.size());
+
+    // The points of a row are numbered x edges first, then y and then z
+    // edges, as in the serial algorithm. Within each direction the segments
+    // follow each other, so an edge starting on the first point of the next
+    // segment is numbered right after those of this one.
+    size_t numPoints = util::parallelScan<size_t>(ny*nz,
+        [this](size_t beg, size_t end)
+        {
+            size_t sum = 0;
+            for(size_t idx = beg*numSegments; idx != end*numSegments; ++idx)
+            {
+                gridEdge const& curGridEdge = gridEdges[idx];
+                sum += size_t(curGridEdge.xstart) + curGridEdge.ystart +
+                       curGridEdge.zstart;
+            }
+            return sum;
+        },
+        [this](size_t beg, size_t end, size_t offset)
+        {
+            for(size_t idx = beg; idx != end; ++idx)
+            {
+                gridEdge* row = &gridEdges[idx*numSegments];
+
+                for(size_t s = 0; s != numSegments; ++s)
+                {
+                    size_t tmp = row[s].xstart;
+                    row[s].xstart = offset;
+                    offset += tmp;
+                }
+
+                for(size_t s = 0; s != numSegments; ++s)
+                {
+                    size_t tmp = row[s].ystart;
+                    row[s].ystart = offset;
+                    offset += tmp;
+                }
+
+                for(size_t s = 0; s != numSegments; ++s)
+                {
+                    size_t tmp = row[s].zstart;
+                    row[s].zstart = offset;
+                    offset += tmp;
+                }
+            }
+            return offset;
+        });
+
+    if(numPoints > std::numeric_limits<offset_t>::max() ||
+       numTriangles > std::numeric_limits<offset_t>::max())
+    {
+        throw util::offset_overflow("Too many points or triangles for offset_t");
+    }
+
+    if(numPoints > std::numeric_limits<index_t>::max())
+    {
+        throw util::index_overflow("Too many points for index_t");
+    }
+
+    // Pass 4 writes every element, in the tasks that work on them.
+    points.resize(numPoints);
+    normals.resize(normalMode == util::NormalMode::gradient ? numPoints : 0);
+    tris.resize(numTriangles);
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Pass 4 of the algorithm
+///////////////////////////////////////////////////////////////////////////////
+void FlyingEdgesAlgorithm::pass4()
+{
+    // For each segment of each (j, k):
+    //  - Find the cut x, y and z edges starting on the segment and fill out
+    //    their points and normals.
+    //  - For each cube at i, fill out the triangles of the cube.
+    // Pass 3 left the offsets of both, so a tile does both parts at once.
+    // Without gradient normals, the provider computes nothing up front and
+    // is never read.
+    util::GradientProvider gradients(image,
+        normalMode == util::NormalMode::gradient ?
+            gradientMode : util::GradientMode::onTheFly);
+
+    // Each thread needs its own reader and scratch space since a reader
+    // holds the rolling cache of gradients. A task uses those of the thread
+    // running it.
+    std::vector<util::GradientProvider::Reader> gradReaders;
+    std::vector<EdgeSweep> sweeps;
+    gradReaders.reserve(omp_get_max_threads());
+    sweeps.reserve(omp_get_max_threads());
+    for(int t = 0; t != omp_get_max_threads(); ++t)
+    {
+        gradReaders.emplace_back(gradients);
+        sweeps.emplace_back(tileX + 1);
+    }
+
+    forEachTile(ny, nz,
+        [this, &gradReaders, &sweeps](size_t s, size_t jBegin, size_t jEnd,
+                                      size_t kBegin, size_t kEnd)
+        {
+            int tID = omp_get_thread_num();
+            for(size_t k = kBegin; k != kEnd; ++k)
+            {
+                for(size_t j = jBegin; j != jEnd; ++j)
+                {
+                    interpolateRow(s, j, k, gradReaders[tID], sweeps[tID]);
+
+                    if(j != ny-1 && k != nz-1)
+                        triangulateRow(s, j, k);
+                }
+            }
+        });
+
+    if(normalMode == util::NormalMode::face)
+    {
+        util::computeFaceNormals(points, tris, normals);
+    }
+}
+
+void FlyingEdgesAlgorithm::interpolateRow(
+    size_t s, size_t j, size_t k,
+    util::GradientProvider::Reader& gradReader,
+    EdgeSweep& sweep)
+{
+    gridEdge const& ge = gridEdges[(k*ny + j)*numSegments + s];
+    bool lastSegment = (s == numSegments-1);
+
+    const util::edgeCaseWord_t* ec = &edgeCases[ecStride*(k*ny + j)];
+
+    size_t n = findCutXEdges(ec, ge.xl, ge.xr, sweep);
+    interpolateEdges(n, j, k, 0, ge.xstart, gradReader, sweep);
+
+    if(j != ny-1)
+    {
+        n = findCutEdges(ec, ec + ecStride, ge.xl, ge.xr, lastSegment, sweep);
+        interpolateEdges(n, j, k, 1, ge.ystart, gradReader, sweep);
+    }
+
+    if(k != nz-1)
+    {
+        n = findCutEdges(ec, ec + ecStride*ny, ge.xl, ge.xr, lastSegment,
+                         sweep);
+        interpolateEdges(n, j, k, 2, ge.zstart, gradReader, sweep);
+    }
+}
+
+void FlyingEdgesAlgorithm::triangulateRow(size_t s, size_t j, size_t k)
+{
+    // find adjusted trim values
+    size_t xl, xr;
+    calcTrimValues(xl, xr, s, j, k); // xl, xr set in this function
+
+    if(xl == xr)
+        return;
+
+    size_t triIdx = triCounter[(k*(ny-1) + j)*numSegments + s];
+    // In low memory mode, the cube cases are recomputed from the edge
+    // cases as in pass 2.
+    const uchar* curCubeCaseIds =
+        lowMemory ? nullptr : &cubeCases[(nx-1)*(k*(ny-1) + j)];
+
+    const util::edgeCaseWord_t* ec0 = &edgeCases[ecStride*(k*ny + j)];
+    const util::edgeCaseWord_t* ec1 = &edgeCases[ecStride*(k*ny + j + 1)];
+    const util::edgeCaseWord_t* ec2 = &edgeCases[ecStride*((k+1)*ny + j)];
+    const util::edgeCaseWord_t* ec3 =
+        &edgeCases[ecStride*((k+1)*ny + j + 1)];
+
+    gridEdge const& ge0 = gridEdges[(k*ny + j)*numSegments + s];
+    gridEdge const& ge1 = gridEdges[(k*ny + j + 1)*numSegments + s];
+    gridEdge const& ge2 = gridEdges[((k+1)*ny + j)*numSegments + s];
+    gridEdge const& ge3 = gridEdges[((k+1)*ny + j + 1)*numSegments + s];
+
+    size_t x0counter = 0;
+    size_t y0counter = 0;
+    size_t z0counter = 0;
+
+    size_t x1counter = 0;
+    size_t z1counter = 0;
+
+    size_t x2counter = 0;
+    size_t y2counter = 0;
+
+    size_t x3counter = 0;
+
+    for(size_t i = xl; i != xr; ++i)
+    {
+        uchar caseId;
+        if(lowMemory)
+        {
+            caseId = calcCubeCase(
+                util::getEdgeCase(ec0, i), util::getEdgeCase(ec1, i),
+                util::getEdgeCase(ec2, i), util::getEdgeCase(ec3, i));
+        }
+        else
+        {
+            caseId = curCubeCaseIds[i];
+        }
+
+        if(caseId == 0 || caseId == 255)
+        {
+            continue;
+        }
+
+        const bool* isCut = util::isCut[caseId]; // has 12 elements
+
+        // Calculate global indices for triangles
+        std::array<size_t, 12> globalIdxs;
+
+        // Note:
+        //   e1, e5, e9 and e11 are visited in the next iteration
+        //   when they are e3, e7, e8 and 10 respectively. So don't
+        //   increment their counters. When the cube is an edge cube,
+        //   their counters won't be used again. On the last cube of a
+        //   segment they are the first edges of the next segment, which
+        //   pass 3 numbered right after the edges of this one.
+        if(isCut[0])
+            globalIdxs[0] = ge0.xstart + x0counter++;
+        if(isCut[3])
+            globalIdxs[3] = ge0.ystart + y0counter++;
+        if(isCut[8])
+            globalIdxs[8] = ge0.zstart + z0counter++;
+
+        if(isCut[1])
+            globalIdxs[1] = ge0.ystart + y0counter;
+        if(isCut[9])
+            globalIdxs[9] = ge0.zstart + z0counter;
+
+        if(isCut[2])
+            globalIdxs[2] = ge1.xstart + x1counter++;
+        if(isCut[10])
+            globalIdxs[10] = ge1.zstart + z1counter++;
+
+        if(isCut[4])
+            globalIdxs[4] = ge2.xstart + x2counter++;
+        if(isCut[7])
+            globalIdxs[7] = ge2.ystart + y2counter++;
+
+        if(isCut[11])
+            globalIdxs[11] = ge1.zstart + z1counter;
+        if(isCut[5])
+            globalIdxs[5] = ge2.ystart + y2counter;
+
+        if(isCut[6])
+            globalIdxs[6] = ge3.xstart + x3counter++;
+
+        // Add triangles
+        const char* caseTri = util::caseTriangles[caseId]; // size 16
+        for(int idx = 0; caseTri[idx] != -1; idx += 3)
+        {
+            tris[triIdx][0] = globalIdxs[caseTri[idx]];
+            tris[triIdx][1] = globalIdxs[caseTri[idx+1]];
+            tris[triIdx][2] = globalIdxs[caseTri[idx+2]];
+            ++triIdx;
+        }
+    }
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Don't copy points, normals and tris but move the output into a TrianlgeMesh.
+///////////////////////////////////////////////////////////////////////////////
+util::TriangleMesh FlyingEdgesAlgorithm::moveOutput()
+{
+    return util::TriangleMesh(std::move(points),
+                              std::move(normals),
+                              std::move(tris));
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory used by the state kept between passes
+///////////////////////////////////////////////////////////////////////////////
+size_t FlyingEdgesAlgorithm::intermediateStateBytes() const
+{
+    return gridEdges.size() * sizeof(gridEdge) +
+           triCounter.size() * sizeof(offset_t) +
+           edgeCases.size() * sizeof(util::edgeCaseWord_t) +
+           cubeCases.size() * sizeof(uchar);
+}
+
+size_t FlyingEdgesAlgorithm::fullIntermediateStateBytes() const
+{
+    // gridEdge has 5 size_t, each edge case is a byte and cubeCases is
+    // allocated
+    return gridEdges.size() * 5 * sizeof(size_t) +
+           triCounter.size() * sizeof(size_t) +
+           (nx-1)*ny*nz * sizeof(uchar) +
+           (nx-1)*(ny-1)*(nz-1) * sizeof(uchar);
+}
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Private helper functions
+///////////////////////////////////////////////////////////////////////////////
+
+inline uchar
+FlyingEdgesAlgorithm::calcCubeCase(
+    uchar const& ec0, uchar const& ec1,
+    uchar const& ec2, uchar const& ec3) const
+{
+    // ec0 | (_,j,k)
+    // ec1 | (_,j+1,k)
+    // ec2 | (_,j,k+1)
+    // ec3 | (_,j+1,k+1)
+
+    uchar caseId = 0;
+    if((ec0 == 0) || (ec0 == 2)) // 0 | (i,j,k)
+        caseId |= 1;
+    if((ec0 == 0) || (ec0 == 1)) // 1 | (i+1,j,k)
+        caseId |= 2;
+    if((ec1 == 0) || (ec1 == 1)) // 2 | (i+1,j+1,k)
+        caseId |= 4;
+    if((ec1 == 0) || (ec1 == 2)) // 3 | (i,j+1,k)
+        caseId |= 8;
+    if((ec2 == 0) || (ec2 == 2)) // 4 | (i,j,k+1)
+        caseId |= 16;
+    if((ec2 == 0) || (ec2 == 1)) // 5 | (i+1,j,k+1)
+        caseId |= 32;
+    if((ec3 == 0) || (ec3 == 1)) // 6 | (i+1,j+1,k+1)
+        caseId |= 64;
+    if((ec3 == 0) || (ec3 == 2)) // 7 | (i,j+1,k+1)
+        caseId |= 128;
+    return caseId;
+}
+
+inline void
+FlyingEdgesAlgorithm::calcTrimValues(
+    size_t& xl, size_t& xr,
+    size_t const& s, size_t const& j, size_t const& k) const
+{
+    gridEdge const& ge0 = gridEdges[(k*ny + j)*numSegments + s];
+    gridEdge const& ge1 = gridEdges[(k*ny + j + 1)*numSegments + s];
+    gridEdge const& ge2 = gridEdges[((k+1)*ny + j)*numSegments + s];
+    gridEdge const& ge3 = gridEdges[((k+1)*ny + j + 1)*numSegments + s];
+
+    xl = size_t(std::min({ge0.xl, ge1.xl, ge2.xl, ge3.xl}));
+    xr = size_t(std::max({ge0.xr, ge1.xr, ge2.xr, ge3.xr}));
+
+    if(xl > xr)
+        xl = xr;
+}
+
+inline size_t
+FlyingEdgesAlgorithm::findCutXEdges(
+    const util::edgeCaseWord_t* ec, size_t xl, size_t xr,
+    EdgeSweep& sweep) const
+{
+    // Every index is written but n only moves past the cut ones, so the
+    // loop has no branches.
+    size_t n = 0;
+    for(size_t i = xl; i < xr; ++i)
+    {
+        uchar edgeCase = util::getEdgeCase(ec, i);
+        sweep.cuts[n] = i;
+        n += (edgeCase == 1) | (edgeCase == 2);
+    }
+    return n;
+}
+
+inline size_t
+FlyingEdgesAlgorithm::findCutEdges(
+    const util::edgeCaseWord_t* ec, const util::edgeCaseWord_t* ecNext,
+    size_t xl, size_t xr, bool lastSegment, EdgeSweep& sweep) const
+{
+    // The edge from point i to the next row is cut if bit 0 of the edge
+    // cases differ. Pass 1 trimmed each segment to the points with such
+    // edges except the last point of the row, which is only bit 1 of the
+    // last edge case and belongs to the last segment.
+    size_t n = 0;
+    for(size_t i = xl; i < xr; ++i)
+    {
+        uchar diff = util::getEdgeCase(ec, i) ^ util::getEdgeCase(ecNext, i);
+        sweep.cuts[n] = i;
+        n += diff & 1;
+    }
+
+    if(!lastSegment)
+        return n;
+
+    uchar diff =
+        util::getEdgeCase(ec, nx-2) ^ util::getEdgeCase(ecNext, nx-2);
+    if(diff & 2)
+    {
+        sweep.cuts[n++] = nx-1;
+    }
+    return n;
+}
+
+inline void
+FlyingEdgesAlgorithm::interpolateEdges(
+    size_t n, size_t j, size_t k, int axis, size_t start,
+    util::GradientProvider::Reader& gradReader, EdgeSweep& sweep)
+{
+    // Each edge starts at (sweep.cuts[m], j, k) and goes one point along
+    // axis.
+    size_t const di = (axis == 0);
+    size_t const dj = (axis == 1);
+    size_t const dk = (axis == 2);
+
+    const scalar_t* row = image.pointer() + nx*(k*ny + j);
+    size_t const step = di + dj*nx + dk*nx*ny;
+
+    for(size_t m = 0; m != n; ++m)
+    {
+        scalar_t v0 = row[sweep.cuts[m]];
+        scalar_t v1 = row[sweep.cuts[m] + step];
+        sweep.weights[m] = (isoval - v0) / (v1 - v0);
+    }
+
+    std::array<scalar_t, 3> const zeroPos = image.getZeroPos();
+    std::array<scalar_t, 3> const spacing = image.getSpacing();
+    size_t const zOffset = image.zoffset();
+
+    std::array<scalar_t, 3> a;
+    a[1] = position(j, ny, zeroPos[1], spacing[1]);
+    a[2] = position(k + zOffset, nz + zOffset, zeroPos[2], spacing[2]);
+    std::array<scalar_t, 3> b = a;
+    b[axis] += spacing[axis];
+
+    // The components are written straight into the output arrays. With
+    // MESH_SOA each of them is contiguous.
+    size_t const stride = util::VectorArray::stride;
+    scalar_t* pointX = points.data(0) + start*stride;
+    scalar_t* pointY = points.data(1) + start*stride;
+    scalar_t* pointZ = points.data(2) + start*stride;
+    for(size_t m = 0; m != n; ++m)
+    {
+        size_t i = sweep.cuts[m];
+        scalar_t w = sweep.weights[m];
+        a[0] = position(i, nx, zeroPos[0], spacing[0]);
+        b[0] = di ? a[0] + spacing[0] : a[0];
+        pointX[m*stride] = a[0] + (w * (b[0] - a[0]));
+        pointY[m*stride] = a[1] + (w * (b[1] - a[1]));
+        pointZ[m*stride] = a[2] + (w * (b[2] - a[2]));
+    }
+
+    if(normalMode != util::NormalMode::gradient)
+        return;
+
+    scalar_t* normX = normals.data(0) + start*stride;
+    scalar_t* normY = normals.data(1) + start*stride;
+    scalar_t* normZ = normals.data(2) + start*stride;
+    for(size_t m = 0; m != n; ++m)
+    {
+        size_t i = sweep.cuts[m];
+        std::array<scalar_t, 3> normal = interpolate(
+            gradReader.getGradient(i, j, k),
+            gradReader.getGradient(i + di, j + dj, k + dk),
+            sweep.weights[m]);
+        normX[m*stride] = normal[0];
+        normY[m*stride] = normal[1];
+        normZ[m*stride] = normal[2];
+    }
+}
+
+inline scalar_t
+FlyingEdgesAlgorithm::position(
+    size_t idx, size_t dim, scalar_t zeroPos, scalar_t spacing) const
+{
+    // Same as Image3D::getPosCube, where the last point along an axis is
+    // one spacing past the point before it.
+    if(idx + 1 != dim)
+        return zeroPos + idx * spacing;
+    return (zeroPos + (idx - 1) * spacing) + spacing;
+}
+
+inline std::array<scalar_t, 3>
+FlyingEdgesAlgorithm::interpolate(
+    std::array<scalar_t, 3> const& a,
+    std::array<scalar_t, 3> const& b,
+    scalar_t const& weight) const
+{
+    std::array<scalar_t, 3> ret;
+    ret[0] = a[0] + (weight * (b[0] - a[0]));
+    ret[1] = a[1] + (weight * (b[1] - a[1]));
+    ret[2] = a[2] + (weight * (b[2] - a[2]));
+    return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
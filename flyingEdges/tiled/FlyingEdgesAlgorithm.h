@@ -0,0 +1,220 @@
+/*
+ * FlyingEdgesAlgorithm.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef FLYINGEDGESALGORITHM_H_
+#define FLYINGEDGESALGORITHM_H_
+
+#include <algorithm>
+#include <vector>
+#include <array>
+
+#include <omp.h>
+
+#include "../util/FlyingEdges_Config.h"
+#include "../util/EdgeCaseKernels.h"
+#include "../util/GradientProvider.h"
+#include "../util/MeshNormals.h"
+
+#include "../util/Image3D.h"
+#include "../util/TriangleMesh.h"
+
+// The image is split into tiles of tileX cubes along x, FE_BLOCK_WIDTH_Y
+// rows along y and FE_BLOCK_WIDTH_Z rows along z. Each pass is an OpenMP
+// task per tile, so there is enough work to go around however thin the
+// image is along any axis, and idle threads take tasks from busy ones.
+//
+// A row of gridEdges is cut into segments of tileX points, and each
+// segment keeps its own trim values and counts. Pass 3 numbers the points
+// of a row by axis first and segment second, so the output is the same as
+// that of the serial algorithm.
+struct FlyingEdgesAlgorithm
+{
+    // tileX is rounded up to a multiple of 32 so that tiles don't share
+    // words of packed edge cases. See the openmp algorithm for the rest.
+    FlyingEdgesAlgorithm(util::Image3D const& image, scalar_t const& isoval,
+                         size_t tileX = FE_BLOCK_WIDTH,
+                         bool lowMemory = false,
+                         util::GradientMode gradientMode =
+                             util::GradientMode::onTheFly,
+                         util::NormalMode normalMode =
+                             util::NormalMode::gradient)
+      : image(image),
+        isoval(isoval),
+        lowMemory(lowMemory),
+        gradientMode(gradientMode),
+        normalMode(normalMode),
+        nx(image.xdimension()),
+        ny(image.ydimension()),
+        nz(image.zdimension()),
+        tileX((std::max(tileX, size_t(1)) + 31) / 32 * 32),
+        numSegments((nx - 1 + this->tileX - 1) / this->tileX),
+        ecStride(util::edgeCaseRowSize(nx)),
+        gridEdges(ny*nz*numSegments),
+        triCounter((ny-1)*(nz-1)*numSegments),
+        edgeCases(ecStride*ny*nz),
+        cubeCases(lowMemory ? 0 : (nx-1)*(ny-1)*(nz-1))
+    {}
+
+    void pass1();
+
+    void pass2();
+
+    void pass3();
+
+    void pass4();
+
+    util::TriangleMesh moveOutput();
+
+    // The number of tiles along x, y and z
+    std::array<size_t, 3> tileCounts() const;
+
+    // Bytes used by gridEdges, triCounter, edgeCases and cubeCases, and the
+    // bytes they use without FE_COMPACT defined or lowMemory set.
+    size_t intermediateStateBytes() const;
+    size_t fullIntermediateStateBytes() const;
+
+private:
+    // The trim values and counts of a segment of a row of gridEdges.
+    struct gridEdge
+    {
+        gridEdge()
+          : xl(0),
+            xr(0),
+            xstart(0),
+            ystart(0),
+            zstart(0)
+        {}
+
+        // trim values
+        // set on pass 1
+        offset_t xl;
+        offset_t xr;
+
+        // modified on pass 2
+        // set on pass 3
+        offset_t xstart;
+        offset_t ystart;
+        offset_t zstart;
+    };
+
+    // Scratch space for the cut edges along a segment in pass 4
+    struct EdgeSweep
+    {
+        EdgeSweep(size_t n)
+          : cuts(n),
+            weights(n)
+        {}
+
+        std::vector<size_t> cuts;       // where each cut edge starts
+        std::vector<scalar_t> weights;  // where the isosurface cuts it
+    };
+
+private:
+    util::Image3D const& image;
+    scalar_t const isoval;
+    bool const lowMemory;
+    util::GradientMode const gradientMode;
+    util::NormalMode const normalMode;
+
+    size_t const nx; //
+    size_t const ny; // for indexing
+    size_t const nz; //
+
+    size_t const tileX;       // points in a segment
+    size_t const numSegments; // segments in a row
+
+    size_t const ecStride; // words in a row of edgeCases
+
+    // size of ny*nz*numSegments
+    std::vector<gridEdge> gridEdges;
+    // size of (ny-1)*(nz-1)*numSegments
+    std::vector<offset_t> triCounter;
+
+    std::vector<util::edgeCaseWord_t> edgeCases; // size ecStride*ny*nz
+    std::vector<uchar> cubeCases;    // size (nx-1)*(ny-1)*(nz-1) or 0
+
+    util::VectorArray points;                      //
+    util::VectorArray normals;                     // The output
+    util::TriangleArray tris;                      //
+
+private:
+    // Calls work(s, jBegin, jEnd, kBegin, kEnd) as a task for each tile of
+    // the rows [0, numY) x [0, numZ), and waits for all of them.
+    template <typename Work>
+    void forEachTile(size_t numY, size_t numZ, Work work);
+
+    // The first and one past the last point of segment s. The last segment
+    // also owns point nx-1, which only has y and z edges.
+    size_t segmentBegin(size_t s) const { return s * tileX; }
+    size_t segmentEnd(size_t s) const
+    {
+        return std::min((s + 1) * tileX, nx - 1);
+    }
+
+    // The word holding the first edge case of segment s in a row of
+    // edgeCases. The segments start on whole words.
+    size_t segmentWord(size_t s) const
+    {
+        return util::edgeCaseRowSize(segmentBegin(s) + 1);
+    }
+
+    // The work of the passes on segment s of gridEdge (j, k). countRow and
+    // triangulateRow work on the cubes starting on that segment.
+    inline void classifyRow(size_t s, size_t j, size_t k);
+    inline void trimRow(size_t s, size_t j, size_t k);
+    inline void countRow(size_t s, size_t j, size_t k);
+    inline void interpolateRow(
+        size_t s, size_t j, size_t k,
+        util::GradientProvider::Reader& gradReader,
+        EdgeSweep& sweep);
+    inline void triangulateRow(size_t s, size_t j, size_t k);
+
+    inline uchar
+    calcCubeCase(uchar const& ec0, uchar const& ec1,
+                 uchar const& ec2, uchar const& ec3) const;
+
+    inline void calcTrimValues(
+        size_t& xl, size_t& xr,
+        size_t const& s, size_t const& j, size_t const& k) const;
+
+    // Fill sweep.cuts with the cut x-edges of a segment, or with the points
+    // of a segment whose edge to the next row is cut. ecNext holds the edge
+    // cases of the next row in y or z. Return how many there are.
+    inline size_t findCutXEdges(
+        const util::edgeCaseWord_t* ec, size_t xl, size_t xr,
+        EdgeSweep& sweep) const;
+
+    inline size_t findCutEdges(
+        const util::edgeCaseWord_t* ec, const util::edgeCaseWord_t* ecNext,
+        size_t xl, size_t xr, bool lastSegment, EdgeSweep& sweep) const;
+
+    // Fill out the points and normals of the first n edges in sweep.cuts
+    // along gridEdge (j, k), from index start on. axis is the direction of
+    // the edges.
+    inline void interpolateEdges(
+        size_t n, size_t j, size_t k, int axis,
+        size_t start,
+        util::GradientProvider::Reader& gradReader,
+        EdgeSweep& sweep);
+
+    inline scalar_t position(
+        size_t idx, size_t dim, scalar_t zeroPos, scalar_t spacing) const;
+
+    inline std::array<scalar_t, 3>
+    interpolate(
+        std::array<scalar_t, 3> const& a,
+        std::array<scalar_t, 3> const& b,
+        scalar_t const& weight) const;
+};
+
+
+#endif
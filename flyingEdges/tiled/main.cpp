@@ -0,0 +1,265 @@
+/*
+ * main.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+#include <iostream>
+#include <string.h>
+#include <cstdlib>
+#include <string>
+#include <omp.h>
+
+#include "FlyingEdgesAlgorithm.h"
+
+#include "../util/EdgeCaseKernels.h"
+#include "../util/GradientProvider.h"
+#include "../util/LoadImage.h"
+#include "../util/MeshNormals.h"
+#include "../util/SaveTriangleMesh.h"
+
+#include "../util/Timer.h"
+#include "../mantevoCommon/YAML_Doc.hpp"
+
+int main(int argc, char* argv[])
+{
+    bool isovalSet = false;
+    scalar_t isoval = 0.0;
+    char* vtkFile = NULL;
+    char* outFile = NULL;
+    bool lowMemory = false;
+    size_t tileX = FE_BLOCK_WIDTH;
+    char* gradientName = NULL;
+    size_t gradientMemory = 1024; // MiB
+    char* normalName = NULL;
+    std::string yamlDirectory = "";
+    std::string yamlFileName  = "";
+
+    // Read command line arguments
+    for(int i=0; i<argc; i++)
+    {
+        if( (strcmp(argv[i], "-i") == 0) || (strcmp(argv[i], "-input_file") == 0))
+        {
+            vtkFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-o") == 0) || (strcmp(argv[i], "-output_file") == 0))
+        {
+            outFile = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-v") == 0) || (strcmp(argv[i], "-isoval") == 0))
+        {
+            isoval = atof(argv[++i]);
+            isovalSet = true;
+        }
+        else if( (strcmp(argv[i], "-l") == 0) || (strcmp(argv[i], "-low_memory") == 0))
+        {
+            lowMemory = atoi(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-tx") == 0) || (strcmp(argv[i], "-tile_x") == 0))
+        {
+            tileX = atol(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-g") == 0) || (strcmp(argv[i], "-gradient") == 0))
+        {
+            gradientName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-gm") == 0) || (strcmp(argv[i], "-gradient_memory") == 0))
+        {
+            gradientMemory = atol(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-normals") == 0))
+        {
+            normalName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
+        {
+            std::string wholeFile(argv[++i]);
+
+            std::size_t pos = wholeFile.rfind("/");
+            if(pos == std::string::npos)
+            {
+                yamlDirectory = "./";
+                yamlFileName = wholeFile;
+            }
+            else
+            {
+                yamlDirectory = wholeFile.substr(0, pos + 1);
+                yamlFileName = wholeFile.substr(pos + 1);
+            }
+        }
+        else if( (strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "-help") == 0))
+        {
+            std::cout <<
+                "Tiled Flying Edges Options:"     << std::endl <<
+                "  -input_file (-i)"              << std::endl <<
+                "  -output_file (-o)"             << std::endl <<
+                "  -isoval (-v)"                  << std::endl <<
+                "  -low_memory (-l), default 0"   << std::endl <<
+                "  -tile_x (-tx), default 512"    << std::endl <<
+                "  -gradient (-g), default auto"  << std::endl <<
+                "    auto, onthefly, rolling or"  << std::endl <<
+                "    precomputed"                 << std::endl <<
+                "  -gradient_memory (-gm), MiB,"  << std::endl <<
+                "    default 1024"                << std::endl <<
+                "  -normals (-n), default"        << std::endl <<
+                "    gradient, none or face"      << std::endl <<
+                "  -yaml_output_file (-y)"        << std::endl <<
+                "  -help (-h)"                    << std::endl;
+            return 0;
+        }
+    }
+
+    if(isovalSet == false || vtkFile == NULL || outFile == NULL)
+    {
+        std::cout << "Error: isoval, input_file and output_file must be set." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    bool autoGradient =
+        gradientName == NULL || strcmp(gradientName, "auto") == 0;
+    util::GradientMode gradientMode = util::GradientMode::onTheFly;
+    if(!autoGradient && !util::parseGradientMode(gradientName, gradientMode))
+    {
+        std::cout << "Error: unknown gradient mode " << gradientName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::NormalMode normalMode = util::NormalMode::gradient;
+    if(normalName != NULL && !util::parseNormalMode(normalName, normalMode))
+    {
+        std::cout << "Error: unknown normal mode " << normalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
+    // YAML_Doc will create a file at in the current directory with a
+    // timestamp on it.
+    YAML_Doc doc("Flying Edges", "0.1", yamlDirectory, yamlFileName);
+
+    // Add information related to this run to doc.
+    doc.add("Flying Edges Algorithm", "tiled");
+    doc.add("Volume image data file path", vtkFile);
+    doc.add("Polygonal mesh output file", outFile);
+    doc.add("Isoval", isoval);
+    doc.add("Edge classification kernel", util::edgeCaseKernelName<scalar_t>());
+#ifdef FE_COMPACT
+    doc.add("Compact intermediate state", "on");
+#else
+    doc.add("Compact intermediate state", "off");
+#endif
+    doc.add("Low memory mode", lowMemory ? "on" : "off");
+    doc.add("Normal mode", util::normalModeName(normalMode));
+    doc.add("Number of threads", omp_get_max_threads());
+
+    // Load the image file. Its rows are read by all of the threads, which
+    // also spreads its pages over their nodes for the tasks to share.
+    util::Image3D image =
+        util::loadImage(vtkFile, util::Placement::firstTouch);
+
+    doc.add("File x-dimension", image.xdimension());
+    doc.add("File y-dimension", image.ydimension());
+    doc.add("File z-dimension", image.zdimension());
+
+    // Without a gradient mode given, use the fastest one that fits in the
+    // gradient memory budget.
+    size_t gradientBudget = gradientMemory << 20;
+    if(autoGradient)
+    {
+        gradientMode = util::chooseGradientMode(
+            image.xdimension(), image.ydimension(), image.zdimension(),
+            omp_get_max_threads(), gradientBudget);
+    }
+    doc.add("Gradient mode", util::gradientModeName(gradientMode));
+    doc.add("Gradient memory budget (bytes)", gradientBudget);
+
+    // Time the output. util::Timer's constructor starts timing.
+    util::Timer runTime;
+
+    // The inputs of the algorithm are the 3D image file and the isoval to
+    // estimate the isosurface at. Each pass is an OpenMP task for each
+    // tile, which is tileX cubes along x and a block of rows along y and z.
+    FlyingEdgesAlgorithm algo(image, isoval, tileX, lowMemory, gradientMode,
+                              normalMode);
+
+    std::array<size_t, 3> tileCounts = algo.tileCounts();
+    doc.add("Tiles", "");
+    doc.get("Tiles")->add("x-dimension", tileCounts[0]);
+    doc.get("Tiles")->add("y-dimension", tileCounts[1]);
+    doc.get("Tiles")->add("z-dimension", tileCounts[2]);
+
+    // The flying edges algorithm makes 4 passes through the image file.
+    // Each pass is timed. See the serial algorithm for what they do.
+    util::Timer runTimePass1;
+    algo.pass1();
+    runTimePass1.stop();
+
+    util::Timer runTimePass2;
+    algo.pass2();
+    runTimePass2.stop();
+
+    util::Timer runTimePass3;
+    algo.pass3();
+    runTimePass3.stop();
+
+    util::Timer runTimePass4;
+    algo.pass4();
+    runTimePass4.stop();
+
+    // Report the memory kept between passes
+    size_t stateBytes = algo.intermediateStateBytes();
+    size_t fullStateBytes = algo.fullIntermediateStateBytes();
+
+    // This function receives the output. The data is not copied or deep copied
+    // but instead is moved or shallow copied. Once moveOutput is called, the
+    // algo structure no longer maintains responsibility of any data.
+    util::TriangleMesh mesh = algo.moveOutput();
+
+    // End overall timing
+    runTime.stop();
+
+    // Report mesh information
+    doc.add("Number of vertices in mesh", mesh.numberOfVertices());
+    doc.add("Number of triangles in mesh", mesh.numberOfTriangles());
+
+    doc.add("Intermediate state (bytes)", stateBytes);
+    doc.add("Intermediate state saved (bytes)", fullStateBytes - stateBytes);
+
+    // Report timing information
+    doc.add("Pass 1", "");
+    doc.get("Pass 1")->add("CPU Time (clicks)", runTimePass1.getTotalTicks());
+    doc.get("Pass 1")->add("CPU Time (seconds)", runTimePass1.getCPUtime());
+    doc.get("Pass 1")->add("Wall Time (seconds)", runTimePass1.getWallTime());
+
+    doc.add("Pass 2", "");
+    doc.get("Pass 2")->add("CPU Time (clicks)", runTimePass2.getTotalTicks());
+    doc.get("Pass 2")->add("CPU Time (seconds)", runTimePass2.getCPUtime());
+    doc.get("Pass 2")->add("Wall Time (seconds)", runTimePass2.getWallTime());
+
+    doc.add("Pass 3", "");
+    doc.get("Pass 3")->add("CPU Time (clicks)", runTimePass3.getTotalTicks());
+    doc.get("Pass 3")->add("CPU Time (seconds)", runTimePass3.getCPUtime());
+    doc.get("Pass 3")->add("Wall Time (seconds)", runTimePass3.getWallTime());
+
+    doc.add("Pass 4", "");
+    doc.get("Pass 4")->add("CPU Time (clicks)", runTimePass4.getTotalTicks());
+    doc.get("Pass 4")->add("CPU Time (seconds)", runTimePass4.getCPUtime());
+    doc.get("Pass 4")->add("Wall Time (seconds)", runTimePass4.getWallTime());
+
+    doc.add("Total Program CPU Time (clicks)", runTime.getTotalTicks());
+    doc.add("Total Program CPU Time (seconds)", runTime.getCPUtime());
+    doc.add("Total Program WALL Time (seconds)", runTime.getWallTime());
+
+    // Generate the YAML file. The file will be both saved and printed to console.
+    std::cout << doc.generateYAML();
+
+    // Save the polygonal mesh to the output file.
+    util::saveTriangleMesh(mesh, outFile);
+}
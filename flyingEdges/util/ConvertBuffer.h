@@ -16,9 +16,22 @@
 #ifndef UTIL_CONVERTBUFFER_H_
 #define UTIL_CONVERTBUFFER_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
 #include "TypeInfo.h"
 #include "Errors.h"
 
+// The byte swap kernels are compiled with function level target attributes
+// so that the rest of the program does not need -mavx2 or -mavx512bw.
+// Whether or not they are used is decided at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTIL_X86_BYTESWAP
+#include <immintrin.h>
+#endif
+
 namespace util
 {
     template<typename T>
@@ -31,15 +44,179 @@ namespace util
         }
     }
 
+    // Reverses the bytes of each of the n values of Size bytes at in and
+    // writes them to out, which may be in.
+    using ByteSwapFunc = void (*)(const void*, std::size_t, void*);
+
+    template<int Size>
+    void byteSwapScalar(const void *in, std::size_t n, void *out)
+    {
+        const char *src = static_cast<const char*>(in);
+        char *dst = static_cast<char*>(out);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            char val[Size];
+            std::memcpy(val, src + i * Size, Size);
+            for (int b = 0; b < Size; ++b)
+                dst[i * Size + b] = val[Size - b - 1];
+        }
+    }
+
+#ifdef UTIL_X86_BYTESWAP
+    // The shuffle that reverses each value of Size bytes in a 16 byte lane
+    template<int Size>
+    void byteSwapShuffle(char (&shuffle)[64])
+    {
+        for (int b = 0; b < 64; ++b)
+            shuffle[b] = (b % 16) / Size * Size + Size - 1 - b % Size;
+    }
+
+    // 32 bytes per iteration, the rest with byteSwapScalar.
+    template<int Size>
+    __attribute__((target("avx2")))
+    void byteSwapAvx2(const void *in, std::size_t n, void *out)
+    {
+        const char *src = static_cast<const char*>(in);
+        char *dst = static_cast<char*>(out);
+
+        char shuffleBytes[64];
+        byteSwapShuffle<Size>(shuffleBytes);
+        __m256i const shuffle = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(shuffleBytes));
+
+        std::size_t const nBytes = n * Size;
+        std::size_t i = 0;
+        for (; i + 32 <= nBytes; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(src + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                                _mm256_shuffle_epi8(v, shuffle));
+        }
+        byteSwapScalar<Size>(src + i, (nBytes - i) / Size, dst + i);
+    }
+
+    // 64 bytes per iteration, see byteSwapAvx2.
+    template<int Size>
+    __attribute__((target("avx512f,avx512bw")))
+    void byteSwapAvx512(const void *in, std::size_t n, void *out)
+    {
+        const char *src = static_cast<const char*>(in);
+        char *dst = static_cast<char*>(out);
+
+        char shuffleBytes[64];
+        byteSwapShuffle<Size>(shuffleBytes);
+        __m512i const shuffle = _mm512_loadu_si512(shuffleBytes);
+
+        std::size_t const nBytes = n * Size;
+        std::size_t i = 0;
+        for (; i + 64 <= nBytes; i += 64)
+        {
+            __m512i v = _mm512_loadu_si512(src + i);
+            _mm512_storeu_si512(dst + i, _mm512_shuffle_epi8(v, shuffle));
+        }
+        byteSwapScalar<Size>(src + i, (nBytes - i) / Size, dst + i);
+    }
+#endif
+
+    struct ByteSwapKernel
+    {
+        ByteSwapFunc swap2;
+        ByteSwapFunc swap4;
+        ByteSwapFunc swap8;
+        const char* name;
+    };
+
+    inline ByteSwapKernel selectByteSwapKernel()
+    {
+#ifdef UTIL_X86_BYTESWAP
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") &&
+            __builtin_cpu_supports("avx512bw"))
+        {
+            return { &byteSwapAvx512<2>, &byteSwapAvx512<4>,
+                     &byteSwapAvx512<8>, "avx512" };
+        }
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return { &byteSwapAvx2<2>, &byteSwapAvx2<4>,
+                     &byteSwapAvx2<8>, "avx2" };
+        }
+#endif
+        return { &byteSwapScalar<2>, &byteSwapScalar<4>,
+                 &byteSwapScalar<8>, "scalar" };
+    }
+
+    // The byte swap kernel is chosen once from what the cpu supports:
+    // AVX-512, AVX2 or a plain C++ loop.
+    inline ByteSwapKernel const& byteSwapKernel()
+    {
+        static ByteSwapKernel const k = selectByteSwapKernel();
+        return k;
+    }
+
+    inline const char* byteSwapKernelName()
+    {
+        return byteSwapKernel().name;
+    }
+
+    // Flips the endianness of the n values at in into out, which may be in.
+    template<typename T>
+    void flipEndianness(const T *in, std::size_t n, T *out)
+    {
+        switch (sizeof(T)) {
+        case 1:
+            if (in != out)
+                std::memmove(out, in, n);
+            break;
+        case 2:
+            byteSwapKernel().swap2(in, n, out);
+            break;
+        case 4:
+            byteSwapKernel().swap4(in, n, out);
+            break;
+        case 8:
+            byteSwapKernel().swap8(in, n, out);
+            break;
+        default:
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                T val = in[i];
+                flipEndianness(val);
+                out[i] = val;
+            }
+        }
+    }
+
+    // Values are flipped a block at a time into a buffer on the stack and
+    // then converted, a loop the compiler vectorizes. Single bytes have
+    // nothing to flip.
     template<typename SrcT, typename DstT>
     void convertBuffer(const SrcT *in, std::size_t nelms, DstT *out)
     {
-        for (std::size_t i = 0; i < nelms; ++i)
+        if (sizeof(SrcT) == 1)
         {
-            SrcT val = *in++;
-            flipEndianness(val);
-            *out++ = static_cast<DstT>(val);
+            for (std::size_t i = 0; i < nelms; ++i)
+                out[i] = static_cast<DstT>(in[i]);
+            return;
         }
+
+        std::size_t const blockSize = 1024;
+        SrcT block[blockSize];
+        for (std::size_t i = 0; i < nelms; i += blockSize)
+        {
+            std::size_t n = std::min(blockSize, nelms - i);
+            flipEndianness(in + i, n, block);
+            for (std::size_t j = 0; j < n; ++j)
+                out[i + j] = static_cast<DstT>(block[j]);
+        }
+    }
+
+    // Values of the same type only need flipping. out may be in.
+    template<typename T>
+    void convertBuffer(const T *in, std::size_t nelms, T *out)
+    {
+        flipEndianness(in, nelms, out);
     }
 
     template<typename T>
@@ -65,9 +242,54 @@ namespace util
         case TypeInfo::ID_DOUBLE:
             convertBuffer(reinterpret_cast<const double*>(in), nelms, out);
             break;
-        //default:
-        //    throw no_type("Data type is not supported");
-        //    break;
+        case TypeInfo::ID_UCHAR:
+            convertBuffer(reinterpret_cast<const unsigned char*>(in), nelms, out);
+            break;
+        default:
+            throw no_type("Data type is not supported");
+        }
+    }
+
+    // Values are split in chunks of this many among the threads below.
+    const std::size_t convertChunkSize = 1 << 16;
+
+    // Same as convertBufferWithTypeInfo with the chunks of the values
+    // converted by the OpenMP threads. Not for use in a parallel region.
+    template<typename T>
+    void convertBufferWithTypeInfoParallel(
+        const char *in, const TypeInfo &ti, std::size_t nelms, T *out)
+    {
+        std::size_t const numChunks =
+            (nelms + convertChunkSize - 1) / convertChunkSize;
+        std::size_t c;
+#ifdef _OPENMP
+        #pragma omp parallel for if(numChunks > 1)
+#endif
+        for (c = 0; c < numChunks; ++c)
+        {
+            std::size_t begin = c * convertChunkSize;
+            std::size_t n = std::min(convertChunkSize, nelms - begin);
+            convertBufferWithTypeInfo(
+                in + begin * ti.size(), ti, n, out + begin);
+        }
+    }
+
+    // Flips the endianness of n values in place, with the chunks split
+    // among the OpenMP threads as above.
+    template<typename T>
+    void flipEndiannessParallel(T *values, std::size_t n)
+    {
+        std::size_t const numChunks =
+            (n + convertChunkSize - 1) / convertChunkSize;
+        std::size_t c;
+#ifdef _OPENMP
+        #pragma omp parallel for if(numChunks > 1)
+#endif
+        for (c = 0; c < numChunks; ++c)
+        {
+            std::size_t begin = c * convertChunkSize;
+            std::size_t len = std::min(convertChunkSize, n - begin);
+            flipEndianness(values + begin, len, values + begin);
         }
     }
 } // util namespace
@@ -0,0 +1,639 @@
+/*
+ * EdgeCaseKernels.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#include "EdgeCaseKernels.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+// The vector kernels are compiled with function level target attributes so
+// that the rest of the program does not need -mavx2 or -mavx512f. Whether or
+// not they are used is decided at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace util {
+
+namespace {
+
+template <typename T>
+void
+classifyEdgesScalar(
+    const T* row, size_t nx, T isoval, uchar* edgeCases)
+{
+    // !(v >= isoval) instead of (v < isoval) so NaNs are classified the
+    // same way as the vector kernels classify them.
+    for(size_t i = 0; i != nx-1; ++i)
+    {
+        uchar left  = !(row[i] >= isoval);
+        uchar right = !(row[i+1] >= isoval);
+        edgeCases[i] = left | (right << 1);
+    }
+}
+
+#ifdef FE_X86_KERNELS
+
+// spreadBits[m] has byte b set to bit b of m. A lookup is used instead of
+// pdep, which is microcoded and very slow on some AMD processors.
+std::array<uint64_t, 256> makeSpreadBits()
+{
+    std::array<uint64_t, 256> table;
+    for(int m = 0; m != 256; ++m)
+    {
+        uint64_t spread = 0;
+        for(int b = 0; b != 8; ++b)
+        {
+            if(m & (1 << b))
+                spread |= uint64_t(1) << (8*b);
+        }
+        table[m] = spread;
+    }
+    return table;
+}
+
+std::array<uint64_t, 256> const spreadBits = makeSpreadBits();
+
+// Bit n of the result is set if p[n] is not >= isoval, for n in [0, 32).
+// Unsigned values are compared as signed ones after flipping their sign
+// bits, since AVX2 only has signed integer comparisons.
+__attribute__((target("avx2")))
+inline uint64_t
+belowMaskAvx2(const float* p, float isoval)
+{
+    __m256 const iso = _mm256_set1_ps(isoval);
+    uint64_t below = 0;
+    for(int b = 0; b != 4; ++b)
+    {
+        __m256 vals = _mm256_loadu_ps(p + 8*b);
+        __m256 cmp = _mm256_cmp_ps(vals, iso, _CMP_NGE_UQ);
+        below |= uint64_t(_mm256_movemask_ps(cmp)) << (8*b);
+    }
+    return below;
+}
+
+__attribute__((target("avx2")))
+inline uint64_t
+belowMaskAvx2(const char* p, char isoval)
+{
+    __m256i vals = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i cmp = _mm256_cmpgt_epi8(_mm256_set1_epi8(isoval), vals);
+    return uint32_t(_mm256_movemask_epi8(cmp));
+}
+
+__attribute__((target("avx2")))
+inline uint64_t
+belowMaskAvx2(const uchar* p, uchar isoval)
+{
+    __m256i const bias = _mm256_set1_epi8(char(0x80));
+    __m256i vals = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    __m256i cmp = _mm256_cmpgt_epi8(
+        _mm256_xor_si256(_mm256_set1_epi8(char(isoval)), bias),
+        _mm256_xor_si256(vals, bias));
+    return uint32_t(_mm256_movemask_epi8(cmp));
+}
+
+// The 16 bit comparisons are packed to bytes, which interleaves the 128 bit
+// lanes of the two halves, and put back in order before taking the mask.
+__attribute__((target("avx2")))
+inline uint64_t
+belowMask16Avx2(__m256i lo, __m256i hi, __m256i iso)
+{
+    __m256i cmp = _mm256_packs_epi16(_mm256_cmpgt_epi16(iso, lo),
+                                     _mm256_cmpgt_epi16(iso, hi));
+    cmp = _mm256_permute4x64_epi64(cmp, 0xd8);
+    return uint32_t(_mm256_movemask_epi8(cmp));
+}
+
+__attribute__((target("avx2")))
+inline uint64_t
+belowMaskAvx2(const short* p, short isoval)
+{
+    const __m256i* v = reinterpret_cast<const __m256i*>(p);
+    return belowMask16Avx2(_mm256_loadu_si256(v), _mm256_loadu_si256(v + 1),
+                           _mm256_set1_epi16(isoval));
+}
+
+__attribute__((target("avx2")))
+inline uint64_t
+belowMaskAvx2(const unsigned short* p, unsigned short isoval)
+{
+    __m256i const bias = _mm256_set1_epi16(short(0x8000));
+    const __m256i* v = reinterpret_cast<const __m256i*>(p);
+    return belowMask16Avx2(
+        _mm256_xor_si256(_mm256_loadu_si256(v), bias),
+        _mm256_xor_si256(_mm256_loadu_si256(v + 1), bias),
+        _mm256_xor_si256(_mm256_set1_epi16(short(isoval)), bias));
+}
+
+// Same as belowMaskAvx2 for n in [0, 64).
+__attribute__((target("avx512f,avx512bw")))
+inline uint64_t
+belowMaskAvx512(const float* p, float isoval)
+{
+    __m512 const iso = _mm512_set1_ps(isoval);
+    uint64_t below = 0;
+    for(int b = 0; b != 4; ++b)
+    {
+        __m512 vals = _mm512_loadu_ps(p + 16*b);
+        __mmask16 cmp = _mm512_cmp_ps_mask(vals, iso, _CMP_NGE_UQ);
+        below |= uint64_t(cmp) << (16*b);
+    }
+    return below;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline uint64_t
+belowMaskAvx512(const char* p, char isoval)
+{
+    return _mm512_cmplt_epi8_mask(_mm512_loadu_si512(p),
+                                  _mm512_set1_epi8(isoval));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline uint64_t
+belowMaskAvx512(const uchar* p, uchar isoval)
+{
+    return _mm512_cmplt_epu8_mask(_mm512_loadu_si512(p),
+                                  _mm512_set1_epi8(char(isoval)));
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline uint64_t
+belowMaskAvx512(const short* p, short isoval)
+{
+    __m512i const iso = _mm512_set1_epi16(isoval);
+    uint64_t lo = _mm512_cmplt_epi16_mask(_mm512_loadu_si512(p), iso);
+    uint64_t hi = _mm512_cmplt_epi16_mask(_mm512_loadu_si512(p + 32), iso);
+    return lo | (hi << 32);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline uint64_t
+belowMaskAvx512(const unsigned short* p, unsigned short isoval)
+{
+    __m512i const iso = _mm512_set1_epi16(short(isoval));
+    uint64_t lo = _mm512_cmplt_epu16_mask(_mm512_loadu_si512(p), iso);
+    uint64_t hi = _mm512_cmplt_epu16_mask(_mm512_loadu_si512(p + 32), iso);
+    return lo | (hi << 32);
+}
+
+template <typename T>
+__attribute__((target("avx2")))
+void
+classifyEdgesAvx2(
+    const T* row, size_t nx, T isoval, uchar* edgeCases)
+{
+    size_t const nEdges = nx - 1;
+
+    // 32 edges per iteration. Vertex i+32 is also needed, so the last
+    // iteration must satisfy i + 32 <= nx - 1.
+    size_t i = 0;
+    for(; i + 32 <= nEdges; i += 32)
+    {
+        // Bit n of below is set if row[i+n] is not >= isoval.
+        uint64_t below = belowMaskAvx2(row + i, isoval);
+        below |= uint64_t(!(row[i+32] >= isoval)) << 32;
+
+        uint64_t left = below;
+        uint64_t right = below >> 1;
+
+        std::array<uint64_t, 4> cases;
+        for(int b = 0; b != 4; ++b)
+        {
+            cases[b] = spreadBits[(left >> (8*b)) & 0xff] |
+                       (spreadBits[(right >> (8*b)) & 0xff] << 1);
+        }
+
+        _mm256_storeu_si256(
+            reinterpret_cast<__m256i*>(edgeCases + i),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cases.data())));
+    }
+
+    if(i != nEdges)
+    {
+        classifyEdgesScalar(row + i, nx - i, isoval, edgeCases + i);
+    }
+}
+
+template <typename T>
+__attribute__((target("avx512f,avx512bw")))
+void
+classifyEdgesAvx512(
+    const T* row, size_t nx, T isoval, uchar* edgeCases)
+{
+    size_t const nEdges = nx - 1;
+
+    // 64 edges per iteration, see classifyEdgesAvx2.
+    size_t i = 0;
+    for(; i + 64 <= nEdges; i += 64)
+    {
+        uint64_t below = belowMaskAvx512(row + i, isoval);
+
+        __mmask64 left = below;
+        __mmask64 right =
+            (below >> 1) | (uint64_t(!(row[i+64] >= isoval)) << 63);
+
+        __m512i cases = _mm512_or_si512(
+            _mm512_maskz_set1_epi8(left, 1),
+            _mm512_maskz_set1_epi8(right, 2));
+
+        _mm512_storeu_si512(edgeCases + i, cases);
+    }
+
+    if(i != nEdges)
+    {
+        classifyEdgesScalar(row + i, nx - i, isoval, edgeCases + i);
+    }
+}
+
+#endif
+
+// The types with vector kernels: float and the 8 and 16 bit integers.
+template <typename T>
+using HasVectorKernels = std::integral_constant<bool,
+    std::is_same<T, float>::value ||
+    (std::is_integral<T>::value && sizeof(T) <= 2)>;
+
+template <typename T>
+struct Kernel
+{
+    using Func = void (*)(const T*, size_t, T, uchar*);
+
+    Func func;
+    const char* name;
+};
+
+template <typename T>
+Kernel<T> selectKernel(std::true_type)
+{
+#ifdef FE_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") &&
+       __builtin_cpu_supports("avx512bw"))
+    {
+        return { &classifyEdgesAvx512<T>, "avx512" };
+    }
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return { &classifyEdgesAvx2<T>, "avx2" };
+    }
+#endif
+    return { &classifyEdgesScalar<T>, "scalar" };
+}
+
+template <typename T>
+Kernel<T> selectKernel(std::false_type)
+{
+    return { &classifyEdgesScalar<T>, "scalar" };
+}
+
+// The kernel for rows of T, chosen once per type.
+template <typename T>
+Kernel<T> const& kernel()
+{
+    static Kernel<T> const k = selectKernel<T>(HasVectorKernels<T>());
+    return k;
+}
+
+// Cut flags of 8 consecutive edges starting at i, one per byte in bit 0.
+// Bit 0 of a case differs from bit 1 if the x-edge is cut and differs from
+// bit 0 of the neighbouring row if the y or z edge is cut.
+inline uint64_t
+cutWord(const uchar* ec, const uchar* ecY, const uchar* ecZ, size_t i)
+{
+    uint64_t const lowBits = 0x0101010101010101ull;
+
+    uint64_t e;
+    std::memcpy(&e, ec + i, 8);
+
+    uint64_t cut = e ^ (e >> 1);
+    if(ecY)
+    {
+        uint64_t y;
+        std::memcpy(&y, ecY + i, 8);
+        cut |= e ^ y;
+    }
+    if(ecZ)
+    {
+        uint64_t z;
+        std::memcpy(&z, ecZ + i, 8);
+        cut |= e ^ z;
+    }
+    return cut & lowBits;
+}
+
+inline bool
+isCutEdge(const uchar* ec, const uchar* ecY, const uchar* ecZ, size_t i)
+{
+    uchar cut = ec[i] ^ (ec[i] >> 1);
+    if(ecY)
+        cut |= ec[i] ^ ecY[i];
+    if(ecZ)
+        cut |= ec[i] ^ ecZ[i];
+    return cut & 1;
+}
+
+// Byte index of the first and last non-zero byte of a non-zero word. The
+// words are loaded with memcpy on a little-endian host.
+inline size_t firstByte(uint64_t word)
+{
+    return __builtin_ctzll(word) / 8;
+}
+
+inline size_t lastByte(uint64_t word)
+{
+    return 7 - __builtin_clzll(word) / 8;
+}
+
+// Packs 8 edge cases, one per byte, into the low 16 bits of a word.
+inline uint64_t packEdgeCases8(const uchar* cases)
+{
+    uint64_t x;
+    std::memcpy(&x, cases, 8);
+
+    x = (x | (x >> 6))  & 0x000f000f000f000full;
+    x = (x | (x >> 12)) & 0x000000ff000000ffull;
+    x = (x | (x >> 24)) & 0x000000000000ffffull;
+    return x;
+}
+
+// Same as cutWord for 32 packed edge cases. The cut flag of edge n is bit 2n.
+inline uint64_t
+cutWordPacked(
+    const uint64_t* ec, const uint64_t* ecY, const uint64_t* ecZ, size_t w)
+{
+    uint64_t const lowBits = 0x5555555555555555ull;
+
+    uint64_t const e = ec[w];
+    uint64_t cut = e ^ (e >> 1);
+    if(ecY)
+        cut |= e ^ ecY[w];
+    if(ecZ)
+        cut |= e ^ ecZ[w];
+    return cut & lowBits;
+}
+
+// Integers that scalar_t holds exactly, such as 8 and 16 bit values.
+template <typename T>
+using ExactInScalar = std::integral_constant<bool,
+    std::is_integral<T>::value &&
+    std::numeric_limits<T>::digits <= std::numeric_limits<scalar_t>::digits>;
+
+// Classifies values of other types than scalar_t the same way as if they
+// had been converted to scalar_t first.
+template <typename T>
+void
+classifyEdgesOf(
+    const T* row, size_t nx, scalar_t isoval, uchar* edgeCases,
+    std::true_type)
+{
+    // An integer is >= isoval exactly when it is >= ceil(isoval), so the
+    // values are compared in T without converting them.
+    double const threshold = std::ceil(double(isoval));
+    if(!(threshold <= double(std::numeric_limits<T>::max())))
+    {
+        // Every value is below a larger or NaN isoval.
+        std::fill(edgeCases, edgeCases + nx-1, 3);
+        return;
+    }
+    if(threshold <= double(std::numeric_limits<T>::lowest()))
+    {
+        std::fill(edgeCases, edgeCases + nx-1, 0);
+        return;
+    }
+
+    kernel<T>().func(row, nx, T(threshold), edgeCases);
+}
+
+template <typename T>
+void
+classifyEdgesOf(
+    const T* row, size_t nx, scalar_t isoval, uchar* edgeCases,
+    std::false_type)
+{
+    for(size_t i = 0; i != nx-1; ++i)
+    {
+        uchar left  = !(scalar_t(row[i]) >= isoval);
+        uchar right = !(scalar_t(row[i+1]) >= isoval);
+        edgeCases[i] = left | (right << 1);
+    }
+}
+
+template <typename T>
+void
+classifyEdgesNative(
+    const T* row, size_t nx, scalar_t isoval, uchar* edgeCases)
+{
+    classifyEdgesOf(row, nx, isoval, edgeCases, ExactInScalar<T>());
+}
+
+// Classifies a row with classify into packed edge cases.
+template <typename T, typename Classify>
+void
+classifyEdgesPacked(
+    const T* row, size_t nx, scalar_t isoval, uint64_t* edgeCases,
+    Classify classify)
+{
+    // The row is classified a block at a time into bytes on the stack and
+    // then packed. The block is a multiple of the vector kernel widths.
+    size_t const blockSize = 256;
+    uchar cases[blockSize];
+
+    size_t const nEdges = nx - 1;
+    for(size_t i = 0; i < nEdges; i += blockSize)
+    {
+        size_t const n = std::min(blockSize, nEdges - i);
+        size_t const nWords = (n + 31) / 32;
+
+        classify(row + i, n + 1, isoval, cases);
+        std::fill(cases + n, cases + 32*nWords, 0);
+
+        uint64_t* out = edgeCases + i / 32;
+        for(size_t w = 0; w != nWords; ++w)
+        {
+            const uchar* c = cases + 32*w;
+            out[w] = packEdgeCases8(c)             |
+                     (packEdgeCases8(c + 8)  << 16) |
+                     (packEdgeCases8(c + 16) << 32) |
+                     (packEdgeCases8(c + 24) << 48);
+        }
+    }
+}
+
+} // anonymous namespace
+
+void
+classifyEdges(
+    const scalar_t* row, size_t nx, scalar_t isoval, uchar* edgeCases)
+{
+    kernel<scalar_t>().func(row, nx, isoval, edgeCases);
+}
+
+void
+classifyEdges(
+    const scalar_t* row, size_t nx, scalar_t isoval, uint64_t* edgeCases)
+{
+    classifyEdgesPacked(row, nx, isoval, edgeCases,
+                        kernel<scalar_t>().func);
+}
+
+template <typename T>
+void
+classifyEdges(
+    const T* row, size_t nx, scalar_t isoval, uchar* edgeCases)
+{
+    classifyEdgesNative(row, nx, isoval, edgeCases);
+}
+
+template <typename T>
+void
+classifyEdges(
+    const T* row, size_t nx, scalar_t isoval, uint64_t* edgeCases)
+{
+    classifyEdgesPacked(row, nx, isoval, edgeCases,
+                        &classifyEdgesNative<T>);
+}
+
+// The other scalar types an image file can hold, see TypeInfo.h
+#define FE_CLASSIFY_EDGES(T)                                                \
+    template void classifyEdges<T>(                                         \
+        const T*, size_t, scalar_t, uchar*);                                \
+    template void classifyEdges<T>(                                         \
+        const T*, size_t, scalar_t, uint64_t*);
+
+FE_CLASSIFY_EDGES(char)
+FE_CLASSIFY_EDGES(unsigned char)
+FE_CLASSIFY_EDGES(short)
+FE_CLASSIFY_EDGES(unsigned short)
+FE_CLASSIFY_EDGES(int)
+FE_CLASSIFY_EDGES(double)
+
+#undef FE_CLASSIFY_EDGES
+
+// Other types than scalar_t that scalar_t doesn't hold exactly are converted
+// one value at a time, see classifyEdgesOf.
+template <typename T>
+const char* edgeCaseKernelName()
+{
+    return kernel<T>().name;
+}
+
+template const char* edgeCaseKernelName<char>();
+template const char* edgeCaseKernelName<unsigned char>();
+template const char* edgeCaseKernelName<short>();
+template const char* edgeCaseKernelName<unsigned short>();
+template const char* edgeCaseKernelName<int>();
+template const char* edgeCaseKernelName<float>();
+template const char* edgeCaseKernelName<double>();
+
+void
+findTrim(
+    const uchar* ec, const uchar* ecY, const uchar* ecZ, size_t nx,
+    size_t& xl, size_t& xr)
+{
+    size_t const nEdges = nx - 1;
+    size_t const nWords = nEdges / 8;
+
+    xl = nx;
+    xr = 0;
+
+    // Search forward for the first cut edge, 8 edges at a time.
+    size_t i = 0;
+    for(size_t w = 0; w != nWords; ++w, i += 8)
+    {
+        uint64_t cut = cutWord(ec, ecY, ecZ, i);
+        if(cut)
+        {
+            xl = i + firstByte(cut);
+            break;
+        }
+    }
+    if(xl == nx)
+    {
+        for(; i != nEdges; ++i)
+        {
+            if(isCutEdge(ec, ecY, ecZ, i))
+            {
+                xl = i;
+                break;
+            }
+        }
+    }
+
+    if(xl == nx)
+        return;
+
+    // Search backward for the last cut edge. It's at or after xl, so
+    // together with the forward search each edge is looked at once.
+    for(size_t j = nEdges; j != nWords*8; --j)
+    {
+        if(isCutEdge(ec, ecY, ecZ, j-1))
+        {
+            xr = j;
+            return;
+        }
+    }
+    for(size_t w = nWords; w != 0; --w)
+    {
+        uint64_t cut = cutWord(ec, ecY, ecZ, 8*(w-1));
+        if(cut)
+        {
+            xr = 8*(w-1) + lastByte(cut) + 1;
+            return;
+        }
+    }
+}
+
+void
+findTrim(
+    const uint64_t* ec, const uint64_t* ecY, const uint64_t* ecZ, size_t nx,
+    size_t& xl, size_t& xr)
+{
+    // The bits past the last edge are 0 in every row so they're never cut.
+    size_t const nWords = (nx - 1 + 31) / 32;
+
+    xl = nx;
+    xr = 0;
+
+    size_t first = 0;
+    for(; first != nWords; ++first)
+    {
+        uint64_t cut = cutWordPacked(ec, ecY, ecZ, first);
+        if(cut)
+        {
+            xl = 32*first + __builtin_ctzll(cut) / 2;
+            break;
+        }
+    }
+
+    if(xl == nx)
+        return;
+
+    for(size_t w = nWords; w != first; --w)
+    {
+        uint64_t cut = cutWordPacked(ec, ecY, ecZ, w-1);
+        if(cut)
+        {
+            xr = 32*(w-1) + (63 - __builtin_clzll(cut)) / 2 + 1;
+            return;
+        }
+    }
+}
+
+}
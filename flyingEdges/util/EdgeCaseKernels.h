@@ -0,0 +1,105 @@
+/*
+ * EdgeCaseKernels.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef EDGECASEKERNELS_H_
+#define EDGECASEKERNELS_H_
+
+#include <cstdint>
+
+#include "FlyingEdges_Config.h"
+
+namespace util {
+
+// With FE_COMPACT defined, edge cases are packed 2 bits apiece, 32 to a
+// word. Each row of edge cases starts on a new word and the bits past the
+// last edge of a row are 0. Otherwise there is one edge case per byte.
+#ifdef FE_COMPACT
+using edgeCaseWord_t = uint64_t;
+#else
+using edgeCaseWord_t = uchar;
+#endif
+
+// The number of words holding the nx-1 edge cases of a row of nx points.
+inline size_t edgeCaseRowSize(size_t nx)
+{
+#ifdef FE_COMPACT
+    return (nx - 1 + 31) / 32;
+#else
+    return nx - 1;
+#endif
+}
+
+// Edge case i of a row stored as above.
+inline uchar getEdgeCase(const uchar* row, size_t i)
+{
+    return row[i];
+}
+
+inline uchar getEdgeCase(const uint64_t* row, size_t i)
+{
+    return (row[i / 32] >> (2 * (i % 32))) & 3;
+}
+
+// Fills edgeCases[0, nx-1) with the case of each x-edge along a row of nx
+// scalar values:
+//   case 0: (i) o-----o (i+1)
+//   case 1: (i) x-----o (i+1)
+//   case 2: (i) o-----x (i+1)
+//   case 3: (i) x-----x (i+1)
+// where o is greater than or equal to isoval and x is not. Bit 0 of a case
+// is set when the left vertex is below isoval, bit 1 when the right one is.
+//
+// The kernel is chosen once at runtime from what the cpu supports: AVX-512,
+// AVX2 or a plain C++ loop.
+void classifyEdges(
+    const scalar_t* row, size_t nx, scalar_t isoval, uchar* edgeCases);
+
+// Same as above but the edge cases are packed into edgeCaseRowSize(nx)
+// words.
+void classifyEdges(
+    const scalar_t* row, size_t nx, scalar_t isoval, uint64_t* edgeCases);
+
+// Same as above for rows of the other scalar types an image file can hold.
+// The cases are those of the values converted to scalar_t. Integers that
+// scalar_t holds exactly are compared without converting them, with the
+// same kinds of kernels as above for 8 and 16 bit integers.
+template <typename T>
+void classifyEdges(
+    const T* row, size_t nx, scalar_t isoval, uchar* edgeCases);
+
+template <typename T>
+void classifyEdges(
+    const T* row, size_t nx, scalar_t isoval, uint64_t* edgeCases);
+
+// The name of the kernel classifyEdges dispatches to for rows of T.
+template <typename T>
+const char* edgeCaseKernelName();
+
+// Finds the trim values of a row of nx points given its edge cases, ec, and
+// the edge cases of the next row in y, ecY, and in z, ecZ. Either of ecY and
+// ecZ is null if the row is on the last y or z boundary. Edge i counts as cut
+// if the x-edge (i, i+1) is cut or the y or z edge at vertex i is cut.
+//   xl is the first cut edge
+//   xr is one past the last cut edge
+// If no edge is cut, xl = nx and xr = 0.
+void findTrim(
+    const uchar* ec, const uchar* ecY, const uchar* ecZ, size_t nx,
+    size_t& xl, size_t& xr);
+
+// Same as above for packed edge cases.
+void findTrim(
+    const uint64_t* ec, const uint64_t* ecY, const uint64_t* ecZ, size_t nx,
+    size_t& xl, size_t& xr);
+
+}
+
+#endif
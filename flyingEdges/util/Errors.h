@@ -68,6 +68,26 @@ private:
     const char* const message;
 };
 
+class offset_overflow: public std::exception {
+public:
+    offset_overflow(const char* const inMessage) :
+        message(inMessage) {
+            std::cout << "Offset overflow: " << inMessage << std::endl;
+    }
+private:
+    const char* const message;
+};
+
+class index_overflow: public std::exception {
+public:
+    index_overflow(const char* const inMessage) :
+        message(inMessage) {
+            std::cout << "Index overflow: " << inMessage << std::endl;
+    }
+private:
+    const char* const message;
+};
+
 } // util namespace
 
 #endif
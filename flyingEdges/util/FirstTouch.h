@@ -0,0 +1,123 @@
+/*
+ * FirstTouch.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef FIRSTTOUCH_H_
+#define FIRSTTOUCH_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <string.h>
+
+namespace util {
+
+// Linux places a page on the NUMA node of the thread that first writes to
+// it, not of the thread that allocates it.
+enum class Placement
+{
+    serial,    // Buffers are zeroed by one thread when they are made, so
+               // all of their pages land on its node.
+    firstTouch // Buffers are first written by the threads that work on
+               // them in the passes, splitting their rows the same way.
+};
+
+inline const char* placementName(Placement placement)
+{
+    switch(placement)
+    {
+    case Placement::serial:
+        return "serial";
+    case Placement::firstTouch:
+        return "firsttouch";
+    }
+    return "";
+}
+
+// Reads "serial" or "firsttouch" into placement. Returns false if name is
+// neither of them.
+inline bool parsePlacement(const char* name, Placement& placement)
+{
+    for(Placement p : { Placement::serial, Placement::firstTouch })
+    {
+        if(strcmp(name, placementName(p)) == 0)
+        {
+            placement = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// An allocator that default-initializes instead of value-initializing, so
+// growing a vector of trivial values leaves them unwritten.
+template <typename T>
+class DefaultInitAllocator : public std::allocator<T>
+{
+public:
+    template <typename U>
+    struct rebind
+    {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    DefaultInitAllocator() noexcept
+    {}
+
+    template <typename U>
+    DefaultInitAllocator(DefaultInitAllocator<U> const&) noexcept
+    {}
+
+    template <typename U>
+    void construct(U* p)
+    {
+        ::new(static_cast<void*>(p)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+// A vector whose new elements are left uninitialized, so none of its pages
+// are touched until something writes to them.
+template <typename T>
+using FirstTouchVector = std::vector<T, DefaultInitAllocator<T> >;
+
+// Sets numRows rows of rowSize values at data to value. With
+// Placement::firstTouch the rows are split among the threads the way the
+// passes split them, so each page lands on the node of the thread that
+// works on it.
+template <typename T>
+void firstTouch(T* data, std::size_t numRows, std::size_t rowSize,
+                T const& value, Placement placement)
+{
+    std::size_t r;
+#ifdef _OPENMP
+    #pragma omp parallel for if(placement == Placement::firstTouch)
+#else
+    (void)placement;
+#endif
+    for(r = 0; r < numRows; r++)
+    {
+        std::fill(data + r*rowSize, data + (r + 1)*rowSize, value);
+    }
+}
+
+} // util namespace
+
+#endif
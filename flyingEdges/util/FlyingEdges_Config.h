@@ -14,6 +14,7 @@
 #define FLYINGEDGES_CONFIG_H_
 
 #include <array>
+#include <cstdint>
 
 using std::size_t;
 
@@ -21,6 +22,23 @@ using scalar_t = float;
 
 using uchar = unsigned char;
 
+// With FE_COMPACT defined, the starting offsets in gridEdge and triCounter
+// are kept in 32 bits. The algorithm throws if the mesh needs more.
+#ifdef FE_COMPACT
+using offset_t = uint32_t;
+#else
+using offset_t = size_t;
+#endif
+
+// With MESH_INDEX32 defined, the point indices of the triangles in the
+// output mesh and the output file are 32 bits. The algorithm throws if the
+// mesh has more points.
+#ifdef MESH_INDEX32
+using index_t = uint32_t;
+#else
+using index_t = size_t;
+#endif
+
 using cube_t = std::array<std::array<scalar_t, 3>, 8>;
 using scalarCube_t = std::array<scalar_t, 8>;
 
@@ -0,0 +1,182 @@
+/*
+ * GradientProvider.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#include "GradientProvider.h"
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+namespace util {
+
+const char* gradientModeName(GradientMode mode)
+{
+    switch(mode)
+    {
+    case GradientMode::onTheFly:
+        return "onthefly";
+    case GradientMode::rolling:
+        return "rolling";
+    case GradientMode::precomputed:
+        return "precomputed";
+    }
+    return "";
+}
+
+bool parseGradientMode(const char* name, GradientMode& mode)
+{
+    for(GradientMode m : { GradientMode::onTheFly,
+                           GradientMode::rolling,
+                           GradientMode::precomputed })
+    {
+        if(strcmp(name, gradientModeName(m)) == 0)
+        {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+GradientMode chooseGradientMode(
+    size_t nx, size_t ny, size_t nz, size_t numReaders, size_t memoryBudget)
+{
+    size_t const gradientBytes = sizeof(std::array<scalar_t, 3>);
+    size_t const cachedBytes = gradientBytes + sizeof(uint32_t);
+
+    // The rolling caches never compute a gradient that isn't used and
+    // compute each one at most once per reader, so they're preferred over
+    // precomputing the whole image even if that fits too.
+    if(numReaders*2*nx*ny*cachedBytes <= memoryBudget)
+        return GradientMode::rolling;
+    if(nx*ny*nz*gradientBytes <= memoryBudget)
+        return GradientMode::precomputed;
+    return GradientMode::onTheFly;
+}
+
+template <typename T>
+BasicGradientProvider<T>::BasicGradientProvider(
+    BasicImage3D<T> const& image, GradientMode mode)
+  : image(image),
+    gradMode(mode),
+    nx(image.xdimension()),
+    ny(image.ydimension()),
+    nz(image.zdimension())
+{
+    if(gradMode == GradientMode::precomputed)
+    {
+        volume.resize(nx*ny*nz);
+
+        // Each thread fills whole slices.
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for(size_t k = 0; k < nz; ++k) {
+        for(size_t j = 0; j != ny; ++j) {
+        for(size_t i = 0; i != nx; ++i)
+        {
+            volume[k*nx*ny + j*nx + i] = image.getGradient(i, j, k);
+        }}}
+    }
+}
+
+template <typename T>
+BasicGradientProvider<T>::Reader::Reader(
+    BasicGradientProvider const& provider)
+  : provider(provider),
+    generation(0)
+{
+    sliceK.fill(std::numeric_limits<size_t>::max());
+    sliceGeneration.fill(0);
+
+    if(provider.gradMode == GradientMode::rolling)
+    {
+        for(int s = 0; s != 2; ++s)
+        {
+            cache[s].resize(provider.nx * provider.ny);
+            stamps[s].resize(provider.nx * provider.ny, 0);
+        }
+    }
+}
+
+template <typename T>
+std::array<scalar_t, 3>
+BasicGradientProvider<T>::Reader::getGradient(size_t i, size_t j, size_t k)
+{
+    switch(provider.gradMode)
+    {
+    case GradientMode::onTheFly:
+        return provider.image.getGradient(i, j, k);
+    case GradientMode::precomputed:
+        return provider.volume[k*provider.nx*provider.ny + j*provider.nx + i];
+    case GradientMode::rolling:
+        break;
+    }
+    return getCachedGradient(getSlice(k), i, j);
+}
+
+template <typename T>
+size_t BasicGradientProvider<T>::Reader::getSlice(size_t k)
+{
+    if(sliceK[0] == k)
+        return 0;
+    if(sliceK[1] == k)
+        return 1;
+
+    // The slice furthest from k is replaced. The image is swept in z, so
+    // it's the one least likely to be used again.
+    auto distance = [k](size_t other) {
+        return (other > k) ? other - k : k - other;
+    };
+    size_t s = (distance(sliceK[0]) > distance(sliceK[1])) ? 0 : 1;
+
+    // Start a new generation. When the counter wraps around, old stamps
+    // could match again, so they're cleared and neither slice is cached.
+    if(++generation == 0)
+    {
+        for(int t = 0; t != 2; ++t)
+        {
+            std::fill(stamps[t].begin(), stamps[t].end(), 0);
+            sliceGeneration[t] = 0;
+        }
+        sliceK.fill(std::numeric_limits<size_t>::max());
+        generation = 1;
+    }
+
+    sliceK[s] = k;
+    sliceGeneration[s] = generation;
+    return s;
+}
+
+template <typename T>
+std::array<scalar_t, 3> const&
+BasicGradientProvider<T>::Reader::getCachedGradient(size_t s, size_t i, size_t j)
+{
+    size_t idx = j*provider.nx + i;
+    if(stamps[s][idx] != sliceGeneration[s])
+    {
+        cache[s][idx] = provider.image.getGradient(i, j, sliceK[s]);
+        stamps[s][idx] = sliceGeneration[s];
+    }
+    return cache[s][idx];
+}
+
+// The scalar types an image file can hold, see TypeInfo.h
+template class BasicGradientProvider<char>;
+template class BasicGradientProvider<unsigned char>;
+template class BasicGradientProvider<short>;
+template class BasicGradientProvider<unsigned short>;
+template class BasicGradientProvider<int>;
+template class BasicGradientProvider<float>;
+template class BasicGradientProvider<double>;
+
+}
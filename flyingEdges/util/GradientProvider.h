@@ -0,0 +1,104 @@
+/*
+ * GradientProvider.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef GRADIENTPROVIDER_H_
+#define GRADIENTPROVIDER_H_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "FlyingEdges_Config.h"
+
+#include "Image3D.h"
+
+namespace util {
+
+// How the gradients at the points of the image are found. All modes give
+// the same values as Image3D::getGradient.
+enum class GradientMode
+{
+    onTheFly,   // Computed each time they're used, 6 reads per point.
+    rolling,    // Cached for the two most recently used z slices. Each
+                // point is computed the first time it is used.
+    precomputed // Computed for the whole image up front.
+};
+
+const char* gradientModeName(GradientMode mode);
+
+// Reads "onthefly", "rolling" or "precomputed" into mode. Returns false if
+// name is none of them.
+bool parseGradientMode(const char* name, GradientMode& mode);
+
+// The mode to use given memoryBudget bytes for gradients: numReaders
+// rolling caches if they fit, else the precomputed gradients of the whole
+// image if they fit, else nothing extra. Precomputing is only worth it when
+// most of the image is near the surface, so it's best asked for directly.
+GradientMode chooseGradientMode(
+    size_t nx, size_t ny, size_t nz, size_t numReaders, size_t memoryBudget);
+
+// Gradients of an image of scalar values of type T. The gradients are
+// scalar_t whatever T is.
+template <typename T>
+class BasicGradientProvider
+{
+public:
+    // In precomputed mode, the gradients of the whole image are computed
+    // here.
+    BasicGradientProvider(BasicImage3D<T> const& image, GradientMode mode);
+
+    GradientMode mode() const { return gradMode; }
+
+    // Gradients are read through a Reader. A reader holds the rolling
+    // cache, so each thread needs its own.
+    class Reader
+    {
+    public:
+        Reader(BasicGradientProvider const& provider);
+
+        std::array<scalar_t, 3> getGradient(size_t i, size_t j, size_t k);
+
+    private:
+        size_t getSlice(size_t k);
+
+        std::array<scalar_t, 3> const&
+        getCachedGradient(size_t slice, size_t i, size_t j);
+
+    private:
+        BasicGradientProvider const& provider;
+
+        // Rolling cache. cache[s] holds the gradients of slice sliceK[s].
+        // A gradient is valid if its stamp is the generation of the slice,
+        // so moving to another slice doesn't clear anything.
+        std::array<std::vector<std::array<scalar_t, 3> >, 2> cache;
+        std::array<std::vector<uint32_t>, 2> stamps;
+        std::array<size_t, 2> sliceK;
+        std::array<uint32_t, 2> sliceGeneration;
+        uint32_t generation;
+    };
+
+private:
+    BasicImage3D<T> const& image;
+    GradientMode const gradMode;
+
+    size_t const nx;
+    size_t const ny;
+    size_t const nz;
+
+    std::vector<std::array<scalar_t, 3> > volume; // precomputed mode only
+};
+
+using GradientProvider = BasicGradientProvider<scalar_t>;
+
+}
+
+#endif
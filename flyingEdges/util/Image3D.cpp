@@ -17,14 +17,16 @@
 
 namespace util {
 
-std::vector<scalar_t>::const_iterator
-Image3D::getRowIter(size_t j, size_t k) const
+template <typename T>
+typename FirstTouchVector<T>::const_iterator
+BasicImage3D<T>::getRowIter(size_t j, size_t k) const
 {
     return data.cbegin() + nx*(k*ny + j);
 }
 
+template <typename T>
 scalarCube_t
-Image3D::getValsCube(size_t i, size_t j, size_t k) const
+BasicImage3D<T>::getValsCube(size_t i, size_t j, size_t k) const
 {
     scalarCube_t vals;
 
@@ -42,14 +44,15 @@ Image3D::getValsCube(size_t i, size_t j, size_t k) const
     return vals;
 }
 
+template <typename T>
 cube_t
-Image3D::getPosCube(size_t i, size_t j, size_t k) const
+BasicImage3D<T>::getPosCube(size_t i, size_t j, size_t k) const
 {
     cube_t pos;
 
     scalar_t xpos = zeroPos[0] + i * spacing[0];
     scalar_t ypos = zeroPos[1] + j * spacing[1];
-    scalar_t zpos = zeroPos[2] + k * spacing[2];
+    scalar_t zpos = zeroPos[2] + (k + zOffset) * spacing[2];
 
     pos[0][0] = xpos;
     pos[0][1] = ypos;
@@ -86,8 +89,9 @@ Image3D::getPosCube(size_t i, size_t j, size_t k) const
     return pos;
 }
 
+template <typename T>
 cube_t
-Image3D::getGradCube(size_t i, size_t j, size_t k) const
+BasicImage3D<T>::getGradCube(size_t i, size_t j, size_t k) const
 {
     cube_t grad;
 
@@ -107,14 +111,16 @@ Image3D::getGradCube(size_t i, size_t j, size_t k) const
 // Private helper functions
 //////////////////////////////////////////////////////////////////////////////
 
+template <typename T>
 inline scalar_t
-Image3D::getData(size_t i, size_t j, size_t k) const
+BasicImage3D<T>::getData(size_t i, size_t j, size_t k) const
 {
     return data[k*nx*ny + j*nx + i];
 }
 
+template <typename T>
 std::array<scalar_t, 3>
-Image3D::computeGradient(size_t i, size_t j, size_t k) const
+BasicImage3D<T>::computeGradient(size_t i, size_t j, size_t k) const
 {
     std::array<std::array<scalar_t, 2>, 3> x;
     std::array<scalar_t, 3> run;
@@ -189,4 +195,13 @@ Image3D::computeGradient(size_t i, size_t j, size_t k) const
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// The scalar types an image file can hold, see TypeInfo.h
+template class BasicImage3D<char>;
+template class BasicImage3D<unsigned char>;
+template class BasicImage3D<short>;
+template class BasicImage3D<unsigned short>;
+template class BasicImage3D<int>;
+template class BasicImage3D<float>;
+template class BasicImage3D<double>;
+
 }
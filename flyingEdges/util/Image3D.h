@@ -17,26 +17,38 @@
 #define IMAGE3DREADER_H_
 
 #include "FlyingEdges_Config.h"
+#include "FirstTouch.h"
 
 #include <vector>
 #include <array>
+#include <utility>
 
 namespace util {
 
-class Image3D
+// An image of scalar values of type T. The values are kept as they are in
+// the file and converted to scalar_t when they are read, so an image of
+// 8 or 16 bit values takes a quarter or half of the memory it would as
+// scalar_t. Positions and gradients are always scalar_t.
+template <typename T>
+class BasicImage3D
 {
 public:
+    using value_type = T;
+
     // This constructor is used to construct an image of size
-    // dimensions.
-    Image3D(std::vector<scalar_t> data,
+    // dimensions. If the image is a slab of z slices of a larger image,
+    // zOffset is the index of its first slice in the larger image.
+    BasicImage3D(FirstTouchVector<T> data,
             std::array<scalar_t, 3> spacing,
             std::array<scalar_t, 3> zeroPos,
-            std::array<size_t, 3> dimensions)
-      : data(data), spacing(spacing), zeroPos(zeroPos),
-        nx(dimensions[0]), ny(dimensions[1]), nz(dimensions[2])
+            std::array<size_t, 3> dimensions,
+            size_t zOffset = 0)
+      : data(std::move(data)), spacing(spacing), zeroPos(zeroPos),
+        nx(dimensions[0]), ny(dimensions[1]), nz(dimensions[2]),
+        zOffset(zOffset)
     {}
 
-    std::vector<scalar_t>::const_iterator
+    typename FirstTouchVector<T>::const_iterator
     getRowIter(size_t j, size_t k) const;
 
     scalarCube_t getValsCube(size_t i, size_t j, size_t k) const;
@@ -45,7 +57,13 @@ public:
 
     cube_t getGradCube(size_t i, size_t j, size_t k) const;
 
-    const scalar_t* pointer() const { return data.data(); }
+    // The gradient at point (i, j, k)
+    std::array<scalar_t, 3> getGradient(size_t i, size_t j, size_t k) const
+    {
+        return computeGradient(i, j, k);
+    }
+
+    const T* pointer() const { return data.data(); }
 
     std::array<scalar_t, 3> getZeroPos() const { return zeroPos; }
     std::array<scalar_t, 3> getSpacing() const { return spacing; }
@@ -53,11 +71,12 @@ public:
     size_t xdimension() const { return nx; }
     size_t ydimension() const { return ny; }
     size_t zdimension() const { return nz; }
+    size_t zoffset() const { return zOffset; }
 
     void cutDown(int const& numX)
     {
         nx = numX;
-        std::vector<scalar_t> newData(nx*ny*nz);
+        FirstTouchVector<T> newData(nx*ny*nz);
         std::copy(data.begin(), data.begin() + nx*ny*nz,
                   newData.begin());
         data = newData;
@@ -71,7 +90,7 @@ private:
     computeGradient(size_t i, size_t j, size_t k) const;
 
 private:
-    std::vector<scalar_t>    data;       // A vector containing scalar values
+    FirstTouchVector<T> data;           // A vector containing scalar values
                                         // along three-dimensional space.
 
     std::array<scalar_t, 3>  spacing;    // The distance between two points in
@@ -82,8 +101,13 @@ private:
     size_t                  nx;         //
     size_t                  ny;         // The dimensions
     size_t                  nz;         //
+
+    size_t                  zOffset;    // The z index of the first slice
+                                        // in the whole image.
 };
 
+using Image3D = BasicImage3D<scalar_t>;
+
 }
 
 #endif
@@ -8,19 +8,26 @@
 #ifndef IOIOIO_H_
 #define IOIOIO_H_
 
+#include <algorithm>
 #include <array>
 #include <vector>
 #include <string>
+#include <utility>
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "FlyingEdges_Config.h"
 
+#include "FirstTouch.h"
 #include "Image3D.h"
 #include "TypeInfo.h"
 #include "ConvertBuffer.h"
+#include "ReadRows.h"
 
 namespace util {
 
@@ -165,8 +172,75 @@ streamIgnore(std::ifstream& stream, size_t nPoints, std::size_t pointSize)
     }
 }
 
-Image3D
-loadImage(const char* file)
+// Reads numRows rows of rowSize values of type ti from fd, starting at
+// offset, and converts them to T into data with readRowChunks. When T is the
+// type of the file, each chunk is read straight into data and flipped there.
+// Returns false if the file is too short.
+template <typename T>
+bool
+readRows(int fd, off_t offset, TypeInfo const& ti,
+         std::size_t rowSize, std::size_t numRows, T* data, bool parallel)
+{
+    bool const sameType =
+        ti.getId() == createTemplateTypeInfo<T>().getId() &&
+        ti.size() == sizeof(T);
+    char* inPlace = sameType ? reinterpret_cast<char*>(data) : nullptr;
+
+    return readRowChunks(
+        fd, offset, rowSize * ti.size(), numRows, inPlace, parallel,
+        [&](char* in, std::size_t row, std::size_t n)
+        {
+            convertBufferWithTypeInfo(in, ti, n * rowSize,
+                                      data + row * rowSize);
+        });
+}
+
+// Opens file with POSIX I/O and reads the image values after its header
+// into data with readRows.
+template <typename T>
+void
+readValues(const char* file, off_t offset, TypeInfo const& ti,
+           std::size_t rowSize, std::size_t numRows, T* data,
+           bool parallel)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        throw file_not_found(file);
+
+    bool complete = readRows(fd, offset, ti, rowSize, numRows, data,
+                             parallel);
+    close(fd);
+
+    if (!complete)
+    {
+        throw bad_format("Fewer values than POINT_DATA");
+    }
+}
+
+// The scalar type of the values of an image file
+TypeInfo
+loadScalarType(const char* file)
+{
+    std::ifstream stream(file);
+    if (!stream)
+        throw file_not_found(file);
+
+    std::array<size_t, 3> dim;
+    std::array<scalar_t, 3> spacing;
+    std::array<scalar_t, 3> zeroPos;
+    size_t npoints;
+
+    TypeInfo ti;
+    loadHeader(stream, dim, spacing, zeroPos, npoints, ti);
+    return ti;
+}
+
+// Loads an image converting its values to T. With Placement::firstTouch,
+// the rows of the image are read and converted in parallel, so their pages
+// land on the nodes of the threads that read them in the passes.
+template <typename T>
+BasicImage3D<T>
+loadImageAs(const char* file, Placement placement = Placement::serial)
 {
     std::ifstream stream(file);
     if (!stream)
@@ -182,19 +256,57 @@ loadImage(const char* file)
     // These variables are all taken by reference
     loadHeader(stream, dim, spacing, zeroPos, npoints, ti);
 
-    std::size_t bufsize = npoints * ti.size();
-    std::vector<char> rbuf(bufsize);
-    stream.read(rbuf.data(), bufsize);
+    if (npoints != dim[0] * dim[1] * dim[2])
+    {
+        throw bad_format("POINT_DATA does not match DIMENSIONS");
+    }
 
-    std::vector<scalar_t> data(dim[0] * dim[1] * dim[2]);
+    // The values start right after the header
+    off_t offset = stream.tellg();
+    stream.close();
 
-    // Converts elements in the charachter vector to elements of type
-    // T and puts them into data.
-    convertBufferWithTypeInfo(rbuf.data(), ti, npoints, data.data());
+    // data is not zeroed first. Each row is first written when it is read.
+    FirstTouchVector<T> data(npoints);
+    readValues(file, offset, ti, dim[0], dim[1] * dim[2], data.data(),
+               placement == Placement::firstTouch);
 
-    stream.close();
+    return BasicImage3D<T>(std::move(data), spacing, zeroPos, dim);
+}
 
-    return Image3D(data, spacing, zeroPos, dim);
+// Loads an image converting its values to scalar_t.
+Image3D
+loadImage(const char* file, Placement placement = Placement::serial)
+{
+    return loadImageAs<scalar_t>(file, placement);
+}
+
+// Loads an image keeping the scalar type of its file and calls
+// visit(image) with it, so visit is instantiated for each type. Returns
+// what visit returns.
+template <typename Visitor>
+auto
+visitImage(const char* file, Visitor&& visit,
+           Placement placement = Placement::serial)
+    -> decltype(visit(std::declval<Image3D const&>()))
+{
+    TypeInfo ti = loadScalarType(file);
+    switch (ti.getId())
+    {
+    case TypeInfo::ID_CHAR:
+        return visit(loadImageAs<char>(file, placement));
+    case TypeInfo::ID_UCHAR:
+        return visit(loadImageAs<unsigned char>(file, placement));
+    case TypeInfo::ID_SHORT:
+        return visit(loadImageAs<short>(file, placement));
+    case TypeInfo::ID_USHORT:
+        return visit(loadImageAs<unsigned short>(file, placement));
+    case TypeInfo::ID_INT:
+        return visit(loadImageAs<int>(file, placement));
+    case TypeInfo::ID_DOUBLE:
+        return visit(loadImageAs<double>(file, placement));
+    default:
+        return visit(loadImageAs<scalar_t>(file, placement));
+    }
 }
 
 void loadImage_thrust(
@@ -224,17 +336,12 @@ void loadImage_thrust(
     // These variables are all taken by reference
     loadHeader(stream, dim, spacing, zeroPos, npoints, ti);
 
-    std::size_t bufsize = npoints * ti.size();
-    std::vector<char> rbuf(bufsize);
-    stream.read(rbuf.data(), bufsize);
+    // The values start right after the header
+    off_t offset = stream.tellg();
+    stream.close();
 
     data.resize(dim[0] * dim[1] * dim[2]);
-
-    // Converts elements in the charachter vector to elements of type
-    // T and puts them into data.
-    convertBufferWithTypeInfo(rbuf.data(), ti, npoints, data.data());
-
-    stream.close();
+    readValues(file, offset, ti, dim[0], dim[1] * dim[2], data.data(), true);
 
     spacingX = spacing[0];
     spacingY = spacing[1];
@@ -247,6 +354,88 @@ void loadImage_thrust(
     nz = dim[2];
 }
 
+// Loads an image a slab of z slices at a time so that only the slab has to
+// fit in memory. Slabs are read in increasing z. Each slab may start on one
+// of the last 'overlap' slices of the slab before it. Those slices are kept
+// instead of being read again.
+class SlabLoader
+{
+public:
+    SlabLoader(const char* file, size_t overlap)
+      : stream(file), overlap(overlap), keptBegin(0), nextSlice(0)
+    {
+        if (!stream)
+            throw file_not_found(file);
+
+        size_t npoints;
+        loadHeader(stream, dim, spacing, zeroPos, npoints, ti);
+    }
+
+    size_t xdimension() const { return dim[0]; }
+    size_t ydimension() const { return dim[1]; }
+    size_t zdimension() const { return dim[2]; }
+
+    // Returns the slices [zBegin, zEnd) of the image.
+    Image3D load(size_t zBegin, size_t zEnd)
+    {
+        if (zBegin < keptBegin || zEnd < nextSlice || zEnd > dim[2])
+        {
+            throw bad_format("Slabs must be loaded in increasing z");
+        }
+
+        size_t const sliceSize = dim[0] * dim[1];
+
+        FirstTouchVector<scalar_t> data((zEnd - zBegin) * sliceSize);
+
+        if (zBegin < nextSlice)
+        {
+            // Slices from before that are still needed
+            std::copy(kept.begin() + (zBegin - keptBegin) * sliceSize,
+                      kept.end(),
+                      data.begin());
+        }
+        else
+        {
+            // Slices that aren't needed at all
+            streamIgnore(stream, (zBegin - nextSlice) * sliceSize, ti.size());
+            nextSlice = zBegin;
+        }
+
+        // Slices that haven't been read yet. They are read one at a time so
+        // the raw buffer is only the size of a slice.
+        std::vector<char> rbuf(sliceSize * ti.size());
+        for(; nextSlice != zEnd; ++nextSlice)
+        {
+            stream.read(rbuf.data(), rbuf.size());
+            convertBufferWithTypeInfo(
+                rbuf.data(), ti, sliceSize,
+                data.data() + (nextSlice - zBegin) * sliceSize);
+        }
+
+        // Keep the last slices for the next slab
+        keptBegin = zEnd - std::min(overlap, zEnd - zBegin);
+        kept.assign(data.begin() + (keptBegin - zBegin) * sliceSize,
+                    data.end());
+
+        std::array<size_t, 3> slabDim = {{ dim[0], dim[1], zEnd - zBegin }};
+        return Image3D(std::move(data), spacing, zeroPos, slabDim, zBegin);
+    }
+
+private:
+    std::ifstream stream;
+
+    std::array<size_t, 3> dim;
+    std::array<scalar_t, 3> spacing;
+    std::array<scalar_t, 3> zeroPos;
+    TypeInfo ti;
+
+    size_t const overlap;
+
+    std::vector<scalar_t> kept; // slices [keptBegin, nextSlice)
+    size_t keptBegin;
+    size_t nextSlice;           // the next slice in the stream
+};
+
 } // util namespace
 
 #endif
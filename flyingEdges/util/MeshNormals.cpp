@@ -0,0 +1,110 @@
+/*
+ * MeshNormals.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#include "MeshNormals.h"
+
+#include <cmath>
+#include <string.h>
+
+namespace util {
+
+const char* normalModeName(NormalMode mode)
+{
+    switch(mode)
+    {
+    case NormalMode::none:
+        return "none";
+    case NormalMode::gradient:
+        return "gradient";
+    case NormalMode::face:
+        return "face";
+    }
+    return "";
+}
+
+bool parseNormalMode(const char* name, NormalMode& mode)
+{
+    for(NormalMode m : { NormalMode::none,
+                         NormalMode::gradient,
+                         NormalMode::face })
+    {
+        if(strcmp(name, normalModeName(m)) == 0)
+        {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+void computeFaceNormals(
+    VectorArray const& points,
+    TriangleArray const& tris,
+    VectorArray& normals)
+{
+    size_t const stride = VectorArray::stride;
+    size_t const numPoints = points.size();
+
+    normals.clear();
+    normals.resize(numPoints);
+    normals.zero();
+
+    const scalar_t* px = points.data(0);
+    const scalar_t* py = points.data(1);
+    const scalar_t* pz = points.data(2);
+    scalar_t* nx = normals.data(0);
+    scalar_t* ny = normals.data(1);
+    scalar_t* nz = normals.data(2);
+
+    // The cross product of two edges of a triangle is its normal scaled by
+    // twice its area.
+    for(std::array<index_t, 3> const& tri: tris)
+    {
+        size_t a = tri[0]*stride;
+        size_t b = tri[1]*stride;
+        size_t c = tri[2]*stride;
+
+        scalar_t ux = px[b] - px[a], uy = py[b] - py[a], uz = pz[b] - pz[a];
+        scalar_t vx = px[c] - px[a], vy = py[c] - py[a], vz = pz[c] - pz[a];
+
+        // The triangles of the case tables wind counterclockwise seen from
+        // the side the gradient points to, so u x v points along it.
+        scalar_t fx = uy*vz - uz*vy;
+        scalar_t fy = uz*vx - ux*vz;
+        scalar_t fz = ux*vy - uy*vx;
+
+        for(size_t p : { a, b, c })
+        {
+            nx[p] += fx;
+            ny[p] += fy;
+            nz[p] += fz;
+        }
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
+    for(size_t i = 0; i < numPoints; ++i)
+    {
+        size_t p = i*stride;
+        scalar_t length =
+            std::sqrt(nx[p]*nx[p] + ny[p]*ny[p] + nz[p]*nz[p]);
+        if(length > 0)
+        {
+            nx[p] /= length;
+            ny[p] /= length;
+            nz[p] /= length;
+        }
+    }
+}
+
+}
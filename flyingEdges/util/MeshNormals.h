@@ -0,0 +1,51 @@
+/*
+ * MeshNormals.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef MESHNORMALS_H_
+#define MESHNORMALS_H_
+
+#include <array>
+#include <vector>
+
+#include "FlyingEdges_Config.h"
+
+#include "TriangleMesh.h"
+
+namespace util {
+
+// How the normals of the output mesh are made.
+enum class NormalMode
+{
+    none,     // No normals. No gradients of the image are computed.
+    gradient, // Interpolated from the gradients of the image at the two
+              // ends of each cut edge.
+    face      // Averaged from the triangles around each point once the
+              // mesh is made.
+};
+
+const char* normalModeName(NormalMode mode);
+
+// Reads "none", "gradient" or "face" into mode. Returns false if name is
+// none of them.
+bool parseNormalMode(const char* name, NormalMode& mode);
+
+// Sets the normal of each point to the sum of the normals of the triangles
+// around it, weighted by their areas, scaled to unit length. The normals
+// point the same way as the gradients of the image.
+void computeFaceNormals(
+    VectorArray const& points,
+    TriangleArray const& tris,
+    VectorArray& normals);
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * ParallelScan.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef PARALLELSCAN_H_
+#define PARALLELSCAN_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace util {
+
+// Fewer elements than this per thread aren't worth waking the threads for.
+const std::size_t scanGrainSize = 1 << 14;
+
+// Scans the n elements in parallel and returns the sum of all of them. An
+// element can hold several fields, which are scanned as one sequence. Each
+// thread gets at least grainSize elements.
+//
+// reduce(beg, end) returns the sum of the fields of the elements in
+// [beg, end). scan(beg, end, offset) replaces the fields of the elements in
+// [beg, end) by their exclusive or inclusive scan, starting from offset, in
+// the same order reduce adds them, and returns offset plus their sum.
+//
+// Each thread reduces a block of the elements, the sums of the blocks before
+// it are its offset, and then it scans its block from there. Each element
+// is read twice and written once, and the threads wait for each other once.
+// With one block, the elements are only scanned.
+template <typename Sum, typename Reduce, typename Scan>
+Sum parallelScan(std::size_t n, Reduce reduce, Scan scan,
+                 std::size_t grainSize = scanGrainSize)
+{
+#ifdef _OPENMP
+    std::size_t numBlocks = std::min(n / std::max(grainSize, std::size_t(1)),
+                                     std::size_t(omp_get_max_threads()));
+    if(numBlocks > 1)
+    {
+        std::vector<Sum> blockSums(numBlocks);
+        Sum total = Sum();
+
+        #pragma omp parallel num_threads(numBlocks)
+        {
+            // The runtime can give fewer threads than asked for.
+            std::size_t numThreads = omp_get_num_threads();
+            std::size_t tID = omp_get_thread_num();
+
+            std::size_t blockSize = (n + numThreads - 1) / numThreads;
+            std::size_t beg = std::min(n, blockSize*tID);
+            std::size_t end = std::min(n, beg + blockSize);
+
+            blockSums[tID] = reduce(beg, end);
+
+            #pragma omp barrier
+
+            Sum offset = Sum();
+            for(std::size_t b = 0; b != tID; ++b)
+            {
+                offset += blockSums[b];
+            }
+
+            Sum blockEnd = scan(beg, end, offset);
+
+            if(tID == numThreads - 1)
+            {
+                total = blockEnd;
+            }
+        }
+
+        return total;
+    }
+#else
+    (void)grainSize;
+#endif
+
+    return scan(0, n, Sum());
+}
+
+// Replaces each of the n values by the sum of the values before it and
+// returns the sum of all of them. The sums are made in Sum, which can be
+// wider than T. See parallelScan for grainSize.
+template <typename Sum, typename T>
+Sum exclusiveScan(T* values, std::size_t n,
+                  std::size_t grainSize = scanGrainSize)
+{
+    return parallelScan<Sum>(n,
+        [values](std::size_t beg, std::size_t end)
+        {
+            Sum sum = Sum();
+            for(std::size_t i = beg; i != end; ++i)
+            {
+                sum += values[i];
+            }
+            return sum;
+        },
+        [values](std::size_t beg, std::size_t end, Sum offset)
+        {
+            for(std::size_t i = beg; i != end; ++i)
+            {
+                Sum value = values[i];
+                values[i] = offset;
+                offset += value;
+            }
+            return offset;
+        },
+        grainSize);
+}
+
+// Replaces each of the n values by the sum of it and the values before it
+// and returns the sum of all of them. See parallelScan for grainSize.
+template <typename Sum, typename T>
+Sum inclusiveScan(T* values, std::size_t n,
+                  std::size_t grainSize = scanGrainSize)
+{
+    return parallelScan<Sum>(n,
+        [values](std::size_t beg, std::size_t end)
+        {
+            Sum sum = Sum();
+            for(std::size_t i = beg; i != end; ++i)
+            {
+                sum += values[i];
+            }
+            return sum;
+        },
+        [values](std::size_t beg, std::size_t end, Sum offset)
+        {
+            for(std::size_t i = beg; i != end; ++i)
+            {
+                offset += values[i];
+                values[i] = offset;
+            }
+            return offset;
+        },
+        grainSize);
+}
+
+}
+
+#endif
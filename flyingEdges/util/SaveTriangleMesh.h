@@ -20,28 +20,90 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 
 #include "FlyingEdges_Config.h"
 
 #include "ConvertBuffer.h"
+#include "Errors.h"
 #include "TypeInfo.h"
 
 #include "TriangleMesh.h"
 
 namespace util {
 
+// Writes the vectors [beg, end) of vectors.
 void
-saveTriangleMesh(TriangleMesh const& mesh, const char* fileName)
+writeVectors(std::ostream& stream, VectorArray const& vectors,
+             size_t beg, size_t end)
+{
+    size_t spacialDimensions = 3;
+    size_t n = end - beg;
+
+    std::vector<char> wbuff;
+    std::size_t bufsize = n * spacialDimensions * sizeof(scalar_t);
+    wbuff.resize(bufsize);
+
+    scalar_t *bufPointer = reinterpret_cast<scalar_t*>(&wbuff[0]);
+
+    // The file interleaves the components, so each one is copied to every
+    // third value of the buffer. Then the whole buffer is flipped.
+    for (int i = 0; i < 3; ++i)
+    {
+        const scalar_t* component =
+            vectors.data(i) + beg*VectorArray::stride;
+        for(size_t idx = 0; idx != n; ++idx)
+        {
+            bufPointer[3*idx + i] = component[idx*VectorArray::stride];
+        }
+    }
+    flipEndiannessParallel(bufPointer, n * spacialDimensions);
+    stream.write(&wbuff[0], wbuff.size());
+}
+
+void
+writeVectors(std::ostream& stream, VectorArray const& vectors)
+{
+    writeVectors(stream, vectors, 0, vectors.size());
+}
+
+// Writes the triangles with pointOffset taken from each of their point
+// indices.
+void
+writeTriangles(
+    std::ostream& stream,
+    TriangleMesh::TriangleIterator begIter,
+    TriangleMesh::TriangleIterator endIter,
+    size_t pointOffset = 0)
 {
-    using PointIterator =    typename TriangleMesh::PointIterator;
     using TriangleIterator = typename TriangleMesh::TriangleIterator;
-    using NormalIterator =   typename TriangleMesh::NormalIterator;
 
+    std::vector<char> wbuff;
+    std::size_t bufsize = (endIter - begIter) * 4 * sizeof(index_t);
+    wbuff.resize(bufsize);
+    index_t *ind = reinterpret_cast<index_t*>(&wbuff[0]);
+
+    for(TriangleIterator iter = begIter; iter != endIter; ++iter)
+    {
+        *ind++ = 3;
+        for (int i = 0; i < 3; ++i)
+        {
+            *ind++ = (*iter)[i] - pointOffset;
+        }
+    }
+    flipEndiannessParallel(reinterpret_cast<index_t*>(&wbuff[0]),
+                           (endIter - begIter) * 4);
+    stream.write(&wbuff[0], wbuff.size());
+}
+
+void
+saveTriangleMesh(TriangleMesh const& mesh, const char* fileName)
+{
     std::ofstream stream(fileName);
 
     size_t nverts = mesh.numberOfVertices();
     size_t ntriangles = mesh.numberOfTriangles();
-    size_t spacialDimensions = 3;
 
     TypeInfo ti = createTemplateTypeInfo<scalar_t>();
 
@@ -51,71 +113,151 @@ saveTriangleMesh(TriangleMesh const& mesh, const char* fileName)
     stream << "DATASET POLYDATA" << std::endl;
     stream << "POINTS " << nverts << " " << ti.name() << std::endl;
 
-    std::vector<char> wbuff;
-    std::size_t bufsize = nverts * spacialDimensions * sizeof(scalar_t);
-    wbuff.resize(bufsize);
-
     // Writing points data
-    scalar_t *bufPointer = reinterpret_cast<scalar_t*>(&wbuff[0]);
+    writeVectors(stream, mesh.getPoints());
+    stream << std::endl;
+
+    // Writing triangle indices
+    stream << "POLYGONS " << ntriangles << " " << ntriangles * 4 << std::endl;
+    writeTriangles(stream, mesh.trianglesBegin(), mesh.trianglesEnd());
+    stream << std::endl;
 
-    PointIterator ptBegIter = mesh.pointsBegin();
-    PointIterator ptEndIter = mesh.pointsEnd();
-    for(PointIterator iter = ptBegIter; iter != ptEndIter; ++iter)
+    // Writing normals. A mesh made without normals has none to write.
+    if(mesh.getNormals().size() == nverts)
     {
-        for (int i = 0; i < 3; ++i)
-        {
-            *bufPointer = (*iter)[i];
-            flipEndianness(*bufPointer++);
-        }
+        stream << "POINT_DATA " << nverts << std::endl;
+        stream << "NORMALS Normals " << ti.name() << std::endl;
+        writeVectors(stream, mesh.getNormals());
+        stream << std::endl;
     }
-    stream.write(&wbuff[0], wbuff.size());
-    stream << std::endl;
 
-    // Writing triangle indices
-    bufsize = ntriangles * 4 * sizeof(size_t);
-    wbuff.resize(bufsize);
-    size_t *ind = reinterpret_cast<size_t*>(&wbuff[0]);
+    stream.close();
+}
 
-    TriangleIterator triBegIter = mesh.trianglesBegin();
-    TriangleIterator triEndIter = mesh.trianglesEnd();
-    for(TriangleIterator iter = triBegIter; iter != triEndIter; ++iter)
+// Writes a mesh given in pieces, such as one piece per slab of the image,
+// to one file per piece: fileName.0, fileName.1 and so on, as the MPI
+// executables of marchingCubes write one file per process. The triangles of
+// every piece index the points of all pieces appended so far, and may also
+// use the first points of the next piece. Each file is a whole mesh written
+// as saveTriangleMesh does, so it also holds the points of the next piece
+// that its triangles use. A piece is written once the next one is appended,
+// or at finish if it is the last.
+class TriangleMeshStreamWriter
+{
+public:
+    TriangleMeshStreamWriter(const char* fileName)
+      : fileName(fileName),
+        havePending(false),
+        numPieces(0),
+        nverts(0),
+        ntriangles(0)
+    {}
+
+    void append(TriangleMesh && mesh)
     {
-        *ind = 3;
-        flipEndianness(*ind++);
-        for (int i = 0; i < 3; ++i)
+        if(havePending)
         {
-            *ind = (*iter)[i];
-            flipEndianness(*ind++);
+            writePending(&mesh);
         }
+        pending = std::move(mesh);
+        havePending = true;
     }
 
-    stream << "POLYGONS " << ntriangles << " " << ntriangles * 4 << std::endl;
-    stream.write(&wbuff[0], wbuff.size());
-    stream << std::endl;
+    void finish()
+    {
+        if(havePending)
+        {
+            writePending(nullptr);
+            havePending = false;
+        }
+    }
 
-    // Writing normals
-    bufsize = nverts * spacialDimensions * sizeof(scalar_t);
-    wbuff.resize(bufsize);
-    bufPointer = reinterpret_cast<scalar_t*>(&wbuff[0]);
+    // The totals over the pieces written so far, without the points that
+    // are in two files
+    size_t numberOfVertices() const { return nverts; }
+    size_t numberOfTriangles() const { return ntriangles; }
+    size_t numberOfFiles() const { return numPieces; }
 
-    NormalIterator norBegIter = mesh.normalsBegin();
-    NormalIterator norEndIter = mesh.normalsEnd();
-    for(NormalIterator iter = norBegIter; iter != norEndIter; ++iter)
+private:
+    // Writes the pending piece to its file. next is the piece after it, if
+    // there is one.
+    void writePending(TriangleMesh const* next)
     {
-        for (int i = 0; i < 3; ++i)
+        size_t pieceVerts = pending.numberOfVertices();
+        size_t pieceTriangles = pending.numberOfTriangles();
+
+        // The number of points of the next piece the triangles use
+        size_t used = nverts + pieceVerts;
+        for(auto iter = pending.trianglesBegin();
+            iter != pending.trianglesEnd(); ++iter)
+        {
+            for(int i = 0; i < 3; ++i)
+            {
+                used = std::max(used, size_t((*iter)[i]) + 1);
+            }
+        }
+        size_t borrowed = used - nverts - pieceVerts;
+        if(borrowed != 0 &&
+           (next == nullptr || borrowed > next->numberOfVertices()))
         {
-            *bufPointer = (*iter)[i];
-            flipEndianness(*bufPointer++);
+            throw bad_format("A piece uses points past the next piece");
         }
+
+        std::string pieceName = fileName + "." + std::to_string(numPieces);
+        std::ofstream stream(pieceName.c_str());
+
+        size_t fileVerts = pieceVerts + borrowed;
+
+        TypeInfo ti = createTemplateTypeInfo<scalar_t>();
+
+        stream << "# vtk DataFile Version 3.0" << std::endl;
+        stream << "Isosurface Mesh" << std::endl;
+        stream << "BINARY" << std::endl;
+        stream << "DATASET POLYDATA" << std::endl;
+        stream << "POINTS " << fileVerts << " " << ti.name() << std::endl;
+        writeVectors(stream, pending.getPoints());
+        if(borrowed != 0)
+        {
+            writeVectors(stream, next->getPoints(), 0, borrowed);
+        }
+        stream << std::endl;
+
+        stream << "POLYGONS " << pieceTriangles << " "
+               << pieceTriangles * 4 << std::endl;
+        writeTriangles(stream, pending.trianglesBegin(),
+                       pending.trianglesEnd(), nverts);
+        stream << std::endl;
+
+        // Writing normals. A mesh made without normals has none to write.
+        if(pending.getNormals().size() == pieceVerts)
+        {
+            stream << "POINT_DATA " << fileVerts << std::endl;
+            stream << "NORMALS Normals " << ti.name() << std::endl;
+            writeVectors(stream, pending.getNormals());
+            if(borrowed != 0)
+            {
+                writeVectors(stream, next->getNormals(), 0, borrowed);
+            }
+            stream << std::endl;
+        }
+
+        stream.close();
+
+        ++numPieces;
+        nverts += pieceVerts;
+        ntriangles += pieceTriangles;
     }
 
-    stream << "POINT_DATA " << nverts << std::endl;
-    stream << "NORMALS Normals " << ti.name() << std::endl;
-    stream.write(&wbuff[0], wbuff.size());
-    stream << std::endl;
+private:
+    std::string fileName;
 
-    stream.close();
-}
+    TriangleMesh pending;
+    bool havePending;
+
+    size_t numPieces;
+    size_t nverts;
+    size_t ntriangles;
+};
 
 } // util namespace
 
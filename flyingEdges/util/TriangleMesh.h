@@ -18,26 +18,113 @@
 
 #include <vector>
 #include <array>
+#include <algorithm>
+
+#include "FirstTouch.h"
 
 namespace util {
 
+// The points or normals of a mesh. With MESH_SOA defined they are kept as
+// separate x, y and z arrays, otherwise as one array of 3-vectors. Either
+// way component axis of vector i is data(axis)[i*stride]. New vectors are
+// left uninitialized, so their pages are placed by whoever fills them.
+class VectorArray
+{
+public:
+#ifdef MESH_SOA
+    static constexpr size_t stride = 1;
+#else
+    static constexpr size_t stride = 3;
+#endif
+
+    std::size_t size() const
+    {
+#ifdef MESH_SOA
+        return values[0].size();
+#else
+        return values.size();
+#endif
+    }
+
+    void resize(std::size_t n)
+    {
+#ifdef MESH_SOA
+        for(FirstTouchVector<scalar_t>& component: values)
+            component.resize(n);
+#else
+        values.resize(n);
+#endif
+    }
+
+    void clear()
+    {
+        resize(0);
+    }
+
+    // Sets every vector to zero.
+    void zero()
+    {
+#ifdef MESH_SOA
+        for(FirstTouchVector<scalar_t>& component: values)
+            std::fill(component.begin(), component.end(), scalar_t(0));
+#else
+        std::fill(values.begin(), values.end(),
+                  std::array<scalar_t, 3>{{ 0, 0, 0 }});
+#endif
+    }
+
+    scalar_t* data(int axis)
+    {
+#ifdef MESH_SOA
+        return values[axis].data();
+#else
+        return reinterpret_cast<scalar_t*>(values.data()) + axis;
+#endif
+    }
+
+    const scalar_t* data(int axis) const
+    {
+#ifdef MESH_SOA
+        return values[axis].data();
+#else
+        return reinterpret_cast<const scalar_t*>(values.data()) + axis;
+#endif
+    }
+
+    std::array<scalar_t, 3> operator[](std::size_t i) const
+    {
+        return {{ data(0)[i*stride], data(1)[i*stride], data(2)[i*stride] }};
+    }
+
+    bool operator==(VectorArray const& other) const
+    {
+        return values == other.values;
+    }
+
+private:
+#ifdef MESH_SOA
+    std::array<FirstTouchVector<scalar_t>, 3> values;
+#else
+    FirstTouchVector<std::array<scalar_t, 3> > values;
+#endif
+};
+
+// The triangles of a mesh, as the indices of their points. New triangles
+// are left uninitialized like the vectors of VectorArray.
+using TriangleArray = FirstTouchVector<std::array<index_t, 3> >;
+
 class TriangleMesh
 {
 public:
-    using PointIterator =
-        typename std::vector<std::array<scalar_t, 3> >::const_iterator;
-    using NormalIterator =
-        typename std::vector<std::array<scalar_t, 3> >::const_iterator;
-    using TriangleIterator =
-        typename std::vector<std::array<size_t, 3> >::const_iterator;
+    using TriangleIterator = typename TriangleArray::const_iterator;
 
     TriangleMesh()
     {}
 
     TriangleMesh(
-        std::vector<std::array<scalar_t, 3> > && points,
-        std::vector<std::array<scalar_t, 3> > && normals,
-        std::vector<std::array<size_t, 3> > && indexTriangles)
+        VectorArray && points,
+        VectorArray && normals,
+        TriangleArray && indexTriangles)
       : points(std::move(points)),   // std::move might be redundant
         normals(std::move(normals)), // but making it explicit.
         indexTriangles(std::move(indexTriangles))
@@ -53,24 +140,14 @@ public:
         return indexTriangles.size();
     }
 
-    PointIterator pointsBegin() const
-    {
-        return points.begin();
-    }
-
-    PointIterator pointsEnd() const
+    VectorArray const& getPoints() const
     {
-        return points.end();
+        return points;
     }
 
-    NormalIterator normalsBegin() const
+    VectorArray const& getNormals() const
     {
-        return normals.begin();
-    }
-
-    NormalIterator normalsEnd() const
-    {
-        return normals.end();
+        return normals;
     }
 
     TriangleIterator trianglesBegin() const
@@ -83,10 +160,25 @@ public:
         return indexTriangles.end();
     }
 
+    // Move the vectors out so that their memory can be used again. The
+    // mesh is left empty.
+    void releaseBuffers(
+        VectorArray & points,
+        VectorArray & normals,
+        TriangleArray & indexTriangles)
+    {
+        points = std::move(this->points);
+        normals = std::move(this->normals);
+        indexTriangles = std::move(this->indexTriangles);
+        this->points.clear();
+        this->normals.clear();
+        this->indexTriangles.clear();
+    }
+
 private:
-    std::vector<std::array<scalar_t, 3> > points;
-    std::vector<std::array<scalar_t, 3> > normals;
-    std::vector<std::array<size_t, 3> > indexTriangles;
+    VectorArray points;
+    VectorArray normals;
+    TriangleArray indexTriangles;
 };
 
 }
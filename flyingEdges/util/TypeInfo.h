@@ -21,8 +21,8 @@
 namespace util
 {
     static const char *names[] = { "unknown", "char", "short", "unsigned_short",
-            "int", "float", "double" };
-    static const size_t sizes[] = { 0, 1, 2, 2, 4, 4, 8 };
+            "int", "float", "double", "unsigned_char" };
+    static const size_t sizes[] = { 0, 1, 2, 2, 4, 4, 8, 1 };
 
 
     class TypeInfo {
@@ -35,6 +35,7 @@ namespace util
             ID_INT,
             ID_FLOAT,
             ID_DOUBLE,
+            ID_UCHAR,
             NUM_TYPES
         };
 
@@ -86,6 +87,11 @@ namespace util
         return TypeInfo(TypeInfo::ID_CHAR);
     }
 
+    template<>
+    TypeInfo createTemplateTypeInfo<unsigned char>() {
+        return TypeInfo(TypeInfo::ID_UCHAR);
+    }
+
     template<>
     TypeInfo createTemplateTypeInfo<short>() {
         return TypeInfo(TypeInfo::ID_SHORT);
@@ -93,7 +99,7 @@ namespace util
 
     template<>
     TypeInfo createTemplateTypeInfo<unsigned short>() {
-        return TypeInfo(TypeInfo::ID_SHORT);
+        return TypeInfo(TypeInfo::ID_USHORT);
     }
 
     template<>
@@ -26,12 +26,14 @@
 #include <iomanip>
 
 #include "../util/Image3D.h"
+#include "../util/CaseIdKernels.h"
+#include "../util/EdgePointMap.h"
 #include "../util/TriangleMesh.h"
 
 #include "../util/LoadImage.h"
 #include "../util/SaveTriangleMesh.h"
 
-#include "../util/util.h"     // for findCaseId and interpolate
+#include "../util/util.h"     // for interpolate
 #include "../util/MarchingCubesTables.h"
 #include "../util/Errors.h"
 
@@ -124,8 +126,8 @@ struct MarchingCubesFunctor
                                            // ptNors and tris
     {
         // This pointMap will only be used on this sectionId. It will map
-        // from global edge indices to indices of ptNors
-        std::unordered_map<size_t, size_t> pointMap;
+        // the edges of the current z-slice of cubes to indices of ptNors
+        util::EdgePointMap pointMap;
 
         // Take ptIdx and triIdx by reference. As the algorithm goes,
         // these values will be incremented.
@@ -135,8 +137,6 @@ struct MarchingCubesFunctor
         size_t maxPtIdx = (sectionId + 1) * sizePoints;
         size_t maxTriIdx = (sectionId + 1) * sizeTris;
 
-        pointMap.reserve(maxPtIdx - ptIdx);
-
         // Retrieve info for this sectionId
         size_t xbeg = begEndInfo[sectionId][0];
         size_t ybeg = begEndInfo[sectionId][1];
@@ -146,25 +146,34 @@ struct MarchingCubesFunctor
         size_t yend = begEndInfo[sectionId][4];
         size_t zend = begEndInfo[sectionId][5];
 
+        pointMap.reset(xbeg, ybeg, xend, yend);
+
+        // The case of each cube of the current row
+        size_t const nCubes = xend - xbeg;
+        std::vector<unsigned char> caseIds(nCubes);
+
         // For each cube, determine whether or not the isosurface insersects
         // the given cube. If so, call processOneCube.
         for(size_t zidx = zbeg; zidx != zend; ++zidx)
         {
+            pointMap.beginSlice(zidx);
+
             for(size_t yidx = ybeg; yidx != yend; ++yidx)
             {
                 auto buffer = image.createBuffer(xbeg, yidx, zidx);
-                for(size_t xidx = xbeg; xidx != xend; ++xidx)
+                buffer.getCaseIds(xend, isoval, caseIds.data());
+
+                // Only the cubes the isosurface intersects are visited.
+                for(size_t c = util::nextCutCube(caseIds.data(), 0, nCubes);
+                    c != nCubes;
+                    c = util::nextCutCube(caseIds.data(), c + 1, nCubes))
                 {
+                    size_t xidx = xbeg + c;
+                    int cellCaseId = caseIds[c];
+
                     std::array<T, 8> cubeVertexVals =
                         buffer.getCubeVertexValues(xidx);
 
-                    int cellCaseId = util::findCaseId(cubeVertexVals, isoval);
-
-                    if (cellCaseId == 0 || cellCaseId == 255)
-                    {
-                        continue;
-                    }
-
                     int newTris = util::numberOfTriangles[cellCaseId];
 
                     // It could be the case that marchingCubes did not
@@ -212,7 +221,7 @@ private:
         size_t const&                        sectionId,
         std::array<T, 8> const&              cubeVertexVals,
         int const&                           cellCaseId,
-        std::unordered_map<size_t, size_t>&  pointMap, // by non-const reference
+        util::EdgePointMap&                  pointMap, // by non-const reference
         size_t&                              ptIdx,    // by non-const reference
         size_t&                              triIdx    // by non-const reference
         ) const
@@ -236,9 +245,10 @@ private:
                     image.getGlobalEdgeIndex(xidx, yidx, zidx, triEdges[i]);
                 tris(triIdx, i) = globalEdgeIndex;
 
-                if(pointMap.find(globalEdgeIndex) == pointMap.end())
+                size_t& pointIdx = pointMap.at(xidx, yidx, triEdges[i]);
+                if(pointIdx == util::noPoint)
                 {
-                    pointMap[globalEdgeIndex] = ptIdx;
+                    pointIdx = ptIdx;
                     edgeMap[ptIdx] = globalEdgeIndex;
 
                     const int *vs = util::edgeVertices[triEdges[i]];
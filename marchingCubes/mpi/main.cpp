@@ -15,7 +15,6 @@
 
 #include <array>
 #include <vector>
-#include <unordered_map>
 
 #include <string>
 #include <string.h>
@@ -26,12 +25,16 @@
 #include <iomanip>
 
 #include "../util/Image3D.h"
+#include "../util/CaseIdKernels.h"
+#include "../util/EdgePointMap.h"
+#include "../util/GradientProvider.h"
+#include "../util/MeshNormals.h"
 #include "../util/TriangleMesh.h"
 
 #include "../util/LoadImage.h"
 #include "../util/SaveTriangleMesh.h"
 
-#include "../util/util.h"     // for findCaseId and interpolate
+#include "../util/util.h"     // for interpolate
 #include "../util/TypeInfo.h"
 #include "../util/MarchingCubesTables.h"
 
@@ -49,11 +52,15 @@ void
 sectionOfMarchingCubes(
     T const&                                isoval,
     util::Image3D<T> const&                 image,
+    util::NormalMode const&                 normalMode,
+    typename util::GradientProvider<T>::Reader& gradReader, // reference
     std::vector<std::array<T, 3> >&         points,         // reference
     std::vector<std::array<T, 3> >&         normals,        // reference
-    std::vector<std::array<size_t, 3> >&  indexTriangles, // reference
-    std::unordered_map<size_t, size_t>& pointMap)       // reference
+    std::vector<std::array<util::index_t, 3> >&  indexTriangles, // reference
+    util::EdgePointMap&                     pointMap)       // reference
 {
+    bool gradientNormals = normalMode == util::NormalMode::gradient;
+
     // For each cube, determine whether or not the isosurface intersects
     // the given cube. If so, first find the cube configuration from a lookup
     // table. Then add the triangles of that cube configuration to points,
@@ -68,30 +75,39 @@ sectionOfMarchingCubes(
     size_t yend = image.yEndIdx();
     size_t zend = image.zEndIdx();
 
+    pointMap.reset(xbeg, ybeg, xend, yend);
+
+    // The case of each cube of the current row
+    size_t const nCubes = xend - xbeg;
+    std::vector<unsigned char> caseIds(nCubes);
+
     size_t ptIdx = points.size();
     for(size_t zidx = zbeg; zidx != zend; ++zidx)
     {
+        pointMap.beginSlice(zidx);
+
         for(size_t yidx = ybeg; yidx != yend; ++yidx)
         {
             // A buffer is used to improve cache efficency when retrieving
             // vertex values of each cube.
             auto buffer = image.createBuffer(xbeg, yidx, zidx);
 
-            for(size_t xidx = xbeg; xidx != xend; ++xidx)
+            // The cases of all the cubes of the row are found at once.
+            // The 0th and 255th cases are the cases where the isosurface
+            // does not intersect the cube, so those cubes are skipped.
+            buffer.getCaseIds(xend, isoval, caseIds.data());
+
+            for(size_t c = util::nextCutCube(caseIds.data(), 0, nCubes);
+                c != nCubes;
+                c = util::nextCutCube(caseIds.data(), c + 1, nCubes))
             {
+                size_t xidx = xbeg + c;
+                int cellCaseId = caseIds[c];
+
                 // For each x, y, z index, get the corresponding 8 scalar values
                 // of a cube with one corner being at the x, y, z index.
                 std::array<T, 8> cubeVertexVals = buffer.getCubeVertexValues(xidx);
 
-                int cellCaseId = util::findCaseId(cubeVertexVals, isoval);
-
-                // The 0th and 255th cellCaseId are the cases where the isosurface
-                // does not intersect the cube.
-                if (cellCaseId == 0 || cellCaseId == 255)
-                {
-                    continue;
-                }
-
                 // From a pre-generated list of possible cube configurations,
                 // get the corresponding "triangles" to this caseId. Each
                 // triangle contains 3 cube edge endices, where each vertex
@@ -105,8 +121,12 @@ sectionOfMarchingCubes(
                 // calculating gradients.
                 std::array<std::array<T, 3>, 8> posCube =
                     image.getPosCube(xidx, yidx, zidx);
-                std::array<std::array<T, 3>, 8> gradCube =
-                    image.getGradCube(xidx, yidx, zidx);
+                // Without gradient normals, no gradients are read.
+                std::array<std::array<T, 3>, 8> gradCube;
+                if(gradientNormals)
+                {
+                    gradCube = gradReader.getGradCube(xidx, yidx, zidx);
+                }
 
                 // For each edge in each triangle, find it's global edge index.
                 // If the point and normal for that  global edge index has not
@@ -117,26 +137,29 @@ sectionOfMarchingCubes(
                 for(; *triEdges != -1; triEdges += 3)
                 {
                     // tri contains indices to points and normals
-                    std::array<size_t, 3> tri;
+                    std::array<util::index_t, 3> tri;
                     for(int i = 0; i != 3; ++i)
                     {
-                        size_t globalEdgeIndex =
-                            image.getGlobalEdgeIndex(xidx, yidx, zidx, triEdges[i]);
-
-                        if(pointMap.find(globalEdgeIndex) != pointMap.end())
+                        // The index of the point on this edge in points and
+                        // normals. If it has not been calculated, even by
+                        // an earlier section, it is calculated below at
+                        // ptIdx.
+                        size_t const pointIdx = pointMap.findOrAdd(
+                            xidx, yidx, triEdges[i], ptIdx);
+
+                        if(pointIdx != util::noPoint)
                         {
-                            // This global edge index has an associated index
+                            // This edge has an associated index
                             // corresponding to its point and normal in points
                             // and normals.
 
-                            tri[i] = pointMap[globalEdgeIndex];
+                            tri[i] = pointIdx;
                         }
                         else
                         {
-                            // This point and normal value on this global edge
-                            // index has not been calculated.
+                            // This point and normal value on this edge has
+                            // not been calculated.
 
-                            pointMap[globalEdgeIndex] = ptIdx;
                             tri[i] = ptIdx++;
 
                             const int *vs = util::edgeVertices[triEdges[i]];
@@ -147,11 +170,12 @@ sectionOfMarchingCubes(
 
                             std::array<T, 3> newPt =
                                 util::interpolate(posCube[v1], posCube[v2], w);
-                            std::array<T, 3> newNorm =
-                                util::interpolate(gradCube[v1], gradCube[v2], w);
-
                             points.push_back(newPt);
-                            normals.push_back(newNorm);
+                            if(gradientNormals)
+                            {
+                                normals.push_back(
+                                    util::interpolate(gradCube[v1], gradCube[v2], w));
+                            }
                         }
                     }
 
@@ -168,25 +192,51 @@ sectionOfMarchingCubes(
 
 template <typename T>
 util::TriangleMesh<T>
-MarchingCubes(std::vector<util::Image3D<T> > const& images, T const& isoval)
+MarchingCubes(std::vector<util::Image3D<T> > const& images, T const& isoval,
+    util::GradientMode const& gradientMode,
+    util::NormalMode const& normalMode)
 {
     std::vector<std::array<T, 3> > processPoints;
     std::vector<std::array<T, 3> > processNormals;
-    std::vector<std::array<size_t, 3> > processIndexTriangles;
+    std::vector<std::array<util::index_t, 3> > processIndexTriangles;
 
-    std::unordered_map<size_t, size_t> processPointMap;
+    // processPointMap maps the edges of the current z-slice of cubes of an
+    // image to indices in processPoints and processNormals. Its arrays are
+    // reused from one image to the next, and it keeps the points on the
+    // planes between images, so a point between two images of this process
+    // is only made once.
+    util::EdgePointMap processPointMap;
+    processPointMap.resetSections(util::sectionBounds(images));
 
     for(util::Image3D<T> const& image: images)
     {
+        // The gradients used for the normals are found by gradients, see
+        // util::GradientMode. With other normal modes the gradients aren't
+        // needed, so nothing is precomputed or cached for them.
+        util::GradientProvider<T> gradients(image,
+            normalMode == util::NormalMode::gradient ?
+                gradientMode : util::GradientMode::onTheFly);
+        typename util::GradientProvider<T>::Reader gradReader(gradients);
+
         sectionOfMarchingCubes(
             isoval, image,                  // constant inputs
+            normalMode,                     // constant inputs
+            gradReader,                     // for modification, taken by reference
             processPoints,                  // for modification, taken by reference
             processNormals,                 // for modification, taken by reference
             processIndexTriangles,          // for modification, taken by reference
             processPointMap);               // for modification, taken by reference
     }
 
-    return util::TriangleMesh<T>(processPoints, processNormals, processIndexTriangles);
+    // The face normals of this process's mesh only see its own triangles.
+    // See main for the single output mesh.
+    util::TriangleMesh<T> mesh(
+        processPoints, processNormals, processIndexTriangles);
+    if(normalMode == util::NormalMode::face)
+    {
+        util::computeFaceNormals(mesh);
+    }
+    return mesh;
 }
 
 int main(int argc, char* argv[])
@@ -202,6 +252,9 @@ int main(int argc, char* argv[])
     char* vtkFile = NULL;
     char* outFile = NULL;
     bool oneOutputMesh = false;
+    char* gradientName = NULL;
+    size_t gradientMemory = 1024; // MiB
+    char* normalName = NULL;
     std::string yamlDirectory = "";
     std::string yamlFileName  = "";
 
@@ -241,6 +294,18 @@ int main(int argc, char* argv[])
         {
             oneOutputMesh = atoi(argv[++i]);
         }
+        else if( (strcmp(argv[i], "-g") == 0) || (strcmp(argv[i], "-gradient") == 0))
+        {
+            gradientName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-gm") == 0) || (strcmp(argv[i], "-gradient_memory") == 0))
+        {
+            gradientMemory = std::stoul(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-normals") == 0))
+        {
+            normalName = argv[++i];
+        }
         else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
         {
             std::string wholeFile(argv[++i]);
@@ -268,6 +333,13 @@ int main(int argc, char* argv[])
                 "  -sections_y (-sy)"             << std::endl <<
                 "  -sections_z (-sz)"             << std::endl <<
                 "  -one_mesh (-m), default 0"     << std::endl <<
+                "  -gradient (-g), default auto"  << std::endl <<
+                "    auto, onthefly, rolling or"  << std::endl <<
+                "    precomputed"                 << std::endl <<
+                "  -gradient_memory (-gm), MiB,"  << std::endl <<
+                "    default 1024"                << std::endl <<
+                "  -normals (-n), default"        << std::endl <<
+                "    gradient, none or face"      << std::endl <<
                 "  -yaml_output_file (-y)"        << std::endl <<
                 "  -help (-h)"                    << std::endl;
             return 0;
@@ -281,6 +353,24 @@ int main(int argc, char* argv[])
         return 0;
     }
 
+    bool autoGradient =
+        gradientName == NULL || strcmp(gradientName, "auto") == 0;
+    util::GradientMode gradientMode = util::GradientMode::onTheFly;
+    if(!autoGradient && !util::parseGradientMode(gradientName, gradientMode))
+    {
+        std::cout << "Error: unknown gradient mode " << gradientName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::NormalMode normalMode = util::NormalMode::gradient;
+    if(normalName != NULL && !util::parseNormalMode(normalName, normalMode))
+    {
+        std::cout << "Error: unknown normal mode " << normalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
     // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
     // YAML_Doc will create a file at in the current directory with a
     // timestamp on it.
@@ -302,6 +392,22 @@ int main(int argc, char* argv[])
     if(nSectionsZ > images[0].zdimension() - 1)
         nSectionsZ = images[0].zdimension() - 1;
 
+    // Without a gradient mode given, use the fastest one that fits in the
+    // gradient memory budget. Each section has its own gradients.
+    std::array<size_t, 3> sectionDim;
+    for(int d = 0; d != 3; ++d)
+    {
+        sectionDim[d] =
+            images[0].dataEndIdx()[d] - images[0].dataBeginIdx()[d];
+    }
+    size_t gradientBudget = gradientMemory << 20;
+    if(autoGradient)
+    {
+        gradientMode = util::chooseGradientMode<float>(
+            sectionDim[0], sectionDim[1], sectionDim[2],
+            1, gradientBudget);
+    }
+
     if (pid == 0)
     {
         // images should never be empty on the 0th processer.
@@ -313,6 +419,8 @@ int main(int argc, char* argv[])
         doc.add("Volume image data file path", vtkFile);
         doc.add("Polygonal mesh output file", outFile);
         doc.add("Isoval", isoval);
+        doc.add("Normal mode", util::normalModeName(normalMode));
+        doc.add("Case ID kernel", util::caseIdKernelName());
         doc.add("Number of X sections", nSectionsX);
         doc.add("Number of Y sections", nSectionsY);
         doc.add("Number of Z sections", nSectionsZ);
@@ -320,6 +428,8 @@ int main(int argc, char* argv[])
         doc.add("File x-dimension", xdim);
         doc.add("File y-dimension", ydim);
         doc.add("File z-dimension", zdim);
+        doc.add("Gradient mode", util::gradientModeName(gradientMode));
+        doc.add("Gradient memory budget (bytes)", gradientBudget);
     }
 
     MPI_Barrier(MPI_COMM_WORLD);
@@ -331,7 +441,8 @@ int main(int argc, char* argv[])
     // loaded at vtkFile and the isoval of the surface to approximate. It's
     // output is a TriangleMesh which stores the mesh as a vector
     // of triangles.
-    util::TriangleMesh<float> polygonalMesh = MarchingCubes(images, isoval);
+    util::TriangleMesh<float> polygonalMesh =
+        MarchingCubes(images, isoval, gradientMode, normalMode);
 
     // End timing
     runTime.stop();
@@ -420,13 +531,20 @@ int main(int argc, char* argv[])
         // output mesh for each processer. gatherMeshes and mergeMeshes
         // are not designed to be performant.
 
+        // Face normals are made again once the meshes are merged, since
+        // the triangles around a point can be on several processes.
         std::vector<util::TriangleMesh<float> > meshes =
-            mpiutil::gatherMeshes(polygonalMesh, pid, numVerts, numTris);
+            mpiutil::gatherMeshes(polygonalMesh, pid, numVerts, numTris,
+                normalMode == util::NormalMode::gradient);
 
         if(pid == 0)
         {
             util::TriangleMesh<float> globalPolygonalMesh =
                 mpiutil::mergeMeshes(meshes);
+            if(normalMode == util::NormalMode::face)
+            {
+                util::computeFaceNormals(globalPolygonalMesh);
+            }
 
             util::saveTriangleMesh(globalPolygonalMesh, outFile);
         }
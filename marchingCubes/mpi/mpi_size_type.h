@@ -35,3 +35,10 @@
    #error "what is happening here?"
 #endif
 
+// The MPI type of util::index_t, see util/TriangleMesh.h
+#ifdef MESH_INDEX32
+   #define my_MPI_INDEX_T MPI_UINT32_T
+#else
+   #define my_MPI_INDEX_T my_MPI_SIZE_T
+#endif
+
@@ -248,7 +248,7 @@ mergeMeshes(std::vector<util::TriangleMesh<T> > const& meshes)
 
     std::vector<std::array<T, 3> > points;
     std::vector<std::array<T, 3> > normals;
-    std::vector<std::array<size_t, 3> > indexTriangles;
+    std::vector<std::array<util::index_t, 3> > indexTriangles;
 
     UnorderedMapArr<T> pointMap;
 
@@ -259,17 +259,20 @@ mergeMeshes(std::vector<util::TriangleMesh<T> > const& meshes)
         auto thesePoints = mesh.pointsBegin();
         auto theseNormals = mesh.normalsBegin();
         size_t numPoints = mesh.numberOfVertices();
+        bool withNormals = mesh.numberOfNormals() != 0;
         for(size_t idx = 0; idx != numPoints; ++idx)
         {
             std::array<T, 3> const& currentPoint = thesePoints[idx];
-            std::array<T, 3> const& currentNormal = theseNormals[idx];
 
             if(pointMap.find(currentPoint) == pointMap.end())
             {
                 pointMap[currentPoint] = count++;
 
                 points.push_back(currentPoint);
-                normals.push_back(currentNormal);
+                if(withNormals)
+                {
+                    normals.push_back(theseNormals[idx]);
+                }
             }
         }
 
@@ -279,9 +282,9 @@ mergeMeshes(std::vector<util::TriangleMesh<T> > const& meshes)
         auto triEnd = mesh.trianglesEnd();
         for(auto triIt = triBeg; triIt != triEnd; ++triIt)
         {
-            std::array<size_t, 3> const& oldTri = *triIt;
+            std::array<util::index_t, 3> const& oldTri = *triIt;
 
-            std::array<size_t, 3> tri;
+            std::array<util::index_t, 3> tri;
             tri[0] = pointMap[thesePoints[oldTri[0]]];
             tri[1] = pointMap[thesePoints[oldTri[1]]];
             tri[2] = pointMap[thesePoints[oldTri[2]]];
@@ -297,29 +300,35 @@ std::vector<util::TriangleMesh<float> >
 gatherMeshes(util::TriangleMesh<float> const& thisMesh,
     int pid,
     std::vector<size_t> numVerts,
-    std::vector<size_t> numTris)
+    std::vector<size_t> numTris,
+    bool withNormals)
 {
-    // Flatten this points, normals
+    // Flatten this points, normals. Every process has to agree on
+    // withNormals since it sets the size of a vertex.
+    size_t vertSize = withNormals ? 6 : 3;
     size_t thisNumVerts = thisMesh.numberOfVertices();
     auto thisPoints = thisMesh.pointsBegin();
     auto thisNormals = thisMesh.normalsBegin();
 
-    std::vector<float> flatThisMesh(thisNumVerts * 6);
+    std::vector<float> flatThisMesh(thisNumVerts * vertSize);
     for(size_t idx = 0; idx != thisNumVerts; ++idx)
     {
-        flatThisMesh[idx * 6 + 0] = thisPoints[idx][0];
-        flatThisMesh[idx * 6 + 1] = thisPoints[idx][1];
-        flatThisMesh[idx * 6 + 2] = thisPoints[idx][2];
-        flatThisMesh[idx * 6 + 3] = thisNormals[idx][0];
-        flatThisMesh[idx * 6 + 4] = thisNormals[idx][1];
-        flatThisMesh[idx * 6 + 5] = thisNormals[idx][2];
+        flatThisMesh[idx * vertSize + 0] = thisPoints[idx][0];
+        flatThisMesh[idx * vertSize + 1] = thisPoints[idx][1];
+        flatThisMesh[idx * vertSize + 2] = thisPoints[idx][2];
+        if(withNormals)
+        {
+            flatThisMesh[idx * vertSize + 3] = thisNormals[idx][0];
+            flatThisMesh[idx * vertSize + 4] = thisNormals[idx][1];
+            flatThisMesh[idx * vertSize + 5] = thisNormals[idx][2];
+        }
     }
 
     // Flatten this indexTriangles
     size_t thisNumTris = thisMesh.numberOfTriangles();
     auto thisTris = thisMesh.trianglesBegin();
 
-    std::vector<size_t> flatThisTris(thisNumTris * 3);
+    std::vector<util::index_t> flatThisTris(thisNumTris * 3);
     for(size_t idx = 0; idx != thisNumTris; ++idx)
     {
         flatThisTris[idx * 3 + 0] = thisTris[idx][0];
@@ -336,18 +345,18 @@ gatherMeshes(util::TriangleMesh<float> const& thisMesh,
     size_t maxVerts = *std::max_element(numVerts.begin(), numVerts.end());
     size_t maxTris = *std::max_element(numTris.begin(), numTris.end());
 
-    size_t receiveVertsSize = 3*2*maxVerts;
+    size_t receiveVertsSize = vertSize*maxVerts;
     size_t receiveTrisSize = 3*maxTris;
 
     std::vector<float> receiveVerts(numProcesses * receiveVertsSize);
-    std::vector<size_t> receiveTris(numProcesses * receiveTrisSize);
+    std::vector<util::index_t> receiveTris(numProcesses * receiveTrisSize);
 
     MPI_Gather(flatThisMesh.data(), flatThisMesh.size(), MPI_FLOAT,
                receiveVerts.data(), receiveVertsSize, MPI_FLOAT,
                0, MPI_COMM_WORLD);
 
-    MPI_Gather(flatThisTris.data(), flatThisTris.size(), my_MPI_SIZE_T,
-               receiveTris.data(), receiveTrisSize, my_MPI_SIZE_T,
+    MPI_Gather(flatThisTris.data(), flatThisTris.size(), my_MPI_INDEX_T,
+               receiveTris.data(), receiveTrisSize, my_MPI_INDEX_T,
                0, MPI_COMM_WORLD);
 
     int gatherSize = numVerts.size();
@@ -362,20 +371,24 @@ gatherMeshes(util::TriangleMesh<float> const& thisMesh,
             size_t tIdx = processIdx * receiveTrisSize;
 
             std::vector<std::array<float, 3> > points(numVerts[processIdx]);
-            std::vector<std::array<float, 3> > normals(numVerts[processIdx]);
-            std::vector<std::array<size_t, 3> > indexTriangles(numTris[processIdx]);
+            std::vector<std::array<float, 3> > normals(
+                withNormals ? numVerts[processIdx] : 0);
+            std::vector<std::array<util::index_t, 3> > indexTriangles(numTris[processIdx]);
 
             for(int i = 0; i != points.size(); ++i)
             {
                 points[i][0] = receiveVerts[vIdx++];
                 points[i][1] = receiveVerts[vIdx++];
                 points[i][2] = receiveVerts[vIdx++];
-                normals[i][0] = receiveVerts[vIdx++];
-                normals[i][1] = receiveVerts[vIdx++];
-                normals[i][2] = receiveVerts[vIdx++];
+                if(withNormals)
+                {
+                    normals[i][0] = receiveVerts[vIdx++];
+                    normals[i][1] = receiveVerts[vIdx++];
+                    normals[i][2] = receiveVerts[vIdx++];
+                }
             }
 
-            for(std::array<size_t, 3>& tri: indexTriangles)
+            for(std::array<util::index_t, 3>& tri: indexTriangles)
             {
                 tri[0] = receiveTris[tIdx++];
                 tri[1] = receiveTris[tIdx++];
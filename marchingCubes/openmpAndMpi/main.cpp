@@ -15,7 +15,7 @@
 
 #include <array>
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
 
 #include <string>
 #include <string.h>
@@ -25,13 +25,20 @@
 #include <chrono>
 #include <iomanip>
 
+#include <omp.h>
+
 #include "../util/Image3D.h"
+#include "../util/CaseIdKernels.h"
+#include "../util/EdgePointMap.h"
+#include "../util/GradientProvider.h"
+#include "../util/MeshNormals.h"
+#include "../util/ParallelScan.h"
 #include "../util/TriangleMesh.h"
 
 #include "../util/LoadImage.h"
 #include "../util/SaveTriangleMesh.h"
 
-#include "../util/util.h"     // for findCaseId and interpolate
+#include "../util/util.h"     // for interpolate
 #include "../util/TypeInfo.h"
 #include "../util/MarchingCubesTables.h"
 #include "../util/DuplicateRemover.h"
@@ -50,11 +57,16 @@ void
 sectionOfMarchingCubes(
     T const&                                isoval,
     util::Image3D<T> const&                 image,
+    util::NormalMode const&                 normalMode,
+    typename util::GradientProvider<T>::Reader& gradReader, // reference
     std::vector<std::array<T, 3> >&         points,         // reference
     std::vector<std::array<T, 3> >&         normals,        // reference
-    std::vector<std::array<size_t, 3> >&  indexTriangles, // reference
-    std::unordered_map<size_t, size_t>& pointMap)       // reference
+    std::vector<std::array<util::index_t, 3> >&  indexTriangles, // reference
+    util::EdgePointMap&                     pointMap,       // reference
+    std::vector<size_t>&                    pointEdges)     // reference
 {
+    bool gradientNormals = normalMode == util::NormalMode::gradient;
+
     // For each cube, determine whether or not the isosurface intersects
     // the given cube. If so, first find the cube configuration from a lookup
     // table. Then add the triangles of that cube configuration to points,
@@ -69,30 +81,39 @@ sectionOfMarchingCubes(
     size_t yend = image.yEndIdx();
     size_t zend = image.zEndIdx();
 
+    pointMap.reset(xbeg, ybeg, xend, yend);
+
+    // The case of each cube of the current row
+    size_t const nCubes = xend - xbeg;
+    std::vector<unsigned char> caseIds(nCubes);
+
     size_t ptIdx = points.size();
     for(size_t zidx = zbeg; zidx != zend; ++zidx)
     {
+        pointMap.beginSlice(zidx);
+
         for(size_t yidx = ybeg; yidx != yend; ++yidx)
         {
             // A buffer is used to improve cache efficency when retrieving
             // vertex values of each cube.
             auto buffer = image.createBuffer(xbeg, yidx, zidx);
 
-            for(size_t xidx = xbeg; xidx != xend; ++xidx)
+            // The cases of all the cubes of the row are found at once.
+            // The 0th and 255th cases are the cases where the isosurface
+            // does not intersect the cube, so those cubes are skipped.
+            buffer.getCaseIds(xend, isoval, caseIds.data());
+
+            for(size_t c = util::nextCutCube(caseIds.data(), 0, nCubes);
+                c != nCubes;
+                c = util::nextCutCube(caseIds.data(), c + 1, nCubes))
             {
+                size_t xidx = xbeg + c;
+                int cellCaseId = caseIds[c];
+
                 // For each x, y, z index, get the corresponding 8 scalar values
                 // of a cube with one corner being at the x, y, z index.
                 std::array<T, 8> cubeVertexVals = buffer.getCubeVertexValues(xidx);
 
-                int cellCaseId = util::findCaseId(cubeVertexVals, isoval);
-
-                // The 0th and 255th cellCaseId are the cases where the isosurface
-                // does not intersect the cube.
-                if (cellCaseId == 0 || cellCaseId == 255)
-                {
-                    continue;
-                }
-
                 // From a pre-generated list of possible cube configurations,
                 // get the corresponding "triangles" to this caseId. Each
                 // triangle contains 3 cube edge endices, where each vertex
@@ -106,8 +127,12 @@ sectionOfMarchingCubes(
                 // calculating gradients.
                 std::array<std::array<T, 3>, 8> posCube =
                     image.getPosCube(xidx, yidx, zidx);
-                std::array<std::array<T, 3>, 8> gradCube =
-                    image.getGradCube(xidx, yidx, zidx);
+                // Without gradient normals, no gradients are read.
+                std::array<std::array<T, 3>, 8> gradCube;
+                if(gradientNormals)
+                {
+                    gradCube = gradReader.getGradCube(xidx, yidx, zidx);
+                }
 
                 // For each edge in each triangle, find it's global edge index.
                 // If the point and normal for that  global edge index has not
@@ -118,28 +143,36 @@ sectionOfMarchingCubes(
                 for(; *triEdges != -1; triEdges += 3)
                 {
                     // tri contains indices to points and normals
-                    std::array<size_t, 3> tri;
+                    std::array<util::index_t, 3> tri;
                     for(int i = 0; i != 3; ++i)
                     {
-                        size_t globalEdgeIndex =
-                            image.getGlobalEdgeIndex(xidx, yidx, zidx, triEdges[i]);
-
-                        if(pointMap.find(globalEdgeIndex) != pointMap.end())
+                        // The index of the point on this edge in points and
+                        // normals. If it has not been calculated, even by
+                        // an earlier section, it is calculated below at
+                        // ptIdx.
+                        size_t const pointIdx = pointMap.findOrAdd(
+                            xidx, yidx, triEdges[i], ptIdx);
+
+                        if(pointIdx != util::noPoint)
                         {
-                            // This global edge index has an associated index
+                            // This edge has an associated index
                             // corresponding to its point and normal in points
                             // and normals.
 
-                            tri[i] = pointMap[globalEdgeIndex];
+                            tri[i] = pointIdx;
                         }
                         else
                         {
-                            // This point and normal value on this global edge
-                            // index has not been calculated.
+                            // This point and normal value on this edge has
+                            // not been calculated.
 
-                            pointMap[globalEdgeIndex] = ptIdx;
                             tri[i] = ptIdx++;
 
+                            // The global edge index of each point tells
+                            // the duplicates of other sections apart.
+                            pointEdges.push_back(image.getGlobalEdgeIndex(
+                                xidx, yidx, zidx, triEdges[i]));
+
                             const int *vs = util::edgeVertices[triEdges[i]];
                             int v1 = vs[0];
                             int v2 = vs[1];
@@ -148,11 +181,12 @@ sectionOfMarchingCubes(
 
                             std::array<T, 3> newPt =
                                 util::interpolate(posCube[v1], posCube[v2], w);
-                            std::array<T, 3> newNorm =
-                                util::interpolate(gradCube[v1], gradCube[v2], w);
-
                             points.push_back(newPt);
-                            normals.push_back(newNorm);
+                            if(gradientNormals)
+                            {
+                                normals.push_back(
+                                    util::interpolate(gradCube[v1], gradCube[v2], w));
+                            }
                         }
                     }
 
@@ -169,13 +203,15 @@ sectionOfMarchingCubes(
 
 template <typename T>
 util::TriangleMesh<T>
-MarchingCubes(std::vector<util::Image3D<T> > const& images, T const& isoval)
+MarchingCubes(std::vector<util::Image3D<T> > const& images, T const& isoval,
+    util::GradientMode const& gradientMode,
+    util::NormalMode const& normalMode,
+    util::DuplicateRemoval const& duplicateRemoval,
+    util::DuplicateRemoverTimes& duplicateTimes)
 {
     std::vector<std::array<T, 3> > processPoints;
     std::vector<std::array<T, 3> > processNormals;
-    std::vector<std::array<size_t, 3> > processIndexTriangles;
-
-    std::unordered_map<size_t, size_t> processPointMap;
+    std::vector<std::array<util::index_t, 3> > processIndexTriangles;
 
     // If multiple threads are present, points may be added
     // more than once. To fix this, duplicateTracker will be filled with pairs
@@ -184,92 +220,115 @@ MarchingCubes(std::vector<util::Image3D<T> > const& images, T const& isoval)
     // the final, duplicate free mesh of this processor.
     std::vector<std::pair<size_t, size_t> > duplicateTracker;
 
+    // The sizes of the mesh of each thread, and then where they start in
+    // the output.
+    std::vector<size_t> threadPointOffsets(omp_get_max_threads());
+    std::vector<size_t> threadTriangleOffsets(omp_get_max_threads());
+
+    // The bounds of the images along each axis, for the planes between
+    // them that the point map of each thread keeps.
+    std::array<std::vector<size_t>, 3> const bounds =
+        util::sectionBounds(images);
+
     #pragma omp parallel
     {
         // Each openMP thread manages it's own threadPoints, threadNormals,
         // threadIndexTriangles and threadPointMap.
         std::vector<std::array<T, 3> > threadPoints;
         std::vector<std::array<T, 3> > threadNormals;
-        std::vector<std::array<size_t, 3> > threadIndexTriangles;
-
-        // threadPointMap will be a dictionary from global edge indices
-        // to indices in threadPoints and threadNormals. Note that
-        // threadPoints and threadNormals share the same indices
-        // but are only unique among this section/thread of execution.
-        std::unordered_map<size_t, size_t> threadPointMap;
+        std::vector<std::array<util::index_t, 3> > threadIndexTriangles;
+
+        // threadPointMap will map the edges of the current z-slice of
+        // cubes of a section to indices in threadPoints and threadNormals.
+        // Note that threadPoints and threadNormals share the same indices.
+        // Its arrays are reused from one section to the next, and it keeps
+        // the points on the planes between sections, so a point between two
+        // sections of this thread is only made once.
+        util::EdgePointMap threadPointMap;
+        threadPointMap.resetSections(bounds);
+        // The global edge index of each point in threadPoints
+        std::vector<size_t> threadPointEdges;
 
         size_t numSections = images.size();
 
         #pragma omp for nowait
         for(size_t i = 0; i < numSections; ++i)
         {
-            // How does this work? TODO
-            // For performance reasons, rehashing the unordered map.
             util::Image3D<T> const& image = images[i];
-            size_t approxNumberOfEdges = 3 *
-                (image.xEndIdx() - image.xBeginIdx()) *
-                (image.yEndIdx() - image.yBeginIdx()) *
-                (image.zEndIdx() - image.zBeginIdx()) ;
-            size_t mapSize = approxNumberOfEdges / 8 + 6;
-            threadPointMap.rehash(mapSize);
+
+            // The gradients used for the normals are found by gradients, see
+            // util::GradientMode. With other normal modes the gradients aren't
+            // needed, so nothing is precomputed or cached for them.
+            util::GradientProvider<T> gradients(image,
+                normalMode == util::NormalMode::gradient ?
+                    gradientMode : util::GradientMode::onTheFly);
+            typename util::GradientProvider<T>::Reader gradReader(gradients);
 
             // Variables for this thread of execution are given by reference and
             // will be modified.
             sectionOfMarchingCubes(
                 isoval, image,                  // constant inputs
+                normalMode,                     // constant inputs
+                gradReader,                     // for modification, taken by reference
                 threadPoints,                   // for modification, taken by reference
                 threadNormals,                  // for modification, taken by reference
                 threadIndexTriangles,           // for modification, taken by reference
-                threadPointMap);                // for modification, taken by reference
+                threadPointMap,                 // for modification, taken by reference
+                threadPointEdges);              // for modification, taken by reference
         }
 
-        // As each section is complete, the mesh information is added to
-        // points, normals and indexTriangles and duplicateTracker. The triangles
-        // in threadIndexTriangles will have to be offset to have indices
-        // that coincide with points and not threadPoints.
-        //
-        // critical ensures that this block of code will execute one
-        // thread at a time.
-        #pragma omp critical
+        // Each thread copies its mesh into processPoints, processNormals,
+        // processIndexTriangles and duplicateTracker after the meshes of the
+        // threads before it, so the output is in the same order every run.
+        // Where each thread's mesh goes is found by scanning the sizes of the
+        // thread meshes.
+        int tID = omp_get_thread_num();
+        threadPointOffsets[tID] = threadPoints.size();
+        threadTriangleOffsets[tID] = threadIndexTriangles.size();
+
+        #pragma omp barrier
+        #pragma omp single
         {
-            // Reserve space in points, normals and indexTriangles so that
-            // these vectors don't have to resize themselves constantly.
-            processPoints.reserve(processPoints.size() + threadPoints.size());
-            processNormals.reserve(processNormals.size() + threadNormals.size());
-            processIndexTriangles.reserve(
-                processIndexTriangles.size() + threadIndexTriangles.size());
-
-            size_t offset = processPoints.size();
-
-            processPoints.insert(
-                processPoints.end(), threadPoints.begin(), threadPoints.end());
-            processNormals.insert(
-                processNormals.end(), threadNormals.begin(), threadNormals.end());
-
-            // The points refered to in each tri need to refer to the points
-            // in the points vector, not threadPoints.
-            for(std::array<size_t, 3>& tri: threadIndexTriangles)
-            {
-                tri[0] = tri[0] + offset;
-                tri[1] = tri[1] + offset;
-                tri[2] = tri[2] + offset;
-            }
+            size_t numPoints = util::exclusiveScan<size_t>(
+                threadPointOffsets.data(), threadPointOffsets.size());
+            size_t numTriangles = util::exclusiveScan<size_t>(
+                threadTriangleOffsets.data(), threadTriangleOffsets.size());
+
+            processPoints.resize(numPoints);
+            processNormals.resize(
+                normalMode == util::NormalMode::gradient ? numPoints : 0);
+            processIndexTriangles.resize(numTriangles);
+            duplicateTracker.resize(numPoints);
+        }
+
+        size_t offset = threadPointOffsets[tID];
+        std::copy(threadPoints.begin(), threadPoints.end(),
+                  processPoints.begin() + offset);
+        if(!threadNormals.empty())
+        {
+            std::copy(threadNormals.begin(), threadNormals.end(),
+                      processNormals.begin() + offset);
+        }
 
-            processIndexTriangles.insert(
-                processIndexTriangles.end(),
-                threadIndexTriangles.begin(), threadIndexTriangles.end());
+        // The points refered to in each tri need to refer to the points
+        // in the points vector, not threadPoints.
+        size_t triIdx = threadTriangleOffsets[tID];
+        for(std::array<util::index_t, 3> const& tri: threadIndexTriangles)
+        {
+            std::array<util::index_t, 3>& outTri = processIndexTriangles[triIdx++];
+            outTri[0] = tri[0] + offset;
+            outTri[1] = tri[1] + offset;
+            outTri[2] = tri[2] + offset;
+        }
 
-            // duplicateTracker provides information for the util::duplicateRemover
-            // function.
-            duplicateTracker.resize(offset + threadPointMap.size());
-            for(auto iter = threadPointMap.begin(); iter != threadPointMap.end(); ++iter)
-            {
-                size_t const& pointIndex = offset + iter->second;
-                size_t const& globalEdgeIndex = iter->first;
+        // duplicateTracker provides information for the util::duplicateRemover
+        // function.
+        for(size_t ptIdx = 0; ptIdx != threadPointEdges.size(); ++ptIdx)
+        {
+            size_t const pointIndex = offset + ptIdx;
 
-                duplicateTracker[pointIndex] =
-                    std::make_pair(pointIndex, globalEdgeIndex);
-            }
+            duplicateTracker[pointIndex] =
+                std::make_pair(pointIndex, threadPointEdges[ptIdx]);
         }
     }
 
@@ -279,8 +338,16 @@ MarchingCubes(std::vector<util::Image3D<T> > const& images, T const& isoval)
         return util::TriangleMesh<T>();
     }
 
-    return util::duplicateRemover(
-        duplicateTracker, processPoints, processNormals, processIndexTriangles);
+    // The face normals of this process's mesh only see its own triangles.
+    // See main for the single output mesh.
+    util::TriangleMesh<T> mesh = util::duplicateRemover(
+        duplicateTracker, processPoints, processNormals, processIndexTriangles,
+        duplicateRemoval, duplicateTimes);
+    if(normalMode == util::NormalMode::face)
+    {
+        util::computeFaceNormals(mesh);
+    }
+    return mesh;
 }
 
 int main(int argc, char* argv[])
@@ -291,12 +358,15 @@ int main(int argc, char* argv[])
     int pid = MPI::COMM_WORLD.Get_rank();
     int nProcesses = MPI::COMM_WORLD.Get_size();
 
-
     float isoval;
     bool isovalSet = false;
     char* vtkFile = NULL;
     char* outFile = NULL;
     bool oneOutputMesh = false;
+    char* gradientName = NULL;
+    size_t gradientMemory = 1024; // MiB
+    char* normalName = NULL;
+    char* duplicateRemovalName = NULL;
     std::string yamlDirectory = "";
     std::string yamlFileName  = "";
 
@@ -336,6 +406,22 @@ int main(int argc, char* argv[])
         {
             oneOutputMesh = atoi(argv[++i]);
         }
+        else if( (strcmp(argv[i], "-g") == 0) || (strcmp(argv[i], "-gradient") == 0))
+        {
+            gradientName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-gm") == 0) || (strcmp(argv[i], "-gradient_memory") == 0))
+        {
+            gradientMemory = std::stoul(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-normals") == 0))
+        {
+            normalName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-dr") == 0) || (strcmp(argv[i], "-duplicate_removal") == 0))
+        {
+            duplicateRemovalName = argv[++i];
+        }
         else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
         {
             std::string wholeFile(argv[++i]);
@@ -363,6 +449,15 @@ int main(int argc, char* argv[])
                 "  -sections_y (-sy)"             << std::endl <<
                 "  -sections_z (-sz)"             << std::endl <<
                 "  -one_mesh (-m), default 0"     << std::endl <<
+                "  -gradient (-g), default auto"  << std::endl <<
+                "    auto, onthefly, rolling or"  << std::endl <<
+                "    precomputed"                 << std::endl <<
+                "  -gradient_memory (-gm), MiB,"  << std::endl <<
+                "    default 1024"                << std::endl <<
+                "  -normals (-n), default"        << std::endl <<
+                "    gradient, none or face"      << std::endl <<
+                "  -duplicate_removal (-dr),"     << std::endl <<
+                "    default radix, or sort"      << std::endl <<
                 "  -yaml_output_file (-y)"        << std::endl <<
                 "  -help (-h)"                    << std::endl;
             return 0;
@@ -376,6 +471,37 @@ int main(int argc, char* argv[])
         return 0;
     }
 
+    bool autoGradient =
+        gradientName == NULL || strcmp(gradientName, "auto") == 0;
+    util::GradientMode gradientMode = util::GradientMode::onTheFly;
+    if(!autoGradient && !util::parseGradientMode(gradientName, gradientMode))
+    {
+        std::cout << "Error: unknown gradient mode " << gradientName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::NormalMode normalMode = util::NormalMode::gradient;
+    if(normalName != NULL && !util::parseNormalMode(normalName, normalMode))
+    {
+        std::cout << "Error: unknown normal mode " << normalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    // The points on the faces between the images of different processes
+    // aren't told apart from the others, so every point is tracked here and
+    // DuplicateRemoval::boundary isn't offered.
+    util::DuplicateRemoval duplicateRemoval = util::DuplicateRemoval::radix;
+    if(duplicateRemovalName != NULL &&
+       (!util::parseDuplicateRemoval(duplicateRemovalName, duplicateRemoval) ||
+        duplicateRemoval == util::DuplicateRemoval::boundary))
+    {
+        std::cout << "Error: unknown duplicate removal " << duplicateRemovalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
     // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
     // YAML_Doc will create a file at in the current directory with a
     // timestamp on it.
@@ -397,6 +523,22 @@ int main(int argc, char* argv[])
     if(nSectionsZ > images[0].zdimension() - 1)
         nSectionsZ = images[0].zdimension() - 1;
 
+    // Without a gradient mode given, use the fastest one that fits in the
+    // gradient memory budget. Each section has its own gradients.
+    std::array<size_t, 3> sectionDim;
+    for(int d = 0; d != 3; ++d)
+    {
+        sectionDim[d] =
+            images[0].dataEndIdx()[d] - images[0].dataBeginIdx()[d];
+    }
+    size_t gradientBudget = gradientMemory << 20;
+    if(autoGradient)
+    {
+        gradientMode = util::chooseGradientMode<float>(
+            sectionDim[0], sectionDim[1], sectionDim[2] * omp_get_max_threads(),
+            omp_get_max_threads(), gradientBudget);
+    }
+
     if (pid == 0)
     {
         // images should never be empty on the 0th processer.
@@ -408,6 +550,9 @@ int main(int argc, char* argv[])
         doc.add("Volume image data file path", vtkFile);
         doc.add("Polygonal mesh output file", outFile);
         doc.add("Isoval", isoval);
+        doc.add("Normal mode", util::normalModeName(normalMode));
+        doc.add("Case ID kernel", util::caseIdKernelName());
+        doc.add("Duplicate removal", util::duplicateRemovalName(duplicateRemoval));
         doc.add("Number of X sections", nSectionsX);
         doc.add("Number of Y sections", nSectionsY);
         doc.add("Number of Z sections", nSectionsZ);
@@ -415,6 +560,8 @@ int main(int argc, char* argv[])
         doc.add("File x-dimension", xdim);
         doc.add("File y-dimension", ydim);
         doc.add("File z-dimension", zdim);
+        doc.add("Gradient mode", util::gradientModeName(gradientMode));
+        doc.add("Gradient memory budget (bytes)", gradientBudget);
     }
 
     MPI_Barrier(MPI_COMM_WORLD);
@@ -426,7 +573,10 @@ int main(int argc, char* argv[])
     // loaded at vtkFile and the isoval of the surface to approximate. It's
     // output is a TriangleMesh which stores the mesh as a vector
     // of triangles.
-    util::TriangleMesh<float> polygonalMesh = MarchingCubes(images, isoval);
+    util::DuplicateRemoverTimes duplicateTimes;
+    util::TriangleMesh<float> polygonalMesh =
+        MarchingCubes(images, isoval, gradientMode, normalMode,
+                      duplicateRemoval, duplicateTimes);
 
     // End timing
     runTime.stop();
@@ -438,6 +588,10 @@ int main(int argc, char* argv[])
     double CPUticksHere = runTime.getTotalTicks();
     double CPUtimeHere = runTime.getCPUtime();
     double wallTimeHere = runTime.getWallTime();
+    double duplicateTimesHere[4] = { duplicateTimes.sort,
+                                     duplicateTimes.relabel,
+                                     duplicateTimes.scatter,
+                                     duplicateTimes.remap };
 
     // The size of the vectors should be 0 for all processes except the 0 process
     int gatherSize = 0;
@@ -452,6 +606,7 @@ int main(int argc, char* argv[])
     std::vector<double> CPUticks(gatherSize);
     std::vector<double> CPUtimes(gatherSize);
     std::vector<double> wallTimes(gatherSize);
+    std::vector<double> duplicateTimesAll(4 * gatherSize);
 
     MPI_Gather(&numSectionsHere, 1, my_MPI_SIZE_T,
                numSections.data(), 1, my_MPI_SIZE_T,
@@ -471,6 +626,9 @@ int main(int argc, char* argv[])
     MPI_Gather(&wallTimeHere, 1, MPI_DOUBLE,
                wallTimes.data(), 1, MPI_DOUBLE,
                0, MPI_COMM_WORLD);
+    MPI_Gather(duplicateTimesHere, 4, MPI_DOUBLE,
+               duplicateTimesAll.data(), 4, MPI_DOUBLE,
+               0, MPI_COMM_WORLD);
 
     // Only create the YAML file on process zero
     if(pid == 0)
@@ -493,6 +651,10 @@ int main(int argc, char* argv[])
             doc.get(process)->add("CPU Time (clicks)", CPUticks[i]);
             doc.get(process)->add("CPU Time (seconds)", CPUtimes[i]);
             doc.get(process)->add("Wall Time (seconds)", wallTimes[i]);
+            doc.get(process)->add("Duplicate removal sort wall time (seconds)", duplicateTimesAll[4*i]);
+            doc.get(process)->add("Duplicate removal relabel wall time (seconds)", duplicateTimesAll[4*i + 1]);
+            doc.get(process)->add("Duplicate removal scatter wall time (seconds)", duplicateTimesAll[4*i + 2]);
+            doc.get(process)->add("Duplicate removal remap wall time (seconds)", duplicateTimesAll[4*i + 3]);
 
             totalSections += numSections[i];
             totalTriangles += numTris[i];
@@ -515,13 +677,20 @@ int main(int argc, char* argv[])
         // output mesh for each processer. gatherMeshes and mergeMeshes
         // are not designed to be performant.
 
+        // Face normals are made again once the meshes are merged, since
+        // the triangles around a point can be on several processes.
         std::vector<util::TriangleMesh<float> > meshes =
-            mpiutil::gatherMeshes(polygonalMesh, pid, numVerts, numTris);
+            mpiutil::gatherMeshes(polygonalMesh, pid, numVerts, numTris,
+                normalMode == util::NormalMode::gradient);
 
         if(pid == 0)
         {
             util::TriangleMesh<float> globalPolygonalMesh =
                 mpiutil::mergeMeshes(meshes);
+            if(normalMode == util::NormalMode::face)
+            {
+                util::computeFaceNormals(globalPolygonalMesh);
+            }
 
             util::saveTriangleMesh(globalPolygonalMesh, outFile);
         }
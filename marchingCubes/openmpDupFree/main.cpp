@@ -15,7 +15,7 @@
 
 #include <array>
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
 
 #include <string>
 #include <string.h>
@@ -28,12 +28,17 @@
 #include <omp.h>
 
 #include "../util/Image3D.h"
+#include "../util/CaseIdKernels.h"
+#include "../util/EdgePointMap.h"
+#include "../util/GradientProvider.h"
+#include "../util/MeshNormals.h"
+#include "../util/ParallelScan.h"
 #include "../util/TriangleMesh.h"
 
 #include "../util/LoadImage.h"
 #include "../util/SaveTriangleMesh.h"
 
-#include "../util/util.h"     // for findCaseId and interpolate
+#include "../util/util.h"     // for interpolate
 #include "../util/MarchingCubesTables.h"
 #include "../util/DuplicateRemover.h"
 
@@ -49,41 +54,56 @@ sectionOfMarchingCubes(
     size_t const& xend, size_t const& yend, size_t const& zend,
     T const&                                isoval,
     util::Image3D<T> const&                 image,
+    util::NormalMode const&                 normalMode,
+    typename util::GradientProvider<T>::Reader& gradReader, // reference
     std::vector<std::array<T, 3> >&         points,         // reference
     std::vector<std::array<T, 3> >&         normals,        // reference
-    std::vector<std::array<size_t, 3> >&  indexTriangles, // reference
-    std::unordered_map<size_t, size_t>& pointMap)       // reference
+    std::vector<std::array<util::index_t, 3> >&  indexTriangles, // reference
+    util::EdgePointMap&                     pointMap,       // reference
+    bool                                    boundaryOnly,
+    std::vector<std::pair<size_t, size_t> >& trackedPoints) // reference
 {
+    bool gradientNormals = normalMode == util::NormalMode::gradient;
+
     // For each cube, determine whether or not the isosurface intersects
     // the given cube. If so, first find the cube configuration from a lookup
     // table. Then add the triangles of that cube configuration to points,
     // normals and triangles. Use pointMap to not add any duplicates on
     // this thread to points or normals
 
+    pointMap.reset(xbeg, ybeg, xend, yend);
+
+    // The case of each cube of the current row
+    size_t const nCubes = xend - xbeg;
+    std::vector<unsigned char> caseIds(nCubes);
+
     size_t ptIdx = points.size();
     for(size_t zidx = zbeg; zidx != zend; ++zidx)
     {
+        pointMap.beginSlice(zidx);
+
         for(size_t yidx = ybeg; yidx != yend; ++yidx)
         {
             // A buffer is used to improve cache efficency when retrieving
             // vertex values of each cube.
             auto buffer = image.createBuffer(xbeg, yidx, zidx);
 
-            for(size_t xidx = xbeg; xidx != xend; ++xidx)
+            // The cases of all the cubes of the row are found at once.
+            // The 0th and 255th cases are the cases where the isosurface
+            // does not intersect the cube, so those cubes are skipped.
+            buffer.getCaseIds(xend, isoval, caseIds.data());
+
+            for(size_t c = util::nextCutCube(caseIds.data(), 0, nCubes);
+                c != nCubes;
+                c = util::nextCutCube(caseIds.data(), c + 1, nCubes))
             {
+                size_t xidx = xbeg + c;
+                int cellCaseId = caseIds[c];
+
                 // For each x, y, z index, get the corresponding 8 scalar values
                 // of a cube with one corner being at the x, y, z index.
                 std::array<T, 8> cubeVertexVals = buffer.getCubeVertexValues(xidx);
 
-                int cellCaseId = util::findCaseId(cubeVertexVals, isoval);
-
-                // The 0th and 255th cellCaseId are the cases where the isosurface
-                // does not intersect the cube.
-                if (cellCaseId == 0 || cellCaseId == 255)
-                {
-                    continue;
-                }
-
                 // From a pre-generated list of possible cube configurations,
                 // get the corresponding "triangles" to this caseId. Each
                 // triangle contains 3 cube edge endices, where each vertex
@@ -97,8 +117,12 @@ sectionOfMarchingCubes(
                 // calculating gradients.
                 std::array<std::array<T, 3>, 8> posCube =
                     image.getPosCube(xidx, yidx, zidx);
-                std::array<std::array<T, 3>, 8> gradCube =
-                    image.getGradCube(xidx, yidx, zidx);
+                // Without gradient normals, no gradients are read.
+                std::array<std::array<T, 3>, 8> gradCube;
+                if(gradientNormals)
+                {
+                    gradCube = gradReader.getGradCube(xidx, yidx, zidx);
+                }
 
                 // For each edge in each triangle, find it's global edge index.
                 // If the point and normal for that  global edge index has not
@@ -109,26 +133,42 @@ sectionOfMarchingCubes(
                 for(; *triEdges != -1; triEdges += 3)
                 {
                     // tri contains indices to points and normals
-                    std::array<size_t, 3> tri;
+                    std::array<util::index_t, 3> tri;
                     for(int i = 0; i != 3; ++i)
                     {
-                        size_t globalEdgeIndex =
-                            image.getGlobalEdgeIndex(xidx, yidx, zidx, triEdges[i]);
-
-                        if(pointMap.find(globalEdgeIndex) != pointMap.end())
+                        // The index of the point on this edge in points and
+                        // normals. If it has not been calculated, even by
+                        // an earlier section, it is calculated below at
+                        // ptIdx.
+                        size_t const pointIdx = pointMap.findOrAdd(
+                            xidx, yidx, triEdges[i], ptIdx);
+
+                        if(pointIdx != util::noPoint)
                         {
-                            // This global edge index has an associated index
+                            // This edge has an associated index
                             // corresponding to its point and normal in points
                             // and normals.
 
-                            tri[i] = pointMap[globalEdgeIndex];
+                            tri[i] = pointIdx;
                         }
                         else
                         {
-                            // This point and normal value on this global edge
-                            // index has not been calculated.
+                            // This point and normal value on this edge has
+                            // not been calculated.
+
+                            // The global edge index of each point tells
+                            // the duplicates of other sections apart. With
+                            // boundaryOnly, only the points that other
+                            // sections can make too are tracked.
+                            if(!boundaryOnly ||
+                               pointMap.betweenSections(
+                                   xidx, yidx, triEdges[i]))
+                            {
+                                trackedPoints.push_back(std::make_pair(
+                                    ptIdx, image.getGlobalEdgeIndex(
+                                        xidx, yidx, zidx, triEdges[i])));
+                            }
 
-                            pointMap[globalEdgeIndex] = ptIdx;
                             tri[i] = ptIdx++;
 
                             const int *vs = util::edgeVertices[triEdges[i]];
@@ -139,10 +179,12 @@ sectionOfMarchingCubes(
 
                             std::array<T, 3> newPt =
                                 util::interpolate(posCube[v1], posCube[v2], w);
-                            std::array<T, 3> newNorm =
-                                util::interpolate(gradCube[v1], gradCube[v2], w);
                             points.push_back(newPt);
-                            normals.push_back(newNorm);
+                            if(gradientNormals)
+                            {
+                                normals.push_back(
+                                    util::interpolate(gradCube[v1], gradCube[v2], w));
+                            }
                         }
                     }
 
@@ -160,7 +202,11 @@ sectionOfMarchingCubes(
 template <typename T>
 util::TriangleMesh<T>
 MarchingCubes(util::Image3D<T> const& image, T const& isoval,
-    size_t const& nSectionsX, size_t const& nSectionsY, size_t const& nSectionsZ)
+    size_t const& nSectionsX, size_t const& nSectionsY, size_t const& nSectionsZ,
+    util::GradientMode const& gradientMode,
+    util::NormalMode const& normalMode,
+    util::DuplicateRemoval const& duplicateRemoval,
+    util::DuplicateRemoverTimes& duplicateTimes)
 {
     // The marching cubes algorithm creates a polygonal mesh to approximate an
     // isosurface from a three-dimensional discrete scalar field.
@@ -177,13 +223,14 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval,
     // Example:
     //   If indexTriangles[5] = {1, 4, 2}, then the polygonal mesh will contain
     //   a triangle with vertices at points[1], points[4] and points[2].
-    std::vector<std::array<size_t, 3> > indexTriangles;
+    std::vector<std::array<util::index_t, 3> > indexTriangles;
 
     // If multiple threads or processes are present, points may be added
     // more than once. To fix this, duplicateTracker will be filled with pairs
     // containing the point index in points/normals and the global edge index.
     // Later, util::duplicateRemover will remove the duplicates and return
-    // the final, duplicate free mesh.
+    // the final, duplicate free mesh. With DuplicateRemoval::boundary, only
+    // the points on the faces between sections are in duplicateTracker.
     std::vector<std::pair<size_t, size_t> > duplicateTracker;
 
     // Using OpenMP, this code is ran in parallel one section at a time.
@@ -222,23 +269,70 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval,
     size_t nSections = nSectionsX * nSectionsY * nSectionsZ;
     size_t nSectionsPerPage = nSectionsX * nSectionsY;
 
+    // The gradients used for the normals are found by gradients, see
+    // util::GradientMode. With other normal modes the gradients aren't
+    // needed, so nothing is precomputed or cached for them.
+    util::GradientProvider<T> gradients(image,
+        normalMode == util::NormalMode::gradient ?
+            gradientMode : util::GradientMode::onTheFly);
+
+    // The sizes of the mesh of each section, and then where they start in
+    // the output. The meshes of the sections are put in the output in order
+    // of section index, whichever thread made them.
+    std::vector<size_t> sectionPointOffsets(nSections);
+    std::vector<size_t> sectionTriangleOffsets(nSections);
+    std::vector<size_t> sectionTrackedOffsets(nSections);
+
+    bool const boundaryOnly =
+        duplicateRemoval == util::DuplicateRemoval::boundary;
+
+    // The bounds of the sections along each axis, for the planes between
+    // them that the point map of each thread keeps.
+    std::array<std::vector<size_t>, 3> const bounds = {{
+        util::sectionBounds(indexerX, nSectionsX),
+        util::sectionBounds(indexerY, nSectionsY),
+        util::sectionBounds(indexerZ, nSectionsZ) }};
+
     #pragma omp parallel
     {
+        // Each openMP thread reads gradients through its own reader since a
+        // reader holds the rolling cache.
+        typename util::GradientProvider<T>::Reader gradReader(gradients);
+
         // Each openMP thread manages it's own threadPoints, threadNormals,
         // threadIndexTriangles and threadPointMap.
         std::vector<std::array<T, 3> > threadPoints;
         std::vector<std::array<T, 3> > threadNormals;
-        std::vector<std::array<size_t, 3> > threadIndexTriangles;
-
-        // threadPointMap will be a dictionary from global edge indices
-        // to indices in threadPoints and threadNormals. Note that
-        // threadPoints and threadNormals share the same indices
-        // but are only unique among this section/thread of execution.
-        std::unordered_map<size_t, size_t> threadPointMap;
+        std::vector<std::array<util::index_t, 3> > threadIndexTriangles;
+
+        // threadPointMap will map the edges of the current z-slice of
+        // cubes of a section to indices in threadPoints and threadNormals.
+        // Note that threadPoints and threadNormals share the same indices.
+        // Its arrays are reused from one section to the next, and it keeps
+        // the points on the planes between sections, so a point between two
+        // sections of this thread is only made once.
+        util::EdgePointMap threadPointMap;
+        threadPointMap.resetSections(bounds);
+        // The index in threadPoints and the global edge index of each
+        // point that may have duplicates.
+        std::vector<std::pair<size_t, size_t> > threadTrackedPoints;
+
+        // The sections this thread made, and where the mesh of each of them
+        // begins in threadPoints, threadIndexTriangles and
+        // threadTrackedPoints.
+        std::vector<size_t> threadSections;
+        std::vector<size_t> threadSectionPoints;
+        std::vector<size_t> threadSectionTriangles;
+        std::vector<size_t> threadSectionTracked;
 
         #pragma omp for nowait
         for(size_t i = 0; i < nSections; ++i)
         {
+            threadSections.push_back(i);
+            threadSectionPoints.push_back(threadPoints.size());
+            threadSectionTriangles.push_back(threadIndexTriangles.size());
+            threadSectionTracked.push_back(threadTrackedPoints.size());
+
             // Determine the coordinates of this section.
             size_t xSectIdx = (i % nSectionsPerPage) % nSectionsX;
             size_t ySectIdx = (i % nSectionsPerPage) / nSectionsX;
@@ -253,70 +347,111 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval,
             size_t yend = indexerY(ySectIdx + 1);
             size_t zend = indexerZ(zSectIdx + 1);
 
-            // How does this work? TODO
-            // For performance reasons, rehashing the unordered map.
-            size_t approxNumberOfEdges = 3*(xend-xbeg)*(yend-ybeg)*(zend-zbeg);
-            size_t mapSize = approxNumberOfEdges / 8 + 6;
-            threadPointMap.rehash(mapSize);
-
             // Variables for this thread of execution are given by reference and
             // will be modified.
             sectionOfMarchingCubes(
                 xbeg, ybeg, zbeg,           // constant inputs
                 xend, yend, zend,           // constant inputs
                 isoval, image,              // constant inputs
+                normalMode,                 // constant inputs
+                gradReader,                 // for modification, taken by reference
                 threadPoints,              // for modification, taken by reference
                 threadNormals,             // for modification, taken by reference
                 threadIndexTriangles,      // for modification, taken by reference
-                threadPointMap);           // for modification, taken by reference
+                threadPointMap,            // for modification, taken by reference
+                boundaryOnly,              // constant inputs
+                threadTrackedPoints);      // for modification, taken by reference
         }
 
-        // As each section is complete, the mesh information is added to
-        // points, normals and indexTriangles and duplicateTracker. The triangles
-        // in threadIndexTriangles will have to be offset to have indices
-        // that coincide with points and not threadPoints.
-        //
-        // critical ensures that this block of code will execute one
-        // thread at a time.
-        #pragma omp critical
+        threadSectionPoints.push_back(threadPoints.size());
+        threadSectionTriangles.push_back(threadIndexTriangles.size());
+        threadSectionTracked.push_back(threadTrackedPoints.size());
+
+        // Each thread copies the mesh of each of its sections into the output
+        // at the place of that section, so the output is in the same order
+        // every run. Where each section's mesh goes is found by scanning the
+        // sizes of the section meshes, and then all threads copy at once.
+        for(size_t s = 0; s != threadSections.size(); ++s)
         {
-            // Reserve space in points, normals and indexTriangles so that
-            // these vectors don't have to resize themselves constantly.
-            points.reserve(points.size() + threadPoints.size());
-            normals.reserve(normals.size() + threadNormals.size());
-            indexTriangles.reserve(
-                indexTriangles.size() + threadIndexTriangles.size());
+            size_t sectIdx = threadSections[s];
+            sectionPointOffsets[sectIdx] =
+                threadSectionPoints[s + 1] - threadSectionPoints[s];
+            sectionTriangleOffsets[sectIdx] =
+                threadSectionTriangles[s + 1] - threadSectionTriangles[s];
+            sectionTrackedOffsets[sectIdx] =
+                threadSectionTracked[s + 1] - threadSectionTracked[s];
+        }
 
-            size_t offset = points.size();
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t numPoints = util::exclusiveScan<size_t>(
+                sectionPointOffsets.data(), sectionPointOffsets.size());
+            size_t numTriangles = util::exclusiveScan<size_t>(
+                sectionTriangleOffsets.data(), sectionTriangleOffsets.size());
+            size_t numTracked = util::exclusiveScan<size_t>(
+                sectionTrackedOffsets.data(), sectionTrackedOffsets.size());
+
+            points.resize(numPoints);
+            normals.resize(
+                normalMode == util::NormalMode::gradient ? numPoints : 0);
+            indexTriangles.resize(numTriangles);
+            duplicateTracker.resize(numTracked);
+        }
 
-            points.insert(
-                points.end(), threadPoints.begin(), threadPoints.end());
-            normals.insert(
-                normals.end(), threadNormals.begin(), threadNormals.end());
+        // Where point p of threadPoints is in the output. A tri may refer
+        // to a point on a face made by an earlier section of this thread.
+        auto outputIndex = [&](size_t p)
+        {
+            size_t sect = std::upper_bound(threadSectionPoints.begin(),
+                                           threadSectionPoints.end(), p) -
+                          threadSectionPoints.begin() - 1;
+            return sectionPointOffsets[threadSections[sect]] + p -
+                   threadSectionPoints[sect];
+        };
+
+        for(size_t s = 0; s != threadSections.size(); ++s)
+        {
+            size_t sectIdx = threadSections[s];
+            size_t pointBeg = threadSectionPoints[s];
+            size_t pointEnd = threadSectionPoints[s + 1];
+
+            size_t offset = sectionPointOffsets[sectIdx];
+            std::copy(threadPoints.begin() + pointBeg,
+                      threadPoints.begin() + pointEnd,
+                      points.begin() + offset);
+            if(!threadNormals.empty())
+            {
+                std::copy(threadNormals.begin() + pointBeg,
+                          threadNormals.begin() + pointEnd,
+                          normals.begin() + offset);
+            }
 
             // The points refered to in each tri need to refer to the points
             // in the points vector, not threadPoints.
-            for(std::array<size_t, 3>& tri: threadIndexTriangles)
+            size_t triIdx = sectionTriangleOffsets[sectIdx];
+            for(size_t t = threadSectionTriangles[s];
+                t != threadSectionTriangles[s + 1]; ++t)
             {
-                tri[0] = tri[0] + offset;
-                tri[1] = tri[1] + offset;
-                tri[2] = tri[2] + offset;
+                std::array<util::index_t, 3> const& tri =
+                    threadIndexTriangles[t];
+                std::array<util::index_t, 3>& outTri = indexTriangles[triIdx++];
+                for(int v = 0; v != 3; ++v)
+                {
+                    outTri[v] = outputIndex(tri[v]);
+                }
             }
 
-            indexTriangles.insert(
-                indexTriangles.end(),
-                threadIndexTriangles.begin(), threadIndexTriangles.end());
-
-            // duplicateTracker provides information for the util::duplicateRemover
-            // function.
-            duplicateTracker.resize(offset + threadPointMap.size());
-            for(auto iter = threadPointMap.begin(); iter != threadPointMap.end(); ++iter)
+            // duplicateTracker provides information for the
+            // util::duplicateRemover function.
+            size_t trackedIdx = sectionTrackedOffsets[sectIdx];
+            for(size_t p = threadSectionTracked[s];
+                p != threadSectionTracked[s + 1]; ++p)
             {
-                size_t const& pointIndex = offset + iter->second;
-                size_t const& globalEdgeIndex = iter->first;
-
-                duplicateTracker[pointIndex] =
-                    std::make_pair(pointIndex, globalEdgeIndex);
+                std::pair<size_t, size_t> const& tracked =
+                    threadTrackedPoints[p];
+                duplicateTracker[trackedIdx++] = std::make_pair(
+                    tracked.first - pointBeg + offset, tracked.second);
             }
         }
     }
@@ -327,8 +462,14 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval,
         return util::TriangleMesh<T>();
     }
 
-    return util::duplicateRemover(
-        duplicateTracker, points, normals, indexTriangles);
+    util::TriangleMesh<T> mesh = util::duplicateRemover(
+        duplicateTracker, points, normals, indexTriangles,
+        duplicateRemoval, duplicateTimes);
+    if(normalMode == util::NormalMode::face)
+    {
+        util::computeFaceNormals(mesh);
+    }
+    return mesh;
 }
 
 int main(int argc, char* argv[])
@@ -337,6 +478,10 @@ int main(int argc, char* argv[])
     bool isovalSet = false;
     char* vtkFile = NULL;
     char* outFile = NULL;
+    char* gradientName = NULL;
+    size_t gradientMemory = 1024; // MiB
+    char* normalName = NULL;
+    char* duplicateRemovalName = NULL;
     std::string yamlDirectory = "";
     std::string yamlFileName  = "";
 
@@ -385,6 +530,22 @@ int main(int argc, char* argv[])
         {
             nSectionsZ = std::stoul(argv[++i]);
         }
+        else if( (strcmp(argv[i], "-g") == 0) || (strcmp(argv[i], "-gradient") == 0))
+        {
+            gradientName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-gm") == 0) || (strcmp(argv[i], "-gradient_memory") == 0))
+        {
+            gradientMemory = std::stoul(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-normals") == 0))
+        {
+            normalName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-dr") == 0) || (strcmp(argv[i], "-duplicate_removal") == 0))
+        {
+            duplicateRemovalName = argv[++i];
+        }
         else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
         {
             std::string wholeFile(argv[++i]);
@@ -411,6 +572,16 @@ int main(int argc, char* argv[])
                 "  -sections_x (-sx)"             << std::endl <<
                 "  -sections_y (-sy)"             << std::endl <<
                 "  -sections_z (-sz)"             << std::endl <<
+                "  -gradient (-g), default auto"  << std::endl <<
+                "    auto, onthefly, rolling or"  << std::endl <<
+                "    precomputed"                 << std::endl <<
+                "  -gradient_memory (-gm), MiB,"  << std::endl <<
+                "    default 1024"                << std::endl <<
+                "  -normals (-n), default"        << std::endl <<
+                "    gradient, none or face"      << std::endl <<
+                "  -duplicate_removal (-dr),"     << std::endl <<
+                "    default boundary, or radix"  << std::endl <<
+                "    or sort"                     << std::endl <<
                 "  -yaml_output_file (-y)"        << std::endl <<
                 "  -help (-h)"                    << std::endl;
             return 0;
@@ -424,6 +595,34 @@ int main(int argc, char* argv[])
         return 0;
     }
 
+    bool autoGradient =
+        gradientName == NULL || strcmp(gradientName, "auto") == 0;
+    util::GradientMode gradientMode = util::GradientMode::onTheFly;
+    if(!autoGradient && !util::parseGradientMode(gradientName, gradientMode))
+    {
+        std::cout << "Error: unknown gradient mode " << gradientName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::NormalMode normalMode = util::NormalMode::gradient;
+    if(normalName != NULL && !util::parseNormalMode(normalName, normalMode))
+    {
+        std::cout << "Error: unknown normal mode " << normalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::DuplicateRemoval duplicateRemoval =
+        util::DuplicateRemoval::boundary;
+    if(duplicateRemovalName != NULL &&
+       !util::parseDuplicateRemoval(duplicateRemovalName, duplicateRemoval))
+    {
+        std::cout << "Error: unknown duplicate removal " << duplicateRemovalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
     // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
     // YAML_Doc will create a file at in the current directory with a
     // timestamp on it.
@@ -434,6 +633,9 @@ int main(int argc, char* argv[])
     doc.add("Volume image data file path", vtkFile);
     doc.add("Polygonal mesh output file", outFile);
     doc.add("Isoval", isoval);
+    doc.add("Normal mode", util::normalModeName(normalMode));
+    doc.add("Case ID kernel", util::caseIdKernelName());
+    doc.add("Duplicate removal", util::duplicateRemovalName(duplicateRemoval));
 
     // Load the image file
     util::Image3D<float> image = util::loadImage<float>(vtkFile);
@@ -455,6 +657,18 @@ int main(int argc, char* argv[])
     doc.add("File y-dimension", image.ydimension());
     doc.add("File z-dimension", image.zdimension());
 
+    // Without a gradient mode given, use the fastest one that fits in the
+    // gradient memory budget. Each thread has its own rolling cache.
+    size_t gradientBudget = gradientMemory << 20;
+    if(autoGradient)
+    {
+        gradientMode = util::chooseGradientMode<float>(
+            image.xdimension(), image.ydimension(), image.zdimension(),
+            omp_get_max_threads(), gradientBudget);
+    }
+    doc.add("Gradient mode", util::gradientModeName(gradientMode));
+    doc.add("Gradient memory budget (bytes)", gradientBudget);
+
     // Time the output. Timer's constructor starts timing.
     util::Timer runTime;
 
@@ -462,8 +676,11 @@ int main(int argc, char* argv[])
     // loaded at vtkFile and the isoval of the surface to approximate. It's
     // output is a TriangleMesh which stores the mesh as a vector
     // of triangles.
+    util::DuplicateRemoverTimes duplicateTimes;
     util::TriangleMesh<float> polygonalMesh =
-        MarchingCubes(image, isoval, nSectionsX, nSectionsY, nSectionsZ);
+        MarchingCubes(image, isoval, nSectionsX, nSectionsY, nSectionsZ,
+                    gradientMode, normalMode, duplicateRemoval,
+                    duplicateTimes);
 
     // End timing
     runTime.stop();
@@ -472,7 +689,17 @@ int main(int argc, char* argv[])
     doc.add("Number of vertices in mesh", polygonalMesh.numberOfVertices());
     doc.add("Number of triangles in mesh", polygonalMesh.numberOfTriangles());
 
-    // Report timing information
+    // Report timing information. The phases of removing the duplicates are
+    // part of the total.
+    doc.add("Duplicate removal sort", "");
+    doc.get("Duplicate removal sort")->add("Wall Time (seconds)", duplicateTimes.sort);
+    doc.add("Duplicate removal relabel", "");
+    doc.get("Duplicate removal relabel")->add("Wall Time (seconds)", duplicateTimes.relabel);
+    doc.add("Duplicate removal scatter", "");
+    doc.get("Duplicate removal scatter")->add("Wall Time (seconds)", duplicateTimes.scatter);
+    doc.add("Duplicate removal remap", "");
+    doc.get("Duplicate removal remap")->add("Wall Time (seconds)", duplicateTimes.remap);
+
     doc.add("Total Program CPU Time (clicks)", runTime.getTotalTicks());
     doc.add("Total Program CPU Time (seconds)", runTime.getCPUtime());
     doc.add("Total Program WALL Time (seconds)", runTime.getWallTime());
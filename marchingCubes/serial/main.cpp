@@ -15,7 +15,6 @@
 
 #include <array>
 #include <vector>
-#include <unordered_map>
 
 #include <string>
 #include <string.h>
@@ -26,12 +25,16 @@
 #include <iomanip>
 
 #include "../util/Image3D.h"
+#include "../util/CaseIdKernels.h"
+#include "../util/EdgePointMap.h"
+#include "../util/GradientProvider.h"
+#include "../util/MeshNormals.h"
 #include "../util/TriangleMesh.h"
 
 #include "../util/LoadImage.h"
 #include "../util/SaveTriangleMesh.h"
 
-#include "../util/util.h" // util::findCaseId, util::interpolate
+#include "../util/util.h" // util::interpolate
 #include "../util/MarchingCubesTables.h"
 
 #include "../util/Timer.h"
@@ -41,7 +44,9 @@ using std::size_t;
 
 template <typename T>
 util::TriangleMesh<T>
-MarchingCubes(util::Image3D<T> const& image, T const& isoval)
+MarchingCubes(util::Image3D<T> const& image, T const& isoval,
+    util::GradientMode const& gradientMode,
+    util::NormalMode const& normalMode)
 {
     // The marching cubes algorithm creates a polygonal mesh to approximate an
     // isosurface from a three-dimensional discrete scalar field.
@@ -58,17 +63,24 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval)
     // Example:
     //   If indexTriangles[5] = {1, 4, 2}, then the polygonal mesh will contain
     //   a triangle with vertices at points[1], points[4] and points[2].
-    std::vector<std::array<size_t, 3> > indexTriangles;
+    std::vector<std::array<util::index_t, 3> > indexTriangles;
 
     // A general cube has 16 edges, each labeled with a cube edge index from
     // 0 to 15. Among the whole image, each individual edge has a global
     // edge index, which can be queried from the Image3D data structure.
 
-    // pointMap will be a dictionary from global edge indices to indices
-    // in points and normals. Note that points and normals share the
+    // The gradients used for the normals are found by gradients, see
+    // util::GradientMode. With other normal modes the gradients aren't
+    // needed, so nothing is precomputed or cached for them.
+    bool gradientNormals = normalMode == util::NormalMode::gradient;
+    util::GradientProvider<T> gradients(image,
+        gradientNormals ? gradientMode : util::GradientMode::onTheFly);
+    typename util::GradientProvider<T>::Reader gradReader(gradients);
+
+    // pointMap will map the edges of the current z-slice of cubes to
+    // indices in points and normals. Note that points and normals share the
     // indices.
-    using PointMap = std::unordered_map<size_t, size_t>;
-    PointMap pointMap;
+    util::EdgePointMap pointMap;
     size_t ptIdx = 0;
 
     size_t xBeginIdx = image.xBeginIdx();
@@ -86,6 +98,12 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval)
     size_t yEndIdx = image.yEndIdx();
     size_t zEndIdx = image.zEndIdx();
 
+    pointMap.reset(xBeginIdx, yBeginIdx, xEndIdx, yEndIdx);
+
+    // The case of each cube of the current row
+    size_t const nCubes = xEndIdx - xBeginIdx;
+    std::vector<unsigned char> caseIds(nCubes);
+
     // For each cube, determine whether or not the isosurface intersects
     // the given cube. If so, first find the cube configuration from a lookup
     // table. Then add the triangles of that cube configuration to points,
@@ -93,27 +111,30 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval)
     // normals.
     for (size_t zidx = zBeginIdx; zidx != zEndIdx; ++zidx)
     {
+        pointMap.beginSlice(zidx);
+
         for (size_t yidx = yBeginIdx; yidx != yEndIdx; ++yidx)
         {
             // A buffer is used to improve cache efficency when retrieving
             // vertex values of each cube.
             auto buffer = image.createBuffer(xBeginIdx, yidx, zidx);
 
-            for (size_t xidx = xBeginIdx; xidx != xEndIdx; ++xidx)
+            // The cases of all the cubes of the row are found at once.
+            // The 0th and 255th cases are the cases where the isosurface
+            // does not intersect the cube, so those cubes are skipped.
+            buffer.getCaseIds(xEndIdx, isoval, caseIds.data());
+
+            for(size_t c = util::nextCutCube(caseIds.data(), 0, nCubes);
+                c != nCubes;
+                c = util::nextCutCube(caseIds.data(), c + 1, nCubes))
             {
+                size_t xidx = xBeginIdx + c;
+                int cellCaseId = caseIds[c];
+
                 // For each x, y, z index, get the corresponding 8 scalar values
                 // of a cube with one corner being at the x, y, z index.
                 std::array<T, 8> cubeVertexVals = buffer.getCubeVertexValues(xidx);
 
-                int cellCaseId = util::findCaseId(cubeVertexVals, isoval);
-
-                // The 0th and 255th cellCaseId are the cases where the isosurface
-                // does not intersect the cube.
-                if (cellCaseId == 0 || cellCaseId == 255)
-                {
-                    continue;
-                }
-
                 // From a pre-generated list of possible cube configurations,
                 // get the corresponding "triangles" to this caseId. Each
                 // triangle contains 3 cube edge endices, where each vertex
@@ -127,8 +148,12 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval)
                 // calculating gradients.
                 std::array<std::array<T, 3>, 8> posCube =
                     image.getPosCube(xidx, yidx, zidx);
-                std::array<std::array<T, 3>, 8> gradCube =
-                    image.getGradCube(xidx, yidx, zidx);
+                // Without gradient normals, no gradients are read.
+                std::array<std::array<T, 3>, 8> gradCube;
+                if(gradientNormals)
+                {
+                    gradCube = gradReader.getGradCube(xidx, yidx, zidx);
+                }
 
                 // For each edge in each triangle, find it's global edge index.
                 // If the point and normal for that  global edge index has not
@@ -139,26 +164,28 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval)
                 for(; *triEdges != -1; triEdges += 3)
                 {
                     // tri contains indices to points and normals
-                    std::array<size_t, 3> tri;
+                    std::array<util::index_t, 3> tri;
                     for(int i = 0; i != 3; ++i)
                     {
-                        size_t globalEdgeIndex =
-                            image.getGlobalEdgeIndex(xidx, yidx, zidx, triEdges[i]);
+                        // The index of the point on this edge in points and
+                        // normals, util::noPoint until it is calculated.
+                        size_t& pointIdx =
+                            pointMap.at(xidx, yidx, triEdges[i]);
 
-                        if(pointMap.find(globalEdgeIndex) != pointMap.end())
+                        if(pointIdx != util::noPoint)
                         {
-                            // This global edge index has an associated index
+                            // This edge has an associated index
                             // corresponding to its point and normal in points
                             // and normals.
 
-                            tri[i] = pointMap[globalEdgeIndex];
+                            tri[i] = pointIdx;
                         }
                         else
                         {
-                            // This point and normal value on this global edge
-                            // index has not been calculated.
+                            // This point and normal value on this edge has
+                            // not been calculated.
 
-                            pointMap[globalEdgeIndex] = ptIdx;
+                            pointIdx = ptIdx;
                             tri[i] = ptIdx++;
 
                             const int *vs = util::edgeVertices[triEdges[i]];
@@ -169,11 +196,12 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval)
 
                             std::array<T, 3> newPt =
                                 util::interpolate(posCube[v1], posCube[v2], w);
-                            std::array<T, 3> newNorm =
-                                util::interpolate(gradCube[v1], gradCube[v2], w);
-
                             points.push_back(newPt);
-                            normals.push_back(newNorm);
+                            if(gradientNormals)
+                            {
+                                normals.push_back(
+                                    util::interpolate(gradCube[v1], gradCube[v2], w));
+                            }
                         }
                     }
 
@@ -188,7 +216,12 @@ MarchingCubes(util::Image3D<T> const& image, T const& isoval)
     }
     // points, normals and indexTriangles contain all the information
     // needed with respect to this new polygonal mesh, stored in TriangleMesh.
-    return util::TriangleMesh<T>(points, normals, indexTriangles);
+    util::TriangleMesh<T> mesh(points, normals, indexTriangles);
+    if(normalMode == util::NormalMode::face)
+    {
+        util::computeFaceNormals(mesh);
+    }
+    return mesh;
 }
 
 int main(int argc, char* argv[])
@@ -197,6 +230,9 @@ int main(int argc, char* argv[])
     bool isovalSet = false;
     char* vtkFile = NULL;
     char* outFile = NULL;
+    char* gradientName = NULL;
+    size_t gradientMemory = 1024; // MiB
+    char* normalName = NULL;
     std::string yamlDirectory = "";
     std::string yamlFileName  = "";
     bool useDat = false;
@@ -222,6 +258,18 @@ int main(int argc, char* argv[])
             isovalSet = true;
             isoval = atof(argv[++i]);
         }
+        else if( (strcmp(argv[i], "-g") == 0) || (strcmp(argv[i], "-gradient") == 0))
+        {
+            gradientName = argv[++i];
+        }
+        else if( (strcmp(argv[i], "-gm") == 0) || (strcmp(argv[i], "-gradient_memory") == 0))
+        {
+            gradientMemory = std::stoul(argv[++i]);
+        }
+        else if( (strcmp(argv[i], "-n") == 0) || (strcmp(argv[i], "-normals") == 0))
+        {
+            normalName = argv[++i];
+        }
         else if( (strcmp(argv[i], "-y") == 0) || (strcmp(argv[i], "-yaml_output_file") == 0))
         {
             std::string wholeFile(argv[++i]);
@@ -246,6 +294,13 @@ int main(int argc, char* argv[])
                 "  -input_dat"                    << std::endl <<
                 "  -output_file (-o)"             << std::endl <<
                 "  -isoval (-v)"                  << std::endl <<
+                "  -gradient (-g), default auto"  << std::endl <<
+                "    auto, onthefly, rolling or"  << std::endl <<
+                "    precomputed"                 << std::endl <<
+                "  -gradient_memory (-gm), MiB,"  << std::endl <<
+                "    default 1024"                << std::endl <<
+                "  -normals (-n), default"        << std::endl <<
+                "    gradient, none or face"      << std::endl <<
                 "  -yaml_output_file (-y)"        << std::endl <<
                 "  -help (-h)"                    << std::endl;
             return 0;
@@ -259,6 +314,24 @@ int main(int argc, char* argv[])
         return 0;
     }
 
+    bool autoGradient =
+        gradientName == NULL || strcmp(gradientName, "auto") == 0;
+    util::GradientMode gradientMode = util::GradientMode::onTheFly;
+    if(!autoGradient && !util::parseGradientMode(gradientName, gradientMode))
+    {
+        std::cout << "Error: unknown gradient mode " << gradientName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
+    util::NormalMode normalMode = util::NormalMode::gradient;
+    if(normalName != NULL && !util::parseNormalMode(normalName, normalMode))
+    {
+        std::cout << "Error: unknown normal mode " << normalName << "." << std::endl <<
+                     "Try -help" << std::endl;
+        return 0;
+    }
+
     // Create a yamlDoc. If yamlDirectory and yamlFileName weren't assigned,
     // YAML_Doc will create a file at in the current directory with a
     // timestamp on it.
@@ -269,6 +342,8 @@ int main(int argc, char* argv[])
     doc.add("Volume image data file path", vtkFile);
     doc.add("Polygonal mesh output file", outFile);
     doc.add("Isoval", isoval);
+    doc.add("Normal mode", util::normalModeName(normalMode));
+    doc.add("Case ID kernel", util::caseIdKernelName());
 
     // Load the image file
     util::Image3D<float> image = util::loadImage<float>(vtkFile, useDat);
@@ -277,6 +352,18 @@ int main(int argc, char* argv[])
     doc.add("File y-dimension", image.ydimension());
     doc.add("File z-dimension", image.zdimension());
 
+    // Without a gradient mode given, use the fastest one that fits in the
+    // gradient memory budget.
+    size_t gradientBudget = gradientMemory << 20;
+    if(autoGradient)
+    {
+        gradientMode = util::chooseGradientMode<float>(
+            image.xdimension(), image.ydimension(), image.zdimension(),
+            1, gradientBudget);
+    }
+    doc.add("Gradient mode", util::gradientModeName(gradientMode));
+    doc.add("Gradient memory budget (bytes)", gradientBudget);
+
     // Time the output. Timer's constructor starts timing.
     util::Timer runTime;
 
@@ -284,7 +371,8 @@ int main(int argc, char* argv[])
     // loaded at vtkFile and the isoval of the surface to approximate. It's
     // output is a TriangleMesh which stores the mesh as a vector
     // of triangles.
-    util::TriangleMesh<float> polygonalMesh = MarchingCubes(image, isoval);
+    util::TriangleMesh<float> polygonalMesh =
+        MarchingCubes(image, isoval, gradientMode, normalMode);
 
     // End timing
     runTime.stop();
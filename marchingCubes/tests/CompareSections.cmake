@@ -0,0 +1,54 @@
+# miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+# See LICENSE.txt for details.
+
+# Copyright (c) 2017
+# National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+# the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+# certain rights in this software.
+
+# Runs EXECUTABLE on IMAGE with one section and with 2 x 3 x 2 sections, on
+# THREADS OpenMP threads and with DUPLICATE_REMOVAL if it is set. Fails
+# unless CHECK finds the two meshes equivalent and they have the same number
+# of points. The meshes are written to OUTPUT followed by the number of
+# sections.
+
+set(ENV{OMP_NUM_THREADS} ${THREADS})
+
+set(args -i ${IMAGE} -v 0.2)
+if(DUPLICATE_REMOVAL)
+    list(APPEND args -dr ${DUPLICATE_REMOVAL})
+endif()
+
+foreach(sections "1;1;1" "2;3;2")
+    list(GET sections 0 sx)
+    list(GET sections 1 sy)
+    list(GET sections 2 sz)
+    set(mesh ${OUTPUT}_${sx}x${sy}x${sz}.vtk)
+    execute_process(
+        COMMAND ${EXECUTABLE} ${args} -o ${mesh} -y ${OUTPUT}.yaml
+                -sx ${sx} -sy ${sy} -sz ${sz}
+        RESULT_VARIABLE result
+        OUTPUT_QUIET ERROR_QUIET)
+    if(NOT result EQUAL 0 OR NOT EXISTS ${mesh})
+        message(FATAL_ERROR "${EXECUTABLE} failed with ${sx}x${sy}x${sz} sections")
+    endif()
+
+    file(STRINGS ${mesh} pointsLine REGEX "^POINTS [0-9]+")
+    string(REGEX MATCH "[0-9]+" numPoints "${pointsLine}")
+    list(APPEND meshes ${mesh})
+    list(APPEND pointCounts ${numPoints})
+endforeach()
+
+execute_process(
+    COMMAND ${CHECK} ${meshes}
+    OUTPUT_VARIABLE checkOutput)
+if(NOT checkOutput MATCHES "The two meshes are equivalent.")
+    message(FATAL_ERROR "The meshes are not equivalent: ${checkOutput}")
+endif()
+
+list(GET pointCounts 0 onePoints)
+list(GET pointCounts 1 severalPoints)
+if(NOT onePoints EQUAL severalPoints)
+    message(FATAL_ERROR
+        "${onePoints} points with one section, ${severalPoints} with several")
+endif()
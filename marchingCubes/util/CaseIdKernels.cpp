@@ -0,0 +1,300 @@
+/*
+ * CaseIdKernels.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#include "CaseIdKernels.h"
+
+#include <cstdint>
+
+// The vector kernels are compiled with function level target attributes so
+// that the rest of the program does not need -mavx2 or -mavx512bw. Whether
+// or not they are used is decided at runtime.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTIL_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace util {
+
+namespace {
+
+template <typename T>
+using CaseIdFunc = void (*)(const T*, const T*, const T*, const T*,
+                            size_t, T, unsigned char*);
+
+// The bits of a case are numbered as the vertices of the cube in
+// util::findCaseId: bits 0 and 1 are values i and i+1 of row0, bits 3 and
+// 2 of row1, bits 4 and 5 of row2 and bits 7 and 6 of row3.
+template <typename T>
+void
+findRowCaseIdsScalar(
+    const T* row0, const T* row1, const T* row2, const T* row3,
+    size_t n, T isoval, unsigned char* caseIds)
+{
+    for(size_t i = 0; i != n; ++i)
+    {
+        caseIds[i] = (row0[i] >= isoval)
+                   | (row0[i+1] >= isoval) << 1
+                   | (row1[i+1] >= isoval) << 2
+                   | (row1[i] >= isoval) << 3
+                   | (row2[i] >= isoval) << 4
+                   | (row2[i+1] >= isoval) << 5
+                   | (row3[i+1] >= isoval) << 6
+                   | (row3[i] >= isoval) << 7;
+    }
+}
+
+#ifdef UTIL_X86_KERNELS
+
+// The vector kernels do 64 cubes at a time. Bit k of the mask of a row is
+// set if value i+k is >= isoval, which is false for NaNs as in
+// util::findCaseId.
+
+__attribute__((target("avx2")))
+inline uint64_t
+rowMaskAvx2(const float* row, float isoval)
+{
+    __m256 const iso = _mm256_set1_ps(isoval);
+    uint64_t mask = 0;
+    for(int b = 0; b != 8; ++b)
+    {
+        __m256 cmp = _mm256_cmp_ps(_mm256_loadu_ps(row + 8*b), iso,
+                                   _CMP_GE_OQ);
+        mask |= uint64_t(_mm256_movemask_ps(cmp)) << (8*b);
+    }
+    return mask;
+}
+
+__attribute__((target("avx2")))
+inline uint64_t
+rowMaskAvx2(const double* row, double isoval)
+{
+    __m256d const iso = _mm256_set1_pd(isoval);
+    uint64_t mask = 0;
+    for(int b = 0; b != 16; ++b)
+    {
+        __m256d cmp = _mm256_cmp_pd(_mm256_loadu_pd(row + 4*b), iso,
+                                    _CMP_GE_OQ);
+        mask |= uint64_t(_mm256_movemask_pd(cmp)) << (4*b);
+    }
+    return mask;
+}
+
+__attribute__((target("avx512f")))
+inline uint64_t
+rowMaskAvx512(const float* row, float isoval)
+{
+    __m512 const iso = _mm512_set1_ps(isoval);
+    uint64_t mask = 0;
+    for(int b = 0; b != 4; ++b)
+    {
+        __mmask16 cmp = _mm512_cmp_ps_mask(_mm512_loadu_ps(row + 16*b), iso,
+                                           _CMP_GE_OQ);
+        mask |= uint64_t(cmp) << (16*b);
+    }
+    return mask;
+}
+
+__attribute__((target("avx512f")))
+inline uint64_t
+rowMaskAvx512(const double* row, double isoval)
+{
+    __m512d const iso = _mm512_set1_pd(isoval);
+    uint64_t mask = 0;
+    for(int b = 0; b != 8; ++b)
+    {
+        __mmask8 cmp = _mm512_cmp_pd_mask(_mm512_loadu_pd(row + 8*b), iso,
+                                          _CMP_GE_OQ);
+        mask |= uint64_t(cmp) << (8*b);
+    }
+    return mask;
+}
+
+// Bit k of bits[b] is bit b of case i+k, from the masks of the rows and
+// whether value i+64 of each row is >= isoval.
+inline void
+caseBits(uint64_t const (&mask)[4], bool const (&last)[4],
+         uint64_t (&bits)[8])
+{
+    uint64_t next[4];
+    for(int r = 0; r != 4; ++r)
+    {
+        next[r] = (mask[r] >> 1) | (uint64_t(last[r]) << 63);
+    }
+    bits[0] = mask[0];
+    bits[1] = next[0];
+    bits[2] = next[1];
+    bits[3] = mask[1];
+    bits[4] = mask[2];
+    bits[5] = next[2];
+    bits[6] = next[3];
+    bits[7] = mask[3];
+}
+
+// Byte k is bit if bit k of m is set, else 0.
+__attribute__((target("avx2")))
+inline __m256i
+spreadBitsAvx2(uint32_t m, char bit)
+{
+    // Byte k gets byte k/8 of m, and then keeps only bit k%8 of it.
+    __m256i const select = _mm256_setr_epi64x(
+        0, 0x0101010101010101ll, 0x0202020202020202ll, 0x0303030303030303ll);
+    __m256i const bitOfByte = _mm256_set1_epi64x(
+        static_cast<long long>(0x8040201008040201ull));
+
+    __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(m), select);
+    v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bitOfByte), bitOfByte);
+    return _mm256_and_si256(v, _mm256_set1_epi8(bit));
+}
+
+template <typename T>
+__attribute__((target("avx2")))
+void
+findRowCaseIdsAvx2(
+    const T* row0, const T* row1, const T* row2, const T* row3,
+    size_t n, T isoval, unsigned char* caseIds)
+{
+    const T* rows[4] = { row0, row1, row2, row3 };
+
+    // Value i+64 of each row is also needed, so the last iteration must
+    // satisfy i + 64 <= n.
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64)
+    {
+        uint64_t mask[4];
+        bool last[4];
+        for(int r = 0; r != 4; ++r)
+        {
+            mask[r] = rowMaskAvx2(rows[r] + i, isoval);
+            last[r] = rows[r][i+64] >= isoval;
+        }
+
+        uint64_t bits[8];
+        caseBits(mask, last, bits);
+
+        for(int h = 0; h != 2; ++h)
+        {
+            __m256i cases = _mm256_setzero_si256();
+            for(int b = 0; b != 8; ++b)
+            {
+                cases = _mm256_or_si256(cases, spreadBitsAvx2(
+                    uint32_t(bits[b] >> (32*h)), char(1 << b)));
+            }
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i*>(caseIds + i + 32*h), cases);
+        }
+    }
+
+    if(i != n)
+    {
+        findRowCaseIdsScalar(row0 + i, row1 + i, row2 + i, row3 + i,
+                             n - i, isoval, caseIds + i);
+    }
+}
+
+template <typename T>
+__attribute__((target("avx512f,avx512bw")))
+void
+findRowCaseIdsAvx512(
+    const T* row0, const T* row1, const T* row2, const T* row3,
+    size_t n, T isoval, unsigned char* caseIds)
+{
+    const T* rows[4] = { row0, row1, row2, row3 };
+
+    // See findRowCaseIdsAvx2.
+    size_t i = 0;
+    for(; i + 64 <= n; i += 64)
+    {
+        uint64_t mask[4];
+        bool last[4];
+        for(int r = 0; r != 4; ++r)
+        {
+            mask[r] = rowMaskAvx512(rows[r] + i, isoval);
+            last[r] = rows[r][i+64] >= isoval;
+        }
+
+        uint64_t bits[8];
+        caseBits(mask, last, bits);
+
+        __m512i cases = _mm512_setzero_si512();
+        for(int b = 0; b != 8; ++b)
+        {
+            cases = _mm512_or_si512(cases,
+                _mm512_maskz_set1_epi8(bits[b], char(1 << b)));
+        }
+        _mm512_storeu_si512(caseIds + i, cases);
+    }
+
+    if(i != n)
+    {
+        findRowCaseIdsScalar(row0 + i, row1 + i, row2 + i, row3 + i,
+                             n - i, isoval, caseIds + i);
+    }
+}
+
+#endif
+
+template <typename T>
+struct Kernel
+{
+    CaseIdFunc<T> func;
+    const char* name;
+};
+
+template <typename T>
+Kernel<T> selectKernel()
+{
+#ifdef UTIL_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f") &&
+       __builtin_cpu_supports("avx512bw"))
+    {
+        return { &findRowCaseIdsAvx512<T>, "avx512" };
+    }
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return { &findRowCaseIdsAvx2<T>, "avx2" };
+    }
+#endif
+    return { &findRowCaseIdsScalar<T>, "scalar" };
+}
+
+template <typename T>
+Kernel<T> const& kernel()
+{
+    static Kernel<T> const k = selectKernel<T>();
+    return k;
+}
+
+}
+
+template <typename T>
+void findRowCaseIds(
+    const T* row0, const T* row1, const T* row2, const T* row3,
+    size_t n, T isoval, unsigned char* caseIds)
+{
+    kernel<T>().func(row0, row1, row2, row3, n, isoval, caseIds);
+}
+
+const char* caseIdKernelName()
+{
+    return kernel<float>().name;
+}
+
+// Need this for explicit instantiation
+template void findRowCaseIds<float>(
+    const float*, const float*, const float*, const float*,
+    size_t, float, unsigned char*);
+template void findRowCaseIds<double>(
+    const double*, const double*, const double*, const double*,
+    size_t, double, unsigned char*);
+
+}
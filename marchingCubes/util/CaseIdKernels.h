@@ -0,0 +1,68 @@
+/*
+ * CaseIdKernels.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef UTIL_CASEIDKERNELS_H_
+#define UTIL_CASEIDKERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+using std::size_t;
+
+namespace util {
+
+// Fills caseIds[0, n) with the case of each of the n cubes along a row, the
+// same case util::findCaseId finds from the values of the cube. The cubes
+// lie between four rows of n+1 values:
+//   row0 at (y, z), row1 at (y+1, z), row2 at (y, z+1), row3 at (y+1, z+1)
+// and cube i has the values i and i+1 of each row as its vertices.
+//
+// The kernel is chosen once at runtime from what the cpu supports: AVX-512,
+// AVX2 or a plain C++ loop.
+template <typename T>
+void findRowCaseIds(
+    const T* row0, const T* row1, const T* row2, const T* row3,
+    size_t n, T isoval, unsigned char* caseIds);
+
+// The name of the kernel findRowCaseIds dispatches to.
+const char* caseIdKernelName();
+
+// The first i in [i, n) such that the isosurface intersects cube i, that is
+// its case is neither 0 nor 255, or n if there is none. The cases are
+// checked 8 at a time.
+inline size_t nextCutCube(const unsigned char* caseIds, size_t i, size_t n)
+{
+    // A case is 0 or 255 when each of its bits equals the one above it.
+    uint64_t const lowBits = 0x7f7f7f7f7f7f7f7full;
+    for(; i + 8 <= n; i += 8)
+    {
+        uint64_t w;
+        std::memcpy(&w, caseIds + i, 8);
+        if(((w ^ (w >> 1)) & lowBits) != 0)
+        {
+            break;
+        }
+    }
+    for(; i != n; ++i)
+    {
+        if(caseIds[i] != 0 && caseIds[i] != 255)
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+}
+
+#endif
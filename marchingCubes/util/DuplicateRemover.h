@@ -19,13 +19,71 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <string.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../util/ParallelScan.h"
+#include "../util/Timer.h"
 #include "../util/TriangleMesh.h"
 
 using std::size_t;
 
 namespace util {
 
+// How util::duplicateRemover finds the duplicates and makes the new mesh.
+enum class DuplicateRemoval
+{
+    sort,    // std::stable_sort by global edge index, then a serial relabel,
+             // scatter and remap.
+    radix,   // Parallel radix sort by global edge index, then a parallel
+             // relabel, scatter and remap.
+    boundary // Like radix, but only the points that can have duplicates
+             // are sorted and the others are copied straight through.
+};
+
+inline const char* duplicateRemovalName(DuplicateRemoval mode)
+{
+    switch(mode)
+    {
+    case DuplicateRemoval::sort:
+        return "sort";
+    case DuplicateRemoval::radix:
+        return "radix";
+    case DuplicateRemoval::boundary:
+        return "boundary";
+    }
+    return "";
+}
+
+// Reads "sort", "radix" or "boundary" into mode. Returns false if name is
+// none of them.
+inline bool parseDuplicateRemoval(const char* name, DuplicateRemoval& mode)
+{
+    for(DuplicateRemoval m : { DuplicateRemoval::sort,
+                               DuplicateRemoval::radix,
+                               DuplicateRemoval::boundary })
+    {
+        if(strcmp(name, duplicateRemovalName(m)) == 0)
+        {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The wall time of each phase of util::duplicateRemover, in seconds.
+struct DuplicateRemoverTimes
+{
+    double sort = 0.0;    // Sorting the pairs by global edge index
+    double relabel = 0.0; // Numbering the distinct global edge indices
+    double scatter = 0.0; // Copying the points and normals to the new mesh
+    double remap = 0.0;   // Pointing the triangles at the new points
+};
+
 struct PairCompareSecond
 {
     template <typename A, typename B>
@@ -35,18 +93,314 @@ struct PairCompareSecond
     }
 };
 
+// Sorts pairs by their second value with a parallel LSD radix sort, a
+// byte of the keys per pass. Pairs with the same key keep their order.
+// Bytes above the highest set bit of the largest key are all 0, so they
+// are not sorted on.
+//
+// In each pass, each thread counts the digits of its block of the pairs.
+// The counts are scanned in the order (digit, thread), which gives where
+// each thread writes its pairs of each digit, and then each thread moves
+// its block there.
+inline void
+radixSortBySecond(std::vector<std::pair<size_t, size_t> >& pairs)
+{
+    size_t const n = pairs.size();
+
+    size_t maxKey = 0;
+    #pragma omp parallel for reduction(max:maxKey)
+    for(size_t i = 0; i < n; ++i)
+    {
+        maxKey = std::max(maxKey, pairs[i].second);
+    }
+
+    int numPasses = 0;
+    while(numPasses != int(sizeof(size_t)) && (maxKey >> (8*numPasses)) != 0)
+    {
+        ++numPasses;
+    }
+
+    int const radix = 256;
+#ifdef _OPENMP
+    int const maxThreads = omp_get_max_threads();
+#else
+    int const maxThreads = 1;
+#endif
+    std::vector<size_t> counts(radix * maxThreads);
+    std::vector<std::pair<size_t, size_t> > buffer(n);
+
+    for(int pass = 0; pass != numPasses; ++pass)
+    {
+        int const shift = 8*pass;
+        std::pair<size_t, size_t> const* src = pairs.data();
+        std::pair<size_t, size_t>* dst = buffer.data();
+
+        #pragma omp parallel num_threads(maxThreads)
+        {
+#ifdef _OPENMP
+            // The runtime can give fewer threads than asked for.
+            int const numThreads = omp_get_num_threads();
+            int const tID = omp_get_thread_num();
+#else
+            int const numThreads = 1;
+            int const tID = 0;
+#endif
+            size_t blockSize = (n + numThreads - 1) / numThreads;
+            size_t beg = std::min(n, blockSize * tID);
+            size_t end = std::min(n, beg + blockSize);
+
+            size_t* count = counts.data() + radix * tID;
+            std::fill(count, count + radix, 0);
+            for(size_t i = beg; i != end; ++i)
+            {
+                ++count[(src[i].second >> shift) & (radix - 1)];
+            }
+
+            #pragma omp barrier
+            #pragma omp single
+            {
+                size_t offset = 0;
+                for(int d = 0; d != radix; ++d)
+                {
+                    for(int t = 0; t != numThreads; ++t)
+                    {
+                        size_t c = counts[radix * t + d];
+                        counts[radix * t + d] = offset;
+                        offset += c;
+                    }
+                }
+            }
+
+            for(size_t i = beg; i != end; ++i)
+            {
+                dst[count[(src[i].second >> shift) & (radix - 1)]++] = src[i];
+            }
+        }
+
+        pairs.swap(buffer);
+    }
+}
+
+// The same as duplicateRemover with DuplicateRemoval::radix. Each phase
+// runs on the OpenMP threads.
+template <typename T>
+TriangleMesh<T>
+duplicateRemoverRadix(
+    std::vector<std::pair<size_t, size_t> >& duplicateTracker,
+    std::vector<std::array<T, 3> > const&        points,
+    std::vector<std::array<T, 3> > const&        normals,
+    std::vector<std::array<index_t, 3> >&      indexTriangles,
+    DuplicateRemoverTimes&                     times)
+{
+    size_t const n = duplicateTracker.size();
+
+    // Sort by global edge indices. The sort is stable, so the duplicates
+    // of a point stay in the order of their indices.
+    Timer sortTime;
+    radixSortBySecond(duplicateTracker);
+    sortTime.stop();
+    times.sort = sortTime.getWallTime();
+
+    // Flag the first pair of each run of the same global edge index. The
+    // inclusive scan of the flags is then one past the new index of each
+    // pair's point.
+    Timer relabelTime;
+    std::vector<size_t> newIndices(n);
+    #pragma omp parallel for
+    for(size_t i = 0; i < n; ++i)
+    {
+        newIndices[i] = i == 0 ||
+            duplicateTracker[i].second != duplicateTracker[i-1].second;
+    }
+    size_t numPoints = inclusiveScan<size_t>(newIndices.data(), n);
+    relabelTime.stop();
+    times.relabel = relabelTime.getWallTime();
+
+    // Only the first pair of a run writes its point and normal, so no two
+    // threads write the same one and the lowest index among duplicates is
+    // kept. Every pair maps its old index to the new one.
+    Timer scatterTime;
+    std::vector<std::array<T, 3> > mPoints(numPoints);
+    // Without normals, normals is empty and so is mNormals.
+    std::vector<std::array<T, 3> > mNormals(normals.empty() ? 0 : numPoints);
+
+    std::vector<size_t> oldToNewMap(n);
+
+    #pragma omp parallel for
+    for(size_t i = 0; i < n; ++i)
+    {
+        size_t const oldPointIdx = duplicateTracker[i].first;
+        size_t const newPointIdx = newIndices[i] - 1;
+
+        if(i == 0 || newIndices[i] != newIndices[i-1])
+        {
+            mPoints[newPointIdx] = points[oldPointIdx];
+            if(!normals.empty())
+            {
+                mNormals[newPointIdx] = normals[oldPointIdx];
+            }
+        }
+
+        oldToNewMap[oldPointIdx] = newPointIdx;
+    }
+    scatterTime.stop();
+    times.scatter = scatterTime.getWallTime();
+
+    // update the triangles using oldToNewMap.
+    Timer remapTime;
+    size_t const numTriangles = indexTriangles.size();
+    #pragma omp parallel for
+    for(size_t t = 0; t < numTriangles; ++t)
+    {
+        std::array<index_t, 3>& tri = indexTriangles[t];
+        tri[0] = oldToNewMap[tri[0]];
+        tri[1] = oldToNewMap[tri[1]];
+        tri[2] = oldToNewMap[tri[2]];
+    }
+    remapTime.stop();
+    times.remap = remapTime.getWallTime();
+
+    return TriangleMesh<T>(mPoints, mNormals, indexTriangles);
+}
+
+// The same as duplicateRemover with DuplicateRemoval::boundary.
+// duplicateTracker only holds the points that may have duplicates, in order
+// of their indices, and every other point is kept as it is. The sort is
+// proportional to the number of those points, and the rest of the phases
+// are a parallel pass over all points or triangles.
+template <typename T>
+TriangleMesh<T>
+duplicateRemoverBoundary(
+    std::vector<std::pair<size_t, size_t> >& duplicateTracker,
+    std::vector<std::array<T, 3> > const&        points,
+    std::vector<std::array<T, 3> > const&        normals,
+    std::vector<std::array<index_t, 3> >&      indexTriangles,
+    DuplicateRemoverTimes&                     times)
+{
+    size_t const n = duplicateTracker.size();
+    size_t const numOldPoints = points.size();
+
+    // Sort by global edge indices. The sort is stable, so the first pair of
+    // each run of the same global edge index has the lowest point index.
+    Timer sortTime;
+    radixSortBySecond(duplicateTracker);
+    sortTime.stop();
+    times.sort = sortTime.getWallTime();
+
+    // Flag the points that are kept: all but the ones after the first of
+    // their run. The exclusive scan of the flags is then the new index of
+    // each kept point.
+    Timer relabelTime;
+    std::vector<size_t> oldToNewMap(numOldPoints + 1, 1);
+    #pragma omp parallel for
+    for(size_t i = 1; i < n; ++i)
+    {
+        if(duplicateTracker[i].second == duplicateTracker[i-1].second)
+        {
+            oldToNewMap[duplicateTracker[i].first] = 0;
+        }
+    }
+    size_t numPoints =
+        exclusiveScan<size_t>(oldToNewMap.data(), numOldPoints + 1) - 1;
+    relabelTime.stop();
+    times.relabel = relabelTime.getWallTime();
+
+    // A point is kept if the next new index is past its own.
+    Timer scatterTime;
+    std::vector<std::array<T, 3> > mPoints(numPoints);
+    // Without normals, normals is empty and so is mNormals.
+    std::vector<std::array<T, 3> > mNormals(normals.empty() ? 0 : numPoints);
+
+    #pragma omp parallel for
+    for(size_t i = 0; i < numOldPoints; ++i)
+    {
+        if(oldToNewMap[i] != oldToNewMap[i+1])
+        {
+            mPoints[oldToNewMap[i]] = points[i];
+            if(!normals.empty())
+            {
+                mNormals[oldToNewMap[i]] = normals[i];
+            }
+        }
+    }
+    scatterTime.stop();
+    times.scatter = scatterTime.getWallTime();
+
+    // The duplicates take the new index of the first point of their run,
+    // which was kept. A run is no longer than the number of sections that
+    // share an edge.
+    Timer remapTime;
+    #pragma omp parallel for
+    for(size_t i = 1; i < n; ++i)
+    {
+        size_t first = i;
+        while(first != 0 &&
+              duplicateTracker[first-1].second == duplicateTracker[i].second)
+        {
+            --first;
+        }
+        if(first != i)
+        {
+            oldToNewMap[duplicateTracker[i].first] =
+                oldToNewMap[duplicateTracker[first].first];
+        }
+    }
+
+    // update the triangles using oldToNewMap.
+    size_t const numTriangles = indexTriangles.size();
+    #pragma omp parallel for
+    for(size_t t = 0; t < numTriangles; ++t)
+    {
+        std::array<index_t, 3>& tri = indexTriangles[t];
+        tri[0] = oldToNewMap[tri[0]];
+        tri[1] = oldToNewMap[tri[1]];
+        tri[2] = oldToNewMap[tri[2]];
+    }
+    remapTime.stop();
+    times.remap = remapTime.getWallTime();
+
+    return TriangleMesh<T>(mPoints, mNormals, indexTriangles);
+}
+
+// duplicateTracker holds a pair for each point, its index in points and
+// normals and its global edge index. Points with the same global edge index
+// are duplicates. Returns the mesh with only one of each, and sets times to
+// the wall time of each phase. With DuplicateRemoval::boundary, see
+// duplicateRemoverBoundary, duplicateTracker may leave out the points that
+// can't have duplicates.
 template <typename T>
 TriangleMesh<T>
 duplicateRemover(
     std::vector<std::pair<size_t, size_t> >& duplicateTracker,
     std::vector<std::array<T, 3> > const&        points,
     std::vector<std::array<T, 3> > const&        normals,
-    std::vector<std::array<size_t, 3> >&       indexTriangles)
+    std::vector<std::array<index_t, 3> >&      indexTriangles,
+    DuplicateRemoval const&                    mode,
+    DuplicateRemoverTimes&                     times)
 {
-    // Sort by global edge indices
-    std::sort(
+    // The indices in indexTriangles are into points, which still has the
+    // duplicates.
+    checkIndexRange(points.size());
+
+    if(mode == DuplicateRemoval::radix)
+    {
+        return duplicateRemoverRadix(
+            duplicateTracker, points, normals, indexTriangles, times);
+    }
+    if(mode == DuplicateRemoval::boundary)
+    {
+        return duplicateRemoverBoundary(
+            duplicateTracker, points, normals, indexTriangles, times);
+    }
+
+    // Sort by global edge indices. The sort is stable, so the duplicates
+    // of a point stay in the order of their indices.
+    Timer sortTime;
+    std::stable_sort(
         duplicateTracker.begin(), duplicateTracker.end(),
         PairCompareSecond());
+    sortTime.stop();
+    times.sort = sortTime.getWallTime();
 
     // If two subsequent global edge indices are the same, then that
     // point is a duplicate. This block of code rewrites over the
@@ -54,6 +408,7 @@ duplicateRemover(
     // So if duplicate Tracker has (0, 1), (3, 2), (2, 2), (4, 20) at
     // first, this block of code will leave duplicate tracker with
     // (0, 0), (3, 1), (2, 1), (4, 2)
+    Timer relabelTime;
     size_t prevEdge = duplicateTracker[0].second;
     duplicateTracker[0].second = 0;
     for(size_t i = 1; i != duplicateTracker.size(); ++i)
@@ -68,13 +423,18 @@ duplicateRemover(
             duplicateTracker[i].second = duplicateTracker[i-1].second + 1;
         }
     }
+    relabelTime.stop();
+    times.relabel = relabelTime.getWallTime();
 
     // Rewrite to new points and normals vector without any
-    // duplicates.
+    // duplicates. Only the first pair of a run writes its point and normal,
+    // so the lowest index among duplicates is kept.
     // And create a map from old indices to new indices.
+    Timer scatterTime;
     size_t numPoints = duplicateTracker.back().second + 1;
     std::vector<std::array<T, 3> > mPoints(numPoints);
-    std::vector<std::array<T, 3> > mNormals(numPoints);
+    // Without normals, normals is empty and so is mNormals.
+    std::vector<std::array<T, 3> > mNormals(normals.empty() ? 0 : numPoints);
 
     std::vector<size_t> oldToNewMap(duplicateTracker.size());
 
@@ -83,19 +443,30 @@ duplicateRemover(
         size_t const& oldPointIdx = duplicateTracker[i].first;
         size_t const& newPointIdx = duplicateTracker[i].second;
 
-        mPoints[newPointIdx] = points[oldPointIdx];
-        mNormals[newPointIdx] = normals[oldPointIdx];
+        if(i == 0 || newPointIdx != duplicateTracker[i-1].second)
+        {
+            mPoints[newPointIdx] = points[oldPointIdx];
+            if(!normals.empty())
+            {
+                mNormals[newPointIdx] = normals[oldPointIdx];
+            }
+        }
 
         oldToNewMap[oldPointIdx] = newPointIdx;
     }
+    scatterTime.stop();
+    times.scatter = scatterTime.getWallTime();
 
     // update the triangles using oldToNewMap.
-    for(std::array<size_t, 3>& tri: indexTriangles)
+    Timer remapTime;
+    for(std::array<index_t, 3>& tri: indexTriangles)
     {
         tri[0] = oldToNewMap[tri[0]];
         tri[1] = oldToNewMap[tri[1]];
         tri[2] = oldToNewMap[tri[2]];
     }
+    remapTime.stop();
+    times.remap = remapTime.getWallTime();
 
     // mPoints, mNormals and indexTriangles contain all the information
     // needed with respect to this new polygonal mesh, stored in a TriangleMesh.
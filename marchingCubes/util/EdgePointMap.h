@@ -0,0 +1,272 @@
+/*
+ * EdgePointMap.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef UTIL_EDGEPOINTMAP_H_
+#define UTIL_EDGEPOINTMAP_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+using std::size_t;
+
+namespace util {
+
+// The point index of an edge that has no point yet
+const size_t noPoint = std::numeric_limits<size_t>::max();
+
+// Maps the cut edges of the cubes of a section to the indices of their
+// points, so that a point shared by several cubes is only made once.
+//
+// The cubes are visited one z-slice at a time in increasing z, so only the
+// edges of the current slice of cubes are kept: the x and y edges on the
+// bottom and top faces of the slice and the z edges between them. Each
+// kind of edge is a flat array indexed by its x and y. When the next slice
+// begins, its bottom face is the top face of the slice before, so the two
+// faces are swapped and only the new top face and the z edges are cleared.
+// A lookup is an array read and the memory is bounded by the size of a
+// slice.
+//
+// A thread or process that makes several sections with one map also keeps
+// the points on the planes between its sections, see resetSections. Each
+// plane is a flat array of its edges, so a point between two of the
+// sections is made once and the memory is bounded by the area of the
+// planes.
+class EdgePointMap
+{
+public:
+    // Sets up the planes between the sections made with this map. The
+    // sections are the boxes of cubes between consecutive bounds along
+    // each axis, see sectionBounds. The points on the planes are kept from
+    // one section to the next until this is called again.
+    void resetSections(std::array<std::vector<size_t>, 3> const& bounds)
+    {
+        // Without sections there are no planes.
+        for(int a = 0; a != 3; ++a)
+        {
+            planesBeg[a] = bounds[a].empty() ? 0 : bounds[a].front();
+            planesDim[a] = bounds[a].empty() ? 0 :
+                           bounds[a].back() - bounds[a].front() + 1;
+        }
+
+        size_t numSlots = 0;
+        for(int a = 0; a != 3; ++a)
+        {
+            // The first and last bounds are the boundary of the sections,
+            // not planes between them.
+            planeOf[a].assign(planesDim[a], noPoint);
+            for(size_t p = 1; p + 1 < bounds[a].size(); ++p)
+            {
+                planeOf[a][bounds[a][p] - planesBeg[a]] = numSlots;
+                // The edges of the plane along each of the other two axes
+                numSlots += 2 * planesDim[firstOtherAxis(a)] *
+                                planesDim[secondOtherAxis(a)];
+            }
+        }
+        planePoints.assign(numSlots, noPoint);
+    }
+
+    // Covers the cubes [xbeg, xend) x [ybeg, yend) of each slice. All
+    // edges of the slices are forgotten, but not the points on the planes
+    // between sections.
+    void reset(size_t xbeg, size_t ybeg, size_t xend, size_t yend)
+    {
+        this->xbeg = xbeg;
+        this->ybeg = ybeg;
+        rowSize = xend - xbeg + 1;
+        sliceSize = rowSize * (yend - ybeg + 1);
+        // The x and y edges of the bottom and top faces, then the z edges.
+        slots.assign(5 * sliceSize, noPoint);
+        bottom = 0;
+        top = 2 * sliceSize;
+        zidx = noPoint;
+    }
+
+    // Moves on to the slice of cubes at zidx. Slices must come in
+    // increasing z. If zidx is not right after the last slice, no edges
+    // are shared with it and all of them are forgotten.
+    void beginSlice(size_t zidx)
+    {
+        if(this->zidx != noPoint && zidx == this->zidx + 1)
+        {
+            std::swap(bottom, top);
+            std::fill(slots.begin() + top, slots.begin() + top +
+                      2 * sliceSize, noPoint);
+            std::fill(slots.begin() + 4 * sliceSize, slots.end(), noPoint);
+        }
+        else if(this->zidx != noPoint)
+        {
+            std::fill(slots.begin(), slots.end(), noPoint);
+        }
+        this->zidx = zidx;
+    }
+
+    // The point index of edge cubeEdgeIdx of cube (xidx, yidx) of the
+    // current slice, noPoint if it has none yet. The edges are numbered as
+    // in Image3D::getGlobalEdgeIndex.
+    size_t& at(size_t xidx, size_t yidx, int cubeEdgeIdx)
+    {
+        // The face (bottom, top or the z edges), the kind of edge (x or y)
+        // and the offset from the cube of each cube edge
+        static const int edgeSlots[12][4] = {
+            { 0, 0, 0, 0 }, { 0, 1, 1, 0 }, { 0, 0, 0, 1 }, { 0, 1, 0, 0 },
+            { 1, 0, 0, 0 }, { 1, 1, 1, 0 }, { 1, 0, 0, 1 }, { 1, 1, 0, 0 },
+            { 2, 0, 0, 0 }, { 2, 0, 1, 0 }, { 2, 0, 0, 1 }, { 2, 0, 1, 1 }
+        };
+        const int *e = edgeSlots[cubeEdgeIdx];
+
+        size_t face = e[0] == 0 ? bottom : e[0] == 1 ? top : 4 * sliceSize;
+        size_t idx = (yidx - ybeg + e[3]) * rowSize + xidx - xbeg + e[2];
+        return slots[face + e[1] * sliceSize + idx];
+    }
+
+    // The point index of edge cubeEdgeIdx of cube (xidx, yidx) of the
+    // current slice, as with at, or of the same edge made by an earlier
+    // section on a plane between sections. If the edge has no point yet,
+    // newIdx becomes its point and noPoint is returned, so the caller
+    // makes the point at newIdx.
+    size_t findOrAdd(size_t xidx, size_t yidx, int cubeEdgeIdx, size_t newIdx)
+    {
+        size_t& pointIdx = at(xidx, yidx, cubeEdgeIdx);
+        if(pointIdx != noPoint)
+        {
+            return pointIdx;
+        }
+
+        size_t const slot = planeSlot(xidx, yidx, cubeEdgeIdx);
+        if(slot != noPoint && planePoints[slot] != noPoint)
+        {
+            pointIdx = planePoints[slot];
+            return pointIdx;
+        }
+        if(slot != noPoint)
+        {
+            planePoints[slot] = newIdx;
+        }
+        pointIdx = newIdx;
+        return noPoint;
+    }
+
+    // Whether edge cubeEdgeIdx of cube (xidx, yidx) of the current slice
+    // lies on a plane between sections. Only the points on those edges can
+    // be made by more than one section.
+    bool betweenSections(size_t xidx, size_t yidx, int cubeEdgeIdx) const
+    {
+        return planeSlot(xidx, yidx, cubeEdgeIdx) != noPoint;
+    }
+
+private:
+    // The slot in planePoints of edge cubeEdgeIdx of cube (xidx, yidx) of
+    // the current slice, noPoint if it isn't on a plane between sections.
+    // An edge on two planes is kept in the one across the lower axis.
+    size_t planeSlot(size_t xidx, size_t yidx, int cubeEdgeIdx) const
+    {
+        // The axis of each cube edge and the offset of its first vertex
+        // from the cube
+        static const int edgeAxes[12][4] = {
+            { 0, 0, 0, 0 }, { 1, 1, 0, 0 }, { 0, 0, 1, 0 }, { 1, 0, 0, 0 },
+            { 0, 0, 0, 1 }, { 1, 1, 0, 1 }, { 0, 0, 1, 1 }, { 1, 0, 0, 1 },
+            { 2, 0, 0, 0 }, { 2, 1, 0, 0 }, { 2, 0, 1, 0 }, { 2, 1, 1, 0 }
+        };
+        const int *e = edgeAxes[cubeEdgeIdx];
+
+        // The first vertex of the edge relative to the planes
+        size_t const vertex[3] = { xidx + e[1] - planesBeg[0],
+                                   yidx + e[2] - planesBeg[1],
+                                   zidx + e[3] - planesBeg[2] };
+
+        // An edge lies on a plane across an axis other than its own.
+        for(int a = 0; a != 3; ++a)
+        {
+            if(a == e[0] || vertex[a] >= planeOf[a].size() ||
+               planeOf[a][vertex[a]] == noPoint)
+            {
+                continue;
+            }
+            int const b = firstOtherAxis(a);
+            int const c = secondOtherAxis(a);
+            size_t const kind = e[0] == b ? 0 : 1;
+            return planeOf[a][vertex[a]] +
+                   (kind * planesDim[b] + vertex[b]) * planesDim[c] +
+                   vertex[c];
+        }
+        return noPoint;
+    }
+
+    // The two axes of a plane across axis a, in increasing order
+    static int firstOtherAxis(int a) { return a == 0 ? 1 : 0; }
+    static int secondOtherAxis(int a) { return a == 2 ? 1 : 2; }
+
+    size_t xbeg = 0;
+    size_t ybeg = 0;
+    size_t rowSize = 0;
+    size_t sliceSize = 0;
+    // Offsets of the bottom and top faces in slots
+    size_t bottom = 0;
+    size_t top = 0;
+    size_t zidx = noPoint;
+    std::vector<size_t> slots;
+
+    // The first vertex and the number of vertices along each axis of the
+    // box the planes between sections span.
+    std::array<size_t, 3> planesBeg = {{ 0, 0, 0 }};
+    std::array<size_t, 3> planesDim = {{ 0, 0, 0 }};
+    // Where the plane at each vertex along each axis begins in planePoints,
+    // noPoint if there is no plane between sections there
+    std::array<std::vector<size_t>, 3> planeOf;
+    std::vector<size_t> planePoints;
+};
+
+// The bounds along one axis of nSections sections split by indexer, see
+// util::Indexer, for EdgePointMap::resetSections.
+template <typename Indexer>
+std::vector<size_t>
+sectionBounds(Indexer const& indexer, size_t nSections)
+{
+    std::vector<size_t> bounds(nSections + 1);
+    for(size_t s = 0; s != nSections + 1; ++s)
+    {
+        bounds[s] = indexer(s);
+    }
+    return bounds;
+}
+
+// The bounds along each axis of the sections of images, for
+// EdgePointMap::resetSections. The images are boxes of cubes of the same
+// grid of sections.
+template <typename Image>
+std::array<std::vector<size_t>, 3>
+sectionBounds(std::vector<Image> const& images)
+{
+    std::array<std::vector<size_t>, 3> bounds;
+    for(Image const& image: images)
+    {
+        bounds[0].push_back(image.xBeginIdx());
+        bounds[0].push_back(image.xEndIdx());
+        bounds[1].push_back(image.yBeginIdx());
+        bounds[1].push_back(image.yEndIdx());
+        bounds[2].push_back(image.zBeginIdx());
+        bounds[2].push_back(image.zEndIdx());
+    }
+    for(std::vector<size_t>& b: bounds)
+    {
+        std::sort(b.begin(), b.end());
+        b.erase(std::unique(b.begin(), b.end()), b.end());
+    }
+    return bounds;
+}
+
+}
+
+#endif
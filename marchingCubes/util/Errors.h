@@ -68,6 +68,16 @@ private:
     const char* const message;
 };
 
+class index_overflow: public std::exception {
+public:
+    index_overflow(const char* const inMessage) :
+        message(inMessage) {
+            std::cout << "Index overflow: " << inMessage << std::endl;
+    }
+private:
+    const char* const message;
+};
+
 } // util namespace
 
 #endif
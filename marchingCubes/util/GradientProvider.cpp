@@ -0,0 +1,203 @@
+/*
+ * GradientProvider.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#include "GradientProvider.h"
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+namespace util {
+
+const char* gradientModeName(GradientMode mode)
+{
+    switch(mode)
+    {
+    case GradientMode::onTheFly:
+        return "onthefly";
+    case GradientMode::rolling:
+        return "rolling";
+    case GradientMode::precomputed:
+        return "precomputed";
+    }
+    return "";
+}
+
+bool parseGradientMode(const char* name, GradientMode& mode)
+{
+    for(GradientMode m : { GradientMode::onTheFly,
+                           GradientMode::rolling,
+                           GradientMode::precomputed })
+    {
+        if(strcmp(name, gradientModeName(m)) == 0)
+        {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+GradientProvider<T>::GradientProvider(Image3D<T> const& image, GradientMode mode)
+  : image(image),
+    gradMode(mode),
+    dataBeg(image.dataBeginIdx()),
+    dim({ image.dataEndIdx()[0] - dataBeg[0],
+          image.dataEndIdx()[1] - dataBeg[1],
+          image.dataEndIdx()[2] - dataBeg[2] })
+{
+    if(gradMode == GradientMode::precomputed)
+    {
+        volume.resize(dim[0]*dim[1]*dim[2]);
+
+        // Each thread fills whole slices.
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for(size_t z = 0; z < dim[2]; ++z) {
+        for(size_t y = 0; y != dim[1]; ++y) {
+        for(size_t x = 0; x != dim[0]; ++x)
+        {
+            volume[x + y*dim[0] + z*dim[0]*dim[1]] = image.getGradient(
+                x + dataBeg[0], y + dataBeg[1], z + dataBeg[2]);
+        }}}
+    }
+}
+
+template <typename T>
+GradientProvider<T>::Reader::Reader(GradientProvider const& provider)
+  : provider(provider),
+    generation(0)
+{
+    sliceZ.fill(std::numeric_limits<size_t>::max());
+    sliceGeneration.fill(0);
+
+    if(provider.gradMode == GradientMode::rolling)
+    {
+        size_t sliceSize = provider.dim[0] * provider.dim[1];
+        for(int s = 0; s != 2; ++s)
+        {
+            cache[s].resize(sliceSize);
+            stamps[s].resize(sliceSize, 0);
+        }
+    }
+}
+
+template <typename T>
+std::array<std::array<T, 3>, 8>
+GradientProvider<T>::Reader::getGradCube(size_t xidx, size_t yidx, size_t zidx)
+{
+    if(provider.gradMode == GradientMode::onTheFly)
+    {
+        return provider.image.getGradCube(xidx, yidx, zidx);
+    }
+
+    // Modify input indices to match with the location of the data origin.
+    xidx -= provider.dataBeg[0];
+    yidx -= provider.dataBeg[1];
+    zidx -= provider.dataBeg[2];
+
+    std::array<std::array<T, 3>, 8> grad;
+
+    if(provider.gradMode == GradientMode::precomputed)
+    {
+        size_t const nx = provider.dim[0];
+        size_t const nxy = nx * provider.dim[1];
+        auto const g = provider.volume.begin() + xidx + yidx*nx + zidx*nxy;
+
+        grad[0] = g[0];
+        grad[1] = g[1];
+        grad[2] = g[nx + 1];
+        grad[3] = g[nx];
+        grad[4] = g[nxy];
+        grad[5] = g[nxy + 1];
+        grad[6] = g[nxy + nx + 1];
+        grad[7] = g[nxy + nx];
+
+        return grad;
+    }
+
+    // The slices of the cube. Loading one of them must not evict the other.
+    size_t s0 = getSlice(zidx, zidx + 1);
+    size_t s1 = getSlice(zidx + 1, zidx);
+
+    grad[0] = getCachedGradient(s0, xidx, yidx);
+    grad[1] = getCachedGradient(s0, xidx + 1, yidx);
+    grad[2] = getCachedGradient(s0, xidx + 1, yidx + 1);
+    grad[3] = getCachedGradient(s0, xidx, yidx + 1);
+    grad[4] = getCachedGradient(s1, xidx, yidx);
+    grad[5] = getCachedGradient(s1, xidx + 1, yidx);
+    grad[6] = getCachedGradient(s1, xidx + 1, yidx + 1);
+    grad[7] = getCachedGradient(s1, xidx, yidx + 1);
+
+    return grad;
+}
+
+template <typename T>
+size_t
+GradientProvider<T>::Reader::getSlice(size_t z, size_t keep)
+{
+    if(sliceZ[0] == z)
+        return 0;
+    if(sliceZ[1] == z)
+        return 1;
+
+    size_t s = (sliceZ[0] == keep) ? 1 : 0;
+
+    // Start a new generation. When the counter wraps around, old stamps
+    // could match again, so they're cleared and neither slice is cached.
+    // The caller still uses the kept slice, so it gets a generation of its
+    // own and its gradients are made again.
+    if(++generation == 0)
+    {
+        bool const kept = sliceZ[1 - s] == keep;
+        for(int t = 0; t != 2; ++t)
+        {
+            std::fill(stamps[t].begin(), stamps[t].end(), 0);
+            sliceGeneration[t] = 0;
+        }
+        sliceZ.fill(std::numeric_limits<size_t>::max());
+        generation = 1;
+
+        if(kept)
+        {
+            sliceZ[1 - s] = keep;
+            sliceGeneration[1 - s] = generation++;
+        }
+    }
+
+    sliceZ[s] = z;
+    sliceGeneration[s] = generation;
+    return s;
+}
+
+template <typename T>
+std::array<T, 3> const&
+GradientProvider<T>::Reader::getCachedGradient(size_t s, size_t x, size_t y)
+{
+    size_t idx = x + y*provider.dim[0];
+    if(stamps[s][idx] != sliceGeneration[s])
+    {
+        cache[s][idx] = provider.image.getGradient(
+            x + provider.dataBeg[0],
+            y + provider.dataBeg[1],
+            sliceZ[s] + provider.dataBeg[2]);
+        stamps[s][idx] = sliceGeneration[s];
+    }
+    return cache[s][idx];
+}
+
+template class GradientProvider<double>;
+template class GradientProvider<float>;
+
+} // util namespace
@@ -0,0 +1,113 @@
+/*
+ * GradientProvider.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef GRADIENTPROVIDER_H_
+#define GRADIENTPROVIDER_H_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Image3D.h"
+
+using std::size_t;
+
+namespace util {
+
+// How the gradients at the vertices of a cube are found. All modes give
+// the same values as Image3D::getGradCube.
+enum class GradientMode
+{
+    onTheFly,   // Computed for each cube, 6 reads per vertex.
+    rolling,    // Cached for the two z slices of the current cubes. Each
+                // vertex is computed the first time a cube uses it.
+    precomputed // Computed for all of the image data up front.
+};
+
+const char* gradientModeName(GradientMode mode);
+
+// Reads "onthefly", "rolling" or "precomputed" into mode. Returns false if
+// name is none of them.
+bool parseGradientMode(const char* name, GradientMode& mode);
+
+// The mode to use given memoryBudget bytes for gradients of an image with
+// nx*ny*nz points of data: numReaders rolling caches if they fit, else the
+// precomputed gradients if they fit, else nothing extra. Precomputing is
+// only worth it when most of the image is near the surface, so it's best
+// asked for directly.
+template <typename T>
+GradientMode chooseGradientMode(
+    size_t nx, size_t ny, size_t nz, size_t numReaders, size_t memoryBudget)
+{
+    size_t const gradientBytes = sizeof(std::array<T, 3>);
+    size_t const cachedBytes = gradientBytes + sizeof(uint32_t);
+
+    if(numReaders*2*nx*ny*cachedBytes <= memoryBudget)
+        return GradientMode::rolling;
+    if(nx*ny*nz*gradientBytes <= memoryBudget)
+        return GradientMode::precomputed;
+    return GradientMode::onTheFly;
+}
+
+template <typename T>
+class GradientProvider
+{
+public:
+    // In precomputed mode, the gradients of all of the data in image are
+    // computed here.
+    GradientProvider(Image3D<T> const& image, GradientMode mode);
+
+    GradientMode mode() const { return gradMode; }
+
+    // Gradients are read through a Reader. A reader holds the rolling
+    // cache, so each thread needs its own.
+    class Reader
+    {
+    public:
+        Reader(GradientProvider const& provider);
+
+        // Same indices as Image3D::getGradCube
+        std::array<std::array<T, 3>, 8>
+        getGradCube(size_t xidx, size_t yidx, size_t zidx);
+
+    private:
+        size_t getSlice(size_t z, size_t keep);
+
+        std::array<T, 3> const&
+        getCachedGradient(size_t slice, size_t x, size_t y);
+
+    private:
+        GradientProvider const& provider;
+
+        // Rolling cache. cache[s] holds the gradients of data slice
+        // sliceZ[s]. A gradient is valid if its stamp is the generation of
+        // the slice, so moving to another slice doesn't clear anything.
+        std::array<std::vector<std::array<T, 3> >, 2> cache;
+        std::array<std::vector<uint32_t>, 2> stamps;
+        std::array<size_t, 2> sliceZ;
+        std::array<uint32_t, 2> sliceGeneration;
+        uint32_t generation;
+    };
+
+private:
+    Image3D<T> const& image;
+    GradientMode const gradMode;
+
+    std::array<size_t, 3> const dataBeg; // Indices are relative to dataBeg
+    std::array<size_t, 3> const dim;     // in the provider and its readers.
+
+    std::vector<std::array<T, 3> > volume; // precomputed mode only
+};
+
+} // util namespace
+
+#endif
@@ -14,6 +14,7 @@
  */
 
 #include "Image3D.h"
+#include "CaseIdKernels.h"
 
 using std::size_t;
 
@@ -302,6 +303,14 @@ std::array<T, 8> Image3D<T>::Image3DBuffer::getCubeVertexValues(size_t xidx) con
     return cubeVertexVals;
 }
 
+template <typename T>
+void Image3D<T>::Image3DBuffer::getCaseIds(
+    size_t xend, T isoval, unsigned char* caseIds) const
+{
+    findRowCaseIds(&*x1buffer, &*x2buffer, &*x3buffer, &*x4buffer,
+                   xend - xBeginIdx, isoval, caseIds);
+}
+
 // Need this for explicit instantiation
 template class Image3D<double>;
 template class Image3D<float>;
@@ -17,6 +17,7 @@
 #define IMAGE3DREADER_H_
 
 #include <array>
+#include <utility>
 #include <vector>
 
 using std::size_t;
@@ -41,7 +42,7 @@ public:
             std::array<size_t, 3> dataBeg,
             std::array<size_t, 3> dataEnd,
             std::array<size_t, 3> globalDim)
-      : data(data), spacing(spacing), zeroPos(zeroPos),
+      : data(std::move(data)), spacing(spacing), zeroPos(zeroPos),
         indexBeg(indexBeg), indexEnd(indexEnd),
         dataBeg(dataBeg), dataEnd(dataEnd),
         globalDim(globalDim)
@@ -53,7 +54,7 @@ public:
             std::array<T, 3> spacing,
             std::array<T, 3> zeroPos,
             std::array<size_t, 3> dimensions)
-      : data(data), spacing(spacing), zeroPos(zeroPos),
+      : data(std::move(data)), spacing(spacing), zeroPos(zeroPos),
         indexBeg({0, 0, 0}),
         indexEnd({dimensions[0] - 1, dimensions[1] - 1, dimensions[2] - 1}),
         dataBeg({0, 0, 0}), dataEnd(dimensions),
@@ -66,6 +67,14 @@ public:
     std::array<std::array<T, 3>, 8>
     getGradCube(size_t xidx, size_t yidx, size_t zidx) const;
 
+    // The gradient at a single point. Takes the same indices as getGradCube.
+    std::array<T, 3>
+    getGradient(size_t xidx, size_t yidx, size_t zidx) const
+    {
+        return computeGradient(
+            xidx - dataBeg[0], yidx - dataBeg[1], zidx - dataBeg[2]);
+    }
+
     size_t
     getGlobalEdgeIndex(size_t xidx, size_t yidx, size_t zidx,
                        size_t cubeEdgeIdx) const;
@@ -81,6 +90,9 @@ public:
     size_t ydimension() const { return globalDim[1]; }
     size_t zdimension() const { return globalDim[2]; }
 
+    std::array<size_t, 3> const& dataBeginIdx() const { return dataBeg; }
+    std::array<size_t, 3> const& dataEndIdx()   const { return dataEnd; }
+
     // TODO
     void cut_down(int const& i)
     {
@@ -119,6 +131,10 @@ private:
 
         std::array<T, 8> getCubeVertexValues(size_t xidx) const;
 
+        // Fills caseIds[xidx - xBeginIdx] with the case of each cube xidx
+        // in [xBeginIdx, xend), see util::findRowCaseIds.
+        void getCaseIds(size_t xend, T isoval, unsigned char* caseIds) const;
+
     private:
         Iter x1buffer;
         Iter x2buffer;
@@ -16,7 +16,9 @@
 #ifndef IOIOIO_H_
 #define IOIOIO_H_
 
+#include <algorithm>
 #include <array>
+#include <utility>
 #include <vector>
 #include <string>
 
@@ -24,9 +26,13 @@
 #include <fstream>
 #include <sstream>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "Image3D.h"
 #include "TypeInfo.h"
 #include "ConvertBuffer.h"
+#include "ReadRows.h"
 
 using std::size_t;
 
@@ -174,6 +180,51 @@ streamIgnore(std::ifstream& stream, size_t nPoints, std::size_t pointSize)
     }
 }
 
+// Reads numRows rows of rowSize values of type ti from fd, starting at
+// offset, and converts them to T into data with readRowChunks. When T is the
+// type of the file, each chunk is read straight into data and flipped there.
+// Returns false if the file is too short.
+template <typename T>
+bool
+readRows(int fd, off_t offset, TypeInfo const& ti,
+         std::size_t rowSize, std::size_t numRows, T* data, bool parallel)
+{
+    bool const sameType =
+        ti.getId() == createTemplateTypeInfo<T>().getId() &&
+        ti.size() == sizeof(T);
+    char* inPlace = sameType ? reinterpret_cast<char*>(data) : nullptr;
+
+    return readRowChunks(
+        fd, offset, rowSize * ti.size(), numRows, inPlace, parallel,
+        [&](char* in, std::size_t row, std::size_t n)
+        {
+            convertBufferWithTypeInfo(in, ti, n * rowSize,
+                                      data + row * rowSize);
+        });
+}
+
+// Opens file with POSIX I/O and reads the image values after its header
+// into data with readRows.
+template <typename T>
+void
+readValues(const char* file, off_t offset, TypeInfo const& ti,
+           std::size_t rowSize, std::size_t numRows, T* data,
+           bool parallel)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+        throw file_not_found(file);
+
+    bool complete = readRows(fd, offset, ti, rowSize, numRows, data,
+                             parallel);
+    close(fd);
+
+    if (!complete)
+    {
+        throw bad_format("Fewer values than POINT_DATA");
+    }
+}
+
 template <typename T>
 Image3D<T>
 loadDatImage(const char* file)
@@ -232,19 +283,14 @@ loadImage(const char* file, bool useDat = false)
     // These variables are all taken by reference
     loadHeader(stream, dim, spacing, zeroPos, npoints, ti);
 
-    std::size_t bufsize = npoints * ti.size();
-    std::vector<char> rbuf(bufsize);
-    stream.read(rbuf.data(), bufsize);
+    // The values start right after the header
+    off_t offset = stream.tellg();
+    stream.close();
 
     std::vector<T> data(dim[0] * dim[1] * dim[2]);
+    readValues(file, offset, ti, dim[0], dim[1] * dim[2], data.data(), true);
 
-    // Converts elements in the charachter vector to elements of type
-    // T and puts them into data.
-    convertBufferWithTypeInfo(rbuf.data(), ti, npoints, data.data());
-
-    stream.close();
-
-    return Image3D<T>(data, spacing, zeroPos, dim);
+    return Image3D<T>(std::move(data), spacing, zeroPos, dim);
 }
 
 } // util namespace
@@ -0,0 +1,120 @@
+/*
+ * MeshNormals.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef UTIL_MESHNORMALS_H_
+#define UTIL_MESHNORMALS_H_
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <string.h>
+
+#include "TriangleMesh.h"
+
+namespace util {
+
+// How the normals of the output mesh are made.
+enum class NormalMode
+{
+    none,     // No normals. No gradients of the image are computed.
+    gradient, // Interpolated from the gradients of the image at the two
+              // ends of each cut edge.
+    face      // Averaged from the triangles around each point once the
+              // mesh is made.
+};
+
+inline const char* normalModeName(NormalMode mode)
+{
+    switch(mode)
+    {
+    case NormalMode::none:
+        return "none";
+    case NormalMode::gradient:
+        return "gradient";
+    case NormalMode::face:
+        return "face";
+    }
+    return "";
+}
+
+// Reads "none", "gradient" or "face" into mode. Returns false if name is
+// none of them.
+inline bool parseNormalMode(const char* name, NormalMode& mode)
+{
+    for(NormalMode m : { NormalMode::none,
+                         NormalMode::gradient,
+                         NormalMode::face })
+    {
+        if(strcmp(name, normalModeName(m)) == 0)
+        {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Sets the normal of each point of mesh to the sum of the normals of the
+// triangles around it, weighted by their areas, scaled to unit length. The
+// normals point the same way as the gradients of the image.
+template <typename T>
+void
+computeFaceNormals(TriangleMesh<T>& mesh)
+{
+    size_t numPoints = mesh.numberOfVertices();
+    auto points = mesh.pointsBegin();
+
+    std::vector<std::array<T, 3> > normals(numPoints, {{0, 0, 0}});
+
+    // The cross product of two edges of a triangle is its normal scaled by
+    // twice its area.
+    for(auto iter = mesh.trianglesBegin(); iter != mesh.trianglesEnd(); ++iter)
+    {
+        std::array<T, 3> const& a = points[(*iter)[0]];
+        std::array<T, 3> const& b = points[(*iter)[1]];
+        std::array<T, 3> const& c = points[(*iter)[2]];
+
+        std::array<T, 3> u = {{ b[0] - a[0], b[1] - a[1], b[2] - a[2] }};
+        std::array<T, 3> v = {{ c[0] - a[0], c[1] - a[1], c[2] - a[2] }};
+
+        // The triangles of the case tables wind counterclockwise seen from
+        // the side the gradient points to, so u x v points along it.
+        std::array<T, 3> f = {{ u[1]*v[2] - u[2]*v[1],
+                                u[2]*v[0] - u[0]*v[2],
+                                u[0]*v[1] - u[1]*v[0] }};
+
+        for(int i = 0; i != 3; ++i)
+        {
+            std::array<T, 3>& n = normals[(*iter)[i]];
+            n[0] += f[0];
+            n[1] += f[1];
+            n[2] += f[2];
+        }
+    }
+
+    for(std::array<T, 3>& n: normals)
+    {
+        T length = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if(length > 0)
+        {
+            n[0] /= length;
+            n[1] /= length;
+            n[2] /= length;
+        }
+    }
+
+    mesh.setNormals(std::move(normals));
+}
+
+} // util namespace
+
+#endif
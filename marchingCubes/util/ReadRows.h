@@ -0,0 +1,115 @@
+/*
+ * ReadRows.h
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#ifndef UTIL_READROWS_H_
+#define UTIL_READROWS_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <errno.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Reading the values of an image file with pread for LoadImage.h, which
+// converts them with ConvertBuffer.h.
+
+namespace util {
+
+// Rows of an image are read this many bytes at a time
+const std::size_t readChunkSize = 1 << 23;
+
+// Reads size bytes at offset in fd into buf, with as many preads as it
+// takes. Returns false if the file ends first or a read fails.
+inline bool
+preadAll(int fd, char* buf, std::size_t size, off_t offset)
+{
+    while (size != 0)
+    {
+        ssize_t n = pread(fd, buf, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+
+        buf += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// Reads numRows rows of rowBytes bytes from fd, starting at offset. Each
+// thread reads its block of the rows with pread a chunk at a time and calls
+// convert(in, row, n) on the n rows starting at row once they are in in, so
+// the only buffer is a chunk per thread. If inPlace is not null, the rows
+// are read straight into inPlace + row * rowBytes instead. With parallel
+// set, the rows are split among the threads the same way a parallel for
+// over them does. Returns false if the file is too short.
+template <typename Convert>
+bool
+readRowChunks(int fd, off_t offset, std::size_t rowBytes,
+              std::size_t numRows, char* inPlace, bool parallel,
+              Convert convert)
+{
+    std::size_t const chunkRows =
+        std::max(readChunkSize / std::max(rowBytes, std::size_t(1)),
+                 std::size_t(1));
+    bool complete = true;
+
+#ifdef _OPENMP
+    #pragma omp parallel if(parallel)
+#else
+    (void)parallel;
+#endif
+    {
+        // A static schedule gives each thread one block of rows.
+        std::size_t rowBegin = numRows;
+        std::size_t rowEnd = 0;
+        std::size_t r;
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for(r = 0; r < numRows; r++)
+        {
+            rowBegin = std::min(rowBegin, r);
+            rowEnd = r + 1;
+        }
+
+        std::vector<char> rbuf;
+        if (!inPlace && rowBegin < rowEnd)
+            rbuf.resize(std::min(chunkRows, rowEnd - rowBegin) * rowBytes);
+
+        for(std::size_t row = rowBegin; row < rowEnd; row += chunkRows)
+        {
+            std::size_t n = std::min(chunkRows, rowEnd - row);
+            char* in = inPlace ? inPlace + row * rowBytes : rbuf.data();
+
+            if (!preadAll(fd, in, n * rowBytes, offset + row * rowBytes))
+            {
+#ifdef _OPENMP
+                #pragma omp critical
+#endif
+                complete = false;
+                break;
+            }
+            convert(in, row, n);
+        }
+    }
+
+    return complete;
+}
+
+}
+
+#endif
@@ -73,9 +73,9 @@ saveTriangleMesh(TriangleMesh<T> const& mesh, const char* fileName)
     stream << std::endl;
 
     // Writing triangle indices
-    bufsize = ntriangles * 4 * sizeof(size_t);
+    bufsize = ntriangles * 4 * sizeof(index_t);
     wbuff.resize(bufsize);
-    size_t *ind = reinterpret_cast<size_t*>(&wbuff[0]);
+    index_t *ind = reinterpret_cast<index_t*>(&wbuff[0]);
 
     TriangleIterator triBegIter = mesh.trianglesBegin();
     TriangleIterator triEndIter = mesh.trianglesEnd();
@@ -94,26 +94,29 @@ saveTriangleMesh(TriangleMesh<T> const& mesh, const char* fileName)
     stream.write(&wbuff[0], wbuff.size());
     stream << std::endl;
 
-    // Writing normals
-    bufsize = nverts * spacialDimensions * sizeof(T);
-    wbuff.resize(bufsize);
-    bufPointer = reinterpret_cast<T*>(&wbuff[0]);
-
-    NormalIterator norBegIter = mesh.normalsBegin();
-    NormalIterator norEndIter = mesh.normalsEnd();
-    for(NormalIterator iter = norBegIter; iter != norEndIter; ++iter)
+    // Writing normals. A mesh made without normals has none to write.
+    if(mesh.numberOfNormals() == nverts)
     {
-        for (int i = 0; i < 3; ++i)
+        bufsize = nverts * spacialDimensions * sizeof(T);
+        wbuff.resize(bufsize);
+        bufPointer = reinterpret_cast<T*>(&wbuff[0]);
+
+        NormalIterator norBegIter = mesh.normalsBegin();
+        NormalIterator norEndIter = mesh.normalsEnd();
+        for(NormalIterator iter = norBegIter; iter != norEndIter; ++iter)
         {
-            *bufPointer = (*iter)[i];
-            flipEndianness(*bufPointer++);
+            for (int i = 0; i < 3; ++i)
+            {
+                *bufPointer = (*iter)[i];
+                flipEndianness(*bufPointer++);
+            }
         }
-    }
 
-    stream << "POINT_DATA " << nverts << std::endl;
-    stream << "NORMALS Normals " << ti.name() << std::endl;
-    stream.write(&wbuff[0], wbuff.size());
-    stream << std::endl;
+        stream << "POINT_DATA " << nverts << std::endl;
+        stream << "NORMALS Normals " << ti.name() << std::endl;
+        stream.write(&wbuff[0], wbuff.size());
+        stream << std::endl;
+    }
 
     stream.close();
 }
@@ -18,9 +18,30 @@
 
 #include <vector>
 #include <array>
+#include <limits>
+#include <cstdint>
+#include <utility>
+
+#include "Errors.h"
 
 namespace util {
 
+// With MESH_INDEX32 defined, the point indices of the triangles are kept and
+// saved in 32 bits. Making a mesh with more points throws index_overflow.
+#ifdef MESH_INDEX32
+using index_t = uint32_t;
+#else
+using index_t = size_t;
+#endif
+
+inline void checkIndexRange(size_t numPoints)
+{
+    if(numPoints > std::numeric_limits<index_t>::max())
+    {
+        throw index_overflow("Too many points for index_t");
+    }
+}
+
 template <typename T>
 class TriangleMesh
 {
@@ -30,7 +51,7 @@ public:
     using NormalIterator =
         typename std::vector<std::array<T, 3> >::const_iterator;
     using TriangleIterator =
-        typename std::vector<std::array<size_t, 3> >::const_iterator;
+        typename std::vector<std::array<index_t, 3> >::const_iterator;
 
     TriangleMesh()
     {}
@@ -38,11 +59,13 @@ public:
     TriangleMesh(
         std::vector<std::array<T, 3> > points,
         std::vector<std::array<T, 3> > normals,
-        std::vector<std::array<size_t, 3> > indexTriangles)
+        std::vector<std::array<index_t, 3> > indexTriangles)
       : points(points),
         normals(normals),
         indexTriangles(indexTriangles)
-    {}
+    {
+        checkIndexRange(this->points.size());
+    }
 
     std::size_t numberOfVertices() const
     {
@@ -54,6 +77,17 @@ public:
         return indexTriangles.size();
     }
 
+    // A mesh made without normals has none, else one per vertex.
+    std::size_t numberOfNormals() const
+    {
+        return normals.size();
+    }
+
+    void setNormals(std::vector<std::array<T, 3> > newNormals)
+    {
+        normals = std::move(newNormals);
+    }
+
     PointIterator pointsBegin() const
     {
         return points.begin();
@@ -87,7 +121,7 @@ public:
 private:
     std::vector<std::array<T, 3> > points;
     std::vector<std::array<T, 3> > normals;
-    std::vector<std::array<size_t, 3> > indexTriangles;
+    std::vector<std::array<index_t, 3> > indexTriangles;
 };
 
 }
@@ -23,6 +23,7 @@
 
 #include <algorithm>
 #include <unordered_map>
+#include <cstdint>
 
 #include "../../marchingCubes/util/TriangleMesh.h"
 #include "../../marchingCubes/util/ConvertBuffer.h"
@@ -56,10 +57,72 @@ bool checkSameFiles(char* fileA, char* fileB)
     return streamA.eof() && streamB.eof();
 }
 
+// The point indices of the triangles are 32 or 64 bits depending on how
+// the mesh was made. The triangles are followed by a newline and then
+// either POINT_DATA or, for a mesh without normals, the end of the file.
+// The size that puts exactly that right after the triangles is the one
+// used. stream is left where it was.
+size_t findIndexSize(std::ifstream& stream, size_t ntriangles)
+{
+    std::string const normalsBeg = "\nPOINT_DATA";
+
+    std::streampos trianglesBeg = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    std::streampos fileEnd = stream.tellg();
+
+    size_t indexSize = sizeof(uint64_t);
+    for(size_t size: {sizeof(uint32_t), sizeof(uint64_t)})
+    {
+        std::streampos trianglesEnd =
+            trianglesBeg + std::streamoff(ntriangles * 4 * size);
+        if(trianglesEnd >= fileEnd)
+        {
+            continue;
+        }
+
+        std::string bytes(normalsBeg.size(), '\0');
+        stream.seekg(trianglesEnd);
+        stream.read(&bytes[0], bytes.size());
+        size_t numRead = stream.gcount();
+        stream.clear();
+
+        bool atNormals = bytes == normalsBeg;
+        bool atEnd = numRead == 1 && bytes[0] == '\n';
+        if(atNormals || atEnd)
+        {
+            indexSize = size;
+            break;
+        }
+    }
+    stream.clear();
+    stream.seekg(trianglesBeg);
+    return indexSize;
+}
+
+template <typename I>
+void readTriangles(
+    std::vector<char>& wbuff,
+    std::vector<std::array<util::index_t, 3> >& indexTriangles)
+{
+    I* bufPointer = reinterpret_cast<I*>(&wbuff[0]);
+    for(std::array<util::index_t, 3>& tri: indexTriangles)
+    {
+        util::flipEndianness(bufPointer[1]);
+        util::flipEndianness(bufPointer[2]);
+        util::flipEndianness(bufPointer[3]);
+
+        tri[0] = bufPointer[1];
+        tri[1] = bufPointer[2];
+        tri[2] = bufPointer[3];
+
+        bufPointer += 4;
+    }
+}
+
 util::TriangleMesh<float> LoadFloatMesh(char* file)
 {
     std::vector<std::array<float, 3> > points;
-    std::vector<std::array<size_t, 3> > indexTriangles;
+    std::vector<std::array<util::index_t, 3> > indexTriangles;
     std::vector<std::array<float, 3> > normals;
 
     std::ifstream stream(file);
@@ -80,7 +143,6 @@ util::TriangleMesh<float> LoadFloatMesh(char* file)
         lineStream >> discard >> nverts >> discard;
     }
     points.resize(nverts);
-    normals.resize(nverts);
 
     std::vector<char> wbuff;
     size_t spatialDimensions = 3;
@@ -123,31 +185,33 @@ util::TriangleMesh<float> LoadFloatMesh(char* file)
     }
     indexTriangles.resize(ntriangles);
 
-    bufsize = ntriangles * 4 * sizeof(size_t);
+    size_t indexSize = findIndexSize(stream, ntriangles);
+    bufsize = ntriangles * 4 * indexSize;
     wbuff.resize(bufsize);
     {
         stream.read(&wbuff[0], wbuff.size());
 
-        size_t* bufPointer = reinterpret_cast<size_t*>(&wbuff[0]);
-        for(std::array<size_t, 3>& tri: indexTriangles)
+        if(indexSize == sizeof(uint32_t))
         {
-            util::flipEndianness(bufPointer[1]);
-            util::flipEndianness(bufPointer[2]);
-            util::flipEndianness(bufPointer[3]);
-
-            tri[0] = bufPointer[1];
-            tri[1] = bufPointer[2];
-            tri[2] = bufPointer[3];
-
-            bufPointer += 4;
+            readTriangles<uint32_t>(wbuff, indexTriangles);
+        }
+        else
+        {
+            readTriangles<uint64_t>(wbuff, indexTriangles);
         }
 
         std::getline(stream, line);
     }
 
+    // A mesh made without normals ends after the triangles.
     std::getline(stream, line);
+    if(line.compare(0, 10, "POINT_DATA") != 0)
+    {
+        return util::TriangleMesh<float>(points, normals, indexTriangles);
+    }
     std::getline(stream, line);
 
+    normals.resize(nverts);
     bufsize = nverts * spatialDimensions * floatSize;
     wbuff.resize(bufsize);
     {
@@ -218,6 +282,14 @@ bool sameMesh(
     }
     */
 
+    // Either both meshes have normals or neither does.
+    bool withNormals = meshA.numberOfNormals() != 0;
+    if(withNormals != (meshB.numberOfNormals() != 0))
+    {
+        std::cout << "only one mesh has normals" << std::endl;
+        return false;
+    }
+
     UnorderedMapArr<float> pointIdxA, pointIdxB;
     UnorderedMapArr<float> normalIdxA, normalIdxB;
 
@@ -231,7 +303,10 @@ bool sameMesh(
     for(size_t i = 0; i != meshB.numberOfVertices(); ++i)
     {
         pointIdxB[pointsB[i]] = i;
-        normalIdxB[normalsB[i]] = i;
+        if(withNormals)
+        {
+            normalIdxB[normalsB[i]] = i;
+        }
     }
 
     for(size_t i = 0; i != meshA.numberOfVertices(); ++i)
@@ -243,8 +318,7 @@ bool sameMesh(
             return false;
         }
 
-        auto itFoundNormal = normalIdxB.find(normalsA[i]);
-        if(itFoundNormal == normalIdxB.end())
+        if(withNormals && normalIdxB.find(normalsA[i]) == normalIdxB.end())
         {
             std::cout << "normal not found" << std::endl;
             return false;
@@ -255,7 +329,10 @@ bool sameMesh(
     for(size_t i = 0; i != meshA.numberOfVertices(); ++i)
     {
         pointIdxA[pointsA[i]] = i;
-        normalIdxA[normalsA[i]] = i;
+        if(withNormals)
+        {
+            normalIdxA[normalsA[i]] = i;
+        }
     }
 
     for(size_t i = 0; i != meshB.numberOfVertices(); ++i)
@@ -267,8 +344,7 @@ bool sameMesh(
             return false;
         }
 
-        auto itFoundNormal = normalIdxA.find(normalsB[i]);
-        if(itFoundNormal == normalIdxA.end())
+        if(withNormals && normalIdxA.find(normalsB[i]) == normalIdxA.end())
         {
             std::cout << "normal not found" << std::endl;
             return false;
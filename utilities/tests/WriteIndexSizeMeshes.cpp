@@ -0,0 +1,114 @@
+/*
+ * tests/WriteIndexSizeMeshes.cpp
+ *
+ * miniIsosurface is distributed under the OSI-approved BSD 3-clause License.
+ * See LICENSE.txt for details.
+ *
+ * Copyright (c) 2017
+ * National Technology & Engineering Solutions of Sandia, LLC (NTESS). Under
+ * the terms of Contract DE-NA0003525 with NTESS, the U.S. Government retains
+ * certain rights in this software.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+
+#include <vector>
+#include <array>
+
+#include <cstdint>
+
+#include "../../marchingCubes/util/ConvertBuffer.h"
+
+using std::size_t;
+
+// Writes the same mesh with 32 and 64 bit triangle indices, with and
+// without normals, for SameContentsCheck to compare. The indices are all
+// small, so the second half of the 64 bit indices has no newline in it and
+// looks like the end of 32 bit indices to a reader that skips to the next
+// line.
+
+static std::vector<std::array<float, 3> > const points = {{
+    {{ 0.0f, 0.0f, 0.0f }}, {{ 1.0f, 0.0f, 0.0f }},
+    {{ 0.0f, 1.0f, 0.0f }}, {{ 0.0f, 0.0f, 1.0f }},
+    {{ 1.0f, 1.0f, 0.0f }}, {{ 1.0f, 0.0f, 1.0f }}
+}};
+
+static std::vector<std::array<size_t, 3> > const triangles = {{
+    {{ 0, 1, 2 }}, {{ 0, 1, 3 }}, {{ 0, 2, 3 }}, {{ 1, 2, 3 }},
+    {{ 1, 2, 4 }}, {{ 1, 3, 5 }}, {{ 1, 4, 5 }}, {{ 2, 3, 4 }}
+}};
+
+void writeVectors(
+    std::ofstream& stream,
+    std::vector<std::array<float, 3> > const& vectors)
+{
+    std::vector<float> wbuff;
+    for(std::array<float, 3> const& v: vectors)
+    {
+        for(float c: v)
+        {
+            util::flipEndianness(c);
+            wbuff.push_back(c);
+        }
+    }
+    stream.write(reinterpret_cast<const char*>(wbuff.data()),
+                 wbuff.size() * sizeof(float));
+    stream << std::endl;
+}
+
+template <typename I>
+void writeMesh(std::string const& fileName, bool withNormals)
+{
+    std::ofstream stream(fileName.c_str(), std::ios::binary);
+
+    stream << "# vtk DataFile Version 3.0" << std::endl;
+    stream << "Isosurface Mesh" << std::endl;
+    stream << "BINARY" << std::endl;
+    stream << "DATASET POLYDATA" << std::endl;
+    stream << "POINTS " << points.size() << " float" << std::endl;
+    writeVectors(stream, points);
+
+    std::vector<I> wbuff;
+    for(std::array<size_t, 3> const& tri: triangles)
+    {
+        I value = 3;
+        util::flipEndianness(value);
+        wbuff.push_back(value);
+        for(size_t idx: tri)
+        {
+            value = idx;
+            util::flipEndianness(value);
+            wbuff.push_back(value);
+        }
+    }
+    stream << "POLYGONS " << triangles.size() << " "
+           << triangles.size() * 4 << std::endl;
+    stream.write(reinterpret_cast<const char*>(wbuff.data()),
+                 wbuff.size() * sizeof(I));
+    stream << std::endl;
+
+    if(withNormals)
+    {
+        stream << "POINT_DATA " << points.size() << std::endl;
+        stream << "NORMALS Normals float" << std::endl;
+        writeVectors(stream, points);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc != 2)
+    {
+        std::cout << "Usage: " << argv[0] << " outputDirectory" << std::endl;
+        return 1;
+    }
+    std::string dir = argv[1];
+
+    writeMesh<uint32_t>(dir + "/index32.vtk", true);
+    writeMesh<uint64_t>(dir + "/index64.vtk", true);
+    writeMesh<uint32_t>(dir + "/index32NoNormals.vtk", false);
+    writeMesh<uint64_t>(dir + "/index64NoNormals.vtk", false);
+    return 0;
+}